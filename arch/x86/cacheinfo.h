@@ -0,0 +1,504 @@
+/*
+@ KrnlAid cache and TLB hierarchy
+@ cacheinfo_decode() turns CPUID into a table of caches(level, type, size, line size, ways, sets and how many
+@ logical processors share it) and TLBs, for memcpy thresholds, allocator coloring and blocking factors.
+@ Caches come from, in order of preference:
+@ - leaf 4(Intel deterministic cache parameters)
+@ - leaf 0x8000001D(AMD, needs TOPOEXT)
+@ - leaf 2 descriptors(old Intel CPUs)
+@ - leaves 0x80000005/0x80000006(old AMD CPUs, the sharing count is unknown there)
+@ TLBs come from leaf 0x18, the leaf 2 descriptors or 0x80000005/0x80000006.
+@
+@ How to use:
+@ 1, define CACHEINFO_IMPL in exactly one source file
+@ 2, cache_info_t info; cacheinfo_decode(&info, cpuid_native);
+@ 3, const cache_desc_t* llc = cacheinfo_last_level(&info);
+@ The source can also replay a recorded CPUID dump, which is how the decoder is checked against other CPUs.
+*/
+
+#ifndef __CACHEINFO_H__
+#define __CACHEINFO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpuid.h"
+
+//Maximum number of caches and TLBs kept, can be overriden
+#ifndef CACHEINFO_MAX_CACHES
+#define CACHEINFO_MAX_CACHES 8
+#endif
+#ifndef CACHEINFO_MAX_TLBS
+#define CACHEINFO_MAX_TLBS 16
+#endif
+
+//Page sizes a TLB holds
+#define TLB_PAGE_4K 1
+#define TLB_PAGE_2M (1 << 1)
+#define TLB_PAGE_4M (1 << 2)
+#define TLB_PAGE_1G (1 << 3)
+
+typedef struct {
+    uint8_t level;
+    uint8_t type;              //CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_*
+    uint8_t fully_associative;
+    uint8_t inclusive;         //of the lower levels, only known from leaf 4/0x8000001D
+    uint32_t line_size;
+    uint32_t ways;
+    uint32_t partitions;
+    uint32_t sets;
+    uint32_t sharing;          //logical processors sharing this cache, 0 if unknown
+    uint64_t size;             //bytes
+} cache_desc_t;
+
+typedef struct {
+    uint8_t level;
+    uint8_t type;              //CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_*
+    uint8_t page_sizes;        //TLB_PAGE_*
+    uint8_t fully_associative;
+    uint32_t entries;
+    uint32_t ways;
+} tlb_desc_t;
+
+typedef struct {
+    cache_desc_t caches[CACHEINFO_MAX_CACHES]; //sorted by level, data before instruction
+    tlb_desc_t tlbs[CACHEINFO_MAX_TLBS];
+    uint32_t cache_count;
+    uint32_t tlb_count;
+    uint32_t prefetch_size;    //leaf 2 prefetch hint in bytes, 0 if not reported
+} cache_info_t;
+
+//Fills info from a CPUID source
+void cacheinfo_decode(cache_info_t* info, cpuid_fn_t source);
+
+//Finds a cache by level and type(data or instruction also match a unified cache), NULL if there is none
+static inline const cache_desc_t* cacheinfo_find(const cache_info_t* info, uint32_t level, uint32_t type) {
+    for (uint32_t i = 0; i < info->cache_count; i++) {
+        const cache_desc_t* c = &info->caches[i];
+        if (c->level == level && (c->type == type || c->type == CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_UNIFIED)) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+//The last level data cache, NULL if no cache was reported
+static inline const cache_desc_t* cacheinfo_last_level(const cache_info_t* info) {
+    const cache_desc_t* llc = NULL;
+    for (uint32_t i = 0; i < info->cache_count; i++) {
+        const cache_desc_t* c = &info->caches[i];
+        if (c->type != CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION && (llc == NULL || c->level > llc->level)) {
+            llc = c;
+        }
+    }
+    return llc;
+}
+
+//Size of a cache in bytes, 0 if there is none
+static inline uint64_t cacheinfo_size(const cache_info_t* info, uint32_t level, uint32_t type) {
+    const cache_desc_t* c = cacheinfo_find(info, level, type);
+    return c != NULL ? c->size : 0;
+}
+
+//Line size of the L1 data cache, 64 if it is unknown
+static inline uint32_t cacheinfo_line_size(const cache_info_t* info) {
+    const cache_desc_t* c = cacheinfo_find(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA);
+    return c != NULL && c->line_size != 0 ? c->line_size : 64;
+}
+
+#ifdef CACHEINFO_IMPL
+    //=================Leaf 2 descriptors=================
+
+    typedef struct {
+        uint8_t descriptor;
+        uint8_t is_tlb;
+        uint8_t level;
+        uint8_t type;
+        uint8_t ways;       //0xFF = fully associative, 0 = not specified
+        uint8_t page_sizes; //TLBs only
+        uint16_t line_size; //caches only
+        uint32_t size;      //KB for caches, entries for TLBs
+    } __cacheinfo_desc_t;
+
+    #define __CACHE(desc, level, type, kb, ways, line) { desc, 0, level, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_##type, ways, 0, line, kb }
+    #define __TLB(desc, level, type, pages, entries, ways) { desc, 1, level, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_##type, ways, pages, 0, entries }
+    #define __4K TLB_PAGE_4K
+    #define __2M TLB_PAGE_2M
+    #define __4M TLB_PAGE_4M
+    #define __1G TLB_PAGE_1G
+
+    //Intel SDM vol. 2A, table 3-12, trace caches are left out(their size is in uops)
+    static const __cacheinfo_desc_t __cacheinfo_descs[] = {
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_4_KBYTE_4WAY_32E, 1, INSTRUCTION, __4K, 32, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_4_MBYTE_FULLY_2E, 1, INSTRUCTION, __4M, 2, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4_KBYTE_4WAY_64E, 1, DATA, __4K, 64, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4_MBYTE_4WAY_8E, 1, DATA, __4M, 8, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB1_4_MBYTE_4WAY_32E, 1, DATA, __4M, 32, 4),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_INST_8K_4WAY_32B, 1, INSTRUCTION, 8, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_INST_16K_4WAY_32B, 1, INSTRUCTION, 16, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_INST_32K_4WAY_64B, 1, INSTRUCTION, 32, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_8K_2WAY_32B, 1, DATA, 8, 2, 32),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_4_MBYTE_4WAY_4E, 1, INSTRUCTION, __4M, 4, 4),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_16K_4WAY_32B, 1, DATA, 16, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_16K_4WAY_64B, 1, DATA, 16, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_24K_6WAY_64B, 1, DATA, 24, 6, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_128K_2WAY_64B, 2, UNIFIED, 128, 2, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_256K_8WAY_64B, 2, UNIFIED, 256, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_512K_4WAY_64B_2LPS, 3, UNIFIED, 512, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_1M_8WAY_64B_2LPS, 3, UNIFIED, 1024, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_16WAY_64B, 2, UNIFIED, 1024, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_2M_8WAY_64B_2LPS, 3, UNIFIED, 2048, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_4M_8WAY_64B_2LPS, 3, UNIFIED, 4096, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_32K_8WAY_64B, 1, DATA, 32, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_INST_32K_8WAY_64B, 1, INSTRUCTION, 32, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_128K_4WAY_32B, 2, UNIFIED, 128, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_256K_4WAY_32B, 2, UNIFIED, 256, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_4WAY_32B, 2, UNIFIED, 512, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_4WAY_32B, 2, UNIFIED, 1024, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_2M_4WAY_32B, 2, UNIFIED, 2048, 4, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_4M_4WAY_64B, 3, UNIFIED, 4096, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_8M_8WAY_64B, 3, UNIFIED, 8192, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_3M_12WAY_64B, 2, UNIFIED, 3072, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_4M_16WAY_64B, 3, UNIFIED, 4096, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_6M_12WAY_64B, 3, UNIFIED, 6144, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_8M_16WAY_64B, 3, UNIFIED, 8192, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_12M_12WAY_64B, 3, UNIFIED, 12288, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L3_16M_16WAY_64B, 3, UNIFIED, 16384, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_6M_24WAY_64B, 2, UNIFIED, 6144, 24, 64),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_32E, 1, INSTRUCTION, __4K, 32, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_2M_4M_64E, 1, INSTRUCTION, __4K | __2M | __4M, 64, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_2M_4M_128E, 1, INSTRUCTION, __4K | __2M | __4M, 128, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_2M_4M_256E, 1, INSTRUCTION, __4K | __2M | __4M, 256, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_2M_4M_FULLY_7E, 1, INSTRUCTION, __2M | __4M, 7, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB0_4M_4WAY_16E, 1, DATA, __4M, 16, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB0_4K_4WAY_16E, 1, DATA, __4K, 16, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB0_4K_FULLY_16E, 1, DATA, __4K, 16, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB0_2M_4M_4WAY_32E, 1, DATA, __2M | __4M, 32, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_4M_64E, 1, DATA, __4K | __4M, 64, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_4M_128E, 1, DATA, __4K | __4M, 128, 0),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_4M_256E, 1, DATA, __4K | __4M, 256, 0),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_16K_8WAY_64B, 1, DATA, 16, 8, 64),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_FULLY_48E, 1, INSTRUCTION, __4K, 48, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_2M_4M_32E_1G_4WAY_4E, 1, DATA, __2M | __4M, 32, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_2M_4M_32E_1G_4WAY_4E, 1, DATA, __1G, 4, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_4WAY_512E, 1, DATA, __4K, 512, 4),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_8K_4WAY_64B, 1, DATA, 8, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_16K_4WAY_64B_DUPLICATE, 1, DATA, 16, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L1_DATA_32K_4WAY_64B, 1, DATA, 32, 4, 64),
+        __TLB(CPUID_CACHE_TLB_DESC_UTLB_4K_8WAY_64E, 1, DATA, __4K, 64, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_8WAY_256E, 1, DATA, __4K, 256, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_2M_4M_8WAY_128E, 1, DATA, __2M | __4M, 128, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_1G_FULLY_16E, 1, DATA, __1G, 16, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_2M_4M_FULLY_8E, 1, INSTRUCTION, __2M | __4M, 8, 0xFF),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_4WAY_64B, 2, UNIFIED, 1024, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_128K_8WAY_64B_2LPS, 2, UNIFIED, 128, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_256K_8WAY_64B_2LPS, 2, UNIFIED, 256, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_8WAY_64B_2LPS, 2, UNIFIED, 512, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_8WAY_64B_2LPS, 2, UNIFIED, 1024, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_2M_8WAY_64B, 2, UNIFIED, 2048, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_2WAY_64B, 2, UNIFIED, 512, 2, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_8WAY_64B, 2, UNIFIED, 512, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_256K_8WAY_32B, 2, UNIFIED, 256, 8, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_8WAY_32B, 2, UNIFIED, 512, 8, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_8WAY_32B, 2, UNIFIED, 1024, 8, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_2M_8WAY_32B, 2, UNIFIED, 2048, 8, 32),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_512K_4WAY_64B, 2, UNIFIED, 512, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_L2_1M_8WAY_64B, 2, UNIFIED, 1024, 8, 64),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_FULLY_ASSOC_32E, 1, DATA, __4K, 32, 0xFF),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_4WAY_128E, 1, INSTRUCTION, __4K, 128, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_2M_4WAY_8E_4M_4WAY_4E, 1, INSTRUCTION, __2M, 8, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_2M_4WAY_8E_4M_4WAY_4E, 1, INSTRUCTION, __4M, 4, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_4WAY_64E, 1, INSTRUCTION, __4K, 64, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_DATA_4K_4WAY_128E, 1, DATA, __4K, 128, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_DATA_4K_4WAY_256E, 1, DATA, __4K, 256, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_8WAY_64E, 1, INSTRUCTION, __4K, 64, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_INST_4K_8WAY_128E, 1, INSTRUCTION, __4K, 128, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_DATA_4K_4WAY_64E, 1, DATA, __4K, 64, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_TLB_DATA_4K_4M_4WAY_8E, 1, DATA, __4K | __4M, 8, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_STLB_2ND_LEVEL_4K_2M_8WAY_1024E, 2, UNIFIED, __4K | __2M, 1024, 8),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_4K_2M_4WAY_16E, 1, DATA, __4K | __2M, 16, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_STLB_2ND_LEVEL_4K_2M_6WAY_1536E_1GB_4WAY_16E, 2, UNIFIED, __4K | __2M, 1536, 6),
+        __TLB(CPUID_CACHE_TLB_DESC_STLB_2ND_LEVEL_4K_2M_6WAY_1536E_1GB_4WAY_16E, 2, UNIFIED, __1G, 16, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_DTLB_2M_4M_4WAY_32E, 1, DATA, __2M | __4M, 32, 4),
+        __TLB(CPUID_CACHE_TLB_DESC_STLB_2ND_LEVEL_4K_4WAY_512E, 2, UNIFIED, __4K, 512, 4),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_512KB_4WAY_64B_LINE, 3, UNIFIED, 512, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_1MB_4WAY_64B_LINE, 3, UNIFIED, 1024, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_2MB_4WAY_64B_LINE, 3, UNIFIED, 2048, 4, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_1MB_8WAY_64B_LINE, 3, UNIFIED, 1024, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_2MB_8WAY_64B_LINE, 3, UNIFIED, 2048, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_4MB_8WAY_64B_LINE, 3, UNIFIED, 4096, 8, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_1_5MB_12WAY_64B_LINE, 3, UNIFIED, 1536, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_3MB_12WAY_64B_LINE, 3, UNIFIED, 3072, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_6MB_12WAY_64B_LINE, 3, UNIFIED, 6144, 12, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_2MB_16WAY_64B_LINE, 3, UNIFIED, 2048, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_4MB_16WAY_64B_LINE, 3, UNIFIED, 4096, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_8MB_16WAY_64B_LINE, 3, UNIFIED, 8192, 16, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_12MB_24WAY_64B_LINE, 3, UNIFIED, 12288, 24, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_18MB_24WAY_64B_LINE, 3, UNIFIED, 18432, 24, 64),
+        __CACHE(CPUID_CACHE_TLB_DESC_CACHE_3RD_LEVEL_24MB_24WAY_64B_LINE, 3, UNIFIED, 24576, 24, 64),
+    };
+
+    #undef __CACHE
+    #undef __TLB
+    #undef __4K
+    #undef __2M
+    #undef __4M
+    #undef __1G
+
+    //=================Helpers=================
+
+    static void __cacheinfo_add_cache(cache_info_t* info, const cache_desc_t* c) {
+        uint32_t i;
+        if (info->cache_count == CACHEINFO_MAX_CACHES) {
+            return;
+        }
+        //keep the table sorted by level, then type(data, instruction, unified)
+        i = info->cache_count++;
+        while (i > 0 && (info->caches[i - 1].level > c->level ||
+                (info->caches[i - 1].level == c->level && info->caches[i - 1].type > c->type))) {
+            info->caches[i] = info->caches[i - 1];
+            i--;
+        }
+        info->caches[i] = *c;
+    }
+
+    //Adds a cache only known by its size, ways(0xFF = fully associative) and line size
+    static void __cacheinfo_add_sized(cache_info_t* info, uint8_t level, uint8_t type, uint64_t size, uint32_t ways, uint32_t line_size) {
+        cache_desc_t c;
+        if (size == 0 || line_size == 0) {
+            return;
+        }
+        c.level = level;
+        c.type = type;
+        c.fully_associative = ways == 0xFF;
+        c.inclusive = 0;
+        c.line_size = line_size;
+        c.partitions = 1;
+        c.sharing = 0;
+        c.size = size;
+        if (ways == 0xFF || ways == 0) {
+            c.ways = (uint32_t)(size / line_size);
+            c.sets = 1;
+        } else {
+            c.ways = ways;
+            c.sets = (uint32_t)(size / ((uint64_t)ways * line_size));
+        }
+        __cacheinfo_add_cache(info, &c);
+    }
+
+    static void __cacheinfo_add_tlb(cache_info_t* info, uint8_t level, uint8_t type, uint8_t page_sizes, uint32_t entries, uint32_t ways) {
+        tlb_desc_t* t;
+        if (entries == 0 || info->tlb_count == CACHEINFO_MAX_TLBS) {
+            return;
+        }
+        t = &info->tlbs[info->tlb_count++];
+        t->level = level;
+        t->type = type;
+        t->page_sizes = page_sizes;
+        t->fully_associative = ways == 0xFF;
+        t->entries = entries;
+        t->ways = ways == 0xFF ? entries : ways;
+    }
+
+    //Leaf 4 and 0x8000001D share their layout
+    static void __cacheinfo_deterministic(cache_info_t* info, cpuid_fn_t source, uint32_t leaf) {
+        uint32_t regs[4];
+        for (uint32_t i = 0; i < CACHEINFO_MAX_CACHES; i++) {
+            cache_desc_t c;
+            source(leaf, i, regs);
+            c.type = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_CACHE_TYPE);
+            if (c.type == CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_NULL) {
+                break;
+            }
+            c.level = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_CACHE_LEVEL);
+            c.fully_associative = (regs[0] & (CPUID_CACHE_PARAMS_EAX_IS_FULLY_ASSOCIATIVE)) != 0;
+            c.sharing = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_MAX_PROC_SHARING) + 1;
+            c.line_size = CPUID_FIELD(regs[1], CPUID_CACHE_PARAMS_EBX_COHERENCY_LINE_SIZE) + 1;
+            c.partitions = CPUID_FIELD(regs[1], CPUID_CACHE_PARAMS_EBX_PHYS_LINE_PARTITIONS) + 1;
+            c.ways = CPUID_FIELD(regs[1], CPUID_CACHE_PARAMS_EBX_WAYS_OF_ASSOCIVITY) + 1;
+            c.sets = regs[2] + 1;
+            c.inclusive = (regs[3] & (CPUID_CACHE_PARAMS_EDX_CACHE_INCLUSIVENESS)) != 0;
+            c.size = (uint64_t)c.ways * c.partitions * c.line_size * c.sets;
+            __cacheinfo_add_cache(info, &c);
+        }
+    }
+
+    //Leaf 2, one byte descriptors, the lowest byte of EAX is the iteration count(always 1)
+    static void __cacheinfo_leaf2(cache_info_t* info, cpuid_fn_t source, int want_caches, int* use_leaf4, int* use_leaf18) {
+        uint32_t regs[4];
+        uint32_t family, model;
+
+        source(CPUID_CPU_INFO, 0, regs);
+        family = (regs[0] >> 8) & 0xF;
+        model = (regs[0] >> 4) & 0xF;
+
+        source(CPUID_CACHE_TLB, 0, regs);
+        for (int r = 0; r < 4; r++) {
+            //bit 31 set means the register holds no descriptors
+            if (regs[r] & (1u << 31)) {
+                continue;
+            }
+            for (int b = (r == 0); b < 4; b++) {
+                uint8_t desc = (uint8_t)(regs[r] >> (b * 8));
+                switch (desc) {
+                    case CPUID_CACHE_TLB_DESC_NULL:
+                        continue;
+                    case CPUID_CACHE_TLB_DESC_NO_CACHE_INFO_CPUID_LEAF_4:
+                        *use_leaf4 = 1;
+                        continue;
+                    case CPUID_CACHE_TLB_DESC_NO_TLB_INFO_CPUID_LEAF_18H:
+                        *use_leaf18 = 1;
+                        continue;
+                    case CPUID_CACHE_TLB_DESC_PREFETCH_64_BYTE:
+                        info->prefetch_size = 64;
+                        continue;
+                    case CPUID_CACHE_TLB_DESC_PREFETCH_128_BYTE:
+                        info->prefetch_size = 128;
+                        continue;
+                }
+                for (size_t i = 0; i < sizeof(__cacheinfo_descs) / sizeof(__cacheinfo_descs[0]); i++) {
+                    const __cacheinfo_desc_t* d = &__cacheinfo_descs[i];
+                    if (d->descriptor != desc) {
+                        continue;
+                    }
+                    if (d->is_tlb) {
+                        __cacheinfo_add_tlb(info, d->level, d->type, d->page_sizes, d->size, d->ways);
+                    } else if (want_caches) {
+                        uint8_t level = d->level;
+                        //0x49 is an L3 only on the Xeon MP family 0xF model 6, an L2 everywhere else
+                        if (desc == CPUID_CACHE_TLB_DESC_L3_4M_16WAY_64B && !(family == 0xF && model == 6)) {
+                            level = 2;
+                        }
+                        __cacheinfo_add_sized(info, level, d->type, (uint64_t)d->size * 1024, d->ways, d->line_size);
+                    }
+                }
+            }
+        }
+    }
+
+    //Leaf 0x18, deterministic address translation parameters
+    static void __cacheinfo_leaf18(cache_info_t* info, cpuid_fn_t source) {
+        uint32_t regs[4];
+        uint32_t max_subleaf;
+        source(CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS, 0, regs);
+        max_subleaf = regs[0];
+        for (uint32_t i = 0; i <= max_subleaf; i++) {
+            uint32_t type, ways, entries;
+            uint8_t pages = 0;
+            if (i != 0) {
+                source(CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS, i, regs);
+            }
+            type = CPUID_FIELD(regs[3], CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_TYPE);
+            if (type == CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_NULL) {
+                continue;
+            }
+            //load only and store only TLBs are data TLBs
+            if (type > CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_UNIFIED) {
+                type = CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA;
+            }
+            if (regs[1] & (CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_4K_PAGES)) pages |= TLB_PAGE_4K;
+            if (regs[1] & (CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_2M_PAGES)) pages |= TLB_PAGE_2M;
+            if (regs[1] & (CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_4M_PAGES)) pages |= TLB_PAGE_4M;
+            if (regs[1] & (CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_1G_PAGES)) pages |= TLB_PAGE_1G;
+            ways = CPUID_FIELD(regs[1], CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_WAYS);
+            entries = ways * regs[2];
+            if (regs[3] & (CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_FULLY_ASSOC)) {
+                ways = 0xFF;
+            }
+            __cacheinfo_add_tlb(info, (uint8_t)CPUID_FIELD(regs[3], CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_LEVEL),
+                (uint8_t)type, pages, entries, ways);
+        }
+    }
+
+    //Associativity encoding of leaf 0x80000006, 0xFF = fully associative
+    static uint32_t __cacheinfo_amd_ways(uint32_t assoc) {
+        static const uint8_t ways[16] = { 0, 1, 2, 3, 4, 6, 8, 0, 16, 0, 32, 48, 64, 96, 128, 0xFF };
+        return ways[assoc & 0xF];
+    }
+
+    //Leaves 0x80000005 and 0x80000006
+    static void __cacheinfo_amd_legacy(cache_info_t* info, cpuid_fn_t source, uint32_t max_extended, int want_caches, int want_tlbs) {
+        uint32_t regs[4];
+        if (max_extended >= CPUID_L1_CACHE_TLB) {
+            source(CPUID_L1_CACHE_TLB, 0, regs);
+            if (want_caches) {
+                __cacheinfo_add_sized(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA,
+                    (uint64_t)CPUID_FIELD(regs[2], CPUID_L1_CACHE_TLB_SIZE_KB) * 1024,
+                    CPUID_FIELD(regs[2], CPUID_L1_CACHE_TLB_ASSOC), CPUID_FIELD(regs[2], CPUID_L1_CACHE_TLB_LINE_SIZE));
+                __cacheinfo_add_sized(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION,
+                    (uint64_t)CPUID_FIELD(regs[3], CPUID_L1_CACHE_TLB_SIZE_KB) * 1024,
+                    CPUID_FIELD(regs[3], CPUID_L1_CACHE_TLB_ASSOC), CPUID_FIELD(regs[3], CPUID_L1_CACHE_TLB_LINE_SIZE));
+            }
+            if (want_tlbs) {
+                __cacheinfo_add_tlb(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA, TLB_PAGE_4K,
+                    CPUID_FIELD(regs[1], CPUID_L1_CACHE_TLB_DTLB_ENTRIES), CPUID_FIELD(regs[1], CPUID_L1_CACHE_TLB_DTLB_ASSOC));
+                __cacheinfo_add_tlb(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION, TLB_PAGE_4K,
+                    CPUID_FIELD(regs[1], CPUID_L1_CACHE_TLB_ITLB_ENTRIES), CPUID_FIELD(regs[1], CPUID_L1_CACHE_TLB_ITLB_ASSOC));
+                __cacheinfo_add_tlb(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA, TLB_PAGE_2M | TLB_PAGE_4M,
+                    CPUID_FIELD(regs[0], CPUID_L1_CACHE_TLB_DTLB_ENTRIES), CPUID_FIELD(regs[0], CPUID_L1_CACHE_TLB_DTLB_ASSOC));
+                __cacheinfo_add_tlb(info, 1, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION, TLB_PAGE_2M | TLB_PAGE_4M,
+                    CPUID_FIELD(regs[0], CPUID_L1_CACHE_TLB_ITLB_ENTRIES), CPUID_FIELD(regs[0], CPUID_L1_CACHE_TLB_ITLB_ASSOC));
+            }
+        }
+        if (max_extended >= CPUID_MORE_CACHE) {
+            source(CPUID_MORE_CACHE, 0, regs);
+            if (want_caches) {
+                __cacheinfo_add_sized(info, 2, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_UNIFIED,
+                    (uint64_t)CPUID_FIELD(regs[2], CPUID_MORE_CACHE_ECX_L2_SIZE_KB) * 1024,
+                    __cacheinfo_amd_ways(CPUID_FIELD(regs[2], CPUID_MORE_CACHE_ECX_L2_ASSOC)),
+                    CPUID_FIELD(regs[2], CPUID_MORE_CACHE_ECX_L2_LINE_SIZE));
+                __cacheinfo_add_sized(info, 3, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_UNIFIED,
+                    (uint64_t)CPUID_FIELD(regs[3], CPUID_MORE_CACHE_EDX_L3_SIZE_512KB) * 512 * 1024,
+                    __cacheinfo_amd_ways(CPUID_FIELD(regs[3], CPUID_MORE_CACHE_EDX_L3_ASSOC)),
+                    CPUID_FIELD(regs[3], CPUID_MORE_CACHE_EDX_L3_LINE_SIZE));
+            }
+            if (want_tlbs) {
+                __cacheinfo_add_tlb(info, 2, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA, TLB_PAGE_4K,
+                    CPUID_FIELD(regs[1], CPUID_MORE_CACHE_DTLB_ENTRIES), __cacheinfo_amd_ways(CPUID_FIELD(regs[1], CPUID_MORE_CACHE_DTLB_ASSOC)));
+                __cacheinfo_add_tlb(info, 2, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION, TLB_PAGE_4K,
+                    CPUID_FIELD(regs[1], CPUID_MORE_CACHE_ITLB_ENTRIES), __cacheinfo_amd_ways(CPUID_FIELD(regs[1], CPUID_MORE_CACHE_ITLB_ASSOC)));
+                __cacheinfo_add_tlb(info, 2, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA, TLB_PAGE_2M | TLB_PAGE_4M,
+                    CPUID_FIELD(regs[0], CPUID_MORE_CACHE_DTLB_ENTRIES), __cacheinfo_amd_ways(CPUID_FIELD(regs[0], CPUID_MORE_CACHE_DTLB_ASSOC)));
+                __cacheinfo_add_tlb(info, 2, CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION, TLB_PAGE_2M | TLB_PAGE_4M,
+                    CPUID_FIELD(regs[0], CPUID_MORE_CACHE_ITLB_ENTRIES), __cacheinfo_amd_ways(CPUID_FIELD(regs[0], CPUID_MORE_CACHE_ITLB_ASSOC)));
+            }
+        }
+    }
+
+    void cacheinfo_decode(cache_info_t* info, cpuid_fn_t source) {
+        uint32_t regs[4];
+        uint32_t max_leaf, max_extended, ext_ecx = 0;
+        int use_leaf4 = 0, use_leaf18 = 0;
+
+        info->cache_count = 0;
+        info->tlb_count = 0;
+        info->prefetch_size = 0;
+
+        source(CPUID_VENDOR, 0, regs);
+        max_leaf = regs[0];
+        source(CPUID_HIGHEST_EXTENDED, 0, regs);
+        max_extended = (regs[0] & 0x80000000) ? regs[0] : 0;
+        if (max_extended >= CPUID_EXTENDED_SIGNATURE) {
+            source(CPUID_EXTENDED_SIGNATURE, 0, regs);
+            ext_ecx = regs[2];
+        }
+
+        if (max_leaf >= CPUID_CACHE_PARAMS) {
+            __cacheinfo_deterministic(info, source, CPUID_CACHE_PARAMS);
+        }
+        if (info->cache_count == 0 && max_extended >= CPUID_AMD_CACHE_PARAMS && (ext_ecx & (CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT))) {
+            __cacheinfo_deterministic(info, source, CPUID_AMD_CACHE_PARAMS);
+        }
+        if (max_leaf >= CPUID_CACHE_TLB) {
+            __cacheinfo_leaf2(info, source, info->cache_count == 0, &use_leaf4, &use_leaf18);
+        }
+        if (use_leaf18 && max_leaf >= CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS) {
+            __cacheinfo_leaf18(info, source);
+        }
+        //AMD: the L1/L2 TLBs(and the caches when there is no leaf 0x8000001D) only live in the extended leaves
+        if (info->cache_count == 0 || info->tlb_count == 0) {
+            __cacheinfo_amd_legacy(info, source, max_extended, info->cache_count == 0, info->tlb_count == 0);
+        }
+    }
+#endif
+
+#endif // __CACHEINFO_H__
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+@ KrnlAid per-CPU descriptor tables
+@ Every CPU needs its own TSS(RSP0 and the IST stacks are per CPU, and LTR marks the descriptor busy), so it
+@ also needs its own GDT. cpu_desc_t puts a CPU's GDT, TSS and prebuilt GDT pointer in a single cache line
+@ aligned block and an array of them is one contiguous allocation. Each block is written by one CPU only,
+@ so the APs can build and install their own tables in parallel without bouncing lines.
+@ GDT layout(the user segments are in SYSRET order):
+@   0x00 null | 0x08 kernel code | 0x10 kernel data | 0x18 user data | 0x20 user code | 0x28 TSS(two slots) | 0x38 unused
+@
+@ How to use:
+@ 1, allocate cpudesc_size(nr_cpus) bytes aligned to CACHELINE_SIZE
+@ 2, fill a cpudesc_config_t with the stack sizes and a stack allocator(called once per stack, it has to be
+@    thread safe if the APs build their own blocks)
+@ 3, cpudesc_build(descs, nr_cpus, &config) on the BSP, or cpudesc_build_one(&descs[cpu], cpu, &config) on each CPU
+@ 4, on every CPU: cpudesc_load(&descs[cpu]), then percpu_load(cpu)(loading the segments clears the GS base)
+*/
+
+#ifndef __CPUDESC_H__
+#define __CPUDESC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gdt.h"
+#include "../../utils/cache.h"
+#include "../../utils/debug.h"
+
+#ifndef __x86_64__
+#error "cpudesc.h: IST stacks only exist in 64 bit mode"
+#endif
+
+#define CPUDESC_KERNEL_CS 0x08
+#define CPUDESC_KERNEL_DS 0x10
+#define CPUDESC_USER_DS   (0x18 | 3)
+#define CPUDESC_USER_CS   (0x20 | 3)
+#define CPUDESC_TSS       0x28
+
+//GDT slots per CPU, the last one is free for the caller(e.g. a per-CPU LDT or segment)
+#define CPUDESC_GDT_ENTRIES 8
+
+//Number of IST stacks a TSS has(IST index 1-7 in a gate, 0 means no stack switch)
+#define CPUDESC_IST_COUNT 7
+
+//Stack alignment the ABI wants at an interrupt entry
+#define CPUDESC_STACK_ALIGN 16
+
+typedef struct {
+    gdt_entry_t gdt[CPUDESC_GDT_ENTRIES]; //first cache line
+    tss_t tss;                            //second and third
+    gdt_pointer_t gdt_pointer;            //points at gdt, ready for load_gdt
+    uint32_t cpu;
+} __cacheline_aligned cpu_desc_t;
+
+STATIC_ASSERT(offsetof(cpu_desc_t, gdt) == 0, "the GDT has to start the block");
+STATIC_ASSERT(offsetof(cpu_desc_t, tss) == CACHELINE_SIZE, "the TSS has to start on its own cache line");
+STATIC_ASSERT(sizeof(cpu_desc_t) == 3 * CACHELINE_SIZE, "cpu_desc_t has to be exactly 3 cache lines");
+STATIC_ASSERT(CPUDESC_TSS / sizeof(gdt_entry_t) + 2 <= CPUDESC_GDT_ENTRIES, "the TSS descriptor doesn't fit");
+
+/*
+@ Returns the lowest address of a stack of size bytes for cpu, or NULL if it can't
+@ stack is 0 for RSP0 and 1-7 for the IST stacks
+*/
+typedef void* (*cpudesc_stack_alloc_t)(uint32_t cpu, uint32_t stack, size_t size, void* ctx);
+
+typedef struct {
+    size_t rsp0_size;                    //stack for interrupts from ring 3, 0 = none
+    size_t ist_size[CPUDESC_IST_COUNT];  //IST1-IST7, 0 = unused
+    cpudesc_stack_alloc_t alloc;
+    void* ctx;                           //passed to alloc
+} cpudesc_config_t;
+
+//The part of the GDT every CPU shares, built by the compiler
+static const gdt_entry_t cpudesc_gdt_template[CPUDESC_GDT_ENTRIES] = {
+    GDT_NULL_INIT,
+    GDT_KERNEL_CODE64_INIT,
+    GDT_KERNEL_DATA_INIT,
+    GDT_USER_DATA_INIT,
+    GDT_USER_CODE64_INIT,
+    GDT_TSS_INIT,
+    GDT_NULL_INIT
+};
+
+//Bytes the blocks of nr_cpus CPUs need
+static inline size_t cpudesc_size(uint32_t nr_cpus) {
+    return (size_t)nr_cpus * sizeof(cpu_desc_t);
+}
+
+//Allocates one stack and returns its top(what the TSS holds), 0 if the allocation failed
+static inline uint64_t __cpudesc_stack(uint32_t cpu, uint32_t stack, size_t size, const cpudesc_config_t* config) {
+    char* bottom = (char*)config->alloc(cpu, stack, size, config->ctx);
+    if (bottom == NULL) {
+        return 0;
+    }
+    return (uint64_t)(bottom + size) & ~(uint64_t)(CPUDESC_STACK_ALIGN - 1);
+}
+
+//Builds one CPU's block, returns 0 on success and -1 if a stack allocation failed
+static inline int cpudesc_build_one(cpu_desc_t* desc, uint32_t cpu, const cpudesc_config_t* config) {
+    char* tss = (char*)&desc->tss;
+    for (size_t i = 0; i < sizeof(tss_t); i++) {
+        tss[i] = 0;
+    }
+    for (uint32_t i = 0; i < CPUDESC_GDT_ENTRIES; i++) {
+        desc->gdt[i] = cpudesc_gdt_template[i];
+    }
+
+    //no I/O permission bitmap: its base past the limit, every port access from ring 3 faults
+    desc->tss.iomap_base = sizeof(tss_t);
+    if (config->rsp0_size != 0) {
+        desc->tss.rsp0 = __cpudesc_stack(cpu, 0, config->rsp0_size, config);
+        if (desc->tss.rsp0 == 0) {
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < CPUDESC_IST_COUNT; i++) {
+        if (config->ist_size[i] == 0) {
+            continue;
+        }
+        desc->tss.ist[i] = __cpudesc_stack(cpu, i + 1, config->ist_size[i], config);
+        if (desc->tss.ist[i] == 0) {
+            return -1;
+        }
+    }
+
+    gdt_patch_tss(desc->gdt, CPUDESC_TSS / sizeof(gdt_entry_t), &desc->tss);
+    desc->gdt_pointer = make_gdt_pointer(desc->gdt, CPUDESC_GDT_ENTRIES);
+    desc->cpu = cpu;
+    return 0;
+}
+
+//Builds the blocks of every CPU, returns 0 on success and -1 if a stack allocation failed
+static inline int cpudesc_build(cpu_desc_t* descs, uint32_t nr_cpus, const cpudesc_config_t* config) {
+    for (uint32_t cpu = 0; cpu < nr_cpus; cpu++) {
+        if (cpudesc_build_one(&descs[cpu], cpu, config) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//Installs a CPU's GDT and TSS on the calling CPU
+static inline void cpudesc_load(const cpu_desc_t* desc) {
+    load_gdt(&desc->gdt_pointer);
+    flush_cs_ds_etc(CPUDESC_KERNEL_CS, CPUDESC_KERNEL_DS);
+    load_tss(CPUDESC_TSS);
+}
+
+#endif // __CPUDESC_H__
\ No newline at end of file
@@ -0,0 +1,372 @@
+/*
+@ KrnlAid CPU feature snapshot
+@ CPUID is serializing and causes a VM exit under virtualization(thousands of cycles), so it has no place on hot paths.
+@ cpu_features_probe() runs it once for leaves 1, 7(subleaves 0-2), 0x80000001, 0x80000007 and 0x80000008
+@ and keeps the feature registers in cpu_features. cpu_has(X86_FEATURE_*) is then a single bit test on cached memory.
+@ Feature IDs are register word * 32 + bit, derived from the CPUID_* masks in cpuid.h, so they never change.
+@
+@ How to use:
+@ 1, define CPUFEATURE_IMPL in exactly one source file
+@ 2, call cpu_features_probe() once during early boot(cpu_features_probe_from replays a recorded CPUID dump)
+@ 3, if (cpu_has(X86_FEATURE_AVX2)) { ... }
+@ NOTE: these are the raw CPUID bits, e.g. AVX also needs the OS to enable it in XCR0(see OSXSAVE)
+*/
+
+#ifndef __CPUFEATURE_H__
+#define __CPUFEATURE_H__
+
+#include <stdint.h>
+#include "cpuid.h"
+
+//The feature registers that are kept, one 32 bit word each
+enum cpuid_words {
+    CPUID_WORD_1_ECX,
+    CPUID_WORD_1_EDX,
+    CPUID_WORD_7_0_EBX,
+    CPUID_WORD_7_0_ECX,
+    CPUID_WORD_7_0_EDX,
+    CPUID_WORD_7_1_EAX,
+    CPUID_WORD_7_1_EBX,
+    CPUID_WORD_7_1_EDX,
+    CPUID_WORD_7_2_EDX,
+    CPUID_WORD_80000001_ECX,
+    CPUID_WORD_80000001_EDX,
+    CPUID_WORD_80000007_EDX,
+    CPUID_WORD_80000008_EBX,
+    CPUID_WORD_COUNT,
+};
+
+//Feature ID of a single bit CPUID_* mask in a word
+#define CPU_FEATURE(word, mask) ((word) * 32 + __builtin_ctz(mask))
+
+enum cpu_features {
+    X86_FEATURE_SSE3                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SSE3),
+    X86_FEATURE_PCLMULQDQ                = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_PCLMULQDQ),
+    X86_FEATURE_DTES64                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_DTES64),
+    X86_FEATURE_MONITOR                  = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_MONITOR),
+    X86_FEATURE_DS_CPL                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_DS_CPL),
+    X86_FEATURE_VMX                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_VMX),
+    X86_FEATURE_SMX                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SMX),
+    X86_FEATURE_EIST                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_EIST),
+    X86_FEATURE_TM2                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_TM2),
+    X86_FEATURE_SSSE3                    = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SSSE3),
+    X86_FEATURE_CNXT_ID                  = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_CNXT_ID),
+    X86_FEATURE_SDBG                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SDBG),
+    X86_FEATURE_FMA                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_FMA),
+    X86_FEATURE_CMPXCHG16B               = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_CMPXCHG16B),
+    X86_FEATURE_XTPR_UC                  = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_XTPR_UC),
+    X86_FEATURE_PDCM                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_PDCM),
+    X86_FEATURE_PCID                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_PCID),
+    X86_FEATURE_DCA                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_DCA),
+    X86_FEATURE_SSE4_1                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SSE4_1),
+    X86_FEATURE_SSE4_2                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_SSE4_2),
+    X86_FEATURE_X2APIC                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_X2APIC),
+    X86_FEATURE_MOVBE                    = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_MOVBE),
+    X86_FEATURE_POPCNT                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_POPCNT),
+    X86_FEATURE_TSC_DEADLINE             = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_TSC_DEADLINE),
+    X86_FEATURE_AESNI                    = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_AESNI),
+    X86_FEATURE_XSAVE                    = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_XSAVE),
+    X86_FEATURE_OSXSAVE                  = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_OSXSAVE),
+    X86_FEATURE_AVX                      = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_AVX),
+    X86_FEATURE_F16C                     = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_F16C),
+    X86_FEATURE_RDRAND                   = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_RDRAND),
+    X86_FEATURE_HYPERVISOR               = CPU_FEATURE(CPUID_WORD_1_ECX, CPUID_CPU_INFO_ECX_HYPERVISOR),
+
+    X86_FEATURE_FPU                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_FPU),
+    X86_FEATURE_VME                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_VME),
+    X86_FEATURE_DE                       = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_DE),
+    X86_FEATURE_PSE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PSE),
+    X86_FEATURE_TSC                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_TSC),
+    X86_FEATURE_MSR                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_MSR),
+    X86_FEATURE_PAE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PAE),
+    X86_FEATURE_MCE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_MCE),
+    X86_FEATURE_CX8                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_CX8),
+    X86_FEATURE_APIC                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_APIC),
+    X86_FEATURE_SEP                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_SEP),
+    X86_FEATURE_MTRR                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_MTRR),
+    X86_FEATURE_PGE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PGE),
+    X86_FEATURE_MCA                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_MCA),
+    X86_FEATURE_CMOV                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_CMOV),
+    X86_FEATURE_PAT                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PAT),
+    X86_FEATURE_PSE_36                   = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PSE_36),
+    X86_FEATURE_PSN                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PSN),
+    X86_FEATURE_CLFSH                    = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_CLFSH),
+    X86_FEATURE_DS                       = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_DS),
+    X86_FEATURE_ACPI                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_ACPI),
+    X86_FEATURE_MMX                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_MMX),
+    X86_FEATURE_FXSR                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_FXSR),
+    X86_FEATURE_SSE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_SSE),
+    X86_FEATURE_SSE2                     = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_SSE2),
+    X86_FEATURE_SS                       = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_SS),
+    X86_FEATURE_HTT                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_HTT),
+    X86_FEATURE_TM                       = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_TM),
+    X86_FEATURE_PBE                      = CPU_FEATURE(CPUID_WORD_1_EDX, CPUID_CPU_INFO_EDX_PBE),
+
+    X86_FEATURE_FSGSBASE                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_FSGSBASE),
+    X86_FEATURE_TSC_ADJUST               = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_TSC_ADJUST),
+    X86_FEATURE_SGX                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_SGX),
+    X86_FEATURE_BMI1                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_BMI1),
+    X86_FEATURE_HLE                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_HLE),
+    X86_FEATURE_AVX2                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX2),
+    X86_FEATURE_FDP_EXCPTN_ONLY          = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_FDP_EXCPTN_ONLY),
+    X86_FEATURE_SMEP                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_SMEP),
+    X86_FEATURE_BMI2                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_BMI2),
+    X86_FEATURE_ENHANCED_REP             = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_ENHANCED_REP),
+    X86_FEATURE_INVCIP                   = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_INVCIP),
+    X86_FEATURE_RTM                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_RTM),
+    X86_FEATURE_RDT_M                    = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_RDT_M),
+    X86_FEATURE_NO_FPU_CS                = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_NO_FPU_CS),
+    X86_FEATURE_MPX                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_MPX),
+    X86_FEATURE_RDT_A                    = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_RDT_A),
+    X86_FEATURE_AVX512F                  = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512F),
+    X86_FEATURE_AVX512DQ                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512DQ),
+    X86_FEATURE_RDSEED                   = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_RDSEED),
+    X86_FEATURE_ADX                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_ADX),
+    X86_FEATURE_SMAP                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_SMAP),
+    X86_FEATURE_AVX512_IFMA              = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512_IFMA),
+    X86_FEATURE_CLFLUSHOPT               = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_CLFLUSHOPT),
+    X86_FEATURE_CLWB                     = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_CLWB),
+    X86_FEATURE_TRACE                    = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_TRACE),
+    X86_FEATURE_AVX512PF                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512PF),
+    X86_FEATURE_AVX512ER                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512ER),
+    X86_FEATURE_AVX512CD                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512CD),
+    X86_FEATURE_SHA                      = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_SHA),
+    X86_FEATURE_AVX512BW                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512BW),
+    X86_FEATURE_AVX512VL                 = CPU_FEATURE(CPUID_WORD_7_0_EBX, CPUID_EXTENDED_FEATURES_EBX_AVX512VL),
+
+    X86_FEATURE_PREFETCHWT1              = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_PREFETCHWT1),
+    X86_FEATURE_AVX512_VBMI              = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_AFX512_VBMI),
+    X86_FEATURE_UMIP                     = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_UMIP),
+    X86_FEATURE_PKU                      = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_PKU),
+    X86_FEATURE_OSPKE                    = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_OSPKE),
+    X86_FEATURE_WAITPKG                  = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_WAITPKG),
+    X86_FEATURE_AVX512_VBMI2             = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_AVX512_VBMI2),
+    X86_FEATURE_CET_SS                   = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_CET_SS),
+    X86_FEATURE_GFNI                     = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_GFNI),
+    X86_FEATURE_VAES                     = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_VAES),
+    X86_FEATURE_VPCLMULQDQ               = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_VPCLMULQDQ),
+    X86_FEATURE_AVX512_VNNI              = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_AVX512_VNNI),
+    X86_FEATURE_AVX512_BITLANG           = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_AVX512_BITLANG),
+    X86_FEATURE_TME_EN                   = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_TME_EN),
+    X86_FEATURE_AVX512_VPOPVNZDQ         = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_AVX512_VPOPVNZDQ),
+    X86_FEATURE_LA57                     = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_LA57),
+    X86_FEATURE_RDPID                    = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_RDPID),
+    X86_FEATURE_KL                       = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_KL),
+    X86_FEATURE_BUS_LOCK_DETECT          = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_BUS_LOCK_DETECT),
+    X86_FEATURE_CLDEMOTE                 = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_CLDEMOTE),
+    X86_FEATURE_MOVDIRI                  = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_MOVDIRI),
+    X86_FEATURE_MOVDIR64B                = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_MOVDIR64B),
+    X86_FEATURE_ENQCMD                   = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_ENQCMD),
+    X86_FEATURE_SGX_LC                   = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_SGX_LC),
+    X86_FEATURE_PKS                      = CPU_FEATURE(CPUID_WORD_7_0_ECX, CPUID_EXTENDED_FEATURES_ECX_PKS),
+
+    X86_FEATURE_SGX_KEYS                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_SGX_KEYS),
+    X86_FEATURE_AVX512_4VNNIW            = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AVX512_4VNNIW),
+    X86_FEATURE_AVX512_4FMAPS            = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AVX512_4FMAPS),
+    X86_FEATURE_FAST_REP_MOV             = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_FAST_REP_MOV),
+    X86_FEATURE_UINTR                    = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_UINTR),
+    X86_FEATURE_AVX512_VPINTERSECT       = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AVX512_VPINTERSECT),
+    X86_FEATURE_SRBDS_CTRL               = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_SRBDS_CTRL),
+    X86_FEATURE_MD_CLEAR                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_MD_CLEAR),
+    X86_FEATURE_RTM_ALWAYS_ABORT         = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_RTM_ALWAYS_ABORT),
+    X86_FEATURE_RTM_FORCE_ABORT          = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_RTM_FORCE_ABORT),
+    X86_FEATURE_SERIALIZE                = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_SERIALIZE),
+    X86_FEATURE_HYBRID                   = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_HYBRID),
+    X86_FEATURE_TSXLDTRK                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_TSXLDTRK),
+    X86_FEATURE_PCONFIG                  = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_PCONFIG),
+    X86_FEATURE_ARCHITECTURAL_LBR        = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_ARCHITECTURAL_LBR),
+    X86_FEATURE_CET_IBT                  = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_CET_IBT),
+    X86_FEATURE_AMX_BF16                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AMX_BF16),
+    X86_FEATURE_AVX512_FP16              = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AVX512_FP16),
+    X86_FEATURE_AMX_TILE                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AMX_TILE),
+    X86_FEATURE_AMX_INT8                 = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_AMX_INT8),
+    X86_FEATURE_IBRS                     = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_IBRS),
+    X86_FEATURE_STIBP                    = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_STIBP),
+    X86_FEATURE_L1D_FLUSH                = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_L1D_FLUSH),
+    X86_FEATURE_ARCH_CAPABS_MSR          = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_ARCH_CAPABS_MSR),
+    X86_FEATURE_CORE_CAPABS_MSR          = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_CORE_CAPABS_MSR),
+    X86_FEATURE_SSBD                     = CPU_FEATURE(CPUID_WORD_7_0_EDX, CPUID_EXTENDED_FEATURES_EDX_SSBD),
+
+    X86_FEATURE_AVX_VNNI                 = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_AVX_VNNI),
+    X86_FEATURE_AVX512_BF16              = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_AVX512_BF16),
+    X86_FEATURE_0_REP_MOVSB              = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_0_REP_MOVSB),
+    X86_FEATURE_FAST_STOSB               = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_STOSB),
+    X86_FEATURE_FAST_CMPSB               = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_CMPSB),
+    X86_FEATURE_HRESET                   = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_HRESET),
+    X86_FEATURE_INVD_POSTPOST            = CPU_FEATURE(CPUID_WORD_7_1_EAX, CPUID_EXTENDED_FEATURES_SL1_EAX_INVD_POSTPOST),
+
+    X86_FEATURE_PPIN                     = CPU_FEATURE(CPUID_WORD_7_1_EBX, CPUID_EXTENDED_FEATURES_SL1_EBX_PPIN),
+
+    X86_FEATURE_CET_SSS                  = CPU_FEATURE(CPUID_WORD_7_1_EDX, CPUID_EXTENDED_FEATURES_SL1_EDX_CET_SSS),
+
+    X86_FEATURE_PSFD                     = CPU_FEATURE(CPUID_WORD_7_2_EDX, CPUID_EXTENDED_FEATURES_SL2_EDX_PSFD),
+    X86_FEATURE_IPRED_CTRL               = CPU_FEATURE(CPUID_WORD_7_2_EDX, CPUID_EXTENDED_FEATURES_SL2_EDX_IPRED_CTRL),
+    X86_FEATURE_RRSBA_CTRL               = CPU_FEATURE(CPUID_WORD_7_2_EDX, CPUID_EXTENDED_FEATURES_SL2_EDX_RRSBA_CTRL),
+    X86_FEATURE_DDPD_U                   = CPU_FEATURE(CPUID_WORD_7_2_EDX, CPUID_EXTENDED_FEATURES_SL2_EDX_DDPD_U),
+    X86_FEATURE_BHI_CTRL                 = CPU_FEATURE(CPUID_WORD_7_2_EDX, CPUID_EXTENDED_FEATURES_SL2_EDX_BHI_CTRL),
+
+    X86_FEATURE_LAHF_SAHF                = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_LAHF_SAHF),
+    X86_FEATURE_CMP_LEGACY               = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_CMP_LEGACY),
+    X86_FEATURE_SVM                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_SVM),
+    X86_FEATURE_EXTAPIC                  = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_EXTAPIC),
+    X86_FEATURE_CR8_LEGACY               = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_CR8_LEGACY),
+    X86_FEATURE_LZCNT                    = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_LZCNT),
+    X86_FEATURE_SSE4A                    = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_SSE4A),
+    X86_FEATURE_MISALIGN_SSE             = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_MISALIGN_SSE),
+    X86_FEATURE_PREFETCHW                = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_PREFETCHW),
+    X86_FEATURE_OSVW                     = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_OSVW),
+    X86_FEATURE_IBS                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_IBS),
+    X86_FEATURE_XOP                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_XOP),
+    X86_FEATURE_SKINIT                   = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_SKINIT),
+    X86_FEATURE_WDT                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_WDT),
+    X86_FEATURE_LWP                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_LWP),
+    X86_FEATURE_FMA4                     = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_FMA4),
+    X86_FEATURE_TCE                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_TCE),
+    X86_FEATURE_NODEID_MSR               = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_NODEID_MSR),
+    X86_FEATURE_TBM                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_TBM),
+    X86_FEATURE_TOPOEXT                  = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT),
+    X86_FEATURE_PERFCTR_CORE             = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_CORE),
+    X86_FEATURE_PERFCTR_NB               = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_NB),
+    X86_FEATURE_DBX                      = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_DBX),
+    X86_FEATURE_PERFTSC                  = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_PERFTSC),
+    X86_FEATURE_PERFCTR_LLC              = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_LLC),
+    X86_FEATURE_MONITORX                 = CPU_FEATURE(CPUID_WORD_80000001_ECX, CPUID_EXTENDED_SIGNATURE_ECX_MONITORX),
+
+    X86_FEATURE_SYSCALL                  = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_SYSCALL),
+    X86_FEATURE_MP                       = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_MP),
+    X86_FEATURE_NX                       = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_NX),
+    X86_FEATURE_MMXEXT                   = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_MMXEXT),
+    X86_FEATURE_FXSR_OPT                 = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_FXSR_OPT),
+    X86_FEATURE_PDPE1GB                  = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_PDPE1GB),
+    X86_FEATURE_RDTSCP                   = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_RDTSCP),
+    X86_FEATURE_LM                       = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_LM),
+    X86_FEATURE_3DNOWEXT                 = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_3DNOWEXT),
+    X86_FEATURE_3DNOW                    = CPU_FEATURE(CPUID_WORD_80000001_EDX, CPUID_EXTENDED_SIGNATURE_EDX_3DNOW),
+
+    X86_FEATURE_PM_TS                    = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_TS),
+    X86_FEATURE_FID                      = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_FID),
+    X86_FEATURE_VID                      = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_VID),
+    X86_FEATURE_TTP                      = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_TTP),
+    X86_FEATURE_PM_TM                    = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_TM),
+    X86_FEATURE_100MHZ_STEPS             = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_100MHZ_STEPS),
+    X86_FEATURE_HW_PSTATE                = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_HW_PSTATE),
+    X86_FEATURE_INVARIANT_TSC            = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_INVARIANT_TSC),
+    X86_FEATURE_CPB                      = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_CPB),
+    X86_FEATURE_EFF_FREQ_RO              = CPU_FEATURE(CPUID_WORD_80000007_EDX, CPUID_INVARIANT_TSC_AVAILABLE_EDX_EFF_FREQ_RO),
+
+    X86_FEATURE_CLZERO                   = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_CLZERO),
+    X86_FEATURE_IRPERF                   = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_IRPERF),
+    X86_FEATURE_XSAVEERPTR               = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_XSAVEERPTR),
+    X86_FEATURE_RDPRU                    = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_RDPRU),
+    X86_FEATURE_MCOMMIT                  = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_MCOMMIT),
+    X86_FEATURE_WBNOINVD                 = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_WBNOINVD),
+    X86_FEATURE_AMD_IBPB                 = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_IBPB),
+    X86_FEATURE_AMD_IBRS                 = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_IBRS),
+    X86_FEATURE_AMD_STIBP                = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_STIBP),
+    X86_FEATURE_AMD_SSBD                 = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_SSBD),
+    X86_FEATURE_VIRT_SSBD                = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_VIRT_SSBD),
+    X86_FEATURE_SSB_NO                   = CPU_FEATURE(CPUID_WORD_80000008_EBX, CPUID_PHYS_ADDR_SIZE_EBX_SSB_NO),
+};
+
+typedef struct {
+    uint32_t words[CPUID_WORD_COUNT];
+    uint32_t max_leaf;
+    uint32_t max_extended_leaf;
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    char vendor[13];
+} cpu_features_t;
+
+extern cpu_features_t cpu_features;
+
+//Does the CPU have a feature(X86_FEATURE_*)
+static inline int cpu_has(uint32_t feature) {
+    return (cpu_features.words[feature >> 5] >> (feature & 31)) & 1;
+}
+
+//Reads the feature leaves from a CPUID source into a snapshot
+static inline void cpu_features_probe_into(cpu_features_t* features, cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t subleaves = 0;
+
+    for (int i = 0; i < CPUID_WORD_COUNT; i++) {
+        features->words[i] = 0;
+    }
+
+    source(CPUID_VENDOR, 0, regs);
+    features->max_leaf = regs[0];
+    //the vendor string is EBX, EDX, ECX
+    for (int i = 0; i < 4; i++) {
+        features->vendor[i] = (char)(regs[1] >> (i * 8));
+        features->vendor[i + 4] = (char)(regs[3] >> (i * 8));
+        features->vendor[i + 8] = (char)(regs[2] >> (i * 8));
+    }
+    features->vendor[12] = '\0';
+
+    if (features->max_leaf >= CPUID_CPU_INFO) {
+        source(CPUID_CPU_INFO, 0, regs);
+        features->words[CPUID_WORD_1_ECX] = regs[2];
+        features->words[CPUID_WORD_1_EDX] = regs[3];
+        features->stepping = regs[0] & 0xF;
+        features->model = (regs[0] >> 4) & 0xF;
+        features->family = (regs[0] >> 8) & 0xF;
+        if (features->family == 0xF) {
+            features->family += (regs[0] >> 20) & 0xFF;
+        }
+        if (features->family == 0x6 || features->family >= 0xF) {
+            features->model |= ((regs[0] >> 16) & 0xF) << 4;
+        }
+    }
+
+    if (features->max_leaf >= CPUID_EXTENDED_FEATURES) {
+        source(CPUID_EXTENDED_FEATURES, 0, regs);
+        subleaves = regs[0];
+        features->words[CPUID_WORD_7_0_EBX] = regs[1];
+        features->words[CPUID_WORD_7_0_ECX] = regs[2];
+        features->words[CPUID_WORD_7_0_EDX] = regs[3];
+        if (subleaves >= CPUID_EXTENDED_FEATURES_SL1) {
+            source(CPUID_EXTENDED_FEATURES, CPUID_EXTENDED_FEATURES_SL1, regs);
+            features->words[CPUID_WORD_7_1_EAX] = regs[0];
+            features->words[CPUID_WORD_7_1_EBX] = regs[1];
+            features->words[CPUID_WORD_7_1_EDX] = regs[3];
+        }
+        if (subleaves >= CPUID_EXTENDED_FEATURES_SL2) {
+            source(CPUID_EXTENDED_FEATURES, CPUID_EXTENDED_FEATURES_SL2, regs);
+            features->words[CPUID_WORD_7_2_EDX] = regs[3];
+        }
+    }
+
+    source(CPUID_HIGHEST_EXTENDED, 0, regs);
+    features->max_extended_leaf = (regs[0] & 0x80000000) ? regs[0] : 0;
+
+    if (features->max_extended_leaf >= CPUID_EXTENDED_SIGNATURE) {
+        source(CPUID_EXTENDED_SIGNATURE, 0, regs);
+        features->words[CPUID_WORD_80000001_ECX] = regs[2];
+        features->words[CPUID_WORD_80000001_EDX] = regs[3];
+    }
+    if (features->max_extended_leaf >= CPUID_INVARIANT_TSC_AVAILABLE) {
+        source(CPUID_INVARIANT_TSC_AVAILABLE, 0, regs);
+        features->words[CPUID_WORD_80000007_EDX] = regs[3];
+    }
+    if (features->max_extended_leaf >= CPUID_PHYS_ADDR_SIZE) {
+        source(CPUID_PHYS_ADDR_SIZE, 0, regs);
+        features->words[CPUID_WORD_80000008_EBX] = regs[1];
+    }
+}
+
+//Fills cpu_features from a CPUID source(cpuid_native or a recorded dump)
+static inline void cpu_features_probe_from(cpuid_fn_t source) {
+    cpu_features_probe_into(&cpu_features, source);
+}
+
+//Fills cpu_features from this CPU, call once during early boot
+static inline void cpu_features_probe(void) {
+    cpu_features_probe_into(&cpu_features, cpuid_native);
+}
+
+#ifdef CPUFEATURE_IMPL
+    cpu_features_t cpu_features;
+#endif
+
+#endif // __CPUFEATURE_H__
\ No newline at end of file
@@ -10,82 +10,82 @@
 
 //================CPUID_CPU_INFO================
 #define CPUID_CPU_INFO_EAX_STEPPING_MASK    0xF
-#define CPUID_CPU_INFO_EAX_MODEL_MASK       0xF  << 4
-#define CPUID_CPU_INFO_EAX_FAMILY_MASK      0xF  << 8
-#define CPUID_CPU_INFO_EAX_TYPE_MASK        0x3  << 12
-#define CPUID_CPU_INFO_EAX_EXT_MODEL_MASK   0xF  << 16
-#define CPUID_CPU_INFO_EAX_EXT_FAMILY_MASK  0xFF << 20
+#define CPUID_CPU_INFO_EAX_MODEL_MASK       (0xF  << 4)
+#define CPUID_CPU_INFO_EAX_FAMILY_MASK      (0xF  << 8)
+#define CPUID_CPU_INFO_EAX_TYPE_MASK        (0x3  << 12)
+#define CPUID_CPU_INFO_EAX_EXT_MODEL_MASK   (0xF  << 16)
+#define CPUID_CPU_INFO_EAX_EXT_FAMILY_MASK  (0xFF << 20)
 
 #define CPUID_CPU_INFO_EBX_BRAND_INDEX  0xFF
-#define CPUID_CPU_INFO_EBX_CFLUSH_SIZE  0xFF << 8
-#define CPUID_CPU_INFO_EBX_MAX_LOGPROC  0xFF << 16
-#define CPUID_CPU_INFO_EBX_INIT_APIC_ID 0xFF << 25
-
-#define CPUID_CPU_INFO_ECX_SSE3          1 << 0
-#define CPUID_CPU_INFO_ECX_PCLMULQDQ     1 << 1
-#define CPUID_CPU_INFO_ECX_DTES64        1 << 2
-#define CPUID_CPU_INFO_ECX_MONITOR       1 << 3
-#define CPUID_CPU_INFO_ECX_DS_CPL        1 << 4
-#define CPUID_CPU_INFO_ECX_VMX           1 << 5
-#define CPUID_CPU_INFO_ECX_SMX           1 << 6
-#define CPUID_CPU_INFO_ECX_EIST          1 << 7
-#define CPUID_CPU_INFO_ECX_TM2           1 << 8
-#define CPUID_CPU_INFO_ECX_SSSE3         1 << 9
-#define CPUID_CPU_INFO_ECX_CNXT_ID       1 << 10
-#define CPUID_CPU_INFO_ECX_SDBG          1 << 11
-#define CPUID_CPU_INFO_ECX_FMA           1 << 12
-#define CPUID_CPU_INFO_ECX_CMPXCHG16B    1 << 13
-#define CPUID_CPU_INFO_ECX_XTPR_UC       1 << 14
-#define CPUID_CPU_INFO_ECX_PDCM          1 << 15
+#define CPUID_CPU_INFO_EBX_CFLUSH_SIZE  (0xFF << 8)
+#define CPUID_CPU_INFO_EBX_MAX_LOGPROC  (0xFF << 16)
+#define CPUID_CPU_INFO_EBX_INIT_APIC_ID (0xFFu << 24)
+
+#define CPUID_CPU_INFO_ECX_SSE3          (1 << 0)
+#define CPUID_CPU_INFO_ECX_PCLMULQDQ     (1 << 1)
+#define CPUID_CPU_INFO_ECX_DTES64        (1 << 2)
+#define CPUID_CPU_INFO_ECX_MONITOR       (1 << 3)
+#define CPUID_CPU_INFO_ECX_DS_CPL        (1 << 4)
+#define CPUID_CPU_INFO_ECX_VMX           (1 << 5)
+#define CPUID_CPU_INFO_ECX_SMX           (1 << 6)
+#define CPUID_CPU_INFO_ECX_EIST          (1 << 7)
+#define CPUID_CPU_INFO_ECX_TM2           (1 << 8)
+#define CPUID_CPU_INFO_ECX_SSSE3         (1 << 9)
+#define CPUID_CPU_INFO_ECX_CNXT_ID       (1 << 10)
+#define CPUID_CPU_INFO_ECX_SDBG          (1 << 11)
+#define CPUID_CPU_INFO_ECX_FMA           (1 << 12)
+#define CPUID_CPU_INFO_ECX_CMPXCHG16B    (1 << 13)
+#define CPUID_CPU_INFO_ECX_XTPR_UC       (1 << 14)
+#define CPUID_CPU_INFO_ECX_PDCM          (1 << 15)
 //bit 16 is reserved
-#define CPUID_CPU_INFO_ECX_PCID          1 << 17
-#define CPUID_CPU_INFO_ECX_DCA           1 << 18
-#define CPUID_CPU_INFO_ECX_SSE4_1        1 << 19
-#define CPUID_CPU_INFO_ECX_SSE4_2        1 << 20
-#define CPUID_CPU_INFO_ECX_X2APIC        1 << 21
-#define CPUID_CPU_INFO_ECX_MOVBE         1 << 22
-#define CPUID_CPU_INFO_ECX_POPCNT        1 << 23
-#define CPUID_CPU_INFO_ECX_TSC_DEADLINE  1 << 24
-#define CPUID_CPU_INFO_ECX_AESNI         1 << 25
-#define CPUID_CPU_INFO_ECX_XSAVE         1 << 26
-#define CPUID_CPU_INFO_ECX_OSXSAVE       1 << 27
-#define CPUID_CPU_INFO_ECX_AVX           1 << 28
-#define CPUID_CPU_INFO_ECX_F16C          1 << 29
-#define CPUID_CPU_INFO_ECX_RDRAND        1 << 30
-//bit 31 is unused
-
-#define CPUID_CPU_INFO_EDX_FPU          1 << 0
-#define CPUID_CPU_INFO_EDX_VME          1 << 1
-#define CPUID_CPU_INFO_EDX_DE           1 << 2
-#define CPUID_CPU_INFO_EDX_PSE          1 << 3
-#define CPUID_CPU_INFO_EDX_TSC          1 << 4
-#define CPUID_CPU_INFO_EDX_MSR          1 << 5
-#define CPUID_CPU_INFO_EDX_PAE          1 << 6
-#define CPUID_CPU_INFO_EDX_MCE          1 << 7
-#define CPUID_CPU_INFO_EDX_CX8          1 << 8
-#define CPUID_CPU_INFO_EDX_APIC         1 << 9
+#define CPUID_CPU_INFO_ECX_PCID          (1 << 17)
+#define CPUID_CPU_INFO_ECX_DCA           (1 << 18)
+#define CPUID_CPU_INFO_ECX_SSE4_1        (1 << 19)
+#define CPUID_CPU_INFO_ECX_SSE4_2        (1 << 20)
+#define CPUID_CPU_INFO_ECX_X2APIC        (1 << 21)
+#define CPUID_CPU_INFO_ECX_MOVBE         (1 << 22)
+#define CPUID_CPU_INFO_ECX_POPCNT        (1 << 23)
+#define CPUID_CPU_INFO_ECX_TSC_DEADLINE  (1 << 24)
+#define CPUID_CPU_INFO_ECX_AESNI         (1 << 25)
+#define CPUID_CPU_INFO_ECX_XSAVE         (1 << 26)
+#define CPUID_CPU_INFO_ECX_OSXSAVE       (1 << 27)
+#define CPUID_CPU_INFO_ECX_AVX           (1 << 28)
+#define CPUID_CPU_INFO_ECX_F16C          (1 << 29)
+#define CPUID_CPU_INFO_ECX_RDRAND        (1 << 30)
+#define CPUID_CPU_INFO_ECX_HYPERVISOR    (1 << 31)
+
+#define CPUID_CPU_INFO_EDX_FPU          (1 << 0)
+#define CPUID_CPU_INFO_EDX_VME          (1 << 1)
+#define CPUID_CPU_INFO_EDX_DE           (1 << 2)
+#define CPUID_CPU_INFO_EDX_PSE          (1 << 3)
+#define CPUID_CPU_INFO_EDX_TSC          (1 << 4)
+#define CPUID_CPU_INFO_EDX_MSR          (1 << 5)
+#define CPUID_CPU_INFO_EDX_PAE          (1 << 6)
+#define CPUID_CPU_INFO_EDX_MCE          (1 << 7)
+#define CPUID_CPU_INFO_EDX_CX8          (1 << 8)
+#define CPUID_CPU_INFO_EDX_APIC         (1 << 9)
 //bit 10 is reserved
-#define CPUID_CPU_INFO_EDX_SEP          1 << 11
-#define CPUID_CPU_INFO_EDX_MTRR         1 << 12
-#define CPUID_CPU_INFO_EDX_PGE          1 << 13
-#define CPUID_CPU_INFO_EDX_MCA          1 << 14
-#define CPUID_CPU_INFO_EDX_CMOV         1 << 15
-#define CPUID_CPU_INFO_EDX_PAT          1 << 16
-#define CPUID_CPU_INFO_EDX_PSE_36       1 << 17
-#define CPUID_CPU_INFO_EDX_PSN          1 << 18
-#define CPUID_CPU_INFO_EDX_CLFSH        1 << 19
+#define CPUID_CPU_INFO_EDX_SEP          (1 << 11)
+#define CPUID_CPU_INFO_EDX_MTRR         (1 << 12)
+#define CPUID_CPU_INFO_EDX_PGE          (1 << 13)
+#define CPUID_CPU_INFO_EDX_MCA          (1 << 14)
+#define CPUID_CPU_INFO_EDX_CMOV         (1 << 15)
+#define CPUID_CPU_INFO_EDX_PAT          (1 << 16)
+#define CPUID_CPU_INFO_EDX_PSE_36       (1 << 17)
+#define CPUID_CPU_INFO_EDX_PSN          (1 << 18)
+#define CPUID_CPU_INFO_EDX_CLFSH        (1 << 19)
 //bit 20 is reserved
-#define CPUID_CPU_INFO_EDX_DS           1 << 21
-#define CPUID_CPU_INFO_EDX_ACPI         1 << 22
-#define CPUID_CPU_INFO_EDX_MMX          1 << 23
-#define CPUID_CPU_INFO_EDX_FXSR         1 << 24
-#define CPUID_CPU_INFO_EDX_SSE          1 << 25
-#define CPUID_CPU_INFO_EDX_SSE2         1 << 26
-#define CPUID_CPU_INFO_EDX_SS           1 << 27
-#define CPUID_CPU_INFO_EDX_HTT          1 << 28
-#define CPUID_CPU_INFO_EDX_TM           1 << 29
+#define CPUID_CPU_INFO_EDX_DS           (1 << 21)
+#define CPUID_CPU_INFO_EDX_ACPI         (1 << 22)
+#define CPUID_CPU_INFO_EDX_MMX          (1 << 23)
+#define CPUID_CPU_INFO_EDX_FXSR         (1 << 24)
+#define CPUID_CPU_INFO_EDX_SSE          (1 << 25)
+#define CPUID_CPU_INFO_EDX_SSE2         (1 << 26)
+#define CPUID_CPU_INFO_EDX_SS           (1 << 27)
+#define CPUID_CPU_INFO_EDX_HTT          (1 << 28)
+#define CPUID_CPU_INFO_EDX_TM           (1 << 29)
 //bit 30 is reserved
-#define CPUID_CPU_INFO_EDX_PBE          1 << 31
+#define CPUID_CPU_INFO_EDX_PBE          (1 << 31)
 
 //===============CPUID_CACHE_TLB===============
 //WARNING: I gave up and used ChatGPT for these
@@ -207,12 +207,13 @@
 #define CPUID_SERIAL_NUMBER_STITCH(ECX,EDX) (uint64_t)((EDX << 32) | ECX)
 
 //=============CPUID_CACHE_PARAMS==============
-#define CPUID_CACHE_PARAMS_EAX_CACHE_TYPE             0xF
-#define CPUID_CACHE_PARAMS_EAX_CACHE_LEVEL            0x7 << 4
-#define CPUID_CACHE_PARAMS_EAX_IS_SELF_INIT           1 << 8 
-#define CPUID_CACHE_PARAMS_EAX_IS_FULLY_ASSOCIATIVE   1 << 9
+#define CPUID_CACHE_PARAMS_EAX_CACHE_TYPE             0x1F
+#define CPUID_CACHE_PARAMS_EAX_CACHE_LEVEL            (0x7 << 5)
+#define CPUID_CACHE_PARAMS_EAX_IS_SELF_INIT           (1 << 8) 
+#define CPUID_CACHE_PARAMS_EAX_IS_FULLY_ASSOCIATIVE   (1 << 9)
 // bits 10-13 are reserved
-#define CPUID_CACHE_PARAMS_EAX_MAX_PROC_SHARING       0xFFF << 14
+#define CPUID_CACHE_PARAMS_EAX_MAX_PROC_SHARING       (0xFFF << 14)
+#define CPUID_CACHE_PARAMS_EAX_MAX_CORES_IN_PACKAGE   (0x3Fu << 26)
 
 #define CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_NULL        0x0
 #define CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA        0x1
@@ -220,183 +221,493 @@
 #define CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_UNIFIED     0x3
 
 #define CPUID_CACHE_PARAMS_EBX_COHERENCY_LINE_SIZE    0xFFF
-#define CPUID_CACHE_PARAMS_EBX_PHYS_LINE_PARTITIONS   0x3FF << 12
-#define CPUID_CACHE_PARAMS_EBX_WAYS_OF_ASSOCIVITY     0x3FF
+#define CPUID_CACHE_PARAMS_EBX_PHYS_LINE_PARTITIONS   (0x3FF << 12)
+#define CPUID_CACHE_PARAMS_EBX_WAYS_OF_ASSOCIVITY     (0x3FFu << 22)
 
-#define CPUID_CACHE_PARAMS_EDX_CACHE_INCLUSIVENESS    1
-#define CPUID_CACHE_PARAMS_EDX_COMPLEX_CACHE_INDEXING 1 << 1
+#define CPUID_CACHE_PARAMS_EDX_WBINVD_NOT_INCLUSIVE   1
+#define CPUID_CACHE_PARAMS_EDX_CACHE_INCLUSIVENESS    (1 << 1)
+#define CPUID_CACHE_PARAMS_EDX_COMPLEX_CACHE_INDEXING (1 << 2)
 
 //=============CPUID_MONITOR_MWAIT=============
+#define CPUID_MONITOR_MWAIT_EAX_SMALLEST_LINE         0xFFFF
+#define CPUID_MONITOR_MWAIT_EBX_LARGEST_LINE          0xFFFF
+
 #define CPUID_MONITOR_MWAIT_ECX_ENUM_EXTENSIONS       1
-#define CPUID_MONITOR_MWAIT_ECX_BREAK_EVENTS          1 << 1
+#define CPUID_MONITOR_MWAIT_ECX_BREAK_EVENTS          (1 << 1)
 
 #define CPUID_MONITOR_MWAIT_EDX_C0_SUBC_STATES        0xF
-#define CPUID_MONITOR_MWAIT_EDX_C1_SUBC_STATES        0xF << 4
-#define CPUID_MONITOR_MWAIT_EDX_C2_SUBC_STATES        0xF << 8
-#define CPUID_MONITOR_MWAIT_EDX_C3_SUBC_STATES        0xF << 12
-#define CPUID_MONITOR_MWAIT_EDX_C4_SUBC_STATES        0xF << 16
-#define CPUID_MONITOR_MWAIT_EDX_C5_SUBC_STATES        0xF << 20
-#define CPUID_MONITOR_MWAIT_EDX_C6_SUBC_STATES        0xF << 24
-#define CPUID_MONITOR_MWAIT_EDX_C7_SUBC_STATES        0xF << 28
+#define CPUID_MONITOR_MWAIT_EDX_C1_SUBC_STATES        (0xF << 4)
+#define CPUID_MONITOR_MWAIT_EDX_C2_SUBC_STATES        (0xF << 8)
+#define CPUID_MONITOR_MWAIT_EDX_C3_SUBC_STATES        (0xF << 12)
+#define CPUID_MONITOR_MWAIT_EDX_C4_SUBC_STATES        (0xF << 16)
+#define CPUID_MONITOR_MWAIT_EDX_C5_SUBC_STATES        (0xF << 20)
+#define CPUID_MONITOR_MWAIT_EDX_C6_SUBC_STATES        (0xF << 24)
+#define CPUID_MONITOR_MWAIT_EDX_C7_SUBC_STATES        (0xFu << 28)
 
 //===========CPUID_THERMAL_AND_POWER===========
 #define CPUID_THERMAL_AND_POWER_EAX_TEMP_SENSOR       1
-#define CPUID_THERMAL_AND_POWER_EAX_TURBO_BOOST       1 << 1
-#define CPUID_THERMAL_AND_POWER_EAX_ARAT              1 << 2
+#define CPUID_THERMAL_AND_POWER_EAX_TURBO_BOOST       (1 << 1)
+#define CPUID_THERMAL_AND_POWER_EAX_ARAT              (1 << 2)
 //Bit 3 is reserved
-#define CPUID_THERMAL_AND_POWER_EAX_PLN               1 << 3
-#define CPUID_THERMAL_AND_POWER_EAX_ECMD              1 << 5
-#define CPUID_THERMAL_AND_POWER_EAX_PTM               1 << 6
-#define CPUID_THERMAL_AND_POWER_EAX_HWP               1 << 7
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_NOTIFICATION  1 << 8
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_ACT_WINDOW    1 << 9
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_PERF_PREF     1 << 10
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_PKG_LVL_REQ   1 << 11
+#define CPUID_THERMAL_AND_POWER_EAX_PLN               (1 << 3)
+#define CPUID_THERMAL_AND_POWER_EAX_ECMD              (1 << 5)
+#define CPUID_THERMAL_AND_POWER_EAX_PTM               (1 << 6)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP               (1 << 7)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_NOTIFICATION  (1 << 8)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_ACT_WINDOW    (1 << 9)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_PERF_PREF     (1 << 10)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_PKG_LVL_REQ   (1 << 11)
 //Bit 12 is reserved
-#define CPUID_THERMAL_AND_POWER_EAX_HDC               1 << 13
-#define CPUID_THERMAL_AND_POWER_EAX_TURBO_BOOST_MAX   1 << 14
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_CAPABILITIES  1 << 15
-#define CPUID_THERMAL_AND_POWER_EAX_HWP_PECI          1 << 16
-#define CPUID_THERMAL_AND_POWER_EAX_FLEXIBLE_HWP      1 << 17
-#define CPUID_THERMAL_AND_POWER_EAX_FAST_HWP_REQUEST  1 << 18
-#define CPUID_THERMAL_AND_POWER_EAX_HW_FEEDBACK       1 << 19
-#define CPUID_THERMAL_AND_POWER_EAX_IGNORE_HWP_IDLE   1 << 20
+#define CPUID_THERMAL_AND_POWER_EAX_HDC               (1 << 13)
+#define CPUID_THERMAL_AND_POWER_EAX_TURBO_BOOST_MAX   (1 << 14)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_CAPABILITIES  (1 << 15)
+#define CPUID_THERMAL_AND_POWER_EAX_HWP_PECI          (1 << 16)
+#define CPUID_THERMAL_AND_POWER_EAX_FLEXIBLE_HWP      (1 << 17)
+#define CPUID_THERMAL_AND_POWER_EAX_FAST_HWP_REQUEST  (1 << 18)
+#define CPUID_THERMAL_AND_POWER_EAX_HW_FEEDBACK       (1 << 19)
+#define CPUID_THERMAL_AND_POWER_EAX_IGNORE_HWP_IDLE   (1 << 20)
 //Bits 21 and 22 are reserved
-#define CPUID_THERMAL_AND_POWER_EAX_THREAD_DIRECTOR   1 << 23
-#define CPUID_THERMAL_AND_POWER_EAX_THERM_INTERRUPT   1 << 24
+#define CPUID_THERMAL_AND_POWER_EAX_THREAD_DIRECTOR   (1 << 23)
+#define CPUID_THERMAL_AND_POWER_EAX_THERM_INTERRUPT   (1 << 24)
 
 #define CPUID_THERMAL_AND_POWER_EBX_INT_TRESHOLD      0xf
 
 #define CPUID_THERMAL_AND_POWER_ECX_HW_COORD_FEEDBACK 1
-#define CPUID_THERMAL_AND_POWER_ECX_ENERGY_PERF_BIAS  1 << 3
-#define CPUID_THERMAL_AND_POWER_ECX_TD_CLASSES        0xff << 8
+#define CPUID_THERMAL_AND_POWER_ECX_ENERGY_PERF_BIAS  (1 << 3)
+#define CPUID_THERMAL_AND_POWER_ECX_TD_CLASSES        (0xff << 8)
 
 #define CPUID_THERMAL_AND_POWER_EDX_PERF_REPORT       1
-#define CPUID_THERMAL_AND_POWER_EDX_EFFICIENCY_REPORT 1      << 1
-#define CPUID_THERMAL_AND_POWER_EDX_HW_FEEDBACK_SIZE  0xf    << 8
-#define CPUID_THERMAL_AND_POWER_EDX_THIS_PROC_HW_FB   0xffff << 16
+#define CPUID_THERMAL_AND_POWER_EDX_EFFICIENCY_REPORT (1      << 1)
+#define CPUID_THERMAL_AND_POWER_EDX_HW_FEEDBACK_SIZE  (0xf    << 8)
+#define CPUID_THERMAL_AND_POWER_EDX_THIS_PROC_HW_FB   (0xffff << 16)
 
 //===========CPUID_EXTENDED_FEATURES===========
 #define CPUID_EXTENDED_FEATURES_EBX_FSGSBASE          1 
-#define CPUID_EXTENDED_FEATURES_EBX_TSC_ADJUST        1 << 1
-#define CPUID_EXTENDED_FEATURES_EBX_SGX               1 << 2
-#define CPUID_EXTENDED_FEATURES_EBX_BMI1              1 << 3
-#define CPUID_EXTENDED_FEATURES_EBX_HLE               1 << 4
-#define CPUID_EXTENDED_FEATURES_EBX_AVX2              1 << 5
-#define CPUID_EXTENDED_FEATURES_EBX_FDP_EXCPTN_ONLY   1 << 6
-#define CPUID_EXTENDED_FEATURES_EBX_SMEP              1 << 7
-#define CPUID_EXTENDED_FEATURES_EBX_BMI2              1 << 8
-#define CPUID_EXTENDED_FEATURES_EBX_ENHANCED_REP      1 << 9
-#define CPUID_EXTENDED_FEATURES_EBX_INVCIP            1 << 10
-#define CPUID_EXTENDED_FEATURES_EBX_RTM               1 << 11
-#define CPUID_EXTENDED_FEATURES_EBX_RDT_M             1 << 12
-#define CPUID_EXTENDED_FEATURES_EBX_NO_FPU_CS         1 << 13
-#define CPUID_EXTENDED_FEATURES_EBX_MPX               1 << 14
-#define CPUID_EXTENDED_FEATURES_EBX_RDT_A             1 << 15
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512F           1 << 16
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512DQ          1 << 17
-#define CPUID_EXTENDED_FEATURES_EBX_RDSEED            1 << 18
-#define CPUID_EXTENDED_FEATURES_EBX_ADX               1 << 19
-#define CPUID_EXTENDED_FEATURES_EBX_SMAP              1 << 20
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512_IFMA       1 << 21
+#define CPUID_EXTENDED_FEATURES_EBX_TSC_ADJUST        (1 << 1)
+#define CPUID_EXTENDED_FEATURES_EBX_SGX               (1 << 2)
+#define CPUID_EXTENDED_FEATURES_EBX_BMI1              (1 << 3)
+#define CPUID_EXTENDED_FEATURES_EBX_HLE               (1 << 4)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX2              (1 << 5)
+#define CPUID_EXTENDED_FEATURES_EBX_FDP_EXCPTN_ONLY   (1 << 6)
+#define CPUID_EXTENDED_FEATURES_EBX_SMEP              (1 << 7)
+#define CPUID_EXTENDED_FEATURES_EBX_BMI2              (1 << 8)
+#define CPUID_EXTENDED_FEATURES_EBX_ENHANCED_REP      (1 << 9)
+#define CPUID_EXTENDED_FEATURES_EBX_INVCIP            (1 << 10)
+#define CPUID_EXTENDED_FEATURES_EBX_RTM               (1 << 11)
+#define CPUID_EXTENDED_FEATURES_EBX_RDT_M             (1 << 12)
+#define CPUID_EXTENDED_FEATURES_EBX_NO_FPU_CS         (1 << 13)
+#define CPUID_EXTENDED_FEATURES_EBX_MPX               (1 << 14)
+#define CPUID_EXTENDED_FEATURES_EBX_RDT_A             (1 << 15)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512F           (1 << 16)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512DQ          (1 << 17)
+#define CPUID_EXTENDED_FEATURES_EBX_RDSEED            (1 << 18)
+#define CPUID_EXTENDED_FEATURES_EBX_ADX               (1 << 19)
+#define CPUID_EXTENDED_FEATURES_EBX_SMAP              (1 << 20)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512_IFMA       (1 << 21)
 // Bit 22 is reserved
-#define CPUID_EXTENDED_FEATURES_EBX_CLFLUSHOPT        1 << 23
-#define CPUID_EXTENDED_FEATURES_EBX_CLWB              1 << 24
-#define CPUID_EXTENDED_FEATURES_EBX_TRACE             1 << 25
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512PF          1 << 26
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512ER          1 << 27
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512CD          1 << 28
-#define CPUID_EXTENDED_FEATURES_EBX_SHA               1 << 29
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512BW          1 << 30
-#define CPUID_EXTENDED_FEATURES_EBX_AVX512VL          1 << 31
+#define CPUID_EXTENDED_FEATURES_EBX_CLFLUSHOPT        (1 << 23)
+#define CPUID_EXTENDED_FEATURES_EBX_CLWB              (1 << 24)
+#define CPUID_EXTENDED_FEATURES_EBX_TRACE             (1 << 25)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512PF          (1 << 26)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512ER          (1 << 27)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512CD          (1 << 28)
+#define CPUID_EXTENDED_FEATURES_EBX_SHA               (1 << 29)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512BW          (1 << 30)
+#define CPUID_EXTENDED_FEATURES_EBX_AVX512VL          (1 << 31)
 
 #define CPUID_EXTENDED_FEATURES_ECX_PREFETCHWT1       1
-#define CPUID_EXTENDED_FEATURES_ECX_AFX512_VBMI       1 << 1
-#define CPUID_EXTENDED_FEATURES_ECX_UMIP              1 << 2
-#define CPUID_EXTENDED_FEATURES_ECX_PKU               1 << 3
-#define CPUID_EXTENDED_FEATURES_ECX_OSPKE             1 << 4
-#define CPUID_EXTENDED_FEATURES_ECX_WAITPKG           1 << 5
-#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VBMI2      1 << 6
-#define CPUID_EXTENDED_FEATURES_ECX_CET_SS            1 << 7
-#define CPUID_EXTENDED_FEATURES_ECX_GFNI              1 << 8
-#define CPUID_EXTENDED_FEATURES_ECX_VAES              1 << 9
-#define CPUID_EXTENDED_FEATURES_ECX_VPCLMULQDQ        1 << 10
-#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VNNI       1 << 11
-#define CPUID_EXTENDED_FEATURES_ECX_AVX512_BITLANG    1 << 12
-#define CPUID_EXTENDED_FEATURES_ECX_TME_EN            1 << 13
-#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VPOPVNZDQ  1 << 14
+#define CPUID_EXTENDED_FEATURES_ECX_AFX512_VBMI       (1 << 1)
+#define CPUID_EXTENDED_FEATURES_ECX_UMIP              (1 << 2)
+#define CPUID_EXTENDED_FEATURES_ECX_PKU               (1 << 3)
+#define CPUID_EXTENDED_FEATURES_ECX_OSPKE             (1 << 4)
+#define CPUID_EXTENDED_FEATURES_ECX_WAITPKG           (1 << 5)
+#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VBMI2      (1 << 6)
+#define CPUID_EXTENDED_FEATURES_ECX_CET_SS            (1 << 7)
+#define CPUID_EXTENDED_FEATURES_ECX_GFNI              (1 << 8)
+#define CPUID_EXTENDED_FEATURES_ECX_VAES              (1 << 9)
+#define CPUID_EXTENDED_FEATURES_ECX_VPCLMULQDQ        (1 << 10)
+#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VNNI       (1 << 11)
+#define CPUID_EXTENDED_FEATURES_ECX_AVX512_BITLANG    (1 << 12)
+#define CPUID_EXTENDED_FEATURES_ECX_TME_EN            (1 << 13)
+#define CPUID_EXTENDED_FEATURES_ECX_AVX512_VPOPVNZDQ  (1 << 14)
 //bit 15 is reserved
-#define CPUID_EXTENDED_FEATURES_ECX_LA57              1 << 16
-#define CPUID_EXTENDED_FEATURES_ECX_MAWAU_VAL         0x1F << 17
-#define CPUID_EXTENDED_FEATURES_ECX_RDPID             1 << 22
-#define CPUID_EXTENDED_FEATURES_ECX_KL                1 << 23
-#define CPUID_EXTENDED_FEATURES_ECX_BUS_LOCK_DETECT   1 << 24
-#define CPUID_EXTENDED_FEATURES_ECX_CLDEMOTE          1 << 25
+#define CPUID_EXTENDED_FEATURES_ECX_LA57              (1 << 16)
+#define CPUID_EXTENDED_FEATURES_ECX_MAWAU_VAL         (0x1F << 17)
+#define CPUID_EXTENDED_FEATURES_ECX_RDPID             (1 << 22)
+#define CPUID_EXTENDED_FEATURES_ECX_KL                (1 << 23)
+#define CPUID_EXTENDED_FEATURES_ECX_BUS_LOCK_DETECT   (1 << 24)
+#define CPUID_EXTENDED_FEATURES_ECX_CLDEMOTE          (1 << 25)
 //bit 26 is reserved
-#define CPUID_EXTENDED_FEATURES_ECX_MOVDIRI           1 << 27
-#define CPUID_EXTENDED_FEATURES_ECX_MOVDIR64B         1 << 28
-#define CPUID_EXTENDED_FEATURES_ECX_ENQCMD            1 << 29
-#define CPUID_EXTENDED_FEATURES_ECX_SGX_LC            1 << 30
-#define CPUID_EXTENDED_FEATURES_ECX_PKS               1 << 31
+#define CPUID_EXTENDED_FEATURES_ECX_MOVDIRI           (1 << 27)
+#define CPUID_EXTENDED_FEATURES_ECX_MOVDIR64B         (1 << 28)
+#define CPUID_EXTENDED_FEATURES_ECX_ENQCMD            (1 << 29)
+#define CPUID_EXTENDED_FEATURES_ECX_SGX_LC            (1 << 30)
+#define CPUID_EXTENDED_FEATURES_ECX_PKS               (1 << 31)
 
 //bit 0 is reserved
-#define CPUID_EXTENDED_FEATURES_EDX_SGX_KEYS          1 << 1
-#define CPUID_EXTENDED_FEATURES_EDX_AVX512_4VNNIW     1 << 2
-#define CPUID_EXTENDED_FEATURES_EDX_AVX512_4FMAPS     1 << 3
-#define CPUID_EXTENDED_FEATURES_EDX_FAST_REP_MOV      1 << 4
-#define CPUID_EXTENDED_FEATURES_EDX_UINTR             1 << 5
+#define CPUID_EXTENDED_FEATURES_EDX_SGX_KEYS          (1 << 1)
+#define CPUID_EXTENDED_FEATURES_EDX_AVX512_4VNNIW     (1 << 2)
+#define CPUID_EXTENDED_FEATURES_EDX_AVX512_4FMAPS     (1 << 3)
+#define CPUID_EXTENDED_FEATURES_EDX_FAST_REP_MOV      (1 << 4)
+#define CPUID_EXTENDED_FEATURES_EDX_UINTR             (1 << 5)
 //bits 6 and 7 are reserved
-#define CPUID_EXTENDED_FEATURES_EDX_AVX512_VPINTERSECT 1 << 8 // intel you son of a bitch
-#define CPUID_EXTENDED_FEATURES_EDX_SRBDS_CTRL        1 << 9
-#define CPUID_EXTENDED_FEATURES_EDX_MD_CLEAR          1 << 10
-#define CPUID_EXTENDED_FEATURES_EDX_RTM_ALWAYS_ABORT  1 << 11
+#define CPUID_EXTENDED_FEATURES_EDX_AVX512_VPINTERSECT (1 << 8) // intel you son of a bitch
+#define CPUID_EXTENDED_FEATURES_EDX_SRBDS_CTRL        (1 << 9)
+#define CPUID_EXTENDED_FEATURES_EDX_MD_CLEAR          (1 << 10)
+#define CPUID_EXTENDED_FEATURES_EDX_RTM_ALWAYS_ABORT  (1 << 11)
 //bit 12 is reserved
-#define CPUID_EXTENDED_FEATURES_EDX_RTM_FORCE_ABORT   1 << 13
-#define CPUID_EXTENDED_FEATURES_EDX_SERIALIZE         1 << 14
-#define CPUID_EXTENDED_FEATURES_EDX_HYBRID            1 << 15
-#define CPUID_EXTENDED_FEATURES_EDX_TSXLDTRK          1 << 16
+#define CPUID_EXTENDED_FEATURES_EDX_RTM_FORCE_ABORT   (1 << 13)
+#define CPUID_EXTENDED_FEATURES_EDX_SERIALIZE         (1 << 14)
+#define CPUID_EXTENDED_FEATURES_EDX_HYBRID            (1 << 15)
+#define CPUID_EXTENDED_FEATURES_EDX_TSXLDTRK          (1 << 16)
 //bit 17 is reserved
-#define CPUID_EXTENDED_FEATURES_EDX_PCONFIG           1 << 18
-#define CPUID_EXTENDED_FEATURES_EDX_ARCHITECTURAL_LBR 1 << 19
-#define CPUID_EXTENDED_FEATURES_EDX_CET_IBT           1 << 20
+#define CPUID_EXTENDED_FEATURES_EDX_PCONFIG           (1 << 18)
+#define CPUID_EXTENDED_FEATURES_EDX_ARCHITECTURAL_LBR (1 << 19)
+#define CPUID_EXTENDED_FEATURES_EDX_CET_IBT           (1 << 20)
 //bit 21 is reserved
-#define CPUID_EXTENDED_FEATURES_EDX_AMX_BF16          1 << 22
-#define CPUID_EXTENDED_FEATURES_EDX_AVX512_FP16       1 << 23
-#define CPUID_EXTENDED_FEATURES_EDX_AMX_TILE          1 << 24
-#define CPUID_EXTENDED_FEATURES_EDX_AMX_INT8          1 << 25
-#define CPUID_EXTENDED_FEATURES_EDX_IBRS              1 << 26
-#define CPUID_EXTENDED_FEATURES_EDX_STIBP             1 << 27
-#define CPUID_EXTENDED_FEATURES_EDX_L1D_FLUSH         1 << 28
-#define CPUID_EXTENDED_FEATURES_EDX_ARCH_CAPABS_MSR   1 << 29
-#define CPUID_EXTENDED_FEATURES_EDX_CORE_CAPABS_MSR   1 << 30
-#define CPUID_EXTENDED_FEATURES_EDX_SSBD              1 << 31
+#define CPUID_EXTENDED_FEATURES_EDX_AMX_BF16          (1 << 22)
+#define CPUID_EXTENDED_FEATURES_EDX_AVX512_FP16       (1 << 23)
+#define CPUID_EXTENDED_FEATURES_EDX_AMX_TILE          (1 << 24)
+#define CPUID_EXTENDED_FEATURES_EDX_AMX_INT8          (1 << 25)
+#define CPUID_EXTENDED_FEATURES_EDX_IBRS              (1 << 26)
+#define CPUID_EXTENDED_FEATURES_EDX_STIBP             (1 << 27)
+#define CPUID_EXTENDED_FEATURES_EDX_L1D_FLUSH         (1 << 28)
+#define CPUID_EXTENDED_FEATURES_EDX_ARCH_CAPABS_MSR   (1 << 29)
+#define CPUID_EXTENDED_FEATURES_EDX_CORE_CAPABS_MSR   (1 << 30)
+#define CPUID_EXTENDED_FEATURES_EDX_SSBD              (1 << 31)
 
 //=========CPUID_EXTENDED_FEATURES_SL1=========
 //bits 0-3 are reserved
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_AVX_VNNI     1 << 4
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_AVX512_BF16  1 << 5
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_AVX_VNNI     (1 << 4)
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_AVX512_BF16  (1 << 5)
 //bits 6-9 are reserved 
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_0_REP_MOVSB  1 << 10
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_STOSB   1 << 11
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_CMPSB   1 << 12
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_0_REP_MOVSB  (1 << 10)
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_STOSB   (1 << 11)
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_FAST_CMPSB   (1 << 12)
 //bits 13-21 are reserved
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_HRESET       1 << 22
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_HRESET       (1 << 22)
 //bits 23-19 are reserved
-#define CPUID_EXTENDED_FEATURES_SL1_EAX_INVD_POSTPOST 1 << 30
+#define CPUID_EXTENDED_FEATURES_SL1_EAX_INVD_POSTPOST (1 << 30)
 //bit 31 is reserved
 
 #define CPUID_EXTENDED_FEATURES_SL1_EBX_PPIN         1
 
-#define CPUID_EXTENDED_FEATURES_SL1_EDX_CET_SSS      1 << 18
+#define CPUID_EXTENDED_FEATURES_SL1_EDX_CET_SSS      (1 << 18)
 
 //=========CPUID_EXTENDED_FEATURES_SL2=========
 #define CPUID_EXTENDED_FEATURES_SL2_EDX_PSFD         1
-#define CPUID_EXTENDED_FEATURES_SL2_EDX_IPRED_CTRL   1 << 1
-#define CPUID_EXTENDED_FEATURES_SL2_EDX_RRSBA_CTRL   1 << 2
-#define CPUID_EXTENDED_FEATURES_SL2_EDX_DDPD_U       1 << 3
-#define CPUID_EXTENDED_FEATURES_SL2_EDX_BHI_CTRL     1 << 4
+#define CPUID_EXTENDED_FEATURES_SL2_EDX_IPRED_CTRL   (1 << 1)
+#define CPUID_EXTENDED_FEATURES_SL2_EDX_RRSBA_CTRL   (1 << 2)
+#define CPUID_EXTENDED_FEATURES_SL2_EDX_DDPD_U       (1 << 3)
+#define CPUID_EXTENDED_FEATURES_SL2_EDX_BHI_CTRL     (1 << 4)
 //The rest of the bits are reserved
 
+//===CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS===
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_4K_PAGES      1
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_2M_PAGES      (1 << 1)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_4M_PAGES      (1 << 2)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_1G_PAGES      (1 << 3)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_PARTITIONING  (0x7 << 8)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EBX_WAYS          (0xFFFFu << 16)
+
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_TYPE          0x1F
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_LEVEL         (0x7 << 5)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_FULLY_ASSOC   (1 << 8)
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_EDX_MAX_SHARING   (0xFFF << 14)
+
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_NULL         0x0
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_DATA         0x1
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_INSTRUCTION  0x2
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_UNIFIED      0x3
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_LOAD_ONLY    0x4
+#define CPUID_DETERMINISTIC_ADRESS_TRANSLATION_PARAMS_TYPE_STORE_ONLY   0x5
+
+//==============CPUID_CPU_FREQ_INFO============
+#define CPUID_CPU_FREQ_INFO_EAX_BASE_MHZ    0xFFFF
+#define CPUID_CPU_FREQ_INFO_EBX_MAX_MHZ     0xFFFF
+#define CPUID_CPU_FREQ_INFO_ECX_BUS_MHZ     0xFFFF
+
+//=========CPUID_PERFORMANCE_MONITORING=========
+#define CPUID_PERFORMANCE_MONITORING_EAX_VERSION        0xFF
+#define CPUID_PERFORMANCE_MONITORING_EAX_GP_COUNTERS    (0xFF << 8)
+#define CPUID_PERFORMANCE_MONITORING_EAX_GP_WIDTH       (0xFF << 16)
+#define CPUID_PERFORMANCE_MONITORING_EAX_EBX_LENGTH     (0xFFu << 24) //valid bits in EBX
+
+//Set = the architectural event is NOT available
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_CYCLES          (1 << 0)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_INSTRUCTIONS    (1 << 1)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_REF_CYCLES      (1 << 2)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_LLC_REFERENCES  (1 << 3)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_LLC_MISSES      (1 << 4)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_BRANCHES        (1 << 5)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_BRANCH_MISSES   (1 << 6)
+#define CPUID_PERFORMANCE_MONITORING_EBX_NO_TOPDOWN_SLOTS   (1 << 7)
+
+//ECX(version 5+): bitmap of the fixed counters that exist
+#define CPUID_PERFORMANCE_MONITORING_ECX_FIXED_MASK     0xFFFFFFFFu
+
+#define CPUID_PERFORMANCE_MONITORING_EDX_FIXED_COUNTERS (0x1F)
+#define CPUID_PERFORMANCE_MONITORING_EDX_FIXED_WIDTH    (0xFF << 5)
+#define CPUID_PERFORMANCE_MONITORING_EDX_ANYTHREAD_DEPRECATED (1 << 15)
+
+//=========CPUID_EXTENDENDED_TOPOLOGY=========
+//Also the layout of CPUID_V2_EXTENDED_TOPOLOGY
+#define CPUID_EXTENDENDED_TOPOLOGY_EAX_SHIFT           0x1F
+#define CPUID_EXTENDENDED_TOPOLOGY_EBX_LOGICAL_PROCS   0xFFFF
+#define CPUID_EXTENDENDED_TOPOLOGY_ECX_LEVEL_NUMBER    0xFF
+#define CPUID_EXTENDENDED_TOPOLOGY_ECX_LEVEL_TYPE      (0xFF << 8)
+
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_INVALID       0x0
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_SMT           0x1
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_CORE          0x2
+//the ones below only show up in CPUID_V2_EXTENDED_TOPOLOGY
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_MODULE        0x3
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_TILE          0x4
+#define CPUID_EXTENDENDED_TOPOLOGY_LEVEL_DIE           0x5
+
+//=================CPUID_XSAVE=================
+//Subleaf 0: EAX/EDX are the XCR0 bits the CPU supports, EBX the standard area size for the current XCR0,
+//ECX the standard area size if every supported component was enabled
+//Subleaf 1:
+#define CPUID_XSAVE_1_EAX_XSAVEOPT        (1 << 0)
+#define CPUID_XSAVE_1_EAX_XSAVEC          (1 << 1)
+#define CPUID_XSAVE_1_EAX_XGETBV_ECX1     (1 << 2) //XGETBV(1) returns XINUSE
+#define CPUID_XSAVE_1_EAX_XSAVES          (1 << 3)
+#define CPUID_XSAVE_1_EAX_XFD             (1 << 4)
+//EBX is the compacted area size for the current XCR0 | IA32_XSS, ECX/EDX are the IA32_XSS bits the CPU supports
+//Subleaf n >= 2(component n): EAX is its size, EBX its offset in the standard format and
+#define CPUID_XSAVE_N_ECX_SUPERVISOR      (1 << 0) //managed through IA32_XSS, not XCR0
+#define CPUID_XSAVE_N_ECX_ALIGN64         (1 << 1) //64 byte aligned in the compacted format
+#define CPUID_XSAVE_N_ECX_XFD             (1 << 2)
+
+//=========CPUID_EXTENDED_SIGNATURE=========
+#define CPUID_EXTENDED_SIGNATURE_ECX_LAHF_SAHF     1
+#define CPUID_EXTENDED_SIGNATURE_ECX_CMP_LEGACY    (1 << 1)
+#define CPUID_EXTENDED_SIGNATURE_ECX_SVM           (1 << 2)
+#define CPUID_EXTENDED_SIGNATURE_ECX_EXTAPIC       (1 << 3)
+#define CPUID_EXTENDED_SIGNATURE_ECX_CR8_LEGACY    (1 << 4)
+#define CPUID_EXTENDED_SIGNATURE_ECX_LZCNT         (1 << 5)
+#define CPUID_EXTENDED_SIGNATURE_ECX_SSE4A         (1 << 6)
+#define CPUID_EXTENDED_SIGNATURE_ECX_MISALIGN_SSE  (1 << 7)
+#define CPUID_EXTENDED_SIGNATURE_ECX_PREFETCHW     (1 << 8)
+#define CPUID_EXTENDED_SIGNATURE_ECX_OSVW          (1 << 9)
+#define CPUID_EXTENDED_SIGNATURE_ECX_IBS           (1 << 10)
+#define CPUID_EXTENDED_SIGNATURE_ECX_XOP           (1 << 11)
+#define CPUID_EXTENDED_SIGNATURE_ECX_SKINIT        (1 << 12)
+#define CPUID_EXTENDED_SIGNATURE_ECX_WDT           (1 << 13)
+//bit 14 is reserved
+#define CPUID_EXTENDED_SIGNATURE_ECX_LWP           (1 << 15)
+#define CPUID_EXTENDED_SIGNATURE_ECX_FMA4          (1 << 16)
+#define CPUID_EXTENDED_SIGNATURE_ECX_TCE           (1 << 17)
+//bit 18 is reserved
+#define CPUID_EXTENDED_SIGNATURE_ECX_NODEID_MSR    (1 << 19)
+//bit 20 is reserved
+#define CPUID_EXTENDED_SIGNATURE_ECX_TBM           (1 << 21)
+#define CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT       (1 << 22)
+#define CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_CORE  (1 << 23)
+#define CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_NB    (1 << 24)
+//bit 25 is reserved
+#define CPUID_EXTENDED_SIGNATURE_ECX_DBX           (1 << 26)
+#define CPUID_EXTENDED_SIGNATURE_ECX_PERFTSC       (1 << 27)
+#define CPUID_EXTENDED_SIGNATURE_ECX_PERFCTR_LLC   (1 << 28)
+#define CPUID_EXTENDED_SIGNATURE_ECX_MONITORX      (1 << 29)
+
+//bits 0-10 mirror CPUID_CPU_INFO_EDX on AMD, they are reserved on Intel
+#define CPUID_EXTENDED_SIGNATURE_EDX_SYSCALL       (1 << 11)
+#define CPUID_EXTENDED_SIGNATURE_EDX_MP            (1 << 19)
+#define CPUID_EXTENDED_SIGNATURE_EDX_NX            (1 << 20)
+#define CPUID_EXTENDED_SIGNATURE_EDX_MMXEXT        (1 << 22)
+#define CPUID_EXTENDED_SIGNATURE_EDX_FXSR_OPT      (1 << 25)
+#define CPUID_EXTENDED_SIGNATURE_EDX_PDPE1GB       (1 << 26)
+#define CPUID_EXTENDED_SIGNATURE_EDX_RDTSCP        (1 << 27)
+//bit 28 is reserved
+#define CPUID_EXTENDED_SIGNATURE_EDX_LM            (1 << 29)
+#define CPUID_EXTENDED_SIGNATURE_EDX_3DNOWEXT      (1 << 30)
+#define CPUID_EXTENDED_SIGNATURE_EDX_3DNOW         (1 << 31)
+
+//========CPUID_INVARIANT_TSC_AVAILABLE========
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_TS             1
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_FID            (1 << 1)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_VID            (1 << 2)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_TTP            (1 << 3)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_TM             (1 << 4)
+//bit 5 is reserved
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_100MHZ_STEPS   (1 << 6)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_HW_PSTATE      (1 << 7)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_INVARIANT_TSC  (1 << 8)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_CPB            (1 << 9)
+#define CPUID_INVARIANT_TSC_AVAILABLE_EDX_EFF_FREQ_RO    (1 << 10)
+
+//============CPUID_PHYS_ADDR_SIZE============
+#define CPUID_PHYS_ADDR_SIZE_EAX_PHYS_BITS          0xFF
+#define CPUID_PHYS_ADDR_SIZE_EAX_LINEAR_BITS        (0xFF << 8)
+
+#define CPUID_PHYS_ADDR_SIZE_EBX_CLZERO             1
+#define CPUID_PHYS_ADDR_SIZE_EBX_IRPERF             (1 << 1)
+#define CPUID_PHYS_ADDR_SIZE_EBX_XSAVEERPTR         (1 << 2)
+//bit 3 is reserved
+#define CPUID_PHYS_ADDR_SIZE_EBX_RDPRU              (1 << 4)
+//bits 5-7 are reserved
+#define CPUID_PHYS_ADDR_SIZE_EBX_MCOMMIT            (1 << 8)
+#define CPUID_PHYS_ADDR_SIZE_EBX_WBNOINVD           (1 << 9)
+//bits 10 and 11 are reserved
+#define CPUID_PHYS_ADDR_SIZE_EBX_IBPB               (1 << 12)
+//bit 13 is reserved
+#define CPUID_PHYS_ADDR_SIZE_EBX_IBRS               (1 << 14)
+#define CPUID_PHYS_ADDR_SIZE_EBX_STIBP              (1 << 15)
+//bits 16-23 are(mostly) speculation control hints
+#define CPUID_PHYS_ADDR_SIZE_EBX_SSBD               (1 << 24)
+#define CPUID_PHYS_ADDR_SIZE_EBX_VIRT_SSBD          (1 << 25)
+#define CPUID_PHYS_ADDR_SIZE_EBX_SSB_NO             (1 << 26)
+
+#define CPUID_PHYS_ADDR_SIZE_ECX_CORES              0xFF //number of cores - 1
+#define CPUID_PHYS_ADDR_SIZE_ECX_APIC_ID_SIZE       (0xF << 12)
+
+//=============CPUID_L1_CACHE_TLB==============
+//EAX = 2M/4M pages, EBX = 4K pages, an associativity of 0xFF means fully associative
+#define CPUID_L1_CACHE_TLB_ITLB_ENTRIES             0xFF
+#define CPUID_L1_CACHE_TLB_ITLB_ASSOC               (0xFF << 8)
+#define CPUID_L1_CACHE_TLB_DTLB_ENTRIES             (0xFF << 16)
+#define CPUID_L1_CACHE_TLB_DTLB_ASSOC               (0xFFu << 24)
+
+//ECX = L1 data cache, EDX = L1 instruction cache
+#define CPUID_L1_CACHE_TLB_LINE_SIZE                0xFF
+#define CPUID_L1_CACHE_TLB_LINES_PER_TAG            (0xFF << 8)
+#define CPUID_L1_CACHE_TLB_ASSOC                    (0xFF << 16)
+#define CPUID_L1_CACHE_TLB_SIZE_KB                  (0xFFu << 24)
+
+//===============CPUID_MORE_CACHE===============
+//EAX = L2 2M/4M page TLBs, EBX = L2 4K page TLBs, associativity uses the CPUID_MORE_CACHE_ASSOC_* encoding
+#define CPUID_MORE_CACHE_ITLB_ENTRIES               0xFFF
+#define CPUID_MORE_CACHE_ITLB_ASSOC                 (0xF << 12)
+#define CPUID_MORE_CACHE_DTLB_ENTRIES               (0xFFF << 16)
+#define CPUID_MORE_CACHE_DTLB_ASSOC                 (0xFu << 28)
+
+#define CPUID_MORE_CACHE_ECX_L2_LINE_SIZE           0xFF
+#define CPUID_MORE_CACHE_ECX_L2_LINES_PER_TAG       (0xF << 8)
+#define CPUID_MORE_CACHE_ECX_L2_ASSOC               (0xF << 12)
+#define CPUID_MORE_CACHE_ECX_L2_SIZE_KB             (0xFFFF << 16)
+
+#define CPUID_MORE_CACHE_EDX_L3_LINE_SIZE           0xFF
+#define CPUID_MORE_CACHE_EDX_L3_LINES_PER_TAG       (0xF << 8)
+#define CPUID_MORE_CACHE_EDX_L3_ASSOC               (0xF << 12)
+#define CPUID_MORE_CACHE_EDX_L3_SIZE_512KB          (0x3FFFu << 18)
+
+#define CPUID_MORE_CACHE_ASSOC_DISABLED             0x0
+#define CPUID_MORE_CACHE_ASSOC_DIRECT_MAPPED        0x1
+#define CPUID_MORE_CACHE_ASSOC_2WAY                 0x2
+#define CPUID_MORE_CACHE_ASSOC_3WAY                 0x3
+#define CPUID_MORE_CACHE_ASSOC_4WAY                 0x4
+#define CPUID_MORE_CACHE_ASSOC_6WAY                 0x5
+#define CPUID_MORE_CACHE_ASSOC_8WAY                 0x6
+//0x7 is reserved
+#define CPUID_MORE_CACHE_ASSOC_16WAY                0x8
+#define CPUID_MORE_CACHE_ASSOC_FROM_LEAF_8000001D   0x9
+#define CPUID_MORE_CACHE_ASSOC_32WAY                0xA
+#define CPUID_MORE_CACHE_ASSOC_48WAY                0xB
+#define CPUID_MORE_CACHE_ASSOC_64WAY                0xC
+#define CPUID_MORE_CACHE_ASSOC_96WAY                0xD
+#define CPUID_MORE_CACHE_ASSOC_128WAY               0xE
+#define CPUID_MORE_CACHE_ASSOC_FULLY                0xF
+
+//============CPUID_AMD_CACHE_PARAMS===========
+//Same layout as CPUID_CACHE_PARAMS(EAX bits 26-31 are reserved)
+
+//=========CPUID_AMD_PROCESSOR_TOPOLOGY========
+#define CPUID_AMD_PROCESSOR_TOPOLOGY_EBX_CORE_ID           0xFF
+#define CPUID_AMD_PROCESSOR_TOPOLOGY_EBX_THREADS_PER_CORE  (0xFF << 8) //minus 1
+#define CPUID_AMD_PROCESSOR_TOPOLOGY_ECX_NODE_ID           0xFF
+#define CPUID_AMD_PROCESSOR_TOPOLOGY_ECX_NODES_PER_CPU     (0x7 << 8)  //minus 1
+
+//===============CPUID_HYPERV_IDENT===============
+//Vendor signatures(EBX, ECX, EDX), the range may also start at 0x40000100, 0x40000200... when several are stacked
+#define CPUID_HYPERV_VENDOR_KVM     "KVMKVMKVM\0\0\0"
+#define CPUID_HYPERV_VENDOR_HYPERV  "Microsoft Hv"
+#define CPUID_HYPERV_VENDOR_XEN     "XenVMMXenVMM"
+#define CPUID_HYPERV_VENDOR_VMWARE  "VMwareVMware"
+
+//=============CPUID_KVM_FEATURES=============
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE         (1 << 0)
+#define CPUID_KVM_FEATURES_EAX_NOP_IO_DELAY        (1 << 1)
+#define CPUID_KVM_FEATURES_EAX_MMU_OP              (1 << 2)
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE2        (1 << 3)
+#define CPUID_KVM_FEATURES_EAX_ASYNC_PF            (1 << 4)
+#define CPUID_KVM_FEATURES_EAX_STEAL_TIME          (1 << 5)
+#define CPUID_KVM_FEATURES_EAX_PV_EOI              (1 << 6)
+#define CPUID_KVM_FEATURES_EAX_PV_UNHALT           (1 << 7)
+//bit 8 is reserved
+#define CPUID_KVM_FEATURES_EAX_PV_TLB_FLUSH        (1 << 9)
+#define CPUID_KVM_FEATURES_EAX_ASYNC_PF_VMEXIT     (1 << 10)
+#define CPUID_KVM_FEATURES_EAX_PV_SEND_IPI         (1 << 11)
+#define CPUID_KVM_FEATURES_EAX_POLL_CONTROL        (1 << 12)
+#define CPUID_KVM_FEATURES_EAX_PV_SCHED_YIELD      (1 << 13)
+#define CPUID_KVM_FEATURES_EAX_ASYNC_PF_INT        (1 << 14)
+#define CPUID_KVM_FEATURES_EAX_MSI_EXT_DEST_ID     (1 << 15)
+#define CPUID_KVM_FEATURES_EAX_HC_MAP_GPA_RANGE    (1 << 16)
+#define CPUID_KVM_FEATURES_EAX_MIGRATION_CONTROL   (1 << 17)
+#define CPUID_KVM_FEATURES_EAX_CLOCKSOURCE_STABLE  (1 << 24) //PVCLOCK_TSC_STABLE_BIT can be trusted
+
+#define CPUID_KVM_FEATURES_EDX_REALTIME            (1 << 0)  //vCPUs are never preempted
+
+//========CPUID_MS_HYPERV_INTERFCE_IDENT========
+#define CPUID_MS_HYPERV_INTERFCE_IDENT_EAX_HV1  0x31237648 //"Hv#1", the TLFS interface
+
+//=========CPUID_MS_HYPERV_FEATURE_IDENT=========
+//Low half of the partition privilege mask
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_VP_RUNTIME          (1 << 0)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_TIME_REF_COUNT      (1 << 1)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_SYNIC               (1 << 2)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_SYNTHETIC_TIMERS    (1 << 3)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_APIC_ACCESS         (1 << 4)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_HYPERCALL           (1 << 5)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_VP_INDEX            (1 << 6)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_RESET               (1 << 7)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_STATS               (1 << 8)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_REFERENCE_TSC       (1 << 9)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_GUEST_IDLE          (1 << 10)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_FREQUENCY_MSRS      (1 << 11)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_REENLIGHTENMENT     (1 << 13)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EAX_TSC_INVARIANT       (1 << 15)
+
+//High half of the partition privilege mask
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_CREATE_PARTITIONS   (1 << 0)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_PARTITION_ID        (1 << 1)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_POST_MESSAGES       (1 << 4)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_SIGNAL_EVENTS       (1 << 5)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_CPU_MANAGEMENT      (1 << 12)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EBX_ISOLATION           (1 << 22)
+
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_MWAIT               (1 << 0)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_GUEST_DEBUGGING     (1 << 1)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_PERF_MONITOR        (1 << 2)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_CPU_DYNAMIC_PART    (1 << 3)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_HYPERCALL_XMM_INPUT (1 << 4)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_GUEST_IDLE_STATE    (1 << 5)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_FREQUENCY_MSRS      (1 << 8)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_GUEST_CRASH_MSRS    (1 << 10)
+#define CPUID_MS_HYPERV_FEATURE_IDENT_EDX_STIMER_DIRECT_MODE  (1 << 19)
+
+//=========CPUID_MS_HYPERV_RECOMMENDATIONS=========
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_AS_SWITCH         (1 << 0)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_LOCAL_TLB_FLUSH   (1 << 1)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_REMOTE_TLB_FLUSH  (1 << 2)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_APIC_MSRS         (1 << 3)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_SYSTEM_RESET      (1 << 4)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_RELAXED_TIMING    (1 << 5)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_DEPRECATING_AEOI  (1 << 9)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_CLUSTER_IPI       (1 << 10)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_EX_PROCESSOR_MASKS (1 << 11)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_NESTED            (1 << 12)
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_ENLIGHTENED_VMCS  (1 << 14)
+
+//Spinlock retries before notifying the hypervisor, 0xFFFFFFFF = never
+#define CPUID_MS_HYPERV_RECOMMENDATIONS_EBX_SPIN_RETRIES      0xFFFFFFFF
+
+//============CPUID_HYPERV_TIMING_INFO============
+//Both in kHz(VMware, and KVM when the TSC frequency is known)
+#define CPUID_HYPERV_TIMING_INFO_EAX_TSC_KHZ      0xFFFFFFFF
+#define CPUID_HYPERV_TIMING_INFO_EBX_APIC_BUS_KHZ 0xFFFFFFFF
+
 
 enum leaves {
    /* @ Basic CPU info
@@ -462,27 +773,29 @@ enum leaves {
     * @ Retruned EDX: Reserved
     */
    CPUID_CACHE_ACCESS_INFO = 0x00000009,
-   /* @ Architectural Performance Monitoring
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+   /* @ Architectural Performance Monitoring(Intel)
+    * @ Returned EAX: Version, number and width of the general purpose counters, length of EBX
+    * @ Returned EBX: Architectural events that are NOT available
+    * @ Returned ECX: Fixed counters that are available(version 5+)
+    * @ Retruned EDX: Number and width of the fixed counters
     */
    CPUID_PERFORMANCE_MONITORING = 0x0000000A,
-   /* @ Extended Topology Enumeration
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+   /* @ Extended Topology Enumeration !!! Initial ECX = Level number !!!
+    * @ Returned EAX: Bits to shift the x2APIC ID right to get the ID of the next level
+    * @ Returned EBX: Number of logical processors at this level
+    * @ Returned ECX: Level number and level type
+    * @ Retruned EDX: x2APIC ID of the current logical processor
     */
    CPUID_EXTENDENDED_TOPOLOGY = 0x0000000B,
-   /* @ Extended Topology Enumeration
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+   /* @ Processor Extended State(XSAVE) Enumeration !!! Initial ECX = Subleaf/state component !!!
+    * @ Returned EAX: Supported XCR0 bits(subleaf 0), XSAVE instruction flags(subleaf 1), component size(subleaf 2+)
+    * @ Returned EBX: Area size for the enabled components(subleaf 0-1), component offset(subleaf 2+)
+    * @ Returned ECX: Largest area size(subleaf 0), supported IA32_XSS bits(subleaf 1), component flags(subleaf 2+)
+    * @ Retruned EDX: Supported XCR0 bits 32-63(subleaf 0), supported IA32_XSS bits 32-63(subleaf 1)
     */
-   CPUID_EXTENDENDED_TOPOLOGY2 = 0x0000000D,
+   CPUID_XSAVE = 0x0000000D,
+   //Old name of CPUID_XSAVE, it was never a topology leaf
+   CPUID_EXTENDENDED_TOPOLOGY2 = CPUID_XSAVE,
    /* @ RDT Monitoring Enumeration
     * @ Returned EAX: Undocumented
     * @ Returned EBX: Undocumented
@@ -512,17 +825,17 @@ enum leaves {
     */
    CPUID_CPU_TRACE_ENUM = 0x00000014,
    /* @ Time Stamp Counter and Norminal Core Crytal Clock Information
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+    * @ Returned EAX: Denominator of the TSC/crystal clock ratio
+    * @ Returned EBX: Numerator of the TSC/crystal clock ratio
+    * @ Returned ECX: Crystal clock frequency in Hz(0 if not enumerated)
+    * @ Retruned EDX: Reserved
     */
    CPUID_TSC = 0x00000015,
    /* @ Processor Frequency Information
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+    * @ Returned EAX: Base frequency in MHz
+    * @ Returned EBX: Maximum frequency in MHz
+    * @ Returned ECX: Bus(reference) frequency in MHz
+    * @ Retruned EDX: Reserved
     */
    CPUID_CPU_FREQ_INFO = 0x00000016,
    /* @ SOC Vendor Information
@@ -581,11 +894,11 @@ enum leaves {
     * @ Retruned EDX: Undocumented
     */
    CPUID_TMUL_INFO = 0x00000001E,
-   /* @ V2 Extended Topology Enumeration
-    * @ Returned EAX: Undocumented
-    * @ Returned EBX: Undocumented
-    * @ Returned ECX: Undocumented
-    * @ Retruned EDX: Undocumented
+   /* @ V2 Extended Topology Enumeration !!! Initial ECX = Level number !!!
+    * @ Returned EAX: Bits to shift the x2APIC ID right to get the ID of the next level
+    * @ Returned EBX: Number of logical processors at this level
+    * @ Returned ECX: Level number and level type(adds module, tile and die levels)
+    * @ Retruned EDX: x2APIC ID of the current logical processor
     */
    CPUID_V2_EXTENDED_TOPOLOGY = 0x00000001F,
    /* @ V2 Extended Topology Enumeration
@@ -595,14 +908,20 @@ enum leaves {
     * @ Retruned EDX: Undocumented
     */
    CPUID_V2_EXTENDED_TOPOLOGY2 = 0x000000020,
-   //TODO: add the bitmasks for these Microsoft ones
-   /* @ Hypervisor CPUID Leaf Range
+   /* @ Hypervisor CPUID Leaf Range(only when CPUID_CPU_INFO_ECX_HYPERVISOR is set)
     * @ Returned EAX: Highest hypervisor CPUID leaf present
-    * @ Returned EBX: Largest monitor-line size
-    * @ Returned ECX: Enumeration of Monitor-Mwait extensions,Supports treating interrupts as break-event for MWAIT
-    * @ Retruned EDX: Number of sub C-states supported using MWAIT for each C number thingy IDK
+    * @ Returned EBX: First 4 letters of the hypervisor vendor signature
+    * @ Returned ECX: Second 4 letters of the hypervisor vendor signature
+    * @ Retruned EDX: Third 4 letters of the hypervisor vendor signature
     */
    CPUID_HYPERV_IDENT = 0x40000000,
+   /* @ KVM Features(relative to the base KVM's signature was found at)
+    * @ Returned EAX: KVM paravirtual features
+    * @ Returned EBX: Reserved
+    * @ Returned ECX: Reserved
+    * @ Retruned EDX: KVM hints
+    */
+   CPUID_KVM_FEATURES = 0x40000001,
    /* @ Hypervisor Vendor-Neutral Interface Identification
     * @ Returned EAX: Hypervisor interface signature
     * @ Returned EBX: Reserved
@@ -659,55 +978,90 @@ enum leaves {
     * @ Retruned EDX: Reserved
     */
    CPUID_MS_HYPERV_NESTED_OPTIMISATIONS = 0x4000000A,
+   /* @ Hypervisor Timing Information(VMware, KVM)
+    * @ Returned EAX: TSC frequency in kHz
+    * @ Returned EBX: APIC bus frequency in kHz
+    * @ Returned ECX: Reserved
+    * @ Retruned EDX: Reserved
+    */
+   CPUID_HYPERV_TIMING_INFO = 0x40000010,
+   /* @ Highest extended leaf
+    * @ Returned EAX: Highest extended CPUID leaf present
+    * @ Returned EBX: Reserved(vendor string on AMD)
+    * @ Returned ECX: Reserved(vendor string on AMD)
+    * @ Retruned EDX: Reserved(vendor string on AMD)
+    */
+   CPUID_HIGHEST_EXTENDED = 0x80000000,
    /* @ Extended processor signature
     * @ Returned EAX: Reserved
     * @ Returned EBX: Reserved
     * @ Returned ECX: Extended feature bits
     * @ Retruned EDX: Extended feature bits
     */
-   CPUID_EXTENDED_SIGNATURE = 0x800000001,
+   CPUID_EXTENDED_SIGNATURE = 0x80000001,
    /* @ Full CPU name
     * @ Returned EAX: First 4 characters of the full CPU name
     * @ Returned EBX: Second 4 characters of the full CPU name
     * @ Returned ECX: Third 4 characters of the full CPU name
     * @ Retruned EDX: Fourth 4 characters of the full CPU name
     */
-   CPUID_BRAND_STRING1 = 0x800000002,
+   CPUID_BRAND_STRING1 = 0x80000002,
    /* @ Full CPU name 2
     * @ Returned EAX: Fifth 4 characters of the full CPU name
     * @ Returned EBX: Sexth 4 characters of the full CPU name
     * @ Returned ECX: Seventh 4 characters of the full CPU name
     * @ Retruned EDX: Eightth 4 characters of the full CPU name
     */
-   CPUID_BRAND_STRING2 = 0x800000003,
+   CPUID_BRAND_STRING2 = 0x80000003,
    /* @ Full CPU name 3
     * @ Returned EAX: Nineth 4 characters of the full CPU name
     * @ Returned EBX: Tenth 4 characters of the full CPU name
     * @ Returned ECX: Eleventh 4 characters of the full CPU name
     * @ Retruned EDX: Twelveth 4 characters of the full CPU name
     */
-   CPUID_BRAND_STRING3 = 0x800000004,
+   CPUID_BRAND_STRING3 = 0x80000004,
+   /* @ AMD L1 cache and TLB information
+    * @ Returned EAX: L1 TLBs for 2M/4M pages
+    * @ Returned EBX: L1 TLBs for 4K pages
+    * @ Returned ECX: L1 data cache
+    * @ Retruned EDX: L1 instruction cache
+    */
+   CPUID_L1_CACHE_TLB = 0x80000005,
    /* @ Cache line size and associativity
-    * @ Returned EAX: Reserved
-    * @ Returned EBX: Reserved
+    * @ Returned EAX: Reserved(L2 TLBs for 2M/4M pages on AMD)
+    * @ Returned EBX: Reserved(L2 TLBs for 4K pages on AMD)
     * @ Returned ECX: Bits 0-7 = Cache line size in bytes, Bits 12-15 = L2 Associativity, Bits 16-31 = Cache size in 1K blocks
-    * @ Retruned EDX: Reserved
+    * @ Retruned EDX: Reserved(L3 cache on AMD, size in 512K blocks)
     */
-   CPUID_MORE_CACHE = 0x800000006,
+   CPUID_MORE_CACHE = 0x80000006,
    /* @ Invariant TSC available
     * @ Returned EAX: Reserved
     * @ Returned EBX: Reserved
-    * @ Returned ECX: Bit 8 = Invariant TSC available
-    * @ Retruned EDX: Reserved
+    * @ Returned ECX: Reserved
+    * @ Retruned EDX: Bit 8 = Invariant TSC available, power management features
     */
-   CPUID_INVARIANT_TSC_AVAILABLE = 0x800000007,
+   CPUID_INVARIANT_TSC_AVAILABLE = 0x80000007,
    /* @ Physical adress size
     * @ Returned EAX: Bits 0-7 =  Physical Adress bits, Bits 8-15 = Linear Address bits
     * @ Returned EBX: Bit 9 = WBNOINVD available
     * @ Returned ECX: Reserved
     * @ Retruned EDX: Reserved
     */
-   CPUID_PHYS_ADDR_SIZE = 0x800000008,
+   CPUID_PHYS_ADDR_SIZE = 0x80000008,
+   /* @ AMD Deterministic cache parameters !!! Initial ECX = Cache index !!!
+    * @ Returned EAX: Cache type and level, Is self init, Is fully associative, Number of logical processors sharing this cache
+    * @ Returned EBX: L, P and W
+    * @ Returned ECX: S
+    * @ Retruned EDX: Cache inclusiveness
+    */
+   CPUID_AMD_CACHE_PARAMS = 0x8000001D,
+   /* @ AMD Processor topology
+    * @ Returned EAX: Extended APIC ID
+    * @ Returned EBX: Core ID, Threads per core - 1
+    * @ Returned ECX: Node ID, Nodes per processor - 1
+    * @ Retruned EDX: Reserved
+    */
+   CPUID_AMD_PROCESSOR_TOPOLOGY = 0x8000001E,
 };
 
 enum sub_leaves{
@@ -749,4 +1103,18 @@ static inline void cpuid(int leaf, int subleaf, int* a, int* b, int* c, int* d)
     );
 }
 
+/*
+@ A source of CPUID results: cpuid_native or a function that replays a recorded dump
+@ regs is filled with EAX, EBX, ECX and EDX in that order
+*/
+typedef void (*cpuid_fn_t)(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+
+//Runs the real CPUID instruction
+static inline void cpuid_native(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    cpuid((int)leaf, (int)subleaf, (int*)&regs[0], (int*)&regs[1], (int*)&regs[2], (int*)&regs[3]);
+}
+
+//Extracts a multi bit field, e.g. CPUID_FIELD(ebx, CPUID_CACHE_PARAMS_EBX_WAYS_OF_ASSOCIVITY)
+#define CPUID_FIELD(reg, mask) (((uint32_t)(reg) & (uint32_t)(mask)) >> __builtin_ctz(mask))
+
 #endif // __CPUID_H__
\ No newline at end of file
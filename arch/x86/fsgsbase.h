@@ -0,0 +1,149 @@
+/*
+@ KrnlAid FS/GS base access
+@ RDFSBASE/WRFSBASE/RDGSBASE/WRGSBASE take a handful of cycles, going through the MSRs takes about 100.
+@ fsgsbase_init() checks CPUID.(EAX=7,ECX=0):EBX.FSGSBASE and turns the instructions on in CR4,
+@ every accessor below then uses them and falls back to MSR_FS_BASE/MSR_GS_BASE/MSR_KERNEL_GS_BASE otherwise.
+@
+@ How to use:
+@ 1, define FSGSBASE_IMPL in exactly one source file
+@ 2, ring 0: call fsgsbase_init() on every CPU
+@    ring 3(Linux 5.9+): don't call fsgsbase_init, set fsgsbase_usable = !!(getauxval(AT_HWCAP2) & HWCAP2_FSGSBASE)
+@ 3, on a context switch: fsgs_save(&prev->fsgs) ... fsgs_restore(&next->fsgs)
+*/
+
+#ifndef __FSGSBASE_H__
+#define __FSGSBASE_H__
+
+#include <stdint.h>
+#include "cpuid.h"
+#include "msr.h"
+
+#ifndef __x86_64__
+#error "fsgsbase.h: FS/GS base registers only exist in 64 bit mode"
+#endif
+
+//CR4 bit that enables the FSGSBASE instructions
+#define CR4_FSGSBASE (1ull << 16)
+
+//How the inactive GS base accessors get at the other GS base, can be overriden(e.g. "" in a userspace benchmark)
+#ifndef FSGSBASE_SWAPGS
+#define FSGSBASE_SWAPGS "swapgs"
+#endif
+
+//Set by fsgsbase_init(or by hand in ring 3), selects the instructions over the MSRs
+extern uint8_t fsgsbase_usable;
+
+static inline uint64_t rdfsbase(void) {
+    uint64_t value;
+    __asm__ __volatile__ ("rdfsbase %0" : "=r" (value));
+    return value;
+}
+
+static inline void wrfsbase(uint64_t value) {
+    __asm__ __volatile__ ("wrfsbase %0" : : "r" (value) : "memory");
+}
+
+static inline uint64_t rdgsbase(void) {
+    uint64_t value;
+    __asm__ __volatile__ ("rdgsbase %0" : "=r" (value));
+    return value;
+}
+
+static inline void wrgsbase(uint64_t value) {
+    __asm__ __volatile__ ("wrgsbase %0" : : "r" (value) : "memory");
+}
+
+//Checks whether the CPU has the FSGSBASE instructions
+static inline int fsgsbase_supported(void) {
+    uint32_t regs[4];
+    cpuid_native(CPUID_VENDOR, 0, regs);
+    if (regs[0] < CPUID_EXTENDED_FEATURES) {
+        return 0;
+    }
+    cpuid_native(CPUID_EXTENDED_FEATURES, 0, regs);
+    return (regs[1] & (CPUID_EXTENDED_FEATURES_EBX_FSGSBASE)) != 0;
+}
+
+//Ring 0 only: enables the instructions in CR4 if the CPU has them
+static inline void fsgsbase_init(void) {
+    uint64_t cr4;
+    if (!fsgsbase_supported()) {
+        fsgsbase_usable = 0;
+        return;
+    }
+    __asm__ __volatile__ ("mov %%cr4, %0" : "=r" (cr4));
+    __asm__ __volatile__ ("mov %0, %%cr4" : : "r" (cr4 | CR4_FSGSBASE) : "memory");
+    fsgsbase_usable = 1;
+}
+
+//Reads the FS base
+static inline uint64_t read_fs_base(void) {
+    return fsgsbase_usable ? rdfsbase() : rdmsr(MSR_FS_BASE);
+}
+
+//Writes the FS base
+static inline void write_fs_base(uint64_t value) {
+    if (fsgsbase_usable) {
+        wrfsbase(value);
+    } else {
+        wrmsr(MSR_FS_BASE, value);
+    }
+}
+
+//Reads the active GS base
+static inline uint64_t read_gs_base(void) {
+    return fsgsbase_usable ? rdgsbase() : rdmsr(MSR_GS_BASE);
+}
+
+//Writes the active GS base
+static inline void write_gs_base(uint64_t value) {
+    if (fsgsbase_usable) {
+        wrgsbase(value);
+    } else {
+        wrmsr(MSR_GS_BASE, value);
+    }
+}
+
+//Ring 0 only: reads the GS base SWAPGS would switch to(the user's one while in the kernel)
+static inline uint64_t read_inactive_gs_base(void) {
+    uint64_t value;
+    if (!fsgsbase_usable) {
+        return rdmsr(MSR_KERNEL_GS_BASE);
+    }
+    //SWAPGS + RDGSBASE + SWAPGS is still way cheaper than RDMSR, interrupts have to be off
+    __asm__ __volatile__ (FSGSBASE_SWAPGS "\n\trdgsbase %0\n\t" FSGSBASE_SWAPGS : "=r" (value));
+    return value;
+}
+
+//Ring 0 only: writes the GS base SWAPGS would switch to
+static inline void write_inactive_gs_base(uint64_t value) {
+    if (!fsgsbase_usable) {
+        wrmsr(MSR_KERNEL_GS_BASE, value);
+        return;
+    }
+    __asm__ __volatile__ (FSGSBASE_SWAPGS "\n\twrgsbase %0\n\t" FSGSBASE_SWAPGS : : "r" (value) : "memory");
+}
+
+//User FS/GS bases of a thread
+typedef struct {
+    uint64_t fs_base;
+    uint64_t gs_base;
+} fsgs_state_t;
+
+//Saves the outgoing thread's bases, call in the kernel with interrupts disabled
+static inline void fsgs_save(fsgs_state_t* state) {
+    state->fs_base = read_fs_base();
+    state->gs_base = read_inactive_gs_base();
+}
+
+//Loads the incoming thread's bases, call in the kernel with interrupts disabled
+static inline void fsgs_restore(const fsgs_state_t* state) {
+    write_fs_base(state->fs_base);
+    write_inactive_gs_base(state->gs_base);
+}
+
+#ifdef FSGSBASE_IMPL
+    uint8_t fsgsbase_usable;
+#endif
+
+#endif // __FSGSBASE_H__
\ No newline at end of file
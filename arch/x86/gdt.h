@@ -2,6 +2,8 @@
 #define __GDT_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include "../../utils/debug.h"
 
 //GDT present bit: this marks the entry as valid
 #define GDT_ACCESS_PRESENT 0x80
@@ -137,7 +139,8 @@ typedef struct {
         uint64_t reserved1;
         uint64_t ist[7];
         uint64_t reserved2;
-        uint32_t iobase;
+        uint16_t reserved3;
+        uint16_t iomap_base; //offset of the I/O permission bitmap, sizeof(tss_t) or more means no bitmap
     } __attribute__((packed)) tss_t;
 
     typedef struct {
@@ -157,8 +160,15 @@ typedef struct {
     } __attribute__((packed)) gdt_pointer_t;
 #endif
 
+STATIC_ASSERT(sizeof(gdt_entry_t) == 8, "gdt_entry_t must be 8 bytes");
+#ifdef __x86_64__
+    STATIC_ASSERT(sizeof(tss_t) == 104, "tss_t must be 104 bytes");
+    STATIC_ASSERT(offsetof(tss_t, iomap_base) == 0x66, "the I/O map base has to be at 0x66");
+    STATIC_ASSERT(sizeof(tss_entry_t) == 16, "tss_entry_t must be 16 bytes");
+#endif
+
 //Constructs a GDT pointer
-static inline gdt_pointer_t make_gdt_pointer(gdt_entry_t* entries, uint16_t count) {
+static inline gdt_pointer_t make_gdt_pointer(const gdt_entry_t* entries, uint16_t count) {
     gdt_pointer_t pointer;
     pointer.limit = (count * sizeof(gdt_entry_t)) - 1;
     #ifdef __i386__
@@ -172,19 +182,118 @@ static inline gdt_pointer_t make_gdt_pointer(gdt_entry_t* entries, uint16_t coun
 //Constructs a TSS entry
 static inline tss_entry_t make_tss_entry(tss_t* tss) {
     tss_entry_t entry;
+    #ifdef __i386__
+        uint32_t base = (uint32_t)tss;
+    #elif defined(__x86_64__)
+        uint64_t base = (uint64_t)tss;
+    #endif
     entry.limit_low = sizeof(tss_t);
-    entry.base_low = (uint16_t)((uint64_t)tss & 0xffff); 
-    entry.base_middle = (uint8_t)(((uint64_t)tss >> 16) & 0xff);
+    entry.base_low = (uint16_t)(base & 0xffff);
+    entry.base_middle = (uint8_t)((base >> 16) & 0xff);
     entry.access = TSS_ACCESS_PRESENT | TSS_ACCESS_TYPE_MODE_DEP;
     entry.flags_limit = 0;
-    entry.base_mid2 = (uint8_t)(((uint64_t)tss >> 24) & 0xff);
-    entry.base_high = (uint32_t)((uint64_t)tss >> 32);
-    entry.zero = 0;
+    #ifdef __i386__
+        entry.base_high = (uint8_t)((base >> 24) & 0xff);
+    #elif defined(__x86_64__)
+        entry.base_mid2 = (uint8_t)((base >> 24) & 0xff);
+        entry.base_high = (uint32_t)(base >> 32);
+        entry.zero = 0;
+    #endif
     return entry;
 }
 
+//=================Compile time tables=================
+
+/*
+@ The CPU sets the accessed bit of a descriptor the first time a selector for it is loaded, which is a write
+@ and faults if the GDT is read only. Every preset below has it set already.
+*/
+#define GDT_ACCESS_KERNEL_CODE (GDT_ACCESS_PRESENT | GDT_ACCESS_DESC_TYPE | GDT_ACCESS_EXECUTABLE | GDT_ACCESS_READ_WRITE | GDT_ACCESS_ACCESSED)
+#define GDT_ACCESS_KERNEL_DATA (GDT_ACCESS_PRESENT | GDT_ACCESS_DESC_TYPE | GDT_ACCESS_READ_WRITE | GDT_ACCESS_ACCESSED)
+#define GDT_ACCESS_USER_CODE   (GDT_ACCESS_KERNEL_CODE | (3 << GDT_ACCESS_DPL_SHIFT))
+#define GDT_ACCESS_USER_DATA   (GDT_ACCESS_KERNEL_DATA | (3 << GDT_ACCESS_DPL_SHIFT))
+
+#define GDT_FLAGS_CODE64 (GDT_FLAGS_GRANULARITY | GDT_FLAGS_LIMIT_64BIT)
+#define GDT_FLAGS_FLAT32 (GDT_FLAGS_GRANULARITY | GDT_FLAGS_LIMIT_32BIT)
+
+//A descriptor as the 64 bit value the CPU reads
+#define GDT_ENCODE(base, limit, access, flags) ( \
+    ((uint64_t)(limit) & 0xFFFF) | \
+    (((uint64_t)(base) & 0xFFFFFF) << 16) | \
+    ((uint64_t)((access) & 0xFF) << 40) | \
+    ((uint64_t)(((limit) >> 16) & 0xF) << 48) | \
+    ((uint64_t)((flags) & 0xF0) << 48) | \
+    ((uint64_t)(((base) >> 24) & 0xFF) << 56))
+
+//Initializer for a gdt_entry_t, base and limit have to be constants
+#define GDT_ENTRY_INIT(base, limit, access, flags) { \
+    (uint16_t)((limit) & 0xFFFF), \
+    (uint16_t)((base) & 0xFFFF), \
+    (uint8_t)(((base) >> 16) & 0xFF), \
+    (uint8_t)(access), \
+    (uint8_t)(((flags) & 0xF0) | (((limit) >> 16) & 0x0F)), \
+    (uint8_t)(((base) >> 24) & 0xFF) \
+}
+
+#define GDT_NULL_INIT         GDT_ENTRY_INIT(0, 0, 0, 0)
+#define GDT_KERNEL_CODE64_INIT GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_CODE64)
+#define GDT_KERNEL_CODE32_INIT GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_FLAT32)
+#define GDT_KERNEL_DATA_INIT  GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_KERNEL_DATA, GDT_FLAGS_FLAT32)
+#define GDT_USER_CODE64_INIT  GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_USER_CODE, GDT_FLAGS_CODE64)
+#define GDT_USER_CODE32_INIT  GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_USER_CODE, GDT_FLAGS_FLAT32)
+#define GDT_USER_DATA_INIT    GDT_ENTRY_INIT(0, 0xFFFFF, GDT_ACCESS_USER_DATA, GDT_FLAGS_FLAT32)
+
+//The presets have to match what every other kernel uses
+STATIC_ASSERT(GDT_ENCODE(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_CODE64) == 0x00AF9B000000FFFFull, "bad kernel code64 descriptor");
+STATIC_ASSERT(GDT_ENCODE(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_FLAT32) == 0x00CF9B000000FFFFull, "bad kernel code32 descriptor");
+STATIC_ASSERT(GDT_ENCODE(0, 0xFFFFF, GDT_ACCESS_KERNEL_DATA, GDT_FLAGS_FLAT32) == 0x00CF93000000FFFFull, "bad kernel data descriptor");
+STATIC_ASSERT(GDT_ENCODE(0, 0xFFFFF, GDT_ACCESS_USER_CODE, GDT_FLAGS_CODE64) == 0x00AFFB000000FFFFull, "bad user code64 descriptor");
+STATIC_ASSERT(GDT_ENCODE(0, 0xFFFFF, GDT_ACCESS_USER_DATA, GDT_FLAGS_FLAT32) == 0x00CFF3000000FFFFull, "bad user data descriptor");
+
+#ifdef __x86_64__
+    /*
+    @ A 64 bit TSS descriptor takes two gdt_entry_t, this fills both with everything but the base,
+    @ gdt_patch_tss() adds that at runtime(no relocation can split an address into the descriptor's pieces)
+    @ NOTE: LTR marks the descriptor busy, which is a write, so a GDT with a TSS can't be read only
+    */
+    #define GDT_TSS_INIT \
+        GDT_ENTRY_INIT(0, sizeof(tss_t) - 1, TSS_ACCESS_PRESENT | TSS_ACCESS_TYPE_MODE_DEP, 0), \
+        GDT_NULL_INIT
+
+    //Puts the base of tss into the descriptor at index(and index + 1)
+    static inline void gdt_patch_tss(gdt_entry_t* entries, uint16_t index, const tss_t* tss) {
+        uint64_t base = (uint64_t)tss;
+        tss_entry_t* entry = (tss_entry_t*)&entries[index];
+        entry->base_low = (uint16_t)(base & 0xFFFF);
+        entry->base_middle = (uint8_t)((base >> 16) & 0xFF);
+        entry->base_mid2 = (uint8_t)((base >> 24) & 0xFF);
+        entry->base_high = (uint32_t)(base >> 32);
+        entry->zero = 0;
+    }
+#endif
+
+#ifdef __cplusplus
+    //constexpr builders, e.g. static constexpr gdt_entry_t gdt[] = { gdt_entry(0, 0, 0, 0), ... };
+    static constexpr gdt_entry_t gdt_entry(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+        return GDT_ENTRY_INIT(base, limit, access, flags);
+    }
+
+    static constexpr uint64_t gdt_encode(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+        return GDT_ENCODE(base, limit, access, flags);
+    }
+
+    //The value the CPU will read from an entry
+    static constexpr uint64_t gdt_entry_value(const gdt_entry_t& entry) {
+        return (uint64_t)entry.limit_low | ((uint64_t)entry.base_low << 16) | ((uint64_t)entry.base_middle << 32) |
+               ((uint64_t)entry.access << 40) | ((uint64_t)entry.flags_limit << 48) | ((uint64_t)entry.base_high << 56);
+    }
+
+    static_assert(gdt_entry_value(gdt_entry(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_CODE64)) ==
+                  gdt_encode(0, 0xFFFFF, GDT_ACCESS_KERNEL_CODE, GDT_FLAGS_CODE64), "gdt_entry and gdt_encode disagree");
+#endif
+
 //loads a GDT
-static inline void load_gdt(gdt_pointer_t* pointer) {
+static inline void load_gdt(const gdt_pointer_t* pointer) {
     __asm__ __volatile__ (
         "lgdt (%0)"
         :
@@ -0,0 +1,371 @@
+/*
+@ KrnlAid hypervisor detection and paravirtual clocks
+@ Under a hypervisor every exit costs a few thousand cycles, so timekeeping shouldn't touch anything that traps(PIT, HPET, ACPI PM timer, most MSRs).
+@ hypervisor_detect() finds KVM, Hyper-V, Xen and VMware in the CPUID 0x40000000 range and decodes their features.
+@ The KVM pvclock and the Hyper-V reference TSC page are shared memory the hypervisor keeps up to date, reading them is
+@ a RDTSC and a few multiplies, no exit.
+@
+@ How to use:
+@ 1, hypervisor_info_t hv; hypervisor_detect(&hv, cpuid_native);
+@ 2, if (hypervisor_tsc_hz(&hv)) tsc_set_frequency(&tsc, hypervisor_tsc_hz(&hv), TSC_FREQ_EXTERNAL); //no calibration needed
+@ 3, KVM: if (hypervisor_kvm_has(&hv, CPUID_KVM_FEATURES_EAX_CLOCKSOURCE2)) kvm_clock_register(physical address of this vCPU's pvclock_vcpu_time_info_t);
+@    then pvclock_read(area, NULL) on that vCPU(Xen's vcpu_time_info has the same layout)
+@ 4, Hyper-V: if (hypervisor_hyperv_has(&hv, CPUID_MS_HYPERV_FEATURE_IDENT_EAX_REFERENCE_TSC)) { hv_set_guest_os_id(id); hv_reference_tsc_enable(physical address of a page); }
+@    then hv_ref_time_read(page) * 100 for ns
+*/
+
+#ifndef __HYPERVISOR_H__
+#define __HYPERVISOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpuid.h"
+#include "msr.h"
+#include "tsc.h"
+#include "../../utils/debug.h"
+
+//End of the range scanned for hypervisor signatures(in steps of 0x100), can be overriden
+#ifndef HYPERVISOR_CPUID_SCAN_END
+#define HYPERVISOR_CPUID_SCAN_END 0x40010000
+#endif
+
+enum hypervisor_types {
+    HYPERVISOR_NONE,    //bare metal
+    HYPERVISOR_UNKNOWN, //the hypervisor bit is set but the signature is unknown
+    HYPERVISOR_KVM,
+    HYPERVISOR_HYPERV,
+    HYPERVISOR_XEN,
+    HYPERVISOR_VMWARE,
+};
+
+typedef struct {
+    uint8_t type;                    //HYPERVISOR_*
+    uint32_t base;                   //leaf the hypervisor's range starts at
+    uint32_t max_leaf;               //highest leaf of that range
+    char signature[13];
+    uint32_t kvm_features;           //CPUID_KVM_FEATURES_EAX_*
+    uint32_t kvm_hints;              //CPUID_KVM_FEATURES_EDX_*
+    uint32_t hyperv_base;            //0 if there is no Hyper-V interface(KVM and Xen can offer one too)
+    uint64_t hyperv_privileges;      //CPUID_MS_HYPERV_FEATURE_IDENT_EAX_*, EBX_* shifted up by 32
+    uint32_t hyperv_features;        //CPUID_MS_HYPERV_FEATURE_IDENT_EDX_*
+    uint32_t hyperv_recommendations; //CPUID_MS_HYPERV_RECOMMENDATIONS_EAX_*
+    uint32_t tsc_khz;                //from CPUID_HYPERV_TIMING_INFO(KVM and VMware only), 0 if not given
+    uint32_t apic_bus_khz;
+} hypervisor_info_t;
+
+//Matches a signature in EBX, ECX, EDX
+static inline uint8_t __hypervisor_match(const uint32_t regs[4], char signature[13]) {
+    static const struct {
+        const char* signature;
+        uint8_t type;
+    } known[] = {
+        { CPUID_HYPERV_VENDOR_KVM, HYPERVISOR_KVM },
+        { CPUID_HYPERV_VENDOR_HYPERV, HYPERVISOR_HYPERV },
+        { CPUID_HYPERV_VENDOR_XEN, HYPERVISOR_XEN },
+        { CPUID_HYPERV_VENDOR_VMWARE, HYPERVISOR_VMWARE },
+    };
+
+    for (int i = 0; i < 4; i++) {
+        signature[i] = (char)(regs[1] >> (i * 8));
+        signature[i + 4] = (char)(regs[2] >> (i * 8));
+        signature[i + 8] = (char)(regs[3] >> (i * 8));
+    }
+    signature[12] = '\0';
+
+    for (size_t k = 0; k < sizeof(known) / sizeof(known[0]); k++) {
+        int i = 0;
+        while (i < 12 && signature[i] == known[k].signature[i]) {
+            i++;
+        }
+        if (i == 12) {
+            return known[k].type;
+        }
+    }
+    return HYPERVISOR_UNKNOWN;
+}
+
+/*
+@ Fills info and returns the hypervisor type.
+@ KVM and Xen with Hyper-V enlightenments put "Microsoft Hv" at 0x40000000 and themselves at 0x40000100,
+@ the real one wins but the Hyper-V interface is decoded as well.
+*/
+static inline uint8_t hypervisor_detect(hypervisor_info_t* info, cpuid_fn_t source) {
+    uint32_t regs[4];
+    char signature[13];
+
+    info->type = HYPERVISOR_NONE;
+    info->base = 0;
+    info->max_leaf = 0;
+    info->signature[0] = '\0';
+    info->kvm_features = 0;
+    info->kvm_hints = 0;
+    info->hyperv_base = 0;
+    info->hyperv_privileges = 0;
+    info->hyperv_features = 0;
+    info->hyperv_recommendations = 0;
+    info->tsc_khz = 0;
+    info->apic_bus_khz = 0;
+
+    source(CPUID_CPU_INFO, 0, regs);
+    if (!(regs[2] & (CPUID_CPU_INFO_ECX_HYPERVISOR))) {
+        return HYPERVISOR_NONE;
+    }
+    info->type = HYPERVISOR_UNKNOWN;
+
+    for (uint32_t base = CPUID_HYPERV_IDENT; base < HYPERVISOR_CPUID_SCAN_END; base += 0x100) {
+        uint8_t type;
+        uint32_t max_leaf;
+
+        source(base, 0, regs);
+        type = __hypervisor_match(regs, signature);
+        max_leaf = regs[0];
+        if (type == HYPERVISOR_UNKNOWN) {
+            //keep an unknown signature around for logging
+            if (base == CPUID_HYPERV_IDENT) {
+                for (int i = 0; i < 13; i++) {
+                    info->signature[i] = signature[i];
+                }
+                info->base = base;
+                info->max_leaf = max_leaf;
+            }
+            continue;
+        }
+        //old KVMs report 0
+        if (max_leaf < base) {
+            max_leaf = base + 1;
+        }
+
+        if (type == HYPERVISOR_HYPERV) {
+            if (info->hyperv_base != 0 || max_leaf < base + 3) {
+                continue;
+            }
+            source(base + 1, 0, regs);
+            if (regs[0] != CPUID_MS_HYPERV_INTERFCE_IDENT_EAX_HV1) {
+                continue;
+            }
+            info->hyperv_base = base;
+            source(base + 3, 0, regs);
+            info->hyperv_privileges = ((uint64_t)regs[1] << 32) | regs[0];
+            info->hyperv_features = regs[3];
+            if (max_leaf >= base + 4) {
+                source(base + 4, 0, regs);
+                info->hyperv_recommendations = regs[0];
+            }
+            //only the compatibility interface of someone else's if another signature follows
+            if (info->type != HYPERVISOR_UNKNOWN && info->type != HYPERVISOR_HYPERV) {
+                continue;
+            }
+        } else if (type == HYPERVISOR_KVM) {
+            source(base + 1, 0, regs);
+            info->kvm_features = regs[0];
+            info->kvm_hints = regs[3];
+        }
+
+        info->type = type;
+        info->base = base;
+        info->max_leaf = max_leaf;
+        for (int i = 0; i < 13; i++) {
+            info->signature[i] = signature[i];
+        }
+    }
+
+    //the timing leaf is a KVM/VMware convention, other hypervisors use base + 0x10 for something else or nothing
+    if ((info->type == HYPERVISOR_KVM || info->type == HYPERVISOR_VMWARE) && info->max_leaf >= info->base + 0x10) {
+        source(info->base + 0x10, 0, regs);
+        info->tsc_khz = CPUID_FIELD(regs[0], CPUID_HYPERV_TIMING_INFO_EAX_TSC_KHZ);
+        info->apic_bus_khz = CPUID_FIELD(regs[1], CPUID_HYPERV_TIMING_INFO_EBX_APIC_BUS_KHZ);
+    }
+    return info->type;
+}
+
+//Checks for KVM paravirtual features(CPUID_KVM_FEATURES_EAX_*)
+static inline int hypervisor_kvm_has(const hypervisor_info_t* info, uint32_t features) {
+    return info->type == HYPERVISOR_KVM && (info->kvm_features & features) == features;
+}
+
+//Checks for Hyper-V privileges(CPUID_MS_HYPERV_FEATURE_IDENT_EAX_*, or EBX_* shifted up by 32)
+static inline int hypervisor_hyperv_has(const hypervisor_info_t* info, uint64_t privileges) {
+    return info->hyperv_base != 0 && (info->hyperv_privileges & privileges) == privileges;
+}
+
+//TSC frequency the hypervisor told us through CPUID, 0 if it didn't
+static inline uint64_t hypervisor_tsc_hz(const hypervisor_info_t* info) {
+    return (uint64_t)info->tsc_khz * 1000;
+}
+
+//=================KVM pvclock=================
+
+//The hypervisor only sets it when the TSC is synchronized between vCPUs(see CPUID_KVM_FEATURES_EAX_CLOCKSOURCE_STABLE)
+#define PVCLOCK_TSC_STABLE_BIT (1 << 0)
+#define PVCLOCK_GUEST_STOPPED  (1 << 1)
+
+/*
+@ Per-vCPU time info, ns = system_time + ((rdtsc - tsc_timestamp) << tsc_shift) * tsc_to_system_mul >> 32
+@ (a negative tsc_shift shifts right). version is odd while the hypervisor is updating it.
+*/
+typedef struct {
+    volatile uint32_t version;
+    uint32_t pad0;
+    volatile uint64_t tsc_timestamp;
+    volatile uint64_t system_time;
+    volatile uint32_t tsc_to_system_mul;
+    volatile int8_t tsc_shift;
+    volatile uint8_t flags;
+    uint8_t pad[2];
+} __attribute__((packed, aligned(4))) pvclock_vcpu_time_info_t;
+
+STATIC_ASSERT(sizeof(pvclock_vcpu_time_info_t) == 32, "pvclock_vcpu_time_info_t must be 32 bytes");
+
+//Converts a TSC delta to ns with the pvclock's factors
+static inline uint64_t pvclock_scale_delta(uint64_t delta, uint32_t mul, int8_t shift) {
+    if (shift < 0) {
+        delta >>= -shift;
+    } else {
+        delta <<= shift;
+    }
+    //delta * mul >> 32 without a 96 bit product
+    return (((delta & 0xFFFFFFFF) * mul) >> 32) + (delta >> 32) * mul;
+}
+
+//Nanoseconds since the hypervisor's epoch, has to run on the vCPU the area belongs to, flags may be NULL
+static inline uint64_t pvclock_read(const pvclock_vcpu_time_info_t* ti, uint8_t* flags) {
+    uint32_t version;
+    uint64_t tsc, tsc_timestamp, system_time;
+    uint32_t mul;
+    int8_t shift;
+    uint8_t f;
+
+    do {
+        //an odd version never matches the second read
+        version = __atomic_load_n(&ti->version, __ATOMIC_ACQUIRE) & ~1u;
+        tsc_timestamp = ti->tsc_timestamp;
+        system_time = ti->system_time;
+        mul = ti->tsc_to_system_mul;
+        shift = ti->tsc_shift;
+        f = ti->flags;
+        tsc = rdtsc_ordered();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (version != ti->version);
+
+    if (flags != NULL) {
+        *flags = f;
+    }
+    return system_time + pvclock_scale_delta(tsc - tsc_timestamp, mul, shift);
+}
+
+/*
+@ pvclock_read that never returns less than what any CPU saw before through the same last.
+@ Without PVCLOCK_TSC_STABLE_BIT two vCPUs can be a little apart, with it this is just pvclock_read.
+*/
+static inline uint64_t pvclock_read_monotonic(const pvclock_vcpu_time_info_t* ti, uint64_t* last) {
+    uint8_t flags;
+    uint64_t now = pvclock_read(ti, &flags);
+    uint64_t old;
+
+    if (flags & PVCLOCK_TSC_STABLE_BIT) {
+        return now;
+    }
+    old = __atomic_load_n(last, __ATOMIC_RELAXED);
+    do {
+        if ((int64_t)(now - old) <= 0) {
+            return old;
+        }
+    } while (!__atomic_compare_exchange_n(last, &old, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return now;
+}
+
+//Ring 0 only: has KVM keep the current vCPU's area at physical address phys(4 byte aligned, not crossing a page) up to date
+static inline void kvm_clock_register(uint64_t phys) {
+    wrmsr(MSR_KVM_SYSTEM_TIME_NEW, phys | 1);
+}
+
+//Ring 0 only: stops the updates, call it before the area is freed(or kexec)
+static inline void kvm_clock_unregister(void) {
+    wrmsr(MSR_KVM_SYSTEM_TIME_NEW, 0);
+}
+
+//=================Hyper-V reference TSC page=================
+
+//hv_ref_tsc_read's result when the page can't be used
+#define HV_REF_TIME_INVALID (~0ull)
+
+/*
+@ Partition wide, time(100ns units) = ((rdtsc * tsc_scale) >> 64) + tsc_offset
+@ tsc_sequence changes on every update, 0 means the page is invalid(e.g. during live migration) and MSR_HV_TIME_REF_COUNT has to be used.
+*/
+typedef struct {
+    volatile uint32_t tsc_sequence;
+    uint32_t reserved1;
+    volatile uint64_t tsc_scale;
+    volatile int64_t tsc_offset;
+    uint64_t reserved2[509];
+} hv_reference_tsc_page_t;
+
+STATIC_ASSERT(sizeof(hv_reference_tsc_page_t) == 4096, "hv_reference_tsc_page_t must be one page");
+
+//High 64 bits of a 64x64 bit product
+static inline uint64_t __hv_mul_high(uint64_t a, uint64_t b) {
+    #ifdef __SIZEOF_INT128__
+        return (uint64_t)(((unsigned __int128)a * b) >> 64);
+    #else
+        uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+        uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+        uint64_t hi_hi = (a >> 32) * (b >> 32);
+        uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+        return hi_hi + (hi_lo >> 32) + (cross >> 32);
+    #endif
+}
+
+//Converts a TSC value to reference time with the page's factors
+static inline uint64_t hv_ref_tsc_scale(uint64_t tsc, uint64_t scale, int64_t offset) {
+    return __hv_mul_high(tsc, scale) + (uint64_t)offset;
+}
+
+//Reference time in 100ns units from the page alone, HV_REF_TIME_INVALID if the hypervisor invalidated it
+static inline uint64_t hv_ref_tsc_read(const hv_reference_tsc_page_t* page) {
+    uint32_t sequence;
+    uint64_t tsc, scale;
+    int64_t offset;
+
+    do {
+        sequence = __atomic_load_n(&page->tsc_sequence, __ATOMIC_ACQUIRE);
+        if (sequence == 0) {
+            return HV_REF_TIME_INVALID;
+        }
+        scale = page->tsc_scale;
+        offset = page->tsc_offset;
+        tsc = rdtsc_ordered();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (sequence != page->tsc_sequence);
+
+    return hv_ref_tsc_scale(tsc, scale, offset);
+}
+
+//Ring 0 only: reference time in 100ns units, through the page if possible and the(trapping) MSR otherwise
+static inline uint64_t hv_ref_time_read(const hv_reference_tsc_page_t* page) {
+    uint64_t time = page != NULL ? hv_ref_tsc_read(page) : HV_REF_TIME_INVALID;
+    if (time == HV_REF_TIME_INVALID) {
+        time = rdmsr(MSR_HV_TIME_REF_COUNT);
+    }
+    return time;
+}
+
+//Ring 0 only: identifies the guest OS, Hyper-V wants it before the other synthetic MSRs are used
+static inline void hv_set_guest_os_id(uint64_t id) {
+    wrmsr(MSR_HV_GUEST_OS_ID, id);
+}
+
+//Ring 0 only: has Hyper-V map the reference TSC page over the page at physical address phys
+static inline void hv_reference_tsc_enable(uint64_t phys) {
+    //bits 1-11 are reserved and have to be preserved
+    uint64_t value = rdmsr(MSR_HV_REFERENCE_TSC) & 0xFFE;
+    wrmsr(MSR_HV_REFERENCE_TSC, value | (phys & ~0xFFFull) | 1);
+}
+
+//Ring 0 only: exact TSC frequency(needs CPUID_MS_HYPERV_FEATURE_IDENT_EAX_FREQUENCY_MSRS), read it once
+static inline uint64_t hv_tsc_frequency(void) {
+    return rdmsr(MSR_HV_TSC_FREQUENCY);
+}
+
+#endif // __HYPERVISOR_H__
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define __IDT_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include "../../utils/debug.h"
 
 //Descriptor type: interrupt
 #define IDT_TYPE_INTERRUPT 0x0E
@@ -50,8 +52,14 @@ typedef struct {
 } __attribute__((packed)) idt_pointer_t;
 #endif
 
+#ifdef __i386__
+    STATIC_ASSERT(sizeof(idt_entry_t) == 8, "idt_entry_t must be 8 bytes");
+#elif defined(__x86_64__)
+    STATIC_ASSERT(sizeof(idt_entry_t) == 16, "idt_entry_t must be 16 bytes");
+#endif
+
 //Constructs an IDT pointer
-static inline idt_pointer_t make_idt_pointer(idt_entry_t* entries, uint16_t count) {
+static inline idt_pointer_t make_idt_pointer(const idt_entry_t* entries, uint16_t count) {
     idt_pointer_t pointer;
     pointer.limit = (count * sizeof(idt_entry_t)) - 1;
     #ifdef __i386__
@@ -63,7 +71,7 @@ static inline idt_pointer_t make_idt_pointer(idt_entry_t* entries, uint16_t coun
 }
 
 //loads an IDT
-static inline void load_idt(idt_pointer_t* pointer) {
+static inline void load_idt(const idt_pointer_t* pointer) {
     __asm__ __volatile__ (
         "lidt (%0)"
         :
@@ -71,24 +79,114 @@ static inline void load_idt(idt_pointer_t* pointer) {
     );
 }
 
-//sets an IDT entry's vlaues
-static inline void idt_set_gate(idt_entry_t* entry, void* offset, uint8_t selector, uint8_t ist, uint8_t type_attr) {
+//sets an IDT entry's handler address
+static inline void idt_set_offset(idt_entry_t* entry, const void* offset) {
     #ifdef __i386__
-        entry->offset_low = (uint32_t)((uint32_t)offset & 0xFFFF);
+        entry->offset_low = (uint16_t)((uint32_t)offset & 0xFFFF);
+        entry->offset_high = (uint16_t)((uint32_t)offset >> 16);
     #elif defined(__x86_64__)
-        entry->offset_low = (uint32_t)((uint64_t)offset & 0xFFFF);
+        entry->offset_low = (uint16_t)((uint64_t)offset & 0xFFFF);
+        entry->offset_mid = (uint16_t)(((uint64_t)offset >> 16) & 0xFFFF);
+        entry->offset_high = (uint32_t)((uint64_t)offset >> 32);
     #endif
+}
+
+//sets an IDT entry's vlaues
+static inline void idt_set_gate(idt_entry_t* entry, void* offset, uint16_t selector, uint8_t ist, uint8_t type_attr) {
+    idt_set_offset(entry, offset);
     entry->selector = selector;
     entry->type_attr = type_attr;
-    entry->ist = ist;
-    entry->type_attr = type_attr;
     #ifdef __i386__
-        entry->offset_mid = (uint16_t)((uint32_t)offset >> 16);
+        (void)ist;
+        entry->zero = 0;
     #elif defined(__x86_64__)
-        entry->offset_mid = (uint16_t)((uint64_t)offset >> 16);
-        entry->offset_high = (uint32_t)((uint64_t)offset >> 32);
+        entry->ist = ist;
         entry->zero = 0;
     #endif
 }
 
+//=================Compile time tables=================
+
+/*
+@ A handler's address is only known once the kernel is linked(and relocated), and no relocation can split it
+@ into the three offset fields of a gate. So a table is built at compile time with everything but the offsets:
+@   static idt_entry_t idt[256] __ro_after_init = { IDT_GATES_256(IDT_GATE_INIT(0x08, 0, IDT_ATTR(IDT_TYPE_INTERRUPT, 0))) };
+@ the BSP calls idt_patch_offsets(idt, handlers, 256) once, the section gets write protected and every CPU loads
+@ the same table. If the handler addresses are constants(e.g. a kernel linked at a fixed address) IDT_ENTRY_INIT
+@ encodes the whole gate and the table can be const.
+*/
+
+//type_attr of a present gate, dpl is the lowest ring allowed to INT n into it
+#define IDT_ATTR(type, dpl) (IDT_ACCESS_PRESENT | (((dpl) << IDT_ACCESS_DPL_SHIFT) & IDT_ACCESS_DPL) | (type))
+
+//Initializer for an idt_entry_t, offset has to be a constant integer
+#ifdef __i386__
+    #define IDT_ENTRY_INIT(offset, selector, ist, type_attr) { \
+        (uint16_t)((offset) & 0xFFFF), \
+        (uint16_t)(selector), \
+        0, \
+        (uint8_t)(type_attr), \
+        (uint16_t)(((offset) >> 16) & 0xFFFF) \
+    }
+#elif defined(__x86_64__)
+    #define IDT_ENTRY_INIT(offset, selector, ist, type_attr) { \
+        (uint16_t)((offset) & 0xFFFF), \
+        (uint16_t)(selector), \
+        (uint8_t)((ist) & 0x7), \
+        (uint8_t)(type_attr), \
+        (uint16_t)(((offset) >> 16) & 0xFFFF), \
+        (uint32_t)((uint64_t)(offset) >> 32), \
+        0 \
+    }
+#endif
+
+//A gate with the offset left for idt_patch_offsets
+#define IDT_GATE_INIT(selector, ist, type_attr) IDT_ENTRY_INIT(0, selector, ist, type_attr)
+
+//The same gate repeated
+#define IDT_GATES_4(...) __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__
+#define IDT_GATES_16(...) IDT_GATES_4(IDT_GATES_4(__VA_ARGS__))
+#define IDT_GATES_256(...) IDT_GATES_16(IDT_GATES_16(__VA_ARGS__))
+
+STATIC_ASSERT(IDT_ATTR(IDT_TYPE_INTERRUPT, 0) == 0x8E, "bad interrupt gate attributes");
+STATIC_ASSERT(IDT_ATTR(IDT_TYPE_TRAP, 3) == 0xEF, "bad user trap gate attributes");
+
+//Fills in the offsets of a prebuilt table, entries whose handler is NULL are marked not present
+static inline void idt_patch_offsets(idt_entry_t* entries, void* const* handlers, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (handlers[i] == NULL) {
+            entries[i].type_attr &= (uint8_t)~IDT_ACCESS_PRESENT;
+            continue;
+        }
+        idt_set_offset(&entries[i], handlers[i]);
+    }
+}
+
+#ifdef __cplusplus
+    //constexpr builder, e.g. static constexpr idt_entry_t gate = idt_entry(0, 0x08, 0, IDT_ATTR(IDT_TYPE_INTERRUPT, 0));
+    static constexpr idt_entry_t idt_entry(uint64_t offset, uint16_t selector, uint8_t ist, uint8_t type_attr) {
+        return IDT_ENTRY_INIT(offset, selector, ist, type_attr);
+    }
+#endif
+
+//make_idt_table needs loops in constexpr functions
+#if defined(__cplusplus) && __cplusplus >= 201402L
+    template <uint16_t N>
+    struct idt_table_t {
+        idt_entry_t entries[N];
+    };
+
+    //A table of N copies of gate, built by the compiler
+    template <uint16_t N>
+    static constexpr idt_table_t<N> make_idt_table(idt_entry_t gate) {
+        idt_table_t<N> table = {};
+        for (uint16_t i = 0; i < N; i++) {
+            table.entries[i] = gate;
+        }
+        return table;
+    }
+
+    static_assert(make_idt_table<2>(idt_entry(0xFFFFFFFF80101234ull, 0x08, 1, 0x8E)).entries[1].offset_low == 0x1234, "bad idt_entry");
+#endif
+
 #endif // __IDT_H__
\ No newline at end of file
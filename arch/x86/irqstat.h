@@ -0,0 +1,148 @@
+/*
+@ KrnlAid interrupt statistics(irqstat)
+@ Counts every vector's interrupts and the cycles its handler took(rdtsc around the handler call in isr_dispatch),
+@ plus a log2 histogram of those cycles: bucket b holds calls of [2^b, 2^(b+1)) cycles, the last one everything longer.
+@ The counters are per-CPU and only ever changed by a single %gs relative add on the CPU that took the interrupt,
+@ so they need no locks or atomics and a nested interrupt can't lose an update.
+@
+@ How to use:
+@ 1, define IRQSTAT for every file that includes arch/x86/irqstat.h
+@ 2, define IRQSTAT_IMPL in exactly one source file to allocate the counters and irqstat_dump(), that file
+@    also needs your logger wrapper(see utils/logger.h)
+@ 3, in the ISR_IMPL file include irqstat.h BEFORE isr.h, that hooks the dispatch path
+@ 4, call irqstat_dump() to print every vector that fired, or irqstat_sum() for the numbers
+@
+@ Without IRQSTAT none of this is compiled in, isr_dispatch stays untouched and the calls below do nothing.
+*/
+
+#ifndef __IRQSTAT_H__
+#define __IRQSTAT_H__
+
+#include <stdint.h>
+
+#ifdef IRQSTAT
+
+#if defined(__ISR_H__) && defined(ISR_IMPL)
+#error "irqstat.h: include it before isr.h, or isr_dispatch isn't hooked"
+#endif
+
+#include "tsc.h"
+#include "percpu.h"
+
+//Number of histogram buckets, can be overriden
+#ifndef IRQSTAT_BUCKETS
+#define IRQSTAT_BUCKETS 24
+#endif
+
+#define ISR_DISPATCH_ENTER(vector) uint64_t __irqstat_start = rdtsc()
+#define ISR_DISPATCH_EXIT(vector) irqstat_account((vector), rdtsc() - __irqstat_start)
+
+static inline void irqstat_account(uint64_t vector, uint64_t cycles);
+
+#include "isr.h"
+
+typedef struct {
+    uint64_t count[ISR_VECTORS];
+    uint64_t cycles[ISR_VECTORS];
+    uint32_t hist[ISR_VECTORS][IRQSTAT_BUCKETS];
+} irqstat_cpu_t;
+
+//One CPU's or every CPU's numbers for a vector
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t hist[IRQSTAT_BUCKETS];
+} irqstat_summary_t;
+
+DECLARE_PER_CPU(irqstat_cpu_t, irqstat_cpu);
+
+void irqstat_dump(void);
+
+static inline uint32_t irqstat_bucket(uint64_t cycles) {
+    uint32_t bucket = 63 - (uint32_t)__builtin_clzll(cycles | 1);
+    return bucket < IRQSTAT_BUCKETS ? bucket : IRQSTAT_BUCKETS - 1;
+}
+
+//Records one handler call on the current CPU, called from isr_dispatch
+static inline void irqstat_account(uint64_t vector, uint64_t cycles) {
+    this_cpu_add(irqstat_cpu.count[vector], 1);
+    this_cpu_add(irqstat_cpu.cycles[vector], cycles);
+    this_cpu_add(irqstat_cpu.hist[vector][irqstat_bucket(cycles)], 1);
+}
+
+//Adds one CPU's numbers for a vector to sum
+static inline void irqstat_sum_cpu(uint32_t cpu, uint32_t vector, irqstat_summary_t* sum) {
+    irqstat_cpu_t* stats = per_cpu_ptr(irqstat_cpu, cpu);
+    sum->count += __atomic_load_n(&stats->count[vector], __ATOMIC_RELAXED);
+    sum->cycles += __atomic_load_n(&stats->cycles[vector], __ATOMIC_RELAXED);
+    for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) {
+        sum->hist[b] += __atomic_load_n(&stats->hist[vector][b], __ATOMIC_RELAXED);
+    }
+}
+
+//Every CPU's numbers for a vector, a snapshot that other CPUs keep adding to while it is taken
+static inline void irqstat_sum(uint32_t vector, irqstat_summary_t* sum) {
+    sum->count = 0;
+    sum->cycles = 0;
+    for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) {
+        sum->hist[b] = 0;
+    }
+    for_each_cpu(cpu) {
+        irqstat_sum_cpu(cpu, vector, sum);
+    }
+}
+
+//Upper bound in cycles of the calls below the given per mille(e.g. 990 for p99)
+static inline uint64_t irqstat_percentile(const irqstat_summary_t* sum, uint32_t per_mille) {
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < IRQSTAT_BUCKETS; b++) {
+        seen += sum->hist[b];
+        if (seen * 1000 >= sum->count * per_mille) {
+            return 2ull << b;
+        }
+    }
+    return 2ull << (IRQSTAT_BUCKETS - 1);
+}
+
+//Zeroes every CPU's counters, interrupts that come in meanwhile may survive it
+static inline void irqstat_reset(void) {
+    for_each_cpu(cpu) {
+        char* stats = (char*)per_cpu_ptr(irqstat_cpu, cpu);
+        for (size_t i = 0; i < sizeof(irqstat_cpu_t); i++) {
+            stats[i] = 0;
+        }
+    }
+}
+
+#ifdef IRQSTAT_IMPL
+    #include "../../utils/logger.h"
+
+    DEFINE_PER_CPU(irqstat_cpu_t, irqstat_cpu);
+
+    //Prints count, average and p50/p99/max bucket bounds(cycles) of every vector that fired
+    void irqstat_dump(void) {
+        irqstat_summary_t sum;
+
+        log_info("%-6s %12s %12s %10s %10s %10s\n", "vector", "count", "avg cycles", "p50 <=", "p99 <=", "max <=");
+        for (uint32_t vector = 0; vector < ISR_VECTORS; vector++) {
+            irqstat_sum(vector, &sum);
+            if (sum.count == 0) {
+                continue;
+            }
+            log_info("%-6u %12llu %12llu %10llu %10llu %10llu\n", vector,
+                     (unsigned long long)sum.count, (unsigned long long)(sum.cycles / sum.count),
+                     (unsigned long long)irqstat_percentile(&sum, 500),
+                     (unsigned long long)irqstat_percentile(&sum, 990),
+                     (unsigned long long)irqstat_percentile(&sum, 1000));
+        }
+    }
+#endif
+
+#else
+
+#define irqstat_dump() do { } while (0)
+#define irqstat_reset() do { } while (0)
+
+#endif // IRQSTAT
+
+#endif // __IRQSTAT_H__
\ No newline at end of file
@@ -0,0 +1,262 @@
+/*
+@ KrnlAid interrupt entry stubs
+@ ISR_IMPL emits 256 entry stubs(16 bytes each, 16 byte aligned) and a common entry path. A stub pushes a zero
+@ error code if the CPU doesn't push one, pushes its vector and jumps to the common path, which does SWAPGS
+@ when coming from ring 3, saves registers and calls the vector's handler from isr_table(cache line aligned,
+@ 4 vectors per line).
+@ A handler is either
+@   full:    gets isr_frame_t, every general purpose register, e.g. for the debugger or a context switch
+@   minimal: gets isr_min_frame_t, only the registers a C function may clobber are saved(the handler itself
+@            preserves the rest), 6 pushes and 6 pops less per interrupt. Use it for IRQs and IPIs.
+@
+@ How to use:
+@ 1, build the kernel with -mno-red-zone and without SSE in handlers(-mgeneral-regs-only), nothing saves them
+@ 2, define ISR_IMPL in exactly one source file
+@ 3, isr_install(idt) fills in every gate of a 256 entry table, e.g. one built with IDT_GATES_256(...)
+@ 4, isr_register(14, page_fault) / isr_register_minimal(0x40, timer_irq), register a vector before it can fire
+@ NOTE: a vector without a handler ends up in ISR_UNHANDLED, which halts by default
+*/
+
+#ifndef __ISR_H__
+#define __ISR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "idt.h"
+#include "../../utils/cache.h"
+#include "../../utils/debug.h"
+
+#ifndef __x86_64__
+#error "isr.h: the entry stubs are x86_64 only"
+#endif
+
+#define ISR_VECTORS 256
+
+//Vectors the CPU pushes an error code for: #DF, #TS, #NP, #SS, #GP, #PF, #AC, #CP, #VC, #SX
+#define ISR_ERROR_CODE_MASK 0x60227D00u
+#define isr_has_error_code(vector) ((vector) < 32 && ((ISR_ERROR_CODE_MASK >> (vector)) & 1))
+
+//isr_entry_t flags: the handler wants isr_frame_t
+#define ISR_FLAG_FULL 1
+
+//Called for a vector without a handler, can be overriden
+#ifndef ISR_UNHANDLED
+#define ISR_UNHANDLED(frame, vector) do { \
+    (void)(frame); \
+    for (;;) { \
+        __asm__ __volatile__ ("cli; hlt"); \
+    } \
+} while (0)
+#endif
+
+//How the entry path switches the GS base when coming from ring 3, can be overriden(e.g. "nop" in a userspace harness)
+#ifndef ISR_SWAPGS
+#define ISR_SWAPGS "swapgs"
+#endif
+
+//Run around every handler call(e.g. by irqstat.h), ENTER may declare variables for EXIT, can be overriden
+#ifndef ISR_DISPATCH_ENTER
+#define ISR_DISPATCH_ENTER(vector) do { } while (0)
+#endif
+#ifndef ISR_DISPATCH_EXIT
+#define ISR_DISPATCH_EXIT(vector) do { } while (0)
+#endif
+
+//Stack on entry to a minimal handler, lowest address first
+typedef struct {
+    uint64_t r11, r10, r9, r8, rdi, rsi, rdx, rcx, rax;
+    uint64_t vector;
+    uint64_t error_code; //0 if the CPU didn't push one
+    //pushed by the CPU
+    uint64_t rip, cs, rflags, rsp, ss;
+} isr_min_frame_t;
+
+//Stack on entry to a full handler, the callee saved registers come on top of a minimal frame
+typedef struct {
+    uint64_t r15, r14, r13, r12, rbp, rbx;
+    uint64_t r11, r10, r9, r8, rdi, rsi, rdx, rcx, rax;
+    uint64_t vector;
+    uint64_t error_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+} isr_frame_t;
+
+typedef void (*isr_handler_t)(isr_frame_t* frame);
+typedef void (*isr_min_handler_t)(isr_min_frame_t* frame);
+
+typedef struct {
+    union {
+        isr_handler_t full;
+        isr_min_handler_t minimal;
+    } handler;
+    uint32_t flags; //ISR_FLAG_*
+    uint32_t reserved;
+} isr_entry_t;
+
+//The entry path uses these offsets as constants
+#define ISR_ENTRY_FLAGS_OFFSET 8
+#define ISR_ENTRY_SIZE_SHIFT 4
+
+STATIC_ASSERT(sizeof(isr_entry_t) == (1 << ISR_ENTRY_SIZE_SHIFT), "isr_entry_t must be 16 bytes");
+STATIC_ASSERT(offsetof(isr_entry_t, flags) == ISR_ENTRY_FLAGS_OFFSET, "isr_entry_t.flags moved");
+STATIC_ASSERT(offsetof(isr_min_frame_t, vector) == 9 * 8, "isr_min_frame_t doesn't match the entry path");
+STATIC_ASSERT(offsetof(isr_min_frame_t, cs) == 12 * 8, "isr_min_frame_t doesn't match the entry path");
+STATIC_ASSERT(sizeof(isr_min_frame_t) == 16 * 8, "isr_min_frame_t doesn't match the entry path");
+STATIC_ASSERT(offsetof(isr_frame_t, r11) == 6 * 8, "isr_frame_t has to end in an isr_min_frame_t");
+STATIC_ASSERT(sizeof(isr_frame_t) == sizeof(isr_min_frame_t) + 6 * 8, "isr_frame_t has to end in an isr_min_frame_t");
+//the CPU aligns RSP to 16 before pushing its frame, the handler has to see it aligned again
+STATIC_ASSERT(sizeof(isr_min_frame_t) % 16 == 0 && sizeof(isr_frame_t) % 16 == 0, "frames must keep RSP 16 byte aligned");
+
+//The entry path refers to these by their C names
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern isr_entry_t isr_table[ISR_VECTORS];
+
+//Stub addresses, in vector order
+extern void* const isr_stub_table[ISR_VECTORS];
+
+//Called by the entry path with the frame it built, full is ISR_FLAG_FULL if that is an isr_frame_t
+void isr_dispatch(void* frame, uint64_t vector, uint64_t full);
+
+//Puts every stub in a 256 entry IDT
+static inline void isr_install(idt_entry_t* idt) {
+    idt_patch_offsets(idt, isr_stub_table, ISR_VECTORS);
+}
+
+//Sets a handler that gets every register
+static inline void isr_register(uint8_t vector, isr_handler_t handler) {
+    isr_table[vector].handler.full = handler;
+    isr_table[vector].flags = ISR_FLAG_FULL;
+}
+
+//Sets a handler that only gets the caller saved registers
+static inline void isr_register_minimal(uint8_t vector, isr_min_handler_t handler) {
+    isr_table[vector].handler.minimal = handler;
+    isr_table[vector].flags = 0;
+}
+
+static inline void isr_unregister(uint8_t vector) {
+    isr_table[vector].handler.full = NULL;
+    isr_table[vector].flags = 0;
+}
+
+//Whether an interrupt came from ring 3
+static inline int isr_from_user(const isr_min_frame_t* frame) {
+    return (frame->cs & 3) != 0;
+}
+
+#ifdef ISR_IMPL
+    isr_entry_t isr_table[ISR_VECTORS] __cacheline_aligned;
+
+    void isr_dispatch(void* frame, uint64_t vector, uint64_t full) {
+        const isr_entry_t* entry = &isr_table[vector];
+        ISR_DISPATCH_ENTER(vector);
+        if (entry->handler.full == NULL) {
+            ISR_UNHANDLED(frame, vector);
+        } else if (full) {
+            entry->handler.full((isr_frame_t*)frame);
+        } else {
+            entry->handler.minimal((isr_min_frame_t*)frame);
+        }
+        ISR_DISPATCH_EXIT(vector);
+    }
+
+    /*
+    @ Entry path, on entry to isr_common the stack holds vector, error code and the CPU's frame.
+    @ The caller saved registers are pushed first, then the vector's flags decide whether the callee saved
+    @ ones are pushed too, so a full frame is a minimal one with 6 more registers on top.
+    */
+    __asm__ (
+        ".pushsection .data.rel.ro.isr_stub_table, \"aw\"\n\t"
+        ".balign 8\n\t"
+        ".globl isr_stub_table\n"
+        "isr_stub_table:\n\t"
+        ".popsection\n\t"
+
+        ".pushsection .text\n\t"
+        ".balign 16\n\t"
+        ".globl isr_stubs\n"
+        "isr_stubs:\n\t"
+        ".set isr_vector, 0\n\t"
+        ".rept " TOSTRING(ISR_VECTORS) "\n\t"
+        ".balign 16\n"
+        "1:\n\t"
+        ".if (isr_vector == 8) || (isr_vector >= 10 && isr_vector <= 14) || (isr_vector == 17) || (isr_vector == 21) || (isr_vector == 29) || (isr_vector == 30)\n\t"
+        ".else\n\t"
+        "pushq $0\n\t"
+        ".endif\n\t"
+        "pushq $isr_vector\n\t"
+        "jmp isr_common\n\t"
+        ".pushsection .data.rel.ro.isr_stub_table, \"aw\"\n\t"
+        ".quad 1b\n\t"
+        ".popsection\n\t"
+        ".set isr_vector, isr_vector + 1\n\t"
+        ".endr\n\t"
+
+        ".balign 16\n"
+        "isr_common:\n\t"
+        "testb $3, 24(%rsp)\n\t"
+        "jz 1f\n\t"
+        ISR_SWAPGS "\n"
+        "1:\n\t"
+        "pushq %rax\n\t"
+        "pushq %rcx\n\t"
+        "pushq %rdx\n\t"
+        "pushq %rsi\n\t"
+        "pushq %rdi\n\t"
+        "pushq %r8\n\t"
+        "pushq %r9\n\t"
+        "pushq %r10\n\t"
+        "pushq %r11\n\t"
+        "cld\n\t"
+        "movq 72(%rsp), %rsi\n\t"
+        "movq %rsi, %rax\n\t"
+        "shlq $" TOSTRING(ISR_ENTRY_SIZE_SHIFT) ", %rax\n\t"
+        "leaq isr_table(%rip), %rcx\n\t"
+        "movl " TOSTRING(ISR_ENTRY_FLAGS_OFFSET) "(%rcx,%rax), %edx\n\t"
+        "andl $" TOSTRING(ISR_FLAG_FULL) ", %edx\n\t"
+        "jnz 2f\n\t"
+        "movq %rsp, %rdi\n\t"
+        "call isr_dispatch\n\t"
+        "jmp 3f\n"
+        "2:\n\t"
+        "pushq %rbx\n\t"
+        "pushq %rbp\n\t"
+        "pushq %r12\n\t"
+        "pushq %r13\n\t"
+        "pushq %r14\n\t"
+        "pushq %r15\n\t"
+        "movq %rsp, %rdi\n\t"
+        "call isr_dispatch\n\t"
+        "popq %r15\n\t"
+        "popq %r14\n\t"
+        "popq %r13\n\t"
+        "popq %r12\n\t"
+        "popq %rbp\n\t"
+        "popq %rbx\n"
+        "3:\n\t"
+        "popq %r11\n\t"
+        "popq %r10\n\t"
+        "popq %r9\n\t"
+        "popq %r8\n\t"
+        "popq %rdi\n\t"
+        "popq %rsi\n\t"
+        "popq %rdx\n\t"
+        "popq %rcx\n\t"
+        "popq %rax\n\t"
+        "addq $16, %rsp\n\t"
+        "testb $3, 8(%rsp)\n\t"
+        "jz 4f\n\t"
+        ISR_SWAPGS "\n"
+        "4:\n\t"
+        "iretq\n\t"
+        ".popsection"
+    );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ISR_H__
\ No newline at end of file
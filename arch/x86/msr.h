@@ -0,0 +1,62 @@
+#ifndef __MSR_H__
+#define __MSR_H__
+
+#include <stdint.h>
+
+//Time stamp counter
+#define MSR_IA32_TSC            0x00000010
+//FS base(64 bit mode)
+#define MSR_FS_BASE             0xC0000100
+//GS base(64 bit mode)
+#define MSR_GS_BASE             0xC0000101
+//Value swapped into GS base by SWAPGS
+#define MSR_KERNEL_GS_BASE      0xC0000102
+//Value returned in ECX by RDTSCP and RDPID
+#define MSR_TSC_AUX             0xC0000103
+//Architectural PMU: general purpose counters and their event selects(one per counter, consecutive)
+#define MSR_IA32_PMC0               0x000000C1
+#define MSR_IA32_PERFEVTSEL0        0x00000186
+//Architectural PMU: fixed counters(consecutive), their control and the global control/status
+#define MSR_IA32_FIXED_CTR0         0x00000309
+#define MSR_IA32_FIXED_CTR_CTRL     0x0000038D
+#define MSR_IA32_PERF_GLOBAL_STATUS 0x0000038E
+#define MSR_IA32_PERF_GLOBAL_CTRL   0x0000038F
+#define MSR_IA32_PERF_GLOBAL_OVF_CTRL 0x00000390
+//Supervisor state components XSAVES/XRSTORS manage(next to XCR0)
+#define MSR_IA32_XSS            0x00000DA0
+
+//KVM: wall clock at boot and the current vCPU's pvclock area(physical address | 1 enables)
+#define MSR_KVM_WALL_CLOCK_NEW  0x4B564D00
+#define MSR_KVM_SYSTEM_TIME_NEW 0x4B564D01
+//Hyper-V: guest OS identity, has to be set before the other synthetic MSRs are used
+#define MSR_HV_GUEST_OS_ID      0x40000000
+//Hyper-V: partition reference time in 100ns units(traps, the reference TSC page doesn't)
+#define MSR_HV_TIME_REF_COUNT   0x40000020
+//Hyper-V: reference TSC page(physical address | 1 enables)
+#define MSR_HV_REFERENCE_TSC    0x40000021
+//Hyper-V: TSC and APIC timer frequencies in Hz
+#define MSR_HV_TSC_FREQUENCY    0x40000022
+#define MSR_HV_APIC_FREQUENCY   0x40000023
+
+//Reads a model specific register
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    __asm__ __volatile__ (
+        "rdmsr"
+        : "=a" (low), "=d" (high)
+        : "c" (msr)
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+//Writes a model specific register
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__ (
+        "wrmsr"
+        :
+        : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32))
+        : "memory"
+    );
+}
+
+#endif // __MSR_H__
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+@ KrnlAid function multiversioning
+@ A multiversioned function is a function pointer plus a list of variants, best first, each tagged with the
+@ X86_FEATURE_* bits it needs. multiversion_init() binds every pointer to the first variant the CPU can run,
+@ after that a call costs one indirect call through a read mostly pointer and no feature checks.
+@ Until then the pointer holds the baseline, so early callers still work.
+@
+@ How to use:
+@ 1, keep the slot section and its bounds in your linker script(GNU ld does this on its own for normal executables):
+@      krnlaid_mv : { __start_krnlaid_mv = .; KEEP(*(krnlaid_mv)) __stop_krnlaid_mv = .; }
+@ 2, in a header: MV_DECLARE(uint32_t, crc32c, (const void* data, size_t len, uint32_t crc));
+@ 3, in one source file, after defining the variants:
+@      MV_DEFINE(uint32_t, crc32c, (const void*, size_t, uint32_t), crc32c_generic,
+@          MV_VARIANT(crc32c_avx512, X86_FEATURE_AVX512F, X86_FEATURE_VPCLMULQDQ),
+@          MV_VARIANT(crc32c_sse42, X86_FEATURE_SSE4_2));
+@ 4, call multiversion_init() once after cpu_features_probe()(and after the OS enabled the SIMD state)
+@    NOTE: with no MV_DEFINE anywhere the section bounds don't exist, so don't call it then
+@ 5, crc32c(buf, len, 0) like any other function
+@
+@ Building with MULTIVERSION_PIN_BASELINE(e.g. when the target ISA is known and the baseline is compiled for it)
+@ turns every multiversioned function into a plain alias of its baseline: direct calls, no pointer, nothing to init.
+@ NOTE: the alias needs the baseline's symbol name, so in C++ the baseline has to be extern "C"
+*/
+
+#ifndef __MULTIVERSION_H__
+#define __MULTIVERSION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpufeature.h"
+#include "../../utils/cache.h"
+
+//Most features a single variant can require, can be overriden
+#ifndef MV_MAX_REQS
+#define MV_MAX_REQS 4
+#endif
+
+//Feature check used to pick variants, can be overriden(e.g. to also check XCR0 or to mask features off for testing)
+#ifndef MULTIVERSION_HAS
+#define MULTIVERSION_HAS(feature) cpu_has(feature)
+#endif
+
+//Ends a variant's requirement list(feature 0 is a real one)
+#define MV_END 0xFFFF
+
+typedef void (*mv_fn_t)(void);
+
+typedef struct {
+    mv_fn_t fn;
+    uint16_t req[MV_MAX_REQS + 1]; //X86_FEATURE_*, up to MV_END
+} mv_variant_t;
+
+typedef struct {
+    mv_fn_t* target;               //the function pointer to bind
+    const mv_variant_t* variants;  //best first, the last one is the baseline and requires nothing
+    uint32_t count;
+    uint32_t selected;             //index of the bound variant, count until multiversion_init ran
+    const char* name;
+} mv_slot_t;
+
+extern mv_slot_t __start_krnlaid_mv[];
+extern mv_slot_t __stop_krnlaid_mv[];
+
+//A variant and the features it needs
+#define MV_VARIANT(fn, ...) { (mv_fn_t)(fn), { __VA_ARGS__, MV_END } }
+
+//A variant that needs nothing
+#define MV_BASELINE(fn) { (mv_fn_t)(fn), { MV_END } }
+
+#ifdef MULTIVERSION_PIN_BASELINE
+    #define MV_DECLARE(ret, name, params) ret name params
+
+    #define MV_DEFINE(ret, name, params, baseline, ...) \
+        ret name params __attribute__((alias(#baseline)))
+#else
+    #define MV_DECLARE(ret, name, params) extern ret (*name) params
+
+    #define MV_DEFINE(ret, name, params, baseline, ...) \
+        ret (*name) params __read_mostly = baseline; \
+        static const mv_variant_t name##_mv_variants[] = { __VA_ARGS__, MV_BASELINE(baseline) }; \
+        static mv_slot_t name##_mv_slot __attribute__((section("krnlaid_mv"), used, aligned(sizeof(void*)))) = { \
+            (mv_fn_t*)(void*)&name, name##_mv_variants, \
+            sizeof(name##_mv_variants) / sizeof(mv_variant_t), \
+            sizeof(name##_mv_variants) / sizeof(mv_variant_t), #name \
+        }
+#endif
+
+//Checks whether the CPU can run a variant
+static inline int mv_variant_supported(const mv_variant_t* variant) {
+    for (int i = 0; i < MV_MAX_REQS && variant->req[i] != MV_END; i++) {
+        if (!MULTIVERSION_HAS(variant->req[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//Index of the best variant the CPU can run(the baseline if nothing else)
+static inline uint32_t mv_resolve(const mv_variant_t* variants, uint32_t count) {
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        if (mv_variant_supported(&variants[i])) {
+            return i;
+        }
+    }
+    return count - 1;
+}
+
+//Binds one slot, can be called again after the feature set changed(e.g. with a different MULTIVERSION_HAS)
+static inline void mv_bind(mv_slot_t* slot) {
+    slot->selected = mv_resolve(slot->variants, slot->count);
+    __atomic_store_n(slot->target, slot->variants[slot->selected].fn, __ATOMIC_RELEASE);
+}
+
+#ifdef MULTIVERSION_PIN_BASELINE
+    //Nothing to bind
+    static inline void multiversion_init(void) {
+    }
+
+    #define for_each_multiversion(slot) for (mv_slot_t* slot = NULL; slot != NULL; )
+#else
+    //Binds every multiversioned function, call it once before the other CPUs start
+    static inline void multiversion_init(void) {
+        for (mv_slot_t* slot = __start_krnlaid_mv; slot < __stop_krnlaid_mv; slot++) {
+            mv_bind(slot);
+        }
+    }
+
+    //Iterates over every multiversioned function(e.g. to log slot->name and the selected variant)
+    #define for_each_multiversion(slot) for (mv_slot_t* slot = __start_krnlaid_mv; slot < __stop_krnlaid_mv; slot++)
+#endif
+
+#endif // __MULTIVERSION_H__
\ No newline at end of file
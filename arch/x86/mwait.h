@@ -0,0 +1,268 @@
+/*
+@ KrnlAid wait on address
+@ Spinning with PAUSE forever burns power and takes execution resources away from the SMT sibling.
+@ wait_cond() spins for WAIT_SPIN_ITERATIONS first(most waits are short), then sleeps until the cache line
+@ of the address is written:
+@   ring 0:            MONITOR/MWAIT(CPUID.1:ECX.MONITOR), the hint picks the C-state
+@   ring 0 or ring 3:  UMONITOR/UMWAIT(CPUID.7:ECX.WAITPKG), C0.1/C0.2 with a TSC deadline
+@   otherwise:         PAUSE with exponential backoff up to WAIT_BACKOFF_MAX
+@ A write to the monitored line, an interrupt or the deadline wakes it up, the condition is always re-checked.
+@
+@ How to use:
+@ 1, define WAIT_IMPL in exactly one source file
+@ 2, ring 0: wait_probe(); ring 3: define WAIT_USERSPACE(MWAIT faults there) and call wait_probe()
+@ 3, uint32_t now = wait_on_u32(&flag, 0); or wait_cond(&node->locked, node->locked != 0);
+@ NOTE: a waker only has to store to the address, no IPI needed. Under most hypervisors MONITOR and WAITPKG
+@ are hidden and the backoff is used.
+*/
+
+#ifndef __MWAIT_H__
+#define __MWAIT_H__
+
+#include <stdint.h>
+#include "cpuid.h"
+#include "tsc.h"
+
+//PAUSEs before going to sleep, can be overriden
+#ifndef WAIT_SPIN_ITERATIONS
+#define WAIT_SPIN_ITERATIONS 128
+#endif
+
+//Largest number of PAUSEs between two checks when there is nothing to sleep on, can be overriden
+#ifndef WAIT_BACKOFF_MAX
+#define WAIT_BACKOFF_MAX 1024
+#endif
+
+//Longest UMWAIT in TSC cycles before the condition is checked again, can be overriden
+#ifndef WAIT_UMWAIT_CYCLES
+#define WAIT_UMWAIT_CYCLES 100000
+#endif
+
+enum wait_methods {
+    WAIT_METHOD_PAUSE,
+    WAIT_METHOD_MWAIT,
+    WAIT_METHOD_UMWAIT,
+};
+
+//UMWAIT/TPAUSE control: C0.2 saves more power, C0.1 wakes up faster
+#define WAIT_UMWAIT_C02 0
+#define WAIT_UMWAIT_C01 1
+
+//MWAIT ECX: wake up on interrupts even while they are masked
+#define WAIT_MWAIT_BREAK_ON_IRQ 1
+
+typedef struct {
+    uint8_t method;            //WAIT_METHOD_*
+    uint8_t waitpkg;           //UMONITOR/UMWAIT/TPAUSE are there
+    uint8_t break_on_irq;      //MWAIT can wake up on masked interrupts
+    uint8_t umwait_control;    //WAIT_UMWAIT_C01 or WAIT_UMWAIT_C02
+    uint32_t mwait_hint;       //EAX for MWAIT, 0 = C1
+    uint16_t monitor_line_min; //smallest and largest monitor line size
+    uint16_t monitor_line_max;
+    uint8_t substates[8];      //MWAIT sub C-states of C0-C7
+} wait_info_t;
+
+extern wait_info_t wait_info;
+
+//Decodes leaf 1, 5 and 7 and picks the method
+static inline void wait_probe_into(wait_info_t* info, cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t max_leaf;
+    int monitor;
+
+    info->method = WAIT_METHOD_PAUSE;
+    info->waitpkg = 0;
+    info->break_on_irq = 0;
+    info->umwait_control = WAIT_UMWAIT_C01;
+    info->mwait_hint = 0;
+    info->monitor_line_min = 0;
+    info->monitor_line_max = 0;
+    for (int i = 0; i < 8; i++) {
+        info->substates[i] = 0;
+    }
+
+    source(CPUID_VENDOR, 0, regs);
+    max_leaf = regs[0];
+    source(CPUID_CPU_INFO, 0, regs);
+    monitor = (regs[2] & (CPUID_CPU_INFO_ECX_MONITOR)) != 0;
+
+    if (monitor && max_leaf >= CPUID_MONITOR_MWAIT) {
+        source(CPUID_MONITOR_MWAIT, 0, regs);
+        info->monitor_line_min = (uint16_t)CPUID_FIELD(regs[0], CPUID_MONITOR_MWAIT_EAX_SMALLEST_LINE);
+        info->monitor_line_max = (uint16_t)CPUID_FIELD(regs[1], CPUID_MONITOR_MWAIT_EBX_LARGEST_LINE);
+        if (regs[2] & (CPUID_MONITOR_MWAIT_ECX_ENUM_EXTENSIONS)) {
+            info->break_on_irq = (regs[2] & (CPUID_MONITOR_MWAIT_ECX_BREAK_EVENTS)) != 0;
+            for (int i = 0; i < 8; i++) {
+                info->substates[i] = (uint8_t)((regs[3] >> (i * 4)) & 0xF);
+            }
+        }
+    }
+    if (max_leaf >= CPUID_EXTENDED_FEATURES) {
+        source(CPUID_EXTENDED_FEATURES, 0, regs);
+        info->waitpkg = (regs[2] & (CPUID_EXTENDED_FEATURES_ECX_WAITPKG)) != 0;
+    }
+
+    #ifndef WAIT_USERSPACE
+        if (monitor) {
+            info->method = WAIT_METHOD_MWAIT;
+            return;
+        }
+    #endif
+    if (info->waitpkg) {
+        info->method = WAIT_METHOD_UMWAIT;
+    }
+}
+
+//wait_probe_into for wait_info with the native CPUID
+static inline void wait_probe(void) {
+    wait_probe_into(&wait_info, cpuid_native);
+}
+
+//MWAIT hint for the deepest sub state of C-state cstate(1 = C1...), 0(C1) if the CPU doesn't list it
+static inline uint32_t wait_mwait_hint(const wait_info_t* info, uint32_t cstate) {
+    if (cstate == 0 || cstate > 7 || info->substates[cstate] == 0) {
+        return 0;
+    }
+    return ((cstate - 1) << 4) | (uint32_t)(info->substates[cstate] - 1);
+}
+
+//=================Instructions=================
+
+static inline void cpu_relax(void) {
+    __asm__ __volatile__ ("pause" : : : "memory");
+}
+
+//Ring 0 only: arms address monitoring for the line of addr
+static inline void __monitor(const volatile void* addr) {
+    __asm__ __volatile__ ("monitor" : : "a" (addr), "c" (0), "d" (0));
+}
+
+//Ring 0 only: sleeps until the monitored line is written or an interrupt comes in
+static inline void __mwait(uint32_t hint, uint32_t extensions) {
+    __asm__ __volatile__ ("mwait" : : "a" (hint), "c" (extensions) : "memory");
+}
+
+//Arms address monitoring for the line of addr(WAITPKG)
+static inline void __umonitor(const volatile void* addr) {
+    __asm__ __volatile__ ("umonitor %0" : : "r" (addr));
+}
+
+//Sleeps until the monitored line is written or the TSC reaches deadline, returns 1 if the OS limit cut it short(WAITPKG)
+static inline int __umwait(uint32_t control, uint64_t deadline) {
+    uint8_t limited;
+    __asm__ __volatile__ (
+        "umwait %k1\n\t"
+        "setc %0"
+        : "=r" (limited)
+        : "r" (control), "a" ((uint32_t)deadline), "d" ((uint32_t)(deadline >> 32))
+        : "memory", "cc"
+    );
+    return limited;
+}
+
+//Sleeps until the TSC reaches deadline, returns 1 if the OS limit cut it short(WAITPKG)
+static inline int __tpause(uint32_t control, uint64_t deadline) {
+    uint8_t limited;
+    __asm__ __volatile__ (
+        "tpause %k1\n\t"
+        "setc %0"
+        : "=r" (limited)
+        : "r" (control), "a" ((uint32_t)deadline), "d" ((uint32_t)(deadline >> 32))
+        : "memory", "cc"
+    );
+    return limited;
+}
+
+//Idles for about cycles TSC cycles, in C0.1 with WAITPKG, with PAUSE otherwise
+static inline void wait_delay(uint64_t cycles) {
+    uint64_t deadline = rdtsc() + cycles;
+    if (wait_info.waitpkg) {
+        __tpause(wait_info.umwait_control, deadline);
+        return;
+    }
+    while ((int64_t)(rdtsc() - deadline) < 0) {
+        cpu_relax();
+    }
+}
+
+//=================Waiting=================
+
+typedef struct {
+    uint32_t spins;
+    uint32_t backoff;
+} wait_state_t;
+
+#define WAIT_STATE_INIT { 0, 1 }
+
+//Arms monitoring for addr, returns 0 if there is nothing to arm(the condition has to be checked after it either way)
+static inline int wait_arm(const volatile void* addr) {
+    switch (wait_info.method) {
+        case WAIT_METHOD_MWAIT:
+            __monitor(addr);
+            return 1;
+        case WAIT_METHOD_UMWAIT:
+            __umonitor(addr);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+//Sleeps once after wait_arm(or backs off), the caller re-checks its condition afterwards
+static inline void wait_sleep(wait_state_t* state) {
+    switch (wait_info.method) {
+        case WAIT_METHOD_MWAIT:
+            __mwait(wait_info.mwait_hint, 0);
+            break;
+        case WAIT_METHOD_UMWAIT:
+            __umwait(wait_info.umwait_control, rdtsc() + WAIT_UMWAIT_CYCLES);
+            break;
+        default:
+            for (uint32_t i = 0; i < state->backoff; i++) {
+                cpu_relax();
+            }
+            if (state->backoff < WAIT_BACKOFF_MAX) {
+                state->backoff <<= 1;
+            }
+            break;
+    }
+}
+
+/*
+@ Waits until cond is true, addr is what a waker writes to make it true
+@ cond is evaluated again after every wake up, so it must read addr(or something on the same line) each time
+*/
+#define wait_cond(addr, cond) do { \
+    wait_state_t __ws = WAIT_STATE_INIT; \
+    while (!(cond)) { \
+        if (__ws.spins < WAIT_SPIN_ITERATIONS) { \
+            __ws.spins++; \
+            cpu_relax(); \
+            continue; \
+        } \
+        if (wait_arm(addr) && (cond)) { \
+            break; \
+        } \
+        wait_sleep(&__ws); \
+    } \
+} while (0)
+
+//Waits until *addr != old and returns the new value
+static inline uint32_t wait_on_u32(const volatile uint32_t* addr, uint32_t old) {
+    uint32_t value;
+    wait_cond(addr, (value = __atomic_load_n(addr, __ATOMIC_ACQUIRE)) != old);
+    return value;
+}
+
+//Waits until *addr != old and returns the new value
+static inline uint64_t wait_on_u64(const volatile uint64_t* addr, uint64_t old) {
+    uint64_t value;
+    wait_cond(addr, (value = __atomic_load_n(addr, __ATOMIC_ACQUIRE)) != old);
+    return value;
+}
+
+#ifdef WAIT_IMPL
+    wait_info_t wait_info;
+#endif
+
+#endif // __MWAIT_H__
\ No newline at end of file
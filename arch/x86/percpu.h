@@ -0,0 +1,177 @@
+/*
+@ KrnlAid per-CPU variables
+@ DEFINE_PER_CPU puts a variable in the percpu_data section, which is only a template: every CPU gets its own
+@ copy of the whole section and GS base points at the current CPU's copy. this_cpu_read/write/add then compute
+@ the variable's offset into a register and access it with one %gs relative instruction, the update itself can't
+@ be split by an interrupt on the same CPU.
+@
+@ How to use:
+@ 1, keep the section and its bounds in your linker script(GNU ld does this on its own for normal executables):
+@      percpu_data : { __start_percpu_data = .; KEEP(*(percpu_data)) __stop_percpu_data = .; }
+@ 2, define PERCPU_IMPL in exactly one source file
+@ 3, for every CPU allocate percpu_area_size() bytes(cache line aligned) and call percpu_setup(cpu, area)
+@ 4, on every CPU call percpu_load(cpu) AFTER flush_cs_ds_etc(), loading a GS selector clears the GS base
+@ 5, optionally #define __kcpu_id() this_cpu_read(percpu_cpu_id) for spinlock.h and friends
+@
+@ For userspace tests define PERCPU_USE_TLS: a thread local pointer stands in for the GS base.
+*/
+
+#ifndef __PERCPU_H__
+#define __PERCPU_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "msr.h"
+
+#if !defined(__x86_64__) && !defined(PERCPU_USE_TLS)
+#error "percpu.h: GS based per-CPU data needs x86_64(or PERCPU_USE_TLS)"
+#endif
+
+//Maximum number of CPUs, can be overriden
+#ifndef PERCPU_MAX_CPUS
+#define PERCPU_MAX_CPUS 256
+#endif
+
+#define DEFINE_PER_CPU(type, name) __attribute__((section("percpu_data"))) __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) extern __attribute__((section("percpu_data"))) __typeof__(type) name
+
+extern char __start_percpu_data[];
+extern char __stop_percpu_data[];
+
+extern char* percpu_areas[PERCPU_MAX_CPUS];
+extern uint32_t percpu_nr_cpus;
+
+//Every CPU's own area and index
+DECLARE_PER_CPU(char*, percpu_base);
+DECLARE_PER_CPU(uint32_t, percpu_cpu_id);
+
+//Offset of a per-CPU variable inside every CPU's area
+#define percpu_offset(var) ((uintptr_t)&(var) - (uintptr_t)__start_percpu_data)
+
+//Bytes every CPU's area needs
+#define percpu_area_size() ((size_t)(__stop_percpu_data - __start_percpu_data))
+
+//Pointer to another CPU's copy of a variable
+#define per_cpu_ptr(var, cpu) ((__typeof__(var)*)(percpu_areas[cpu] + percpu_offset(var)))
+
+//Iterates over every CPU that has been set up
+#define for_each_cpu(cpu) for (uint32_t cpu = 0; cpu < percpu_nr_cpus; cpu++)
+
+#ifdef PERCPU_USE_TLS
+    extern __thread char* percpu_tls_base;
+
+    #define __this_cpu_lvalue(var) (*(volatile __typeof__(var)*)(percpu_tls_base + percpu_offset(var)))
+    #define this_cpu_read(var) __this_cpu_lvalue(var)
+    #define this_cpu_write(var, val) do { __this_cpu_lvalue(var) = (val); } while (0)
+    #define this_cpu_add(var, val) do { __this_cpu_lvalue(var) += (val); } while (0)
+    #define this_cpu_add_return(var, val) (__this_cpu_lvalue(var) += (val))
+#else
+    //Reads the current CPU's copy of a scalar per-CPU variable
+    #define this_cpu_read(var) ({ \
+        __typeof__(var) __val; \
+        __asm__ __volatile__ ("mov %%gs:(%1), %0" : "=r" (__val) : "r" (percpu_offset(var))); \
+        __val; \
+    })
+
+    //Writes the current CPU's copy of a scalar per-CPU variable
+    #define this_cpu_write(var, val) do { \
+        __typeof__(var) __val = (val); \
+        __asm__ __volatile__ ("mov %0, %%gs:(%1)" : : "r" (__val), "r" (percpu_offset(var)) : "memory"); \
+    } while (0)
+
+    //Adds to the current CPU's copy of an integer per-CPU variable(one instruction, no LOCK prefix)
+    #define this_cpu_add(var, val) do { \
+        __typeof__(var) __val = (val); \
+        __asm__ __volatile__ ("add %0, %%gs:(%1)" : : "r" (__val), "r" (percpu_offset(var)) : "memory", "cc"); \
+    } while (0)
+
+    //Adds to the current CPU's copy of an integer per-CPU variable and returns the new value
+    #define this_cpu_add_return(var, val) ({ \
+        __typeof__(var) __val = (val); \
+        __typeof__(var) __old = __val; \
+        __asm__ __volatile__ ("xadd %0, %%gs:(%1)" : "+r" (__old) : "r" (percpu_offset(var)) : "memory", "cc"); \
+        (__typeof__(var))(__old + __val); \
+    })
+#endif
+
+//Pointer to the current CPU's copy of a variable
+#define this_cpu_ptr(var) ((__typeof__(var)*)(this_cpu_read(percpu_base) + percpu_offset(var)))
+
+//Copies the template into a CPU's area and registers it
+static inline void percpu_setup(uint32_t cpu, void* area) {
+    char* dest = (char*)area;
+    for (size_t i = 0; i < percpu_area_size(); i++) {
+        dest[i] = __start_percpu_data[i];
+    }
+    percpu_areas[cpu] = dest;
+    *per_cpu_ptr(percpu_base, cpu) = dest;
+    *per_cpu_ptr(percpu_cpu_id, cpu) = cpu;
+    if (cpu >= percpu_nr_cpus) {
+        percpu_nr_cpus = cpu + 1;
+    }
+}
+
+//Points GS base(or the TLS stand in) at a CPU's area, call it on that CPU after flush_cs_ds_etc()
+static inline void percpu_load(uint32_t cpu) {
+    #ifdef PERCPU_USE_TLS
+        percpu_tls_base = percpu_areas[cpu];
+    #else
+        wrmsr(MSR_GS_BASE, (uint64_t)percpu_areas[cpu]);
+    #endif
+}
+
+//=================Per-CPU counters=================
+
+/*
+@ A counter that is cheap to bump on every CPU: each CPU adds to its own delta and only folds it into
+@ the shared count once it reached the batch size.
+@ percpu_counter_read is approximate(off by less than batch * CPUs), percpu_counter_sum is exact but walks every CPU.
+*/
+typedef struct {
+    volatile int64_t count;
+    int32_t batch;
+    int32_t* delta; //the per-CPU delta variable
+} percpu_counter_t;
+
+#define DEFINE_PERCPU_COUNTER(name, batch) \
+    DEFINE_PER_CPU(int32_t, name##_delta); \
+    percpu_counter_t name = { 0, (batch), &name##_delta }
+
+//Adds to a counter
+static inline void percpu_counter_add(percpu_counter_t* counter, int32_t value) {
+    int32_t* delta = counter->delta;
+    int32_t now = this_cpu_add_return(*delta, value);
+    if (now >= counter->batch || now <= -counter->batch) {
+        //fold the delta into the shared count without losing adds from interrupts in between
+        this_cpu_add(*delta, -now);
+        __atomic_fetch_add(&counter->count, now, __ATOMIC_RELAXED);
+    }
+}
+
+//Approximate value, one load
+static inline int64_t percpu_counter_read(percpu_counter_t* counter) {
+    return __atomic_load_n(&counter->count, __ATOMIC_RELAXED);
+}
+
+//Exact value, adds up every CPU's delta
+static inline int64_t percpu_counter_sum(percpu_counter_t* counter) {
+    int64_t sum = __atomic_load_n(&counter->count, __ATOMIC_RELAXED);
+    for_each_cpu(cpu) {
+        sum += __atomic_load_n(per_cpu_ptr(*counter->delta, cpu), __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+#ifdef PERCPU_IMPL
+    char* percpu_areas[PERCPU_MAX_CPUS];
+    uint32_t percpu_nr_cpus;
+
+    DEFINE_PER_CPU(char*, percpu_base);
+    DEFINE_PER_CPU(uint32_t, percpu_cpu_id);
+
+    #ifdef PERCPU_USE_TLS
+        __thread char* percpu_tls_base;
+    #endif
+#endif
+
+#endif // __PERCPU_H__
\ No newline at end of file
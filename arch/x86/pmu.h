@@ -0,0 +1,374 @@
+/*
+@ KrnlAid hardware event counting
+@ pmu_decode() reads the architectural PMU description(CPUID 0xA): how many general purpose and fixed counters
+@ there are, how wide they are and which architectural events exist.
+@ A pmu_set_t then counts up to PMU_MAX_COUNTERS events around a piece of code:
+@ cycles, instructions and reference cycles go on fixed counters when there are some, the rest on general purpose ones.
+@ In the kernel the counters are programmed through the MSRs and read with RDPMC(a few dozen cycles, no exit on
+@ most hypervisors), with PMU_USE_PERF_EVENT the same API runs in Linux userspace on top of perf_event_open.
+@
+@ How to use:
+@ 1, define PMU_IMPL in exactly one source file to get pmu_report(), that file also needs your logger wrapper(see utils/logger.h)
+@ 2, pmu_info_t pmu; pmu_decode(&pmu, cpuid_native);
+@ 3, pmu_set_t set; uint8_t events[] = { PMU_EVENT_CYCLES, PMU_EVENT_INSTRUCTIONS, PMU_EVENT_LLC_MISSES, PMU_EVENT_BRANCH_MISSES };
+@    pmu_set_init(&set, &pmu, events, 4); (on the CPU that runs the code, with preemption off)
+@ 4, pmu_begin(&set); hot_path(); pmu_end(&set); pmu_report(&set, "hot_path");
+@ 5, pmu_set_release(&set)
+*/
+
+#ifndef __PMU_H__
+#define __PMU_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpuid.h"
+#include "msr.h"
+
+#ifdef PMU_USE_PERF_EVENT
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <sys/ioctl.h>
+    #include <unistd.h>
+#endif
+
+//Most events one set counts, can be overriden
+#ifndef PMU_MAX_COUNTERS
+#define PMU_MAX_COUNTERS 8
+#endif
+
+//Architectural events, in CPUID 0xA EBX bit order
+enum pmu_events {
+    PMU_EVENT_CYCLES,
+    PMU_EVENT_INSTRUCTIONS,
+    PMU_EVENT_REF_CYCLES,
+    PMU_EVENT_LLC_REFERENCES,
+    PMU_EVENT_LLC_MISSES,
+    PMU_EVENT_BRANCHES,
+    PMU_EVENT_BRANCH_MISSES,
+    PMU_EVENT_COUNT,
+};
+
+//Event select bits
+#define PMU_EVTSEL_USR      (1ull << 16)
+#define PMU_EVTSEL_OS       (1ull << 17)
+#define PMU_EVTSEL_EDGE     (1ull << 18)
+#define PMU_EVTSEL_INT      (1ull << 20)
+#define PMU_EVTSEL_EN       (1ull << 22)
+#define PMU_EVTSEL_INV      (1ull << 23)
+#define PMU_EVTSEL(event, umask) ((uint64_t)(event) | ((uint64_t)(umask) << 8))
+
+//Fixed counter control, 4 bits per counter
+#define PMU_FIXED_OS  0x1
+#define PMU_FIXED_USR 0x2
+
+//RDPMC selects a fixed counter with this bit
+#define PMU_RDPMC_FIXED (1u << 30)
+
+typedef struct {
+    uint8_t version;         //0 = no architectural PMU(e.g. AMD, or a hypervisor that hides it)
+    uint8_t gp_counters;
+    uint8_t gp_width;
+    uint8_t fixed_counters;
+    uint8_t fixed_width;
+    uint32_t fixed_mask;     //fixed counters that exist
+    uint32_t events;         //1 << PMU_EVENT_* for every event that is available
+} pmu_info_t;
+
+//Architectural event encodings and the fixed counter that counts it(-1 if none)
+static const struct {
+    uint8_t event;
+    uint8_t umask;
+    int8_t fixed;
+    const char* name;
+} pmu_event_table[PMU_EVENT_COUNT] = {
+    { 0x3C, 0x00,  1, "cycles" },
+    { 0xC0, 0x00,  0, "instructions" },
+    { 0x3C, 0x01,  2, "ref-cycles" },
+    { 0x2E, 0x4F, -1, "llc-references" },
+    { 0x2E, 0x41, -1, "llc-misses" },
+    { 0xC4, 0x00, -1, "branches" },
+    { 0xC5, 0x00, -1, "branch-misses" },
+};
+
+//Decodes CPUID 0xA
+static inline void pmu_decode(pmu_info_t* info, cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t ebx_length;
+
+    info->version = 0;
+    info->gp_counters = 0;
+    info->gp_width = 0;
+    info->fixed_counters = 0;
+    info->fixed_width = 0;
+    info->fixed_mask = 0;
+    info->events = 0;
+
+    source(CPUID_VENDOR, 0, regs);
+    if (regs[0] < CPUID_PERFORMANCE_MONITORING) {
+        return;
+    }
+    source(CPUID_PERFORMANCE_MONITORING, 0, regs);
+    info->version = (uint8_t)CPUID_FIELD(regs[0], CPUID_PERFORMANCE_MONITORING_EAX_VERSION);
+    if (info->version == 0) {
+        return;
+    }
+    info->gp_counters = (uint8_t)CPUID_FIELD(regs[0], CPUID_PERFORMANCE_MONITORING_EAX_GP_COUNTERS);
+    info->gp_width = (uint8_t)CPUID_FIELD(regs[0], CPUID_PERFORMANCE_MONITORING_EAX_GP_WIDTH);
+    ebx_length = CPUID_FIELD(regs[0], CPUID_PERFORMANCE_MONITORING_EAX_EBX_LENGTH);
+
+    //EBX bits past its length don't mean anything, those events are missing too
+    for (uint32_t i = 0; i < PMU_EVENT_COUNT; i++) {
+        if (i < ebx_length && !(regs[1] & (1u << i))) {
+            info->events |= 1u << i;
+        }
+    }
+
+    //fixed counters came with version 2
+    if (info->version >= 2) {
+        info->fixed_counters = (uint8_t)CPUID_FIELD(regs[3], CPUID_PERFORMANCE_MONITORING_EDX_FIXED_COUNTERS);
+        info->fixed_width = (uint8_t)CPUID_FIELD(regs[3], CPUID_PERFORMANCE_MONITORING_EDX_FIXED_WIDTH);
+        info->fixed_mask = (info->fixed_counters >= 32) ? ~0u : (1u << info->fixed_counters) - 1;
+        //version 5 can have holes
+        if (info->version >= 5) {
+            info->fixed_mask |= CPUID_FIELD(regs[2], CPUID_PERFORMANCE_MONITORING_ECX_FIXED_MASK);
+        }
+    }
+}
+
+//=================Measurement=================
+
+typedef struct {
+    uint32_t count;
+    uint8_t events[PMU_MAX_COUNTERS];
+    uint32_t counter[PMU_MAX_COUNTERS]; //RDPMC index(or perf event fd)
+    uint64_t mask[PMU_MAX_COUNTERS];    //counter width
+    uint64_t start[PMU_MAX_COUNTERS];
+    uint64_t delta[PMU_MAX_COUNTERS];
+    #ifdef PMU_USE_PERF_EVENT
+        int leader;
+    #else
+        uint8_t version;                //pmu_info_t.version, which control MSRs exist
+    #endif
+} pmu_set_t;
+
+void pmu_report(const pmu_set_t* set, const char* name);
+
+//Reads a performance counter(ring 0, or ring 3 with CR4.PCE set)
+static inline uint64_t rdpmc(uint32_t counter) {
+    uint32_t low, high;
+    __asm__ __volatile__ (
+        "rdpmc"
+        : "=a" (low), "=d" (high)
+        : "c" (counter)
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+//Delta of an event counted by a set, 0 if the set doesn't count it
+static inline uint64_t pmu_delta(const pmu_set_t* set, uint8_t event) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        if (set->events[i] == event) {
+            return set->delta[i];
+        }
+    }
+    return 0;
+}
+
+#ifndef PMU_USE_PERF_EVENT
+    /*
+    @ Ring 0 only: programs the counters for events on the current CPU and starts them,
+    @ returns how many were set up(events the PMU doesn't have or that don't fit are skipped)
+    @ NOTE: it takes the counters over, don't mix it with another user of the PMU
+    */
+    static inline uint32_t pmu_set_init(pmu_set_t* set, const pmu_info_t* info, const uint8_t* events, uint32_t n) {
+        uint64_t fixed_ctrl = 0, global = 0;
+        uint32_t next_gp = 0;
+
+        set->count = 0;
+        set->version = info->version;
+        if (info->version == 0) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < n && set->count < PMU_MAX_COUNTERS; i++) {
+            uint8_t event = events[i];
+            int8_t fixed;
+            uint32_t slot = set->count;
+
+            if (event >= PMU_EVENT_COUNT || !(info->events & (1u << event))) {
+                continue;
+            }
+            fixed = pmu_event_table[event].fixed;
+            if (fixed >= 0 && (info->fixed_mask & (1u << fixed))) {
+                fixed_ctrl |= (uint64_t)(PMU_FIXED_OS | PMU_FIXED_USR) << (fixed * 4);
+                global |= 1ull << (32 + fixed);
+                wrmsr(MSR_IA32_FIXED_CTR0 + fixed, 0);
+                set->counter[slot] = PMU_RDPMC_FIXED | (uint32_t)fixed;
+                set->mask[slot] = (info->fixed_width >= 64) ? ~0ull : (1ull << info->fixed_width) - 1;
+            } else if (next_gp < info->gp_counters) {
+                wrmsr(MSR_IA32_PERFEVTSEL0 + next_gp, 0);
+                wrmsr(MSR_IA32_PMC0 + next_gp, 0);
+                wrmsr(MSR_IA32_PERFEVTSEL0 + next_gp,
+                      PMU_EVTSEL(pmu_event_table[event].event, pmu_event_table[event].umask) | PMU_EVTSEL_OS | PMU_EVTSEL_USR | PMU_EVTSEL_EN);
+                global |= 1ull << next_gp;
+                set->counter[slot] = next_gp;
+                set->mask[slot] = (info->gp_width >= 64) ? ~0ull : (1ull << info->gp_width) - 1;
+                next_gp++;
+            } else {
+                continue;
+            }
+            set->events[slot] = event;
+            set->delta[slot] = 0;
+            set->count++;
+        }
+
+        if (fixed_ctrl != 0) {
+            wrmsr(MSR_IA32_FIXED_CTR_CTRL, fixed_ctrl);
+        }
+        //version 1 has no global control, the enable bits in the event selects are all there is
+        if (info->version >= 2) {
+            wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, global);
+        }
+        return set->count;
+    }
+
+    //Ring 0 only: stops every counter
+    static inline void pmu_set_release(pmu_set_t* set) {
+        for (uint32_t i = 0; i < set->count; i++) {
+            if (!(set->counter[i] & PMU_RDPMC_FIXED)) {
+                wrmsr(MSR_IA32_PERFEVTSEL0 + set->counter[i], 0);
+            }
+        }
+        //version 1 has neither MSR, writing them would #GP
+        if (set->version >= 2) {
+            wrmsr(MSR_IA32_FIXED_CTR_CTRL, 0);
+            wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, 0);
+        }
+        set->count = 0;
+    }
+
+    //Reads every counter of the set
+    static inline void __pmu_read(const pmu_set_t* set, uint64_t* values) {
+        //keep earlier instructions out of the window
+        __asm__ __volatile__ ("lfence" : : : "memory");
+        for (uint32_t i = 0; i < set->count; i++) {
+            values[i] = rdpmc(set->counter[i]);
+        }
+        __asm__ __volatile__ ("lfence" : : : "memory");
+    }
+#else
+    static inline long __pmu_perf_event_open(struct perf_event_attr* attr, int group) {
+        return syscall(SYS_perf_event_open, attr, 0, -1, group, 0);
+    }
+
+    //Opens one perf event per event as a group on the calling thread, returns how many could be opened
+    static inline uint32_t pmu_set_init(pmu_set_t* set, const pmu_info_t* info, const uint8_t* events, uint32_t n) {
+        static const uint64_t configs[PMU_EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_REF_CPU_CYCLES,
+            PERF_COUNT_HW_CACHE_REFERENCES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        (void)info;
+
+        set->count = 0;
+        set->leader = -1;
+        for (uint32_t i = 0; i < n && set->count < PMU_MAX_COUNTERS; i++) {
+            struct perf_event_attr attr;
+            long fd;
+            uint8_t* bytes = (uint8_t*)&attr;
+
+            if (events[i] >= PMU_EVENT_COUNT) {
+                continue;
+            }
+            for (size_t b = 0; b < sizeof(attr); b++) {
+                bytes[b] = 0;
+            }
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[events[i]];
+            attr.disabled = set->leader == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            fd = __pmu_perf_event_open(&attr, set->leader);
+            if (fd < 0) {
+                continue;
+            }
+            if (set->leader == -1) {
+                set->leader = (int)fd;
+            }
+            set->events[set->count] = events[i];
+            set->counter[set->count] = (uint32_t)fd;
+            set->mask[set->count] = ~0ull;
+            set->delta[set->count] = 0;
+            set->count++;
+        }
+        if (set->leader != -1) {
+            ioctl(set->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+        return set->count;
+    }
+
+    //Closes every event
+    static inline void pmu_set_release(pmu_set_t* set) {
+        for (uint32_t i = 0; i < set->count; i++) {
+            close((int)set->counter[i]);
+        }
+        set->count = 0;
+        set->leader = -1;
+    }
+
+    //Reads the whole group with one syscall, values come back in the order the events were opened
+    static inline void __pmu_read(const pmu_set_t* set, uint64_t* values) {
+        uint64_t buffer[PMU_MAX_COUNTERS + 1];
+        if (set->leader == -1 || read(set->leader, buffer, sizeof(buffer)) <= 0) {
+            for (uint32_t i = 0; i < set->count; i++) {
+                values[i] = 0;
+            }
+            return;
+        }
+        for (uint32_t i = 0; i < set->count && i < buffer[0]; i++) {
+            values[i] = buffer[i + 1];
+        }
+    }
+#endif
+
+//Starts a measurement
+static inline void pmu_begin(pmu_set_t* set) {
+    __pmu_read(set, set->start);
+}
+
+//Ends a measurement, the deltas are in set->delta(and pmu_delta)
+static inline void pmu_end(pmu_set_t* set) {
+    uint64_t now[PMU_MAX_COUNTERS];
+    __pmu_read(set, now);
+    for (uint32_t i = 0; i < set->count; i++) {
+        set->delta[i] = (now[i] - set->start[i]) & set->mask[i];
+    }
+}
+
+#ifdef PMU_IMPL
+    #include "../../utils/logger.h"
+
+    //Prints the deltas of the last measurement through the logger
+    void pmu_report(const pmu_set_t* set, const char* name) {
+        uint64_t cycles = pmu_delta(set, PMU_EVENT_CYCLES);
+        uint64_t instructions = pmu_delta(set, PMU_EVENT_INSTRUCTIONS);
+
+        log_info("%s:\n", name);
+        for (uint32_t i = 0; i < set->count; i++) {
+            log_info("  %-16s %14llu\n", pmu_event_table[set->events[i]].name, (unsigned long long)set->delta[i]);
+        }
+        //IPC with two decimals, no floating point in the kernel
+        if (cycles != 0 && instructions != 0) {
+            uint64_t ipc = instructions * 100 / cycles;
+            log_info("  %-16s %11llu.%02llu\n", "IPC", (unsigned long long)(ipc / 100), (unsigned long long)(ipc % 100));
+        }
+    }
+#endif
+
+#endif // __PMU_H__
\ No newline at end of file
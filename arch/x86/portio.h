@@ -1,10 +1,39 @@
+/*
+@ KrnlAid port and MMIO access
+@ Every accessor goes through a backend picked at compile time:
+@   default:      the real in/out/ins/outs instructions and volatile MMIO loads and stores
+@   PORTIO_MOCK:  an in-memory device model, port and MMIO ranges are claimed by portio_device_t callbacks,
+@                 so drivers can be run and tested as a normal Linux program
+@ On top of either one PORTIO_TRACE counts every access per (call site, port or MMIO address). A port access
+@ costs about 1us on real hardware, so the dump shows which code paths do too many of them and should batch
+@ (e.g. with the string versions).
+@
+@ How to use:
+@ 1, pick the backend(and PORTIO_TRACE) for every file that includes arch/x86/portio.h
+@ 2, with PORTIO_MOCK or PORTIO_TRACE define PORTIO_IMPL in exactly one source file, with PORTIO_TRACE
+@    that file also needs your logger wrapper(see utils/logger.h)
+@ 3, PORTIO_MOCK: fill a portio_device_t(space, base, size, read, write) and portio_mock_attach(&dev)
+@    before the driver touches it, unclaimed reads return all ones like a floating bus
+@ 4, PORTIO_TRACE: run the code, then portio_trace_dump(n) prints the n busiest call sites and ports
+@ NOTE: with PORTIO_TRACE the accessors are macros(to see the caller's __CUR_LOC), so their address can't be taken
+*/
+
 #ifndef __PORTIO_H__
 #define __PORTIO_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include "../../utils/debug.h"
 
-//Outputs a byte(1 bytes) to an I/O port
-static inline void outb(uint16_t port, uint8_t value) {
+//Address spaces
+#define PORTIO_SPACE_PORT 0
+#define PORTIO_SPACE_MMIO 1
+
+#ifndef PORTIO_MOCK
+
+//=================Hardware=================
+
+static inline void __outb(uint16_t port, uint8_t value) {
     __asm__ __volatile__ (
         "outb %b0, %w1"
         :
@@ -12,8 +41,7 @@ static inline void outb(uint16_t port, uint8_t value) {
     );
 }
 
-//Reads a byte(1 bytes) from an I/O port
-static inline uint8_t inb(uint16_t port) {
+static inline uint8_t __inb(uint16_t port) {
     uint8_t value;
     __asm__ __volatile__ (
         "inb %w1, %b0"
@@ -23,8 +51,7 @@ static inline uint8_t inb(uint16_t port) {
     return value;
 }
 
-//Outputs a word(2 bytes) to an I/O port
-static inline void outw(uint16_t port, uint16_t value) {
+static inline void __outw(uint16_t port, uint16_t value) {
     __asm__ __volatile__ (
         "outw %w0, %w1"
         :
@@ -32,8 +59,7 @@ static inline void outw(uint16_t port, uint16_t value) {
     );
 }
 
-//Reads a word(2 bytes) from an I/O port
-static inline uint16_t inw(uint16_t port) {
+static inline uint16_t __inw(uint16_t port) {
     uint16_t value;
     __asm__ __volatile__ (
         "inw %w1, %w0"
@@ -43,49 +69,643 @@ static inline uint16_t inw(uint16_t port) {
     return value;
 }
 
-//Outputs a long(4 bytes) to an I/O port
-static inline void outl(uint16_t port, uint32_t value) {
+static inline void __outl(uint16_t port, uint32_t value) {
     __asm__ __volatile__ (
-        "outl %0, %1"
+        "outl %k0, %w1"
         :
         : "a" (value), "Nd" (port)
     );
 }
 
-//Reads a long(4 bytes) from an I/O port
-static inline uint32_t inl(uint16_t port) {
+static inline uint32_t __inl(uint16_t port) {
     uint32_t value;
     __asm__ __volatile__ (
-        "inl %1, %0"
+        "inl %w1, %k0"
         : "=a" (value)
         : "Nd" (port)
     );
     return value;
 }
 
-//Outputs a quadword(8 bytes) to an I/O port
-static inline void outq(uint16_t port, uint64_t value) {
+/*
+@ rep ins/rep outs move count values between a port and memory in one instruction, instead of a loop of
+@ separate in/out instructions. The direction flag has to be clear, which the ABI guarantees outside of asm.
+*/
+
+static inline void __insb(uint16_t port, void* buffer, size_t count) {
     __asm__ __volatile__ (
-        "outq %0, %1"
-        :
-        : "a" (value), "Nd" (port)
+        "rep insb"
+        : "+D" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
     );
 }
 
-//Reads a quadword(8 bytes) from an I/O port
-static inline uint64_t inq(uint16_t port) {
-    uint64_t value;
+static inline void __insw(uint16_t port, void* buffer, size_t count) {
     __asm__ __volatile__ (
-        "inq %1, %0"
-        : "=a" (value)
-        : "Nd" (port)
+        "rep insw"
+        : "+D" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
     );
-    return value;
+}
+
+static inline void __insl(uint16_t port, void* buffer, size_t count) {
+    __asm__ __volatile__ (
+        "rep insl"
+        : "+D" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
+    );
+}
+
+static inline void __outsb(uint16_t port, const void* buffer, size_t count) {
+    __asm__ __volatile__ (
+        "rep outsb"
+        : "+S" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
+    );
+}
+
+static inline void __outsw(uint16_t port, const void* buffer, size_t count) {
+    __asm__ __volatile__ (
+        "rep outsw"
+        : "+S" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
+    );
+}
+
+static inline void __outsl(uint16_t port, const void* buffer, size_t count) {
+    __asm__ __volatile__ (
+        "rep outsl"
+        : "+S" (buffer), "+c" (count)
+        : "d" (port)
+        : "memory"
+    );
+}
+
+//One naturally aligned load or store each(the 64 bit ones are split in two on i386)
+static inline uint8_t __mmio_read8(const volatile void* addr) {
+    return *(const volatile uint8_t*)addr;
+}
+
+static inline uint16_t __mmio_read16(const volatile void* addr) {
+    return *(const volatile uint16_t*)addr;
+}
+
+static inline uint32_t __mmio_read32(const volatile void* addr) {
+    return *(const volatile uint32_t*)addr;
+}
+
+static inline uint64_t __mmio_read64(const volatile void* addr) {
+    return *(const volatile uint64_t*)addr;
+}
+
+static inline void __mmio_write8(volatile void* addr, uint8_t value) {
+    *(volatile uint8_t*)addr = value;
+}
+
+static inline void __mmio_write16(volatile void* addr, uint16_t value) {
+    *(volatile uint16_t*)addr = value;
+}
+
+static inline void __mmio_write32(volatile void* addr, uint32_t value) {
+    *(volatile uint32_t*)addr = value;
+}
+
+static inline void __mmio_write64(volatile void* addr, uint64_t value) {
+    *(volatile uint64_t*)addr = value;
+}
+
+#else
+
+//=================Mock=================
+
+/*
+@ A device claims [base, base + size) of a space, read and write get the offset into that range and the
+@ access width in bytes(1, 2, 4 or 8). MMIO addresses are only compared, never dereferenced, so a mock
+@ device can sit at its real physical address.
+*/
+typedef struct portio_device {
+    uint8_t space; //PORTIO_SPACE_*
+    uint64_t base;
+    uint64_t size;
+    uint64_t (*read)(struct portio_device* dev, uint64_t offset, uint8_t width);
+    void (*write)(struct portio_device* dev, uint64_t offset, uint8_t width, uint64_t value);
+    void* ctx;
+    struct portio_device* next;
+} portio_device_t;
+
+extern portio_device_t* portio_devices;
+
+//Adds a device, later ones win where ranges overlap
+static inline void portio_mock_attach(portio_device_t* dev) {
+    dev->next = portio_devices;
+    portio_devices = dev;
+}
+
+static inline void portio_mock_detach(portio_device_t* dev) {
+    for (portio_device_t** link = &portio_devices; *link != NULL; link = &(*link)->next) {
+        if (*link == dev) {
+            *link = dev->next;
+            return;
+        }
+    }
+}
+
+static inline portio_device_t* __portio_mock_find(uint8_t space, uint64_t addr) {
+    for (portio_device_t* dev = portio_devices; dev != NULL; dev = dev->next) {
+        if (dev->space == space && addr >= dev->base && addr - dev->base < dev->size) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+static inline uint64_t __portio_mock_read(uint8_t space, uint64_t addr, uint8_t width) {
+    portio_device_t* dev = __portio_mock_find(space, addr);
+    uint64_t mask = width == 8 ? UINT64_MAX : (1ull << (width * 8)) - 1;
+    if (dev == NULL || dev->read == NULL) {
+        return mask;
+    }
+    return dev->read(dev, addr - dev->base, width) & mask;
+}
+
+static inline void __portio_mock_write(uint8_t space, uint64_t addr, uint8_t width, uint64_t value) {
+    portio_device_t* dev = __portio_mock_find(space, addr);
+    if (dev != NULL && dev->write != NULL) {
+        dev->write(dev, addr - dev->base, width, value);
+    }
+}
+
+static inline void __portio_mock_ins(uint16_t port, void* buffer, size_t count, uint8_t width) {
+    uint8_t* dest = (uint8_t*)buffer;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = __portio_mock_read(PORTIO_SPACE_PORT, port, width);
+        for (uint8_t b = 0; b < width; b++) {
+            *dest++ = (uint8_t)(value >> (b * 8));
+        }
+    }
+}
+
+static inline void __portio_mock_outs(uint16_t port, const void* buffer, size_t count, uint8_t width) {
+    const uint8_t* src = (const uint8_t*)buffer;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = 0;
+        for (uint8_t b = 0; b < width; b++) {
+            value |= (uint64_t)*src++ << (b * 8);
+        }
+        __portio_mock_write(PORTIO_SPACE_PORT, port, width, value);
+    }
+}
+
+#define __outb(port, value) __portio_mock_write(PORTIO_SPACE_PORT, (port), 1, (uint8_t)(value))
+#define __outw(port, value) __portio_mock_write(PORTIO_SPACE_PORT, (port), 2, (uint16_t)(value))
+#define __outl(port, value) __portio_mock_write(PORTIO_SPACE_PORT, (port), 4, (uint32_t)(value))
+#define __inb(port) ((uint8_t)__portio_mock_read(PORTIO_SPACE_PORT, (port), 1))
+#define __inw(port) ((uint16_t)__portio_mock_read(PORTIO_SPACE_PORT, (port), 2))
+#define __inl(port) ((uint32_t)__portio_mock_read(PORTIO_SPACE_PORT, (port), 4))
+
+#define __insb(port, buffer, count) __portio_mock_ins((port), (buffer), (count), 1)
+#define __insw(port, buffer, count) __portio_mock_ins((port), (buffer), (count), 2)
+#define __insl(port, buffer, count) __portio_mock_ins((port), (buffer), (count), 4)
+#define __outsb(port, buffer, count) __portio_mock_outs((port), (buffer), (count), 1)
+#define __outsw(port, buffer, count) __portio_mock_outs((port), (buffer), (count), 2)
+#define __outsl(port, buffer, count) __portio_mock_outs((port), (buffer), (count), 4)
+
+#define __mmio_read8(addr) ((uint8_t)__portio_mock_read(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 1))
+#define __mmio_read16(addr) ((uint16_t)__portio_mock_read(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 2))
+#define __mmio_read32(addr) ((uint32_t)__portio_mock_read(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 4))
+#define __mmio_read64(addr) __portio_mock_read(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 8)
+#define __mmio_write8(addr, value) __portio_mock_write(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 1, (uint8_t)(value))
+#define __mmio_write16(addr, value) __portio_mock_write(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 2, (uint16_t)(value))
+#define __mmio_write32(addr, value) __portio_mock_write(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 4, (uint32_t)(value))
+#define __mmio_write64(addr, value) __portio_mock_write(PORTIO_SPACE_MMIO, (uintptr_t)(addr), 8, (uint64_t)(value))
+
+#endif // PORTIO_MOCK
+
+/*
+@ Byte length versions for buffers that aren't a multiple of the port width(e.g. an odd ATA PIO transfer):
+@ the whole values go through rep ins/outs, the rest through one more in/out. Reads drop the bytes past
+@ length, writes pad them with zeros, the device always sees whole values.
+@ Misaligned buffers are fine, x86 string I/O doesn't need aligned memory(it is only slower when a value
+@ straddles a cache line).
+*/
+
+static inline void __insw_bytes(uint16_t port, void* buffer, size_t length) {
+    uint8_t* tail = (uint8_t*)buffer + (length & ~(size_t)1);
+    __insw(port, buffer, length / 2);
+    if (length & 1) {
+        *tail = (uint8_t)__inw(port);
+    }
+}
+
+static inline void __insl_bytes(uint16_t port, void* buffer, size_t length) {
+    uint8_t* tail = (uint8_t*)buffer + (length & ~(size_t)3);
+    __insl(port, buffer, length / 4);
+    if (length & 3) {
+        uint32_t value = __inl(port);
+        for (size_t i = 0; i < (length & 3); i++) {
+            tail[i] = (uint8_t)(value >> (i * 8));
+        }
+    }
+}
+
+static inline void __outsw_bytes(uint16_t port, const void* buffer, size_t length) {
+    const uint8_t* tail = (const uint8_t*)buffer + (length & ~(size_t)1);
+    __outsw(port, buffer, length / 2);
+    if (length & 1) {
+        __outw(port, *tail);
+    }
+}
+
+static inline void __outsl_bytes(uint16_t port, const void* buffer, size_t length) {
+    const uint8_t* tail = (const uint8_t*)buffer + (length & ~(size_t)3);
+    __outsl(port, buffer, length / 4);
+    if (length & 3) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < (length & 3); i++) {
+            value |= (uint32_t)tail[i] << (i * 8);
+        }
+        __outl(port, value);
+    }
+}
+
+#ifdef PORTIO_TRACE
+
+//=================Tracer=================
+
+//Number of (call site, port or address) pairs that can be tracked, has to be a power of 2, can be overriden
+#ifndef PORTIO_TRACE_ENTRIES
+#define PORTIO_TRACE_ENTRIES 1024
+#endif
+
+STATIC_ASSERT((PORTIO_TRACE_ENTRIES & (PORTIO_TRACE_ENTRIES - 1)) == 0, "PORTIO_TRACE_ENTRIES must be a power of 2");
+
+typedef struct {
+    volatile uint8_t state; //0 free, 1 being claimed, 2 in use
+    uint8_t space;          //PORTIO_SPACE_*
+    uint64_t addr;
+    const char* site;
+    uint64_t calls;
+    uint64_t reads;         //values read(a string read of n values counts n)
+    uint64_t writes;
+} portio_trace_entry_t;
+
+extern portio_trace_entry_t portio_trace_table[PORTIO_TRACE_ENTRIES];
+extern volatile uint64_t portio_trace_dropped;
+
+void portio_trace_dump(uint32_t n);
+void portio_trace_reset(void);
+
+//Only the address is hashed, so every call site of a port or register ends up in one probe chain
+static inline uint32_t __portio_trace_hash(uint8_t space, uint64_t addr) {
+    uint64_t key = addr << 1 | space;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 40) & (PORTIO_TRACE_ENTRIES - 1);
+}
+
+/*
+@ Finds(or claims) the entry of a call site and address, NULL if the table is full
+@ Slots another CPU(or an interrupted claim on this one) is still filling in are skipped, not waited for, so
+@ an IRQ handler doing port I/O can't spin here. Two CPUs claiming the same pair at the same moment may end
+@ up with an entry each, portio_trace_dump then lists both.
+*/
+static inline portio_trace_entry_t* __portio_trace_find(uint8_t space, uint64_t addr, const char* site) {
+    uint32_t i = __portio_trace_hash(space, addr);
+    for (uint32_t probe = 0; probe < PORTIO_TRACE_ENTRIES; probe++, i = (i + 1) & (PORTIO_TRACE_ENTRIES - 1)) {
+        portio_trace_entry_t* e = &portio_trace_table[i];
+        uint8_t state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+        if (state == 0) {
+            uint8_t expected = 0;
+            if (__atomic_compare_exchange_n(&e->state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                e->space = space;
+                e->addr = addr;
+                e->site = site;
+                __atomic_store_n(&e->state, 2, __ATOMIC_RELEASE);
+                return e;
+            }
+            state = expected;
+        }
+        if (state == 2 && e->addr == addr && e->space == space && cur_loc_equal(e->site, site)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+//Counts one accessor call that moved count values
+static inline void portio_trace_record(uint8_t space, uint64_t addr, int write, uint64_t count, const char* site) {
+    portio_trace_entry_t* e = __portio_trace_find(space, addr, site);
+    if (e == NULL) {
+        __atomic_fetch_add(&portio_trace_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_fetch_add(&e->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(write ? &e->writes : &e->reads, count, __ATOMIC_RELAXED);
+}
+
+#define __PORTIO_IN(fn, port) ({ \
+    uint16_t __port = (port); \
+    portio_trace_record(PORTIO_SPACE_PORT, __port, 0, 1, __CUR_LOC); \
+    fn(__port); \
+})
+
+#define __PORTIO_OUT(fn, port, value) ({ \
+    uint16_t __port = (port); \
+    portio_trace_record(PORTIO_SPACE_PORT, __port, 1, 1, __CUR_LOC); \
+    fn(__port, (value)); \
+})
+
+#define __PORTIO_STRING(fn, write, size, port, buffer, count) ({ \
+    uint16_t __port = (port); \
+    size_t __count = (count); \
+    portio_trace_record(PORTIO_SPACE_PORT, __port, (write), (__count + (size) - 1) / (size), __CUR_LOC); \
+    fn(__port, (buffer), __count); \
+})
+
+#define __MMIO_READ(fn, addr) ({ \
+    const volatile void* __addr = (addr); \
+    portio_trace_record(PORTIO_SPACE_MMIO, (uintptr_t)__addr, 0, 1, __CUR_LOC); \
+    fn(__addr); \
+})
+
+#define __MMIO_WRITE(fn, addr, value) ({ \
+    volatile void* __addr = (addr); \
+    portio_trace_record(PORTIO_SPACE_MMIO, (uintptr_t)__addr, 1, 1, __CUR_LOC); \
+    fn(__addr, (value)); \
+})
+
+//=================Accessors=================
+
+#define outb(port, value) __PORTIO_OUT(__outb, port, value)
+#define inb(port) __PORTIO_IN(__inb, port)
+#define outw(port, value) __PORTIO_OUT(__outw, port, value)
+#define inw(port) __PORTIO_IN(__inw, port)
+#define outl(port, value) __PORTIO_OUT(__outl, port, value)
+#define inl(port) __PORTIO_IN(__inl, port)
+#define io_wait() __PORTIO_OUT(__outb, 0x80, 0)
+
+#define insb(port, buffer, count) __PORTIO_STRING(__insb, 0, 1, port, buffer, count)
+#define insw(port, buffer, count) __PORTIO_STRING(__insw, 0, 1, port, buffer, count)
+#define insl(port, buffer, count) __PORTIO_STRING(__insl, 0, 1, port, buffer, count)
+#define outsb(port, buffer, count) __PORTIO_STRING(__outsb, 1, 1, port, buffer, count)
+#define outsw(port, buffer, count) __PORTIO_STRING(__outsw, 1, 1, port, buffer, count)
+#define outsl(port, buffer, count) __PORTIO_STRING(__outsl, 1, 1, port, buffer, count)
+#define insw_bytes(port, buffer, length) __PORTIO_STRING(__insw_bytes, 0, 2, port, buffer, length)
+#define insl_bytes(port, buffer, length) __PORTIO_STRING(__insl_bytes, 0, 4, port, buffer, length)
+#define outsw_bytes(port, buffer, length) __PORTIO_STRING(__outsw_bytes, 1, 2, port, buffer, length)
+#define outsl_bytes(port, buffer, length) __PORTIO_STRING(__outsl_bytes, 1, 4, port, buffer, length)
+
+#define mmio_read8(addr) __MMIO_READ(__mmio_read8, addr)
+#define mmio_read16(addr) __MMIO_READ(__mmio_read16, addr)
+#define mmio_read32(addr) __MMIO_READ(__mmio_read32, addr)
+#define mmio_read64(addr) __MMIO_READ(__mmio_read64, addr)
+#define mmio_write8(addr, value) __MMIO_WRITE(__mmio_write8, addr, value)
+#define mmio_write16(addr, value) __MMIO_WRITE(__mmio_write16, addr, value)
+#define mmio_write32(addr, value) __MMIO_WRITE(__mmio_write32, addr, value)
+#define mmio_write64(addr, value) __MMIO_WRITE(__mmio_write64, addr, value)
+
+#else
+
+//=================Accessors=================
+
+//Outputs a byte(1 bytes) to an I/O port
+static inline void outb(uint16_t port, uint8_t value) {
+    __outb(port, value);
+}
+
+//Reads a byte(1 bytes) from an I/O port
+static inline uint8_t inb(uint16_t port) {
+    return __inb(port);
+}
+
+//Outputs a word(2 bytes) to an I/O port
+static inline void outw(uint16_t port, uint16_t value) {
+    __outw(port, value);
+}
+
+//Reads a word(2 bytes) from an I/O port
+static inline uint16_t inw(uint16_t port) {
+    return __inw(port);
+}
+
+//Outputs a long(4 bytes) to an I/O port
+static inline void outl(uint16_t port, uint32_t value) {
+    __outl(port, value);
+}
+
+//Reads a long(4 bytes) from an I/O port
+static inline uint32_t inl(uint16_t port) {
+    return __inl(port);
 }
 
 //Waits for the I/O bus to be available
 static inline void io_wait() {
-    outb(0x80, 0); //0x80 is unused port
+    __outb(0x80, 0); //0x80 is unused port
 }
 
+//Reads count bytes from an I/O port into buffer
+static inline void insb(uint16_t port, void* buffer, size_t count) {
+    __insb(port, buffer, count);
+}
+
+//Reads count words from an I/O port into buffer
+static inline void insw(uint16_t port, void* buffer, size_t count) {
+    __insw(port, buffer, count);
+}
+
+//Reads count longs from an I/O port into buffer
+static inline void insl(uint16_t port, void* buffer, size_t count) {
+    __insl(port, buffer, count);
+}
+
+//Outputs count bytes from buffer to an I/O port
+static inline void outsb(uint16_t port, const void* buffer, size_t count) {
+    __outsb(port, buffer, count);
+}
+
+//Outputs count words from buffer to an I/O port
+static inline void outsw(uint16_t port, const void* buffer, size_t count) {
+    __outsw(port, buffer, count);
+}
+
+//Outputs count longs from buffer to an I/O port
+static inline void outsl(uint16_t port, const void* buffer, size_t count) {
+    __outsl(port, buffer, count);
+}
+
+//Reads length bytes from a 16 bit port
+static inline void insw_bytes(uint16_t port, void* buffer, size_t length) {
+    __insw_bytes(port, buffer, length);
+}
+
+//Reads length bytes from a 32 bit port
+static inline void insl_bytes(uint16_t port, void* buffer, size_t length) {
+    __insl_bytes(port, buffer, length);
+}
+
+//Outputs length bytes to a 16 bit port
+static inline void outsw_bytes(uint16_t port, const void* buffer, size_t length) {
+    __outsw_bytes(port, buffer, length);
+}
+
+//Outputs length bytes to a 32 bit port
+static inline void outsl_bytes(uint16_t port, const void* buffer, size_t length) {
+    __outsl_bytes(port, buffer, length);
+}
+
+//Reads a byte from a device register, addr has to be mapped uncached
+static inline uint8_t mmio_read8(const volatile void* addr) {
+    return __mmio_read8(addr);
+}
+
+static inline uint16_t mmio_read16(const volatile void* addr) {
+    return __mmio_read16(addr);
+}
+
+static inline uint32_t mmio_read32(const volatile void* addr) {
+    return __mmio_read32(addr);
+}
+
+static inline uint64_t mmio_read64(const volatile void* addr) {
+    return __mmio_read64(addr);
+}
+
+//Writes a byte to a device register, addr has to be mapped uncached
+static inline void mmio_write8(volatile void* addr, uint8_t value) {
+    __mmio_write8(addr, value);
+}
+
+static inline void mmio_write16(volatile void* addr, uint16_t value) {
+    __mmio_write16(addr, value);
+}
+
+static inline void mmio_write32(volatile void* addr, uint32_t value) {
+    __mmio_write32(addr, value);
+}
+
+static inline void mmio_write64(volatile void* addr, uint64_t value) {
+    __mmio_write64(addr, value);
+}
+
+#endif // PORTIO_TRACE
+
+#ifdef PORTIO_IMPL
+    #ifdef PORTIO_MOCK
+        portio_device_t* portio_devices;
+    #endif
+
+    #ifdef PORTIO_TRACE
+        #include "../../utils/logger.h"
+
+        portio_trace_entry_t portio_trace_table[PORTIO_TRACE_ENTRIES];
+        volatile uint64_t portio_trace_dropped;
+
+        static inline uint64_t __portio_trace_total(const portio_trace_entry_t* e) {
+            return e->reads + e->writes;
+        }
+
+        //Sum of every call site's accesses to the address of entry index, 0 if an earlier entry has the same address
+        static inline uint64_t __portio_trace_addr_total(uint32_t index) {
+            const portio_trace_entry_t* e = &portio_trace_table[index];
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < PORTIO_TRACE_ENTRIES; i++) {
+                const portio_trace_entry_t* other = &portio_trace_table[i];
+                if (other->state != 2 || other->space != e->space || other->addr != e->addr) {
+                    continue;
+                }
+                if (i < index) {
+                    return 0;
+                }
+                total += __portio_trace_total(other);
+            }
+            return total;
+        }
+
+        //Prints the n busiest (call site, address) pairs and the n busiest addresses through the logger
+        void portio_trace_dump(uint32_t n) {
+            uint64_t last_total = UINT64_MAX;
+            uint32_t last = UINT32_MAX;
+
+            log_info("%-48s %-4s %18s %10s %10s %10s\n", "site", "type", "port/address", "calls", "reads", "writes");
+
+            //selection sort by (accesses descending, index ascending), the table is not reordered
+            for (uint32_t printed = 0; printed < n; printed++) {
+                uint32_t best = UINT32_MAX;
+                for (uint32_t i = 0; i < PORTIO_TRACE_ENTRIES; i++) {
+                    portio_trace_entry_t* e = &portio_trace_table[i];
+                    uint64_t total = __portio_trace_total(e);
+                    if (e->state != 2 || total == 0) {
+                        continue;
+                    }
+                    if (total > last_total || (total == last_total && i <= last)) {
+                        continue;
+                    }
+                    if (best == UINT32_MAX || total > __portio_trace_total(&portio_trace_table[best])) {
+                        best = i;
+                    }
+                }
+                if (best == UINT32_MAX) {
+                    break;
+                }
+
+                portio_trace_entry_t* e = &portio_trace_table[best];
+                log_info("%-48s %-4s %18llx %10llu %10llu %10llu\n",
+                         e->site, e->space == PORTIO_SPACE_PORT ? "port" : "mmio", (unsigned long long)e->addr,
+                         (unsigned long long)e->calls, (unsigned long long)e->reads, (unsigned long long)e->writes);
+                last_total = __portio_trace_total(e);
+                last = best;
+            }
+
+            log_info("%-4s %18s %10s\n", "type", "port/address", "accesses");
+            last_total = UINT64_MAX;
+            last = UINT32_MAX;
+            for (uint32_t printed = 0; printed < n; printed++) {
+                uint32_t best = UINT32_MAX;
+                uint64_t best_total = 0;
+                for (uint32_t i = 0; i < PORTIO_TRACE_ENTRIES; i++) {
+                    if (portio_trace_table[i].state != 2) {
+                        continue;
+                    }
+                    uint64_t total = __portio_trace_addr_total(i);
+                    if (total == 0 || total > last_total || (total == last_total && i <= last)) {
+                        continue;
+                    }
+                    if (best == UINT32_MAX || total > best_total) {
+                        best = i;
+                        best_total = total;
+                    }
+                }
+                if (best == UINT32_MAX) {
+                    break;
+                }
+
+                portio_trace_entry_t* e = &portio_trace_table[best];
+                log_info("%-4s %18llx %10llu\n",
+                         e->space == PORTIO_SPACE_PORT ? "port" : "mmio", (unsigned long long)e->addr,
+                         (unsigned long long)best_total);
+                last_total = best_total;
+                last = best;
+            }
+
+            if (portio_trace_dropped != 0) {
+                log_warn("%llu accesses weren't recorded, raise PORTIO_TRACE_ENTRIES\n",
+                         (unsigned long long)portio_trace_dropped);
+            }
+        }
+
+        //Clears all counters, the (call site, address) pairs stay claimed
+        void portio_trace_reset(void) {
+            for (uint32_t i = 0; i < PORTIO_TRACE_ENTRIES; i++) {
+                __atomic_store_n(&portio_trace_table[i].calls, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&portio_trace_table[i].reads, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&portio_trace_table[i].writes, 0, __ATOMIC_RELAXED);
+            }
+            portio_trace_dropped = 0;
+        }
+    #endif
+#endif
+
 #endif // __PORTIO_H__
\ No newline at end of file
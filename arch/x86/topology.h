@@ -0,0 +1,319 @@
+/*
+@ KrnlAid CPU topology
+@ Every logical CPU's APIC ID is made of bit fields: | package | die | core(+module/tile) | SMT thread |
+@ topology_probe() reads the field widths once from leaf 0x1F, 0xB or the legacy leaves(1/4 on Intel,
+@ 0x80000008/0x8000001E on AMD) plus how many IDs share the last level cache, after that
+@ any APIC ID(e.g. straight from the MADT) decodes without running CPUID on that CPU.
+@ The topology table keeps every CPU's IDs and masks of its SMT siblings, the CPUs sharing its LLC
+@ and the CPUs in its package, for the scheduler's placement decisions.
+@
+@ How to use:
+@ 1, static topology_t topo; topology_init(&topo, cpuid_native);
+@ 2, for every CPU: topology_add_cpu(&topo, cpu, apic_id)(apic_id from the MADT, or topology_apic_id(cpuid_native) on that CPU)
+@ 3, topology_smt_siblings(&topo, cpu), topology_llc_siblings(&topo, cpu), topology_shares_llc(&topo, a, b)
+*/
+
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <stdint.h>
+#include "cpuid.h"
+
+//Maximum number of logical CPUs, can be overriden
+#ifndef TOPOLOGY_MAX_CPUS
+#define TOPOLOGY_MAX_CPUS 256
+#endif
+
+//=================CPU masks=================
+
+typedef struct {
+    uint64_t bits[(TOPOLOGY_MAX_CPUS + 63) / 64];
+} cpumask_t;
+
+static inline void cpumask_clear_all(cpumask_t* mask) {
+    for (uint32_t i = 0; i < (TOPOLOGY_MAX_CPUS + 63) / 64; i++) {
+        mask->bits[i] = 0;
+    }
+}
+
+static inline void cpumask_set(cpumask_t* mask, uint32_t cpu) {
+    mask->bits[cpu >> 6] |= 1ull << (cpu & 63);
+}
+
+static inline int cpumask_test(const cpumask_t* mask, uint32_t cpu) {
+    return (mask->bits[cpu >> 6] >> (cpu & 63)) & 1;
+}
+
+//Number of CPUs in a mask
+static inline uint32_t cpumask_weight(const cpumask_t* mask) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < (TOPOLOGY_MAX_CPUS + 63) / 64; i++) {
+        n += __builtin_popcountll(mask->bits[i]);
+    }
+    return n;
+}
+
+//Iterates over every CPU in a mask
+#define for_each_cpu_in(cpu, mask) \
+    for (uint32_t cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) \
+        if (cpumask_test((mask), cpu))
+
+//=================APIC ID decoding=================
+
+//Widths of the APIC ID fields, as shifts from bit 0
+typedef struct {
+    uint8_t smt_shift;  //above the SMT thread ID
+    uint8_t core_shift; //above the core ID(modules and tiles are folded into the core ID)
+    uint8_t die_shift;  //above the die ID(0 bits wide without leaf 0x1F dies), the rest is the package ID
+    uint8_t llc_shift;  //CPUs whose APIC IDs match above this share the last level cache
+} topology_shifts_t;
+
+typedef struct {
+    uint32_t apic_id;
+    uint32_t package;
+    uint32_t die;       //within the package
+    uint32_t core;      //within the die
+    uint32_t smt;       //within the core
+    uint32_t llc;       //APIC ID >> llc_shift, equal for CPUs sharing the last level cache
+} cpu_ids_t;
+
+//Smallest n with (1 << n) >= count
+static inline uint8_t __topology_bits(uint32_t count) {
+    return count <= 1 ? 0 : (uint8_t)(32 - __builtin_clz(count - 1));
+}
+
+//Reads the field widths from leaf 0x1F or 0xB, returns 0 if the leaf doesn't enumerate anything
+static inline int __topology_extended(topology_shifts_t* shifts, cpuid_fn_t source, uint32_t leaf) {
+    uint32_t regs[4];
+    uint8_t core_shift = 0, last_shift = 0;
+    int smt_seen = 0, core_seen = 0;
+
+    for (uint32_t level = 0; level < 8; level++) {
+        uint32_t type;
+        uint8_t shift;
+        source(leaf, level, regs);
+        type = CPUID_FIELD(regs[2], CPUID_EXTENDENDED_TOPOLOGY_ECX_LEVEL_TYPE);
+        if (type == CPUID_EXTENDENDED_TOPOLOGY_LEVEL_INVALID || regs[1] == 0) {
+            break;
+        }
+        shift = (uint8_t)CPUID_FIELD(regs[0], CPUID_EXTENDENDED_TOPOLOGY_EAX_SHIFT);
+        switch (type) {
+            case CPUID_EXTENDENDED_TOPOLOGY_LEVEL_SMT:
+                shifts->smt_shift = shift;
+                smt_seen = 1;
+                break;
+            case CPUID_EXTENDENDED_TOPOLOGY_LEVEL_CORE:
+            case CPUID_EXTENDENDED_TOPOLOGY_LEVEL_MODULE:
+            case CPUID_EXTENDENDED_TOPOLOGY_LEVEL_TILE:
+                core_shift = shift;
+                core_seen = 1;
+                break;
+        }
+        last_shift = shift;
+    }
+    if (!smt_seen && !core_seen) {
+        return 0;
+    }
+    if (!smt_seen) {
+        shifts->smt_shift = 0;
+    }
+    shifts->core_shift = core_seen ? core_shift : shifts->smt_shift;
+    //the last level's shift gives the package ID, dies and any newer level types in between make up the die ID
+    shifts->die_shift = last_shift;
+    return 1;
+}
+
+//Field widths from leaf 1/4(Intel) or 0x80000008/0x8000001E(AMD), CPUs without leaf 0xB
+static inline void __topology_legacy(topology_shifts_t* shifts, cpuid_fn_t source, uint32_t max_leaf, uint32_t max_extended) {
+    uint32_t regs[4];
+    uint32_t logical = 1, cores = 1;
+    uint32_t ext_ecx = 0;
+
+    source(CPUID_CPU_INFO, 0, regs);
+    if (regs[3] & (CPUID_CPU_INFO_EDX_HTT)) {
+        logical = CPUID_FIELD(regs[1], CPUID_CPU_INFO_EBX_MAX_LOGPROC);
+    }
+    if (max_extended >= CPUID_EXTENDED_SIGNATURE) {
+        source(CPUID_EXTENDED_SIGNATURE, 0, regs);
+        ext_ecx = regs[2];
+    }
+
+    if (max_extended >= CPUID_PHYS_ADDR_SIZE && (ext_ecx & (CPUID_EXTENDED_SIGNATURE_ECX_CMP_LEGACY | CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT))) {
+        //AMD: the core ID width is given directly
+        uint8_t core_bits;
+        uint32_t threads = 1;
+        source(CPUID_PHYS_ADDR_SIZE, 0, regs);
+        core_bits = (uint8_t)CPUID_FIELD(regs[2], CPUID_PHYS_ADDR_SIZE_ECX_APIC_ID_SIZE);
+        if (core_bits == 0) {
+            core_bits = __topology_bits(CPUID_FIELD(regs[2], CPUID_PHYS_ADDR_SIZE_ECX_CORES) + 1);
+        }
+        if (max_extended >= CPUID_AMD_PROCESSOR_TOPOLOGY && (ext_ecx & (CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT))) {
+            source(CPUID_AMD_PROCESSOR_TOPOLOGY, 0, regs);
+            threads = CPUID_FIELD(regs[1], CPUID_AMD_PROCESSOR_TOPOLOGY_EBX_THREADS_PER_CORE) + 1;
+        }
+        shifts->smt_shift = __topology_bits(threads);
+        shifts->core_shift = core_bits;
+        shifts->die_shift = core_bits;
+        return;
+    }
+
+    if (max_leaf >= CPUID_CACHE_PARAMS) {
+        source(CPUID_CACHE_PARAMS, 0, regs);
+        if (CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_CACHE_TYPE) != CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_NULL) {
+            cores = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_MAX_CORES_IN_PACKAGE) + 1;
+        }
+    }
+    if (logical < cores) {
+        logical = cores;
+    }
+    shifts->smt_shift = __topology_bits(logical / cores);
+    shifts->core_shift = __topology_bits(logical);
+    shifts->die_shift = shifts->core_shift;
+}
+
+//How many APIC IDs share the last level cache, from leaf 4 or 0x8000001D
+static inline uint8_t __topology_llc_shift(cpuid_fn_t source, uint32_t leaf) {
+    uint32_t regs[4];
+    uint32_t level = 0, sharing = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t l;
+        source(leaf, i, regs);
+        if (CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_CACHE_TYPE) == CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_NULL) {
+            break;
+        }
+        l = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_CACHE_LEVEL);
+        if (l >= level) {
+            level = l;
+            sharing = CPUID_FIELD(regs[0], CPUID_CACHE_PARAMS_EAX_MAX_PROC_SHARING) + 1;
+        }
+    }
+    return level == 0 ? 0xFF : __topology_bits(sharing);
+}
+
+//Reads the APIC ID field widths, they are the same on every CPU
+static inline void topology_probe(topology_shifts_t* shifts, cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t max_leaf, max_extended, ext_ecx = 0;
+    uint8_t llc_shift = 0xFF;
+
+    source(CPUID_VENDOR, 0, regs);
+    max_leaf = regs[0];
+    source(CPUID_HIGHEST_EXTENDED, 0, regs);
+    max_extended = (regs[0] & 0x80000000) ? regs[0] : 0;
+    if (max_extended >= CPUID_EXTENDED_SIGNATURE) {
+        source(CPUID_EXTENDED_SIGNATURE, 0, regs);
+        ext_ecx = regs[2];
+    }
+
+    if (!(max_leaf >= CPUID_V2_EXTENDED_TOPOLOGY && __topology_extended(shifts, source, CPUID_V2_EXTENDED_TOPOLOGY)) &&
+        !(max_leaf >= CPUID_EXTENDENDED_TOPOLOGY && __topology_extended(shifts, source, CPUID_EXTENDENDED_TOPOLOGY))) {
+        __topology_legacy(shifts, source, max_leaf, max_extended);
+    }
+
+    if (max_extended >= CPUID_AMD_CACHE_PARAMS && (ext_ecx & (CPUID_EXTENDED_SIGNATURE_ECX_TOPOEXT))) {
+        llc_shift = __topology_llc_shift(source, CPUID_AMD_CACHE_PARAMS);
+    }
+    if (llc_shift == 0xFF && max_leaf >= CPUID_CACHE_PARAMS) {
+        llc_shift = __topology_llc_shift(source, CPUID_CACHE_PARAMS);
+    }
+    //without cache info assume the whole die shares it
+    shifts->llc_shift = llc_shift == 0xFF ? shifts->die_shift : llc_shift;
+}
+
+//The current CPU's APIC ID(x2APIC ID if leaf 0xB exists)
+static inline uint32_t topology_apic_id(cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t max_leaf;
+    source(CPUID_VENDOR, 0, regs);
+    max_leaf = regs[0];
+    if (max_leaf >= CPUID_EXTENDENDED_TOPOLOGY) {
+        source(CPUID_EXTENDENDED_TOPOLOGY, 0, regs);
+        if (regs[1] != 0) {
+            return regs[3];
+        }
+    }
+    source(CPUID_CPU_INFO, 0, regs);
+    return CPUID_FIELD(regs[1], CPUID_CPU_INFO_EBX_INIT_APIC_ID);
+}
+
+//Splits an APIC ID into package, die, core and thread IDs
+static inline void topology_decode(const topology_shifts_t* shifts, uint32_t apic_id, cpu_ids_t* ids) {
+    ids->apic_id = apic_id;
+    ids->smt = apic_id & ((1u << shifts->smt_shift) - 1);
+    ids->core = (apic_id & ((1u << shifts->core_shift) - 1)) >> shifts->smt_shift;
+    ids->die = (apic_id & ((1ull << shifts->die_shift) - 1)) >> shifts->core_shift;
+    ids->package = shifts->die_shift >= 32 ? 0 : apic_id >> shifts->die_shift;
+    ids->llc = shifts->llc_shift >= 32 ? 0 : apic_id >> shifts->llc_shift;
+}
+
+//=================Topology table=================
+
+typedef struct {
+    cpu_ids_t ids;
+    cpumask_t smt_siblings;     //including itself
+    cpumask_t llc_siblings;
+    cpumask_t package_siblings;
+} cpu_topology_t;
+
+typedef struct {
+    topology_shifts_t shifts;
+    cpumask_t present;
+    uint32_t count; //highest CPU number + 1
+    cpu_topology_t cpus[TOPOLOGY_MAX_CPUS];
+} topology_t;
+
+//Sets up an empty table
+static inline void topology_init(topology_t* topo, cpuid_fn_t source) {
+    topology_probe(&topo->shifts, source);
+    cpumask_clear_all(&topo->present);
+    topo->count = 0;
+}
+
+//Adds a logical CPU, links it with the CPUs already in the table
+static inline void topology_add_cpu(topology_t* topo, uint32_t cpu, uint32_t apic_id) {
+    cpu_topology_t* self = &topo->cpus[cpu];
+    topology_decode(&topo->shifts, apic_id, &self->ids);
+    cpumask_clear_all(&self->smt_siblings);
+    cpumask_clear_all(&self->llc_siblings);
+    cpumask_clear_all(&self->package_siblings);
+    cpumask_set(&topo->present, cpu);
+    if (cpu >= topo->count) {
+        topo->count = cpu + 1;
+    }
+
+    for_each_cpu_in(other, &topo->present) {
+        cpu_topology_t* o = &topo->cpus[other];
+        if (o->ids.package != self->ids.package) {
+            continue;
+        }
+        cpumask_set(&self->package_siblings, other);
+        cpumask_set(&o->package_siblings, cpu);
+        if (o->ids.llc == self->ids.llc) {
+            cpumask_set(&self->llc_siblings, other);
+            cpumask_set(&o->llc_siblings, cpu);
+        }
+        if (o->ids.die == self->ids.die && o->ids.core == self->ids.core) {
+            cpumask_set(&self->smt_siblings, other);
+            cpumask_set(&o->smt_siblings, cpu);
+        }
+    }
+}
+
+static inline const cpumask_t* topology_smt_siblings(const topology_t* topo, uint32_t cpu) {
+    return &topo->cpus[cpu].smt_siblings;
+}
+
+static inline const cpumask_t* topology_llc_siblings(const topology_t* topo, uint32_t cpu) {
+    return &topo->cpus[cpu].llc_siblings;
+}
+
+static inline const cpumask_t* topology_package_siblings(const topology_t* topo, uint32_t cpu) {
+    return &topo->cpus[cpu].package_siblings;
+}
+
+//Do two CPUs share the last level cache
+static inline int topology_shares_llc(const topology_t* topo, uint32_t a, uint32_t b) {
+    return cpumask_test(&topo->cpus[a].llc_siblings, b);
+}
+
+#endif // __TOPOLOGY_H__
\ No newline at end of file
@@ -0,0 +1,210 @@
+/*
+@ KrnlAid TSC clocksource
+@ The TSC is the cheapest clock there is(~20 cycles), as long as it is invariant(CPUID 0x80000007 EDX bit 8):
+@ it then ticks at a constant rate in every P-/C-state.
+@ The frequency comes from CPUID 0x15(exact), 0x16(base frequency, close) or tsc_calibrate() against a reference timer.
+@ Cycles convert to ns with a precomputed fixed point pair: ns = cycles * mult >> shift(no division on the read path).
+@
+@ How to use:
+@ 1, tsc_info_t tsc; if (!tsc_probe(&tsc, cpuid_native)) tsc_set_frequency(&tsc, tsc_calibrate(hpet_ns, 50000000), TSC_FREQ_CALIBRATED);
+@ 2, for a monotonic ns clock see arch/x86/tsc_clock.h
+*/
+
+#ifndef __TSC_H__
+#define __TSC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpuid.h"
+
+//Longest time between two tsc_clock_update calls(and longest duration tsc_cycles_to_ns converts), can be overriden
+#ifndef TSC_MAX_DELTA_SECONDS
+#define TSC_MAX_DELTA_SECONDS 600
+#endif
+
+//Calibration rounds, the one with the tightest bracketing wins
+#ifndef TSC_CALIBRATION_ROUNDS
+#define TSC_CALIBRATION_ROUNDS 3
+#endif
+
+#define TSC_NSEC_PER_SEC 1000000000ull
+
+//Reads the time stamp counter(not ordered against the surrounding instructions)
+static inline uint64_t rdtsc(void) {
+    uint32_t low, high;
+    __asm__ __volatile__ (
+        "rdtsc"
+        : "=a" (low), "=d" (high)
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+//Reads the time stamp counter after every earlier instruction completed(LFENCE is dispatch serializing on Intel and on AMD with DE_CFG[1] set)
+static inline uint64_t rdtsc_ordered(void) {
+    uint32_t low, high;
+    __asm__ __volatile__ (
+        "lfence\n\t"
+        "rdtsc"
+        : "=a" (low), "=d" (high)
+        :
+        : "memory"
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+//Reads the time stamp counter and TSC_AUX(usually the CPU number) after every earlier instruction completed
+//NOTE: later instructions may still start early, add an LFENCE after it when timing the end of a region
+static inline uint64_t rdtscp(uint32_t* aux) {
+    uint32_t low, high, c;
+    __asm__ __volatile__ (
+        "rdtscp"
+        : "=a" (low), "=d" (high), "=c" (c)
+        :
+        : "memory"
+    );
+    if (aux != NULL) {
+        *aux = c;
+    }
+    return ((uint64_t)high << 32) | low;
+}
+
+//=================Frequency=================
+
+enum tsc_freq_sources {
+    TSC_FREQ_UNKNOWN,
+    TSC_FREQ_CPUID_TSC,       //leaf 0x15, exact
+    TSC_FREQ_CPUID_FREQ_INFO, //leaf 0x16 base frequency, nominal
+    TSC_FREQ_CALIBRATED,      //measured against a reference timer
+    TSC_FREQ_EXTERNAL,        //given by the embedder(e.g. a hypervisor)
+};
+
+typedef struct {
+    uint64_t hz;
+    uint32_t mult;      //ns = cycles * mult >> shift
+    uint32_t shift;
+    uint8_t invariant;  //constant rate in every P-/C-state
+    uint8_t source;     //TSC_FREQ_*
+} tsc_info_t;
+
+/*
+@ Picks mult and shift for converting from Hz to to_hz so that up to max_seconds worth of cycles
+@ don't overflow 64 bits, with as much precision as that leaves
+*/
+static inline void tsc_calc_mult_shift(uint32_t* mult, uint32_t* shift, uint64_t from_hz, uint64_t to_hz, uint32_t max_seconds) {
+    uint64_t tmp = ((uint64_t)max_seconds * from_hz) >> 32;
+    uint32_t sftacc = 32;
+    uint32_t sft;
+
+    //bits the largest input needs above 32 are bits the multiplier can't use
+    while (tmp) {
+        tmp >>= 1;
+        sftacc--;
+    }
+    for (sft = 32; sft > 0; sft--) {
+        tmp = (to_hz << sft) + from_hz / 2;
+        tmp /= from_hz;
+        if ((tmp >> sftacc) == 0) {
+            break;
+        }
+    }
+    *mult = (uint32_t)tmp;
+    *shift = sft;
+}
+
+//Sets the frequency and the conversion factors
+static inline void tsc_set_frequency(tsc_info_t* tsc, uint64_t hz, uint8_t source) {
+    tsc->hz = hz;
+    tsc->source = source;
+    if (hz == 0) {
+        tsc->mult = 0;
+        tsc->shift = 0;
+        return;
+    }
+    tsc_calc_mult_shift(&tsc->mult, &tsc->shift, hz, TSC_NSEC_PER_SEC, TSC_MAX_DELTA_SECONDS);
+}
+
+//Reads invariance and, if CPUID reports it, the frequency, returns 0 if the frequency has to be calibrated
+static inline int tsc_probe(tsc_info_t* tsc, cpuid_fn_t source) {
+    uint32_t regs[4];
+    uint32_t max_leaf, max_extended;
+
+    tsc->invariant = 0;
+    tsc_set_frequency(tsc, 0, TSC_FREQ_UNKNOWN);
+
+    source(CPUID_VENDOR, 0, regs);
+    max_leaf = regs[0];
+    source(CPUID_HIGHEST_EXTENDED, 0, regs);
+    max_extended = (regs[0] & 0x80000000) ? regs[0] : 0;
+    if (max_extended >= CPUID_INVARIANT_TSC_AVAILABLE) {
+        source(CPUID_INVARIANT_TSC_AVAILABLE, 0, regs);
+        tsc->invariant = (regs[3] & (CPUID_INVARIANT_TSC_AVAILABLE_EDX_INVARIANT_TSC)) != 0;
+    }
+
+    //TSC = crystal * EBX / EAX
+    if (max_leaf >= CPUID_TSC) {
+        source(CPUID_TSC, 0, regs);
+        if (regs[0] != 0 && regs[1] != 0 && regs[2] != 0) {
+            tsc_set_frequency(tsc, (uint64_t)regs[2] * regs[1] / regs[0], TSC_FREQ_CPUID_TSC);
+            return 1;
+        }
+    }
+    //the TSC runs at the base frequency, which 0x16 only gives in MHz
+    if (max_leaf >= CPUID_CPU_FREQ_INFO) {
+        source(CPUID_CPU_FREQ_INFO, 0, regs);
+        if (CPUID_FIELD(regs[0], CPUID_CPU_FREQ_INFO_EAX_BASE_MHZ) != 0) {
+            tsc_set_frequency(tsc, (uint64_t)CPUID_FIELD(regs[0], CPUID_CPU_FREQ_INFO_EAX_BASE_MHZ) * 1000000, TSC_FREQ_CPUID_FREQ_INFO);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+@ Measures the TSC frequency in Hz against a reference clock in ns(PIT, HPET, ACPI PM timer...) over window_ns
+@ Every reference read is bracketed by two TSC reads, the round whose brackets were tightest
+@ (fewest interrupts/SMIs in between) is used.
+*/
+static inline uint64_t tsc_calibrate(uint64_t (*ref_ns)(void), uint64_t window_ns) {
+    uint64_t best_hz = 0, best_error = ~0ull;
+
+    for (int round = 0; round < TSC_CALIBRATION_ROUNDS; round++) {
+        uint64_t t0, t1, u0, u1, r0, r, cycles, ns, error;
+
+        //start right after the reference clock ticked, coarse timers would be off by a whole tick otherwise
+        r0 = ref_ns();
+        do {
+            t0 = rdtsc_ordered();
+            r = ref_ns();
+            t1 = rdtsc_ordered();
+        } while (r == r0);
+        r0 = r;
+
+        do {
+            u0 = rdtsc_ordered();
+            r = ref_ns();
+            u1 = rdtsc_ordered();
+        } while (r - r0 < window_ns);
+
+        cycles = (u0 / 2 + u1 / 2) - (t0 / 2 + t1 / 2);
+        ns = r - r0;
+        error = (t1 - t0) + (u1 - u0);
+        if (error < best_error) {
+            best_error = error;
+            //cycles * 10^9 / ns without overflowing
+            best_hz = (cycles / ns) * TSC_NSEC_PER_SEC + (cycles % ns) * TSC_NSEC_PER_SEC / ns;
+        }
+    }
+    return best_hz;
+}
+
+//Converts a duration, cycles has to be below TSC_MAX_DELTA_SECONDS worth
+static inline uint64_t tsc_cycles_to_ns(const tsc_info_t* tsc, uint64_t cycles) {
+    return (cycles * tsc->mult) >> tsc->shift;
+}
+
+//Converts a duration to cycles
+static inline uint64_t tsc_ns_to_cycles(const tsc_info_t* tsc, uint64_t ns) {
+    return (ns / TSC_NSEC_PER_SEC) * tsc->hz + (ns % TSC_NSEC_PER_SEC) * tsc->hz / TSC_NSEC_PER_SEC;
+}
+
+#endif // __TSC_H__
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+@ KrnlAid TSC monotonic clock
+@ A tsc_clock_t turns the TSC into nanoseconds since boot, readers are lock free through a seqcount.
+@ It lives apart from tsc.h so that low level users of rdtsc()(lockstat.h, spinlock.h) don't pull in seqlock.h.
+@
+@ How to use:
+@ 1, probe the frequency with tsc.h(tsc_probe or tsc_calibrate)
+@ 2, tsc_clock_t clock; tsc_clock_init(&clock, &tsc, 0);
+@ 3, call tsc_clock_update(&clock) at least every TSC_MAX_DELTA_SECONDS / 2 seconds(e.g. from the timer tick, on one CPU)
+@ 4, uint64_t now = tsc_clock_read(&clock);
+*/
+
+#ifndef __TSC_CLOCK_H__
+#define __TSC_CLOCK_H__
+
+#include <stdint.h>
+#include "tsc.h"
+#include "../../utils/seqlock.h"
+
+//=================Monotonic clock=================
+
+/*
+@ ns = base_ns + (base_frac + (rdtsc - base_cycles) * mult) >> shift
+@ base_frac keeps the sub-ns remainder across updates, so an update never moves the clock backwards.
+*/
+typedef struct {
+    seqcount_t seq;
+    uint64_t base_cycles;
+    uint64_t base_ns;
+    uint64_t base_frac;
+    uint32_t mult;
+    uint32_t shift;
+} tsc_clock_t;
+
+//Starts the clock at start_ns
+static inline void tsc_clock_init(tsc_clock_t* clock, const tsc_info_t* tsc, uint64_t start_ns) {
+    clock->seq.sequence = 0;
+    clock->mult = tsc->mult;
+    clock->shift = tsc->shift;
+    clock->base_ns = start_ns;
+    clock->base_frac = 0;
+    clock->base_cycles = rdtsc_ordered();
+}
+
+//Nanoseconds since the clock's start, lock free and never goes backwards on one CPU
+static inline uint64_t tsc_clock_read(const tsc_clock_t* clock) {
+    uint32_t seq;
+    uint64_t now, base_cycles, base_ns, base_frac;
+    uint32_t mult, shift;
+
+    do {
+        seq = read_seqcount_begin(&clock->seq);
+        base_cycles = clock->base_cycles;
+        base_ns = clock->base_ns;
+        base_frac = clock->base_frac;
+        mult = clock->mult;
+        shift = clock->shift;
+        now = rdtsc_ordered();
+    } while (read_seqcount_retry(&clock->seq, seq));
+
+    //a CPU whose TSC lags the one that did the last update by a few cycles would go negative
+    if ((int64_t)(now - base_cycles) < 0) {
+        now = base_cycles;
+    }
+    return base_ns + ((base_frac + (now - base_cycles) * mult) >> shift);
+}
+
+//Moves the base forward so the delta never overflows, only one CPU at a time may call it
+static inline void tsc_clock_update(tsc_clock_t* clock) {
+    uint64_t now = rdtsc_ordered();
+    uint64_t total;
+    if ((int64_t)(now - clock->base_cycles) < 0) {
+        return;
+    }
+    total = clock->base_frac + (now - clock->base_cycles) * clock->mult;
+    write_seqcount_begin(&clock->seq);
+    clock->base_cycles = now;
+    clock->base_ns += total >> clock->shift;
+    clock->base_frac = total & ((1ull << clock->shift) - 1);
+    write_seqcount_end(&clock->seq);
+}
+
+#endif // __TSC_CLOCK_H__
\ No newline at end of file
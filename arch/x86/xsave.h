@@ -0,0 +1,369 @@
+/*
+@ KrnlAid XSAVE state management
+@ With AVX-512 the FPU/SIMD state is ~2.7 KiB and AMX adds 8 KiB more, so how it is saved matters for context switches.
+@ xsave_probe() reads CPUID 0xD, works out every component's size and offset, the exact area size for the
+@ enabled components and the fastest save instruction:
+@   XSAVES   - compacted, skips components in their init state and ones unmodified since the last XRSTORS(ring 0)
+@   XSAVEC   - compacted, skips components in their init state
+@   XSAVEOPT - standard layout, skips init and unmodified components
+@   XSAVE    - standard layout, writes everything asked for
+@   FXSAVE   - x87/SSE only, 512 bytes
+@ XRSTOR(S) puts components whose XSTATE_BV bit is clear into their init state instead of loading them.
+@
+@ How to use:
+@ 1, define XSAVE_IMPL in exactly one source file
+@ 2, ring 0: xsave_probe(~0ull, 0); xsave_enable(); (on every CPU)
+@    ring 3: define XSAVE_USERSPACE(XSAVES faults there) and xsave_probe(xgetbv(0), 0)
+@ 3, allocate xsave_info.size bytes aligned to XSAVE_ALIGN per thread and call xsave_area_init on it
+@ 4, on a context switch: xsave_save(prev->fpu, XSAVE_ALL) ... xsave_restore(next->fpu, XSAVE_ALL)
+*/
+
+#ifndef __XSAVE_H__
+#define __XSAVE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpuid.h"
+#include "msr.h"
+
+//Components tracked, can be overriden
+#ifndef XSAVE_MAX_COMPONENTS
+#define XSAVE_MAX_COMPONENTS 32
+#endif
+
+//Alignment every area needs(FXSAVE alone would do with 16)
+#define XSAVE_ALIGN 64
+
+//The legacy region(x87, SSE) and the XSAVE header
+#define XSAVE_LEGACY_SIZE 512
+#define XSAVE_HEADER_SIZE 64
+
+//Requested feature bitmap for saving/restoring everything that is enabled
+#define XSAVE_ALL (~0ull)
+
+//CR4 bit that enables XSETBV/XGETBV and the XSAVE family
+#define CR4_OSXSAVE (1ull << 18)
+
+//State components(bit numbers in XCR0/IA32_XSS)
+enum xfeatures {
+    XFEATURE_X87,
+    XFEATURE_SSE,
+    XFEATURE_YMM,
+    XFEATURE_BNDREGS,
+    XFEATURE_BNDCSR,
+    XFEATURE_OPMASK,
+    XFEATURE_ZMM_HI256,
+    XFEATURE_HI16_ZMM,
+    XFEATURE_PT,        //supervisor
+    XFEATURE_PKRU,
+    XFEATURE_PASID,     //supervisor
+    XFEATURE_CET_USER,  //supervisor
+    XFEATURE_CET_KERNEL,//supervisor
+    XFEATURE_HDC,       //supervisor
+    XFEATURE_UINTR,     //supervisor
+    XFEATURE_LBR,       //supervisor
+    XFEATURE_HWP,       //supervisor
+    XFEATURE_XTILECFG,
+    XFEATURE_XTILEDATA,
+};
+
+#define XFEATURE_MASK(feature) (1ull << (feature))
+#define XFEATURE_MASK_FPSSE  (XFEATURE_MASK(XFEATURE_X87) | XFEATURE_MASK(XFEATURE_SSE))
+#define XFEATURE_MASK_AVX512 (XFEATURE_MASK(XFEATURE_OPMASK) | XFEATURE_MASK(XFEATURE_ZMM_HI256) | XFEATURE_MASK(XFEATURE_HI16_ZMM))
+#define XFEATURE_MASK_MPX    (XFEATURE_MASK(XFEATURE_BNDREGS) | XFEATURE_MASK(XFEATURE_BNDCSR))
+#define XFEATURE_MASK_AMX    (XFEATURE_MASK(XFEATURE_XTILECFG) | XFEATURE_MASK(XFEATURE_XTILEDATA))
+
+enum xsave_methods {
+    XSAVE_METHOD_FXSAVE,
+    XSAVE_METHOD_XSAVE,
+    XSAVE_METHOD_XSAVEOPT,
+    XSAVE_METHOD_XSAVEC,
+    XSAVE_METHOD_XSAVES,
+};
+
+typedef struct {
+    uint64_t xcr0_supported;                 //user components the CPU has
+    uint64_t xss_supported;                  //supervisor components the CPU has
+    uint64_t xcr0;                           //user components to enable
+    uint64_t xss;                            //supervisor components to enable
+    uint32_t size;                           //area size for xcr0 | xss in the chosen format
+    uint32_t instructions;                   //CPUID_XSAVE_1_EAX_*
+    uint32_t sizes[XSAVE_MAX_COMPONENTS];
+    uint32_t offsets[XSAVE_MAX_COMPONENTS];  //in the chosen format, 0 if not enabled
+    uint32_t std_offsets[XSAVE_MAX_COMPONENTS];
+    uint32_t align64;                        //components that are 64 byte aligned when compacted
+    uint8_t method;                          //XSAVE_METHOD_*
+    uint8_t compacted;
+} xsave_info_t;
+
+extern xsave_info_t xsave_info;
+
+//XSAVE header, right after the legacy region
+typedef struct {
+    uint64_t xstate_bv;  //components that are not in their init state
+    uint64_t xcomp_bv;   //bit 63 = compacted format, then the components it holds
+    uint64_t reserved[6];
+} xsave_header_t;
+
+#define XCOMP_BV_COMPACTED (1ull << 63)
+
+//Reads an extended control register(0 = XCR0, 1 = XINUSE if CPUID_XSAVE_1_EAX_XGETBV_ECX1)
+static inline uint64_t xgetbv(uint32_t index) {
+    uint32_t low, high;
+    __asm__ __volatile__ (
+        "xgetbv"
+        : "=a" (low), "=d" (high)
+        : "c" (index)
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+//Ring 0 only: writes an extended control register
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    __asm__ __volatile__ (
+        "xsetbv"
+        :
+        : "c" (index), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32))
+        : "memory"
+    );
+}
+
+//Drops components that can't be enabled on their own
+static inline uint64_t __xsave_fix_xcr0(uint64_t xcr0) {
+    //x87 is mandatory, AVX needs SSE
+    xcr0 |= XFEATURE_MASK(XFEATURE_X87);
+    if (!(xcr0 & XFEATURE_MASK(XFEATURE_SSE))) {
+        xcr0 &= ~XFEATURE_MASK(XFEATURE_YMM);
+    }
+    //AVX-512 needs AVX and all three of its components, MPX and AMX both of theirs
+    if (!(xcr0 & XFEATURE_MASK(XFEATURE_YMM)) || (xcr0 & XFEATURE_MASK_AVX512) != XFEATURE_MASK_AVX512) {
+        xcr0 &= ~XFEATURE_MASK_AVX512;
+    }
+    if ((xcr0 & XFEATURE_MASK_MPX) != XFEATURE_MASK_MPX) {
+        xcr0 &= ~XFEATURE_MASK_MPX;
+    }
+    if ((xcr0 & XFEATURE_MASK_AMX) != XFEATURE_MASK_AMX) {
+        xcr0 &= ~XFEATURE_MASK_AMX;
+    }
+    return xcr0;
+}
+
+//Lays out the area for the method in info->method
+static inline void xsave_layout(xsave_info_t* info) {
+    uint64_t features = info->xcr0 | info->xss;
+    uint32_t end = XSAVE_LEGACY_SIZE + XSAVE_HEADER_SIZE;
+
+    info->compacted = info->method >= XSAVE_METHOD_XSAVEC;
+    for (int i = 0; i < XSAVE_MAX_COMPONENTS; i++) {
+        info->offsets[i] = 0;
+    }
+    if (info->method == XSAVE_METHOD_FXSAVE) {
+        info->size = XSAVE_LEGACY_SIZE;
+        return;
+    }
+
+    //x87 and SSE always live in the legacy region
+    for (int i = 2; i < XSAVE_MAX_COMPONENTS; i++) {
+        if (!(features & XFEATURE_MASK(i))) {
+            continue;
+        }
+        if (info->compacted) {
+            if (info->align64 & (1u << i)) {
+                end = (end + 63) & ~63u;
+            }
+            info->offsets[i] = end;
+            end += info->sizes[i];
+        } else {
+            info->offsets[i] = info->std_offsets[i];
+            if (info->std_offsets[i] + info->sizes[i] > end) {
+                end = info->std_offsets[i] + info->sizes[i];
+            }
+        }
+    }
+    info->size = end;
+}
+
+//Picks a save method by hand(e.g. to compare them), it has to be supported
+static inline void xsave_set_method(xsave_info_t* info, uint8_t method) {
+    info->method = method;
+    xsave_layout(info);
+}
+
+/*
+@ Decodes leaf 0xD for the components in xcr0/xss(clamped to what the CPU supports and can enable)
+@ and picks the fastest method, returns 0 if the CPU has no XSAVE(FXSAVE is used then)
+*/
+static inline int xsave_probe_into(xsave_info_t* info, cpuid_fn_t source, uint64_t xcr0, uint64_t xss) {
+    uint32_t regs[4];
+    uint32_t max_leaf;
+
+    info->xcr0_supported = XFEATURE_MASK_FPSSE;
+    info->xss_supported = 0;
+    info->instructions = 0;
+    info->align64 = 0;
+    for (int i = 0; i < XSAVE_MAX_COMPONENTS; i++) {
+        info->sizes[i] = 0;
+        info->std_offsets[i] = 0;
+    }
+    //x87 and SSE are parts of the legacy region, not components with their own offset
+    info->sizes[XFEATURE_X87] = 160;
+    info->sizes[XFEATURE_SSE] = 256;
+
+    source(CPUID_VENDOR, 0, regs);
+    max_leaf = regs[0];
+    source(CPUID_CPU_INFO, 0, regs);
+    if (max_leaf < CPUID_XSAVE || !(regs[2] & (CPUID_CPU_INFO_ECX_XSAVE))) {
+        info->xcr0 = XFEATURE_MASK_FPSSE;
+        info->xss = 0;
+        xsave_set_method(info, XSAVE_METHOD_FXSAVE);
+        return 0;
+    }
+
+    source(CPUID_XSAVE, 0, regs);
+    info->xcr0_supported = ((uint64_t)regs[3] << 32) | regs[0];
+    source(CPUID_XSAVE, 1, regs);
+    info->instructions = regs[0];
+    info->xss_supported = ((uint64_t)regs[3] << 32) | regs[2];
+
+    for (int i = 2; i < XSAVE_MAX_COMPONENTS; i++) {
+        if (!((info->xcr0_supported | info->xss_supported) & XFEATURE_MASK(i))) {
+            continue;
+        }
+        source(CPUID_XSAVE, i, regs);
+        info->sizes[i] = regs[0];
+        info->std_offsets[i] = regs[1];
+        if (regs[2] & (CPUID_XSAVE_N_ECX_ALIGN64)) {
+            info->align64 |= 1u << i;
+        }
+    }
+
+    info->xcr0 = __xsave_fix_xcr0(xcr0 & info->xcr0_supported);
+    info->xss = xss & info->xss_supported;
+
+    #ifdef XSAVE_USERSPACE
+        info->instructions &= ~(CPUID_XSAVE_1_EAX_XSAVES);
+        info->xss = 0;
+    #endif
+    if (info->instructions & (CPUID_XSAVE_1_EAX_XSAVES)) {
+        info->method = XSAVE_METHOD_XSAVES;
+    } else if (info->instructions & (CPUID_XSAVE_1_EAX_XSAVEC)) {
+        info->method = XSAVE_METHOD_XSAVEC;
+    } else if (info->instructions & (CPUID_XSAVE_1_EAX_XSAVEOPT)) {
+        info->method = XSAVE_METHOD_XSAVEOPT;
+    } else {
+        info->method = XSAVE_METHOD_XSAVE;
+    }
+    //supervisor components can only be saved by XSAVES
+    if (info->method != XSAVE_METHOD_XSAVES) {
+        info->xss = 0;
+    }
+    xsave_layout(info);
+    return 1;
+}
+
+//xsave_probe_into for xsave_info with the native CPUID
+static inline int xsave_probe(uint64_t xcr0, uint64_t xss) {
+    return xsave_probe_into(&xsave_info, cpuid_native, xcr0, xss);
+}
+
+//Ring 0 only: turns XSAVE on and enables xsave_info's components, call it on every CPU after xsave_probe
+static inline void xsave_enable(void) {
+    uint64_t cr4;
+    if (xsave_info.method == XSAVE_METHOD_FXSAVE) {
+        return;
+    }
+    __asm__ __volatile__ ("mov %%cr4, %0" : "=r" (cr4));
+    __asm__ __volatile__ ("mov %0, %%cr4" : : "r" (cr4 | CR4_OSXSAVE) : "memory");
+    xsetbv(0, xsave_info.xcr0);
+    if (xsave_info.method == XSAVE_METHOD_XSAVES) {
+        wrmsr(MSR_IA32_XSS, xsave_info.xss);
+    }
+}
+
+//Components that aren't in their init state right now, all enabled ones if the CPU can't tell
+static inline uint64_t xsave_in_use(void) {
+    if (xsave_info.instructions & (CPUID_XSAVE_1_EAX_XGETBV_ECX1)) {
+        return xgetbv(1);
+    }
+    return xsave_info.xcr0 | xsave_info.xss;
+}
+
+//Gets an area into the init state, XRSTOR(S) faults on a garbage header
+static inline void xsave_area_init(void* area) {
+    uint8_t* bytes = (uint8_t*)area;
+    xsave_header_t* header = (xsave_header_t*)(bytes + XSAVE_LEGACY_SIZE);
+
+    for (uint32_t i = 0; i < xsave_info.size; i++) {
+        bytes[i] = 0;
+    }
+    //FXRSTOR always loads these and XRSTOR loads MXCSR whenever SSE or AVX is requested
+    *(uint16_t*)(bytes + 0) = 0x037F;   //FCW
+    *(uint32_t*)(bytes + 24) = 0x1F80;  //MXCSR
+    if (xsave_info.compacted) {
+        header->xcomp_bv = XCOMP_BV_COMPACTED | xsave_info.xcr0 | xsave_info.xss;
+    }
+}
+
+//Where a component sits in an area saved with xsave_info's method, NULL if it isn't there
+static inline void* xsave_component(void* area, uint32_t feature) {
+    xsave_header_t* header = (xsave_header_t*)((uint8_t*)area + XSAVE_LEGACY_SIZE);
+    if (feature >= XSAVE_MAX_COMPONENTS || xsave_info.offsets[feature] == 0) {
+        return NULL;
+    }
+    //components in their init state weren't written
+    if (!(header->xstate_bv & XFEATURE_MASK(feature))) {
+        return NULL;
+    }
+    return (uint8_t*)area + xsave_info.offsets[feature];
+}
+
+#ifdef __x86_64__
+    #define __XSAVE_SUFFIX "64"
+#else
+    #define __XSAVE_SUFFIX ""
+#endif
+
+//Saves the components in rfbm(usually XSAVE_ALL) that are enabled, area has to be XSAVE_ALIGN aligned
+static inline void xsave_save(void* area, uint64_t rfbm) {
+    uint32_t low = (uint32_t)rfbm, high = (uint32_t)(rfbm >> 32);
+    switch (xsave_info.method) {
+        case XSAVE_METHOD_XSAVES:
+            __asm__ __volatile__ ("xsaves" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+        case XSAVE_METHOD_XSAVEC:
+            __asm__ __volatile__ ("xsavec" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+        case XSAVE_METHOD_XSAVEOPT:
+            __asm__ __volatile__ ("xsaveopt" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+        case XSAVE_METHOD_XSAVE:
+            __asm__ __volatile__ ("xsave" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+        default:
+            __asm__ __volatile__ ("fxsave" __XSAVE_SUFFIX " (%0)" : : "r" (area) : "memory");
+            break;
+    }
+}
+
+//Loads the components in rfbm, the ones the area holds in their init state are just reset
+static inline void xsave_restore(const void* area, uint64_t rfbm) {
+    uint32_t low = (uint32_t)rfbm, high = (uint32_t)(rfbm >> 32);
+    switch (xsave_info.method) {
+        case XSAVE_METHOD_XSAVES:
+            __asm__ __volatile__ ("xrstors" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+        case XSAVE_METHOD_FXSAVE:
+            __asm__ __volatile__ ("fxrstor" __XSAVE_SUFFIX " (%0)" : : "r" (area) : "memory");
+            break;
+        default:
+            //XRSTOR reads both formats
+            __asm__ __volatile__ ("xrstor" __XSAVE_SUFFIX " (%0)" : : "r" (area), "a" (low), "d" (high) : "memory");
+            break;
+    }
+}
+
+#ifdef XSAVE_IMPL
+    xsave_info_t xsave_info;
+#endif
+
+#endif // __XSAVE_H__
\ No newline at end of file
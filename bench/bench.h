@@ -0,0 +1,109 @@
+/*
+@ Shared bits of the userspace benchmarks
+@ bench_run(threads, fn, arg) starts threads threads, pins thread i to CPU i % online CPUs, releases them
+@ together and returns the wall clock ns until the last one finished. bench_cpu is the calling thread's
+@ index, so __kcpu_id() can be bench_cpu for the headers that want one.
+@ The thread count goes 1, 2, 4, ... up to the online CPUs(or fewer, BENCH_THREADS from the environment).
+*/
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+//Most threads a benchmark starts
+#define BENCH_MAX_THREADS 256
+
+static __thread uint32_t bench_cpu;
+
+typedef void (*bench_fn_t)(uint32_t thread, uint32_t threads, void* arg);
+
+typedef struct {
+    bench_fn_t fn;
+    void* arg;
+    uint32_t thread;
+    uint32_t threads;
+    pthread_barrier_t* start;
+} __bench_thread_t;
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t bench_online_cpus(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (uint32_t)cpus;
+}
+
+//Most threads to go up to: the online CPUs, BENCH_THREADS can lower it(spinning threads that share a CPU only measure the scheduler)
+static inline uint32_t bench_max_threads(void) {
+    const char* env = getenv("BENCH_THREADS");
+    uint32_t max = bench_online_cpus();
+    if (env != NULL && atoi(env) > 0 && (uint32_t)atoi(env) < max) {
+        max = (uint32_t)atoi(env);
+    }
+    return max > BENCH_MAX_THREADS ? BENCH_MAX_THREADS : max;
+}
+
+static void* __bench_thread(void* arg) {
+    __bench_thread_t* t = (__bench_thread_t*)arg;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(t->thread % bench_online_cpus(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    bench_cpu = t->thread;
+
+    pthread_barrier_wait(t->start);
+    t->fn(t->thread, t->threads, t->arg);
+    return NULL;
+}
+
+//Runs fn on threads threads at once, returns the wall clock ns they took
+static inline uint64_t bench_run(uint32_t threads, bench_fn_t fn, void* arg) {
+    static pthread_t handles[BENCH_MAX_THREADS];
+    static __bench_thread_t args[BENCH_MAX_THREADS];
+    pthread_barrier_t start;
+    uint64_t begin;
+
+    pthread_barrier_init(&start, NULL, threads + 1);
+    for (uint32_t i = 0; i < threads; i++) {
+        args[i].fn = fn;
+        args[i].arg = arg;
+        args[i].thread = i;
+        args[i].threads = threads;
+        args[i].start = &start;
+        if (pthread_create(&handles[i], NULL, __bench_thread, &args[i]) != 0) {
+            fprintf(stderr, "bench: pthread_create failed\n");
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start);
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    pthread_barrier_destroy(&start);
+    return bench_now_ns() - begin;
+}
+
+//Next thread count after n: doubles, but always ends on max
+static inline uint32_t bench_next_threads(uint32_t n, uint32_t max) {
+    return n < max && n * 2 > max ? max : n * 2;
+}
+
+#define for_each_thread_count(n) for (uint32_t n = 1, __max = bench_max_threads(); n <= __max; n = bench_next_threads(n, __max))
+
+#endif // __BENCH_H__
\ No newline at end of file
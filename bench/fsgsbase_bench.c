@@ -0,0 +1,151 @@
+/*
+@ fsgsbase.h cycle benchmark
+@ Cycles per RDFSBASE/WRFSBASE/RDGSBASE/WRGSBASE and per fsgs_save/fsgs_restore, against the MSR fallback.
+@ RDMSR/WRMSR fault in ring 3, so the fallback is measured the way a user thread pays for it: arch_prctl
+@ ARCH_GET_FS/ARCH_SET_FS and ARCH_GET_GS/ARCH_SET_GS(a syscall that goes to the MSRs without FSGSBASE), and
+@ RDMSR through /dev/cpu/0/msr when the msr driver is loaded and readable.
+@ fsgs_save/fsgs_restore are built with FSGSBASE_SWAPGS "", so they read and write the active GS base here.
+@ Every write stores the value that is already there. Each row is the best of BATCHES batches of ITERATIONS calls.
+@ Skipped when the CPU has no FSGSBASE or the kernel didn't enable it(HWCAP2_FSGSBASE).
+*/
+
+#include "bench.h"
+#include <fcntl.h>
+#include <sys/auxv.h>
+#include <sys/syscall.h>
+#include <asm/prctl.h>
+
+#define FSGSBASE_IMPL
+#define FSGSBASE_SWAPGS ""
+#include "../arch/x86/fsgsbase.h"
+#include "../arch/x86/tsc.h"
+
+#ifndef HWCAP2_FSGSBASE
+#define HWCAP2_FSGSBASE (1 << 1)
+#endif
+
+#define ITERATIONS 1000
+#define BATCHES 100
+
+enum ops {
+    OP_RDFSBASE,
+    OP_WRFSBASE,
+    OP_RDGSBASE,
+    OP_WRGSBASE,
+    OP_FSGS_SAVE,
+    OP_FSGS_RESTORE,
+    OP_ARCH_GET_FS,
+    OP_ARCH_SET_FS,
+    OP_ARCH_GET_GS,
+    OP_ARCH_SET_GS,
+    OP_MSR_READ,
+    OP_COUNT
+};
+
+static const char* const op_names[] = {
+    "rdfsbase", "wrfsbase", "rdgsbase", "wrgsbase", "fsgs_save", "fsgs_restore",
+    "ARCH_GET_FS", "ARCH_SET_FS", "ARCH_GET_GS", "ARCH_SET_GS", "/dev/cpu/0/msr read"
+};
+
+static int msr_fd = -1;
+static volatile uint64_t sink;
+
+static inline void op(uint8_t which, uint64_t fs, uint64_t gs, fsgs_state_t* state) {
+    uint64_t value;
+    switch (which) {
+        case OP_RDFSBASE:
+            sink = rdfsbase();
+            break;
+        case OP_WRFSBASE:
+            wrfsbase(fs);
+            break;
+        case OP_RDGSBASE:
+            sink = rdgsbase();
+            break;
+        case OP_WRGSBASE:
+            wrgsbase(gs);
+            break;
+        case OP_FSGS_SAVE:
+            fsgs_save(state);
+            break;
+        case OP_FSGS_RESTORE:
+            fsgs_restore(state);
+            break;
+        case OP_ARCH_GET_FS:
+            syscall(SYS_arch_prctl, ARCH_GET_FS, &value);
+            sink = value;
+            break;
+        case OP_ARCH_SET_FS:
+            syscall(SYS_arch_prctl, ARCH_SET_FS, fs);
+            break;
+        case OP_ARCH_GET_GS:
+            syscall(SYS_arch_prctl, ARCH_GET_GS, &value);
+            sink = value;
+            break;
+        case OP_ARCH_SET_GS:
+            syscall(SYS_arch_prctl, ARCH_SET_GS, gs);
+            break;
+        default:
+            if (pread(msr_fd, &value, sizeof(value), MSR_FS_BASE) == sizeof(value)) {
+                sink = value;
+            }
+            break;
+    }
+}
+
+static uint64_t measure(uint8_t which, uint64_t fs, uint64_t gs) {
+    fsgs_state_t state = {fs, gs};
+    uint64_t best = UINT64_MAX;
+    for (int batch = 0; batch < BATCHES; batch++) {
+        uint64_t start = rdtsc_ordered();
+        for (int i = 0; i < ITERATIONS; i++) {
+            op(which, fs, gs, &state);
+        }
+        uint64_t cycles = rdtsc_ordered() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best / ITERATIONS;
+}
+
+int main(void) {
+    fsgs_state_t state;
+    uint64_t fs, gs, value;
+    cpu_set_t set;
+
+    if (!fsgsbase_supported() || !(getauxval(AT_HWCAP2) & HWCAP2_FSGSBASE)) {
+        printf("fsgsbase_bench: FSGSBASE isn't supported or enabled, skipped\n");
+        return 0;
+    }
+    fsgsbase_usable = 1;
+
+    //the msr driver reads the MSR of the CPU the file belongs to, stay on it
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+    msr_fd = open("/dev/cpu/0/msr", O_RDONLY);
+
+    //the instructions and the kernel have to agree on both bases
+    fs = rdfsbase();
+    gs = rdgsbase();
+    fsgs_save(&state);
+    if (syscall(SYS_arch_prctl, ARCH_GET_FS, &value) != 0 || value != fs || state.fs_base != fs || state.gs_base != gs) {
+        fprintf(stderr, "fsgsbase_bench: FS base 0x%llx, arch_prctl says 0x%llx\n", (unsigned long long)fs, (unsigned long long)value);
+        return 1;
+    }
+
+    printf("%-20s %10s\n", "operation", "cycles");
+    for (uint8_t which = 0; which < OP_COUNT; which++) {
+        if (which == OP_MSR_READ && msr_fd < 0) {
+            printf("%-20s %10s\n", op_names[which], "n/a");
+            continue;
+        }
+        printf("%-20s %10llu\n", op_names[which], (unsigned long long)measure(which, fs, gs));
+    }
+    if (rdfsbase() != fs || rdgsbase() != gs) {
+        fprintf(stderr, "fsgsbase_bench: a write changed a base\n");
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
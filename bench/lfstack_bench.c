@@ -0,0 +1,206 @@
+/*
+@ lfstack.h push/pop benchmark
+@ Every thread takes HOLD objects and gives them back again, ROUNDS times. Once with lfstack_t(the CMPXCHG16B
+@ path), once with a plain stack behind one spinlock_t and once with freelist_t, whose per-CPU caches only
+@ reach the shared stack every batch objects. Pushes + pops per microsecond for 1, 2, 4, ... threads.
+@ An object handed to two threads at once or lost on the way fails the run.
+*/
+
+#include "bench.h"
+#include "../utils/lfstack.h"
+
+#define ROUNDS 100000
+#define HOLD 48
+#define BATCH 32
+#define OBJECTS_PER_THREAD 128
+
+typedef struct {
+    freelist_node_t node; //node.link for the stacks
+    volatile uint32_t owner; //thread + 1 while taken
+} __cacheline_aligned object_t;
+
+typedef struct {
+    spinlock_t lock __cacheline_aligned;
+    lfstack_node_t* head;
+} locked_stack_t;
+
+static object_t objects[BENCH_MAX_THREADS * OBJECTS_PER_THREAD];
+static lfstack_t stack;
+static locked_stack_t locked;
+static freelist_t freelist;
+static freelist_cache_t caches[BENCH_MAX_THREADS];
+
+static inline object_t* object_of(lfstack_node_t* link) {
+    return (object_t*)((char*)link - offsetof(object_t, node.link));
+}
+
+static inline void take(object_t* obj, uint32_t thread) {
+    if (obj == NULL || obj->owner != 0) {
+        fprintf(stderr, "lfstack_bench: %s\n", obj == NULL ? "ran dry" : "object handed out twice");
+        exit(1);
+    }
+    obj->owner = thread + 1;
+}
+
+static inline void give(object_t* obj) {
+    obj->owner = 0;
+}
+
+//=================Plain spinlock_t stack=================
+
+static inline void locked_push(locked_stack_t* s, lfstack_node_t* node) {
+    lock(s->lock);
+    node->next = s->head;
+    s->head = node;
+    unlock(s->lock);
+}
+
+static inline lfstack_node_t* locked_pop(locked_stack_t* s) {
+    lfstack_node_t* node;
+    lock(s->lock);
+    node = s->head;
+    if (node != NULL) {
+        s->head = node->next;
+    }
+    unlock(s->lock);
+    return node;
+}
+
+//=================Workers=================
+
+static void lfstack_worker(uint32_t thread, uint32_t threads, void* arg) {
+    object_t* held[HOLD];
+    (void)threads;
+    (void)arg;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < HOLD; i++) {
+            lfstack_node_t* node = lfstack_pop(&stack);
+            held[i] = node == NULL ? NULL : object_of(node);
+            take(held[i], thread);
+        }
+        for (int i = 0; i < HOLD; i++) {
+            give(held[i]);
+            lfstack_push(&stack, &held[i]->node.link);
+        }
+    }
+}
+
+static void locked_worker(uint32_t thread, uint32_t threads, void* arg) {
+    object_t* held[HOLD];
+    (void)threads;
+    (void)arg;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < HOLD; i++) {
+            lfstack_node_t* node = locked_pop(&locked);
+            held[i] = node == NULL ? NULL : object_of(node);
+            take(held[i], thread);
+        }
+        for (int i = 0; i < HOLD; i++) {
+            give(held[i]);
+            locked_push(&locked, &held[i]->node.link);
+        }
+    }
+}
+
+static void freelist_worker(uint32_t thread, uint32_t threads, void* arg) {
+    object_t* held[HOLD];
+    (void)threads;
+    (void)arg;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < HOLD; i++) {
+            held[i] = (object_t*)freelist_alloc(&freelist, thread);
+            take(held[i], thread);
+        }
+        for (int i = 0; i < HOLD; i++) {
+            give(held[i]);
+            freelist_free(&freelist, thread, held[i]);
+        }
+    }
+}
+
+//=================Setup and checks=================
+
+static void fill(uint32_t threads) {
+    uint32_t count = threads * OBJECTS_PER_THREAD;
+    lfstack_init(&stack);
+    //the point is the CMPXCHG16B path, the spinlock fallback is what locked_stack_t measures
+    stack.use_lock = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        objects[i].owner = 0;
+        lfstack_push(&stack, &objects[i].node.link);
+    }
+}
+
+static void fill_locked(uint32_t threads) {
+    uint32_t count = threads * OBJECTS_PER_THREAD;
+    locked.head = NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        objects[i].owner = 0;
+        locked_push(&locked, &objects[i].node.link);
+    }
+}
+
+static void fill_freelist(uint32_t threads) {
+    freelist_init(&freelist, caches, threads, BATCH);
+    freelist.global.use_lock = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        for (uint32_t i = 0; i < OBJECTS_PER_THREAD; i++) {
+            objects[t * OBJECTS_PER_THREAD + i].owner = 0;
+        }
+        freelist_populate(&freelist, t, &objects[t * OBJECTS_PER_THREAD], sizeof(object_t), OBJECTS_PER_THREAD);
+    }
+}
+
+static uint32_t count_list(lfstack_node_t* node) {
+    uint32_t n = 0;
+    for (; node != NULL; node = node->next) {
+        n++;
+    }
+    return n;
+}
+
+static uint32_t count_freelist(uint32_t threads) {
+    uint32_t n = 0;
+    lfstack_node_t* chain;
+    for (uint32_t t = 0; t < threads; t++) {
+        for (freelist_node_t* obj = caches[t].head; obj != NULL; obj = obj->next) {
+            n++;
+        }
+    }
+    while ((chain = lfstack_pop(&freelist.global)) != NULL) {
+        for (freelist_node_t* obj = (freelist_node_t*)chain; obj != NULL; obj = obj->next) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void check(const char* name, uint32_t found, uint32_t threads) {
+    if (found != threads * OBJECTS_PER_THREAD) {
+        fprintf(stderr, "lfstack_bench: %s holds %u objects, expected %u\n", name, found, threads * OBJECTS_PER_THREAD);
+        exit(1);
+    }
+}
+
+int main(void) {
+    printf("%-8s %16s %16s %16s\n", "threads", "lfstack ops/us", "locked ops/us", "freelist ops/us");
+    for_each_thread_count(threads) {
+        double ops = (double)threads * ROUNDS * HOLD * 2;
+        double lf, lk, fl;
+
+        fill(threads);
+        lf = ops * 1000.0 / bench_run(threads, lfstack_worker, NULL);
+        check("lfstack_t", count_list(stack.top.head), threads);
+
+        fill_locked(threads);
+        lk = ops * 1000.0 / bench_run(threads, locked_worker, NULL);
+        check("the locked stack", count_list(locked.head), threads);
+
+        fill_freelist(threads);
+        fl = ops * 1000.0 / bench_run(threads, freelist_worker, NULL);
+        check("freelist_t", count_freelist(threads), threads);
+
+        printf("%-8u %16.1f %16.1f %16.1f\n", threads, lf, lk, fl);
+    }
+    return 0;
+}
\ No newline at end of file
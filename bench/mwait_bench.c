@@ -0,0 +1,201 @@
+/*
+@ mwait.h wake-up latency and SMT sibling benchmark
+@ latency: a waker stores to a flag every DELAY_CYCLES(long enough for the waiter to get past its spin phase and
+@          sleep), the waiter sits in wait_on_u32 and measures rdtsc from the store to its return, p50/p99 cycles
+@ sibling: a worker counts loop iterations for WINDOW_NS on CPU 0 while the other thread waits for a flag
+@          on CPU 0's SMT sibling(any other CPU if there is none), iterations relative to an idle sibling
+@ Each is run with a plain PAUSE spin, wait_on_u32 with the PAUSE backoff and, with WAITPKG, wait_on_u32 with
+@ UMWAIT in C0.1 and C0.2. Both parts need two CPUs, with one the waiter would just take turns with the waker.
+*/
+
+#include "bench.h"
+#include "../utils/cache.h"
+
+#define WAIT_USERSPACE
+#define WAIT_IMPL
+#include "../arch/x86/mwait.h"
+
+#define ROUNDS 10000
+#define DELAY_CYCLES 50000
+#define WINDOW_NS 200000000ull
+
+enum waiters {
+    WAITER_SPIN,
+    WAITER_BACKOFF,
+    WAITER_UMWAIT_C01,
+    WAITER_UMWAIT_C02,
+};
+
+static const char* const waiter_names[] = {"pause spin", "pause backoff", "umwait C0.1", "umwait C0.2"};
+
+static struct {
+    volatile uint32_t flag __cacheline_aligned;
+    volatile uint64_t stamp;
+    volatile uint32_t ack __cacheline_aligned;
+    volatile uint32_t stop __cacheline_aligned;
+    uint64_t latency[ROUNDS];
+    uint64_t work;
+    uint32_t sibling;
+    uint8_t waiter;
+} shared;
+
+static inline void pin(uint32_t cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+//The first CPU in cpu0's thread_siblings_list that isn't cpu0, -1 if there is none
+static int smt_sibling(void) {
+    FILE* file = fopen("/sys/devices/system/cpu/cpu0/topology/thread_siblings_list", "r");
+    int cpu, sibling = -1;
+    char separator;
+    if (file == NULL) {
+        return -1;
+    }
+    while (fscanf(file, "%d%c", &cpu, &separator) >= 1) {
+        if (cpu != 0) {
+            sibling = cpu;
+            break;
+        }
+    }
+    fclose(file);
+    return sibling;
+}
+
+static void set_waiter(uint8_t waiter) {
+    shared.waiter = waiter;
+    if (waiter == WAITER_UMWAIT_C01 || waiter == WAITER_UMWAIT_C02) {
+        wait_info.method = WAIT_METHOD_UMWAIT;
+        wait_info.umwait_control = waiter == WAITER_UMWAIT_C01 ? WAIT_UMWAIT_C01 : WAIT_UMWAIT_C02;
+    } else {
+        wait_info.method = WAIT_METHOD_PAUSE;
+    }
+}
+
+static inline uint32_t wait_for(const volatile uint32_t* addr, uint32_t old) {
+    uint32_t value;
+    if (shared.waiter != WAITER_SPIN) {
+        return wait_on_u32(addr, old);
+    }
+    while ((value = __atomic_load_n(addr, __ATOMIC_ACQUIRE)) == old) {
+        cpu_relax();
+    }
+    return value;
+}
+
+//=================Wake-up latency=================
+
+static void latency_thread(uint32_t thread, uint32_t threads, void* arg) {
+    (void)threads;
+    (void)arg;
+
+    if (thread == 0) {
+        for (uint32_t round = 1; round <= ROUNDS; round++) {
+            wait_delay(DELAY_CYCLES);
+            shared.stamp = rdtsc_ordered();
+            __atomic_store_n(&shared.flag, round, __ATOMIC_RELEASE);
+            while (__atomic_load_n(&shared.ack, __ATOMIC_ACQUIRE) != round) {
+                cpu_relax();
+            }
+        }
+    } else {
+        for (uint32_t round = 1; round <= ROUNDS; round++) {
+            uint32_t seen = wait_for(&shared.flag, round - 1);
+            uint64_t now = rdtsc_ordered();
+            if (seen != round) {
+                fprintf(stderr, "mwait_bench: woke up to round %u, expected %u\n", seen, round);
+                exit(1);
+            }
+            shared.latency[round - 1] = now - shared.stamp;
+            __atomic_store_n(&shared.ack, round, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_latency(uint8_t waiter) {
+    set_waiter(waiter);
+    shared.flag = 0;
+    shared.ack = 0;
+    bench_run(2, latency_thread, NULL);
+
+    qsort(shared.latency, ROUNDS, sizeof(uint64_t), compare_u64);
+    printf("%-14s %12llu %12llu\n", waiter_names[waiter],
+           (unsigned long long)shared.latency[ROUNDS / 2],
+           (unsigned long long)shared.latency[ROUNDS * 99 / 100]);
+}
+
+//=================Sibling throughput=================
+
+static inline uint64_t count_work(void) {
+    uint64_t start = bench_now_ns(), work = 0;
+    uint32_t x = 1;
+    while (bench_now_ns() - start < WINDOW_NS) {
+        for (int i = 0; i < 1000; i++) {
+            x = x * 1664525u + 1013904223u;
+            __asm__ __volatile__ ("" : "+r" (x));
+        }
+        work++;
+    }
+    return work;
+}
+
+static void sibling_thread(uint32_t thread, uint32_t threads, void* arg) {
+    (void)threads;
+    (void)arg;
+
+    if (thread == 0) {
+        pin(0);
+        shared.work = count_work();
+        __atomic_store_n(&shared.stop, 1, __ATOMIC_RELEASE);
+    } else {
+        pin(shared.sibling);
+        if (wait_for(&shared.stop, 0) != 1) {
+            fprintf(stderr, "mwait_bench: stop flag corrupted\n");
+            exit(1);
+        }
+    }
+}
+
+static void run_sibling(uint8_t waiter, uint64_t idle) {
+    set_waiter(waiter);
+    shared.stop = 0;
+    bench_run(2, sibling_thread, NULL);
+    printf("%-14s %12llu %11.1f%%\n", waiter_names[waiter], (unsigned long long)shared.work, shared.work * 100.0 / idle);
+}
+
+int main(void) {
+    int sibling = smt_sibling();
+    uint8_t last;
+    uint64_t idle;
+
+    wait_probe();
+    if (bench_online_cpus() < 2) {
+        printf("mwait_bench: needs at least 2 CPUs, skipped\n");
+        return 0;
+    }
+    last = wait_info.waitpkg ? WAITER_UMWAIT_C02 : WAITER_BACKOFF;
+    printf("WAITPKG %s\n", wait_info.waitpkg ? "yes" : "no, only the PAUSE waiters run");
+
+    printf("%-14s %12s %12s\n", "waiter", "p50 cycles", "p99 cycles");
+    for (uint8_t waiter = WAITER_SPIN; waiter <= last; waiter++) {
+        run_latency(waiter);
+    }
+
+    shared.sibling = sibling > 0 ? (uint32_t)sibling : 1;
+    printf("\nworker on CPU 0, waiter on CPU %u%s\n", shared.sibling, sibling > 0 ? "(SMT sibling)" : "(no SMT sibling)");
+    pin(0);
+    idle = count_work();
+    printf("%-14s %12s %12s\n", "waiter", "work", "of idle");
+    printf("%-14s %12llu %11.1f%%\n", "idle", (unsigned long long)idle, 100.0);
+    for (uint8_t waiter = WAITER_SPIN; waiter <= last; waiter++) {
+        run_sibling(waiter, idle);
+    }
+    return 0;
+}
\ No newline at end of file
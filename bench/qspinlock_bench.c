@@ -0,0 +1,83 @@
+/*
+@ qspinlock scaling benchmark
+@ Every thread takes the lock ITERATIONS times, does a short critical section(a few writes to the protected
+@ line) and a little work outside of it. Once with the test-and-set spinlock_t and once with qspinlock_t,
+@ for 1, 2, 4, ... threads. Under contention every test-and-set waiter hammers the lock's line, qspinlock
+@ waiters spin on their own node.
+*/
+
+#include "bench.h"
+
+#define __kcpu_id() bench_cpu
+#define QSPINLOCK_MAX_CPUS BENCH_MAX_THREADS
+#define SPINLOCK_IMPL
+#include "../utils/spinlock.h"
+
+#define ITERATIONS 200000
+
+static struct {
+    spinlock_t tas __cacheline_aligned;
+    qspinlock_t qspin __cacheline_aligned;
+    uint64_t protected_data[8] __cacheline_aligned;
+} shared = { 0, QSPINLOCK_INIT, { 0 } };
+
+static inline void critical_section(void) {
+    for (int i = 0; i < 8; i++) {
+        shared.protected_data[i]++;
+    }
+}
+
+//Work between two acquisitions, so an uncontended lock isn't just a loop around the line
+static inline void outside_work(void) {
+    for (volatile int i = 0; i < 20; i++) {
+    }
+}
+
+static void tas_worker(uint32_t thread, uint32_t threads, void* arg) {
+    (void)thread;
+    (void)threads;
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        lock(shared.tas);
+        critical_section();
+        unlock(shared.tas);
+        outside_work();
+    }
+}
+
+static void qspin_worker(uint32_t thread, uint32_t threads, void* arg) {
+    (void)thread;
+    (void)threads;
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        qspin_lock(&shared.qspin);
+        critical_section();
+        qspin_unlock(&shared.qspin);
+        outside_work();
+    }
+}
+
+static uint64_t run(uint32_t threads, bench_fn_t fn) {
+    uint64_t ns;
+    for (int i = 0; i < 8; i++) {
+        shared.protected_data[i] = 0;
+    }
+    ns = bench_run(threads, fn, NULL);
+    //a lost update means the lock let two threads in
+    if (shared.protected_data[0] != (uint64_t)threads * ITERATIONS) {
+        fprintf(stderr, "qspinlock_bench: mutual exclusion broken\n");
+        exit(1);
+    }
+    return ns;
+}
+
+int main(void) {
+    printf("%-8s %16s %16s %10s\n", "threads", "tas ns/lock", "qspin ns/lock", "speedup");
+    for_each_thread_count(threads) {
+        uint64_t ops = (uint64_t)threads * ITERATIONS;
+        double tas = (double)run(threads, tas_worker) / ops;
+        double qspin = (double)run(threads, qspin_worker) / ops;
+        printf("%-8u %16.1f %16.1f %9.2fx\n", threads, tas, qspin, tas / qspin);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+/*
+@ ring.h throughput and latency benchmark
+@ throughput: producers push ITEMS items in bursts, consumers pull them out, Mitems/s for
+@             the SPSC ring(1 + 1 threads), the MPMC ring(N/2 + N/2 threads) and a spinlock_t protected
+@             array queue doing the same, at burst sizes 1 and 32
+@ latency:    two threads bounce one item back and forth over a pair of queues, ns per round trip
+@ A thread that finds its queue full or empty yields, so the numbers stay sane with fewer CPUs than threads.
+*/
+
+#include "bench.h"
+#include "../utils/spinlock.h"
+#include "../utils/ring.h"
+
+#define RING_SIZE 1024
+#define ITEMS (1u << 21)
+#define ROUND_TRIPS 100000
+#define MAX_BURST 32
+
+//=================spinlock_t protected queue=================
+
+typedef struct {
+    spinlock_t lock;
+    uint32_t head, tail, mask;
+    void* slots[RING_SIZE];
+} __cacheline_aligned locked_queue_t;
+
+static uint32_t locked_enqueue_burst(void* queue, void* const* items, uint32_t n) {
+    locked_queue_t* q = (locked_queue_t*)queue;
+    uint32_t free;
+    lock(q->lock);
+    free = q->mask + 1 - (q->tail - q->head);
+    n = n < free ? n : free;
+    for (uint32_t i = 0; i < n; i++) {
+        q->slots[(q->tail + i) & q->mask] = items[i];
+    }
+    q->tail += n;
+    unlock(q->lock);
+    return n;
+}
+
+static uint32_t locked_dequeue_burst(void* queue, void** items, uint32_t n) {
+    locked_queue_t* q = (locked_queue_t*)queue;
+    uint32_t used;
+    lock(q->lock);
+    used = q->tail - q->head;
+    n = n < used ? n : used;
+    for (uint32_t i = 0; i < n; i++) {
+        items[i] = q->slots[(q->head + i) & q->mask];
+    }
+    q->head += n;
+    unlock(q->lock);
+    return n;
+}
+
+static uint32_t spsc_enq(void* q, void* const* items, uint32_t n) { return spsc_enqueue_burst((spsc_ring_t*)q, items, n); }
+static uint32_t spsc_deq(void* q, void** items, uint32_t n) { return spsc_dequeue_burst((spsc_ring_t*)q, items, n); }
+static uint32_t mpmc_enq(void* q, void* const* items, uint32_t n) { return mpmc_enqueue_burst((mpmc_ring_t*)q, items, n); }
+static uint32_t mpmc_deq(void* q, void** items, uint32_t n) { return mpmc_dequeue_burst((mpmc_ring_t*)q, items, n); }
+
+typedef struct {
+    uint32_t (*enqueue)(void* q, void* const* items, uint32_t n);
+    uint32_t (*dequeue)(void* q, void** items, uint32_t n);
+    void* q[2]; //the latency test bounces between both
+} queue_ops_t;
+
+static spsc_ring_t spsc[2];
+static void* spsc_slots[2][RING_SIZE];
+static mpmc_ring_t mpmc[2];
+static mpmc_cell_t mpmc_cells[2][RING_SIZE];
+static locked_queue_t locked[2];
+
+static void reset_queues(void) {
+    for (int i = 0; i < 2; i++) {
+        spsc_ring_init(&spsc[i], spsc_slots[i], RING_SIZE);
+        locked[i].lock = 0;
+        locked[i].head = locked[i].tail = 0;
+        locked[i].mask = RING_SIZE - 1;
+        mpmc_ring_init(&mpmc[i], mpmc_cells[i], RING_SIZE);
+    }
+}
+
+//=================Throughput=================
+
+typedef struct {
+    queue_ops_t ops;
+    uint32_t producers;
+    uint32_t burst;
+    volatile uint64_t consumed;
+    volatile uint64_t sum;
+} throughput_t;
+
+static void throughput_worker(uint32_t thread, uint32_t threads, void* arg) {
+    throughput_t* t = (throughput_t*)arg;
+    void* items[MAX_BURST];
+    (void)threads;
+
+    if (thread < t->producers) {
+        //items are 1..ITEMS, so the consumers' sum proves nothing was lost or duplicated
+        uint32_t first = thread * (ITEMS / t->producers) + 1;
+        uint32_t end = thread == t->producers - 1 ? ITEMS + 1 : first + ITEMS / t->producers;
+        for (uint32_t next = first; next < end;) {
+            uint32_t n = end - next < t->burst ? end - next : t->burst;
+            for (uint32_t i = 0; i < n; i++) {
+                items[i] = (void*)(uintptr_t)(next + i);
+            }
+            n = t->ops.enqueue(t->ops.q[0], items, n);
+            if (n == 0) {
+                sched_yield();
+            }
+            next += n;
+        }
+    } else {
+        uint64_t sum = 0;
+        while (__atomic_load_n(&t->consumed, __ATOMIC_RELAXED) < ITEMS) {
+            uint32_t n = t->ops.dequeue(t->ops.q[0], items, t->burst);
+            if (n == 0) {
+                sched_yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                sum += (uintptr_t)items[i];
+            }
+            __atomic_fetch_add(&t->consumed, n, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&t->sum, sum, __ATOMIC_RELAXED);
+    }
+}
+
+static double throughput(queue_ops_t ops, uint32_t producers, uint32_t consumers, uint32_t burst) {
+    throughput_t t;
+    uint64_t ns;
+
+    reset_queues();
+    t.ops = ops;
+    t.producers = producers;
+    t.burst = burst;
+    t.consumed = 0;
+    t.sum = 0;
+    ns = bench_run(producers + consumers, throughput_worker, &t);
+    if (t.sum != (uint64_t)ITEMS * (ITEMS + 1) / 2) {
+        fprintf(stderr, "ring_bench: items lost or duplicated\n");
+        exit(1);
+    }
+    return ITEMS * 1000.0 / ns;
+}
+
+//=================Latency=================
+
+static void latency_worker(uint32_t thread, uint32_t threads, void* arg) {
+    queue_ops_t* ops = (queue_ops_t*)arg;
+    void* item = (void*)1;
+    (void)threads;
+
+    for (uint32_t i = 0; i < ROUND_TRIPS; i++) {
+        //thread 0 sends on q[0] and waits on q[1], thread 1 echoes
+        if (thread == 0) {
+            while (ops->enqueue(ops->q[0], &item, 1) == 0) {
+                sched_yield();
+            }
+        }
+        while (ops->dequeue(ops->q[thread == 0], &item, 1) == 0) {
+            sched_yield();
+        }
+        if (thread == 1) {
+            while (ops->enqueue(ops->q[1], &item, 1) == 0) {
+                sched_yield();
+            }
+        }
+    }
+}
+
+static double latency(queue_ops_t ops) {
+    reset_queues();
+    return (double)bench_run(2, latency_worker, &ops) / ROUND_TRIPS;
+}
+
+int main(void) {
+    queue_ops_t spsc_ops = { spsc_enq, spsc_deq, { &spsc[0], &spsc[1] } };
+    queue_ops_t mpmc_ops = { mpmc_enq, mpmc_deq, { &mpmc[0], &mpmc[1] } };
+    queue_ops_t locked_ops = { locked_enqueue_burst, locked_dequeue_burst, { &locked[0], &locked[1] } };
+    uint32_t bursts[] = { 1, MAX_BURST };
+
+    printf("throughput(Mitems/s)\n");
+    printf("%-6s %-12s %12s %12s\n", "burst", "threads", "ring", "locked");
+    for (int b = 0; b < 2; b++) {
+        uint32_t burst = bursts[b];
+        printf("%-6u %-12s %12.1f %12.1f\n", burst, "spsc 1+1", throughput(spsc_ops, 1, 1, burst),
+               throughput(locked_ops, 1, 1, burst));
+        for (uint32_t pairs = 1, max = bench_max_threads() / 2 ? bench_max_threads() / 2 : 1; pairs <= max;
+             pairs = bench_next_threads(pairs, max)) {
+            char name[16];
+            snprintf(name, sizeof(name), "mpmc %u+%u", pairs, pairs);
+            printf("%-6u %-12s %12.1f %12.1f\n", burst, name, throughput(mpmc_ops, pairs, pairs, burst),
+                   throughput(locked_ops, pairs, pairs, burst));
+        }
+    }
+
+    printf("round trip latency(ns)\n");
+    printf("%-12s %12.1f\n", "spsc", latency(spsc_ops));
+    printf("%-12s %12.1f\n", "mpmc", latency(mpmc_ops));
+    printf("%-12s %12.1f\n", "locked", latency(locked_ops));
+    return 0;
+}
\ No newline at end of file
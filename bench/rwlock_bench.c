@@ -0,0 +1,114 @@
+/*
+@ rwlock read-heavy benchmark
+@ Every thread does ITERATIONS operations on a small shared table, a write every `1 / write_permille`-th one
+@ and reads otherwise. Once under the exclusive spinlock_t, once under rwlock_t, for several read/write
+@ mixes and 1, 2, 4, ... threads. Readers of rwlock_t only touch their own shard's line.
+*/
+
+#include "bench.h"
+
+#define __kcpu_id() bench_cpu
+#include "../utils/spinlock.h"
+#include "../utils/rwlock.h"
+
+#define ITERATIONS 200000
+
+static const uint32_t write_permilles[] = { 0, 10, 100, 500 };
+
+static struct {
+    spinlock_t lock __cacheline_aligned;
+    rwlock_t rw;
+    uint64_t table[8] __cacheline_aligned;
+} shared;
+
+static uint32_t write_permille;
+
+static inline uint64_t read_table(void) {
+    uint64_t sum = 0;
+    for (int i = 0; i < 8; i++) {
+        sum += ((volatile uint64_t*)shared.table)[i];
+    }
+    return sum;
+}
+
+static inline void write_table(void) {
+    for (int i = 0; i < 8; i++) {
+        shared.table[i]++;
+    }
+}
+
+//Whether operation i of a thread is a write, spread evenly over the run
+static inline int is_write(uint32_t i) {
+    return (i * write_permille) % 1000 + write_permille >= 1000;
+}
+
+static void spinlock_worker(uint32_t thread, uint32_t threads, void* arg) {
+    uint64_t sink = 0;
+    (void)thread;
+    (void)threads;
+    (void)arg;
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        lock(shared.lock);
+        if (is_write(i)) {
+            write_table();
+        } else {
+            sink += read_table();
+        }
+        unlock(shared.lock);
+    }
+    __asm__ __volatile__ ("" : : "r" (sink));
+}
+
+static void rwlock_worker(uint32_t thread, uint32_t threads, void* arg) {
+    uint64_t sink = 0;
+    (void)thread;
+    (void)threads;
+    (void)arg;
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        if (is_write(i)) {
+            write_lock(&shared.rw);
+            write_table();
+            write_unlock(&shared.rw);
+        } else {
+            read_lock(&shared.rw);
+            sink += read_table();
+            read_unlock(&shared.rw);
+        }
+    }
+    __asm__ __volatile__ ("" : : "r" (sink));
+}
+
+static uint32_t writes_per_thread(void) {
+    uint32_t writes = 0;
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        writes += is_write(i);
+    }
+    return writes;
+}
+
+static double run(uint32_t threads, bench_fn_t fn) {
+    uint64_t ns;
+    for (int i = 0; i < 8; i++) {
+        shared.table[i] = 0;
+    }
+    ns = bench_run(threads, fn, NULL);
+    //every write has to have been exclusive
+    if (shared.table[0] != (uint64_t)threads * writes_per_thread()) {
+        fprintf(stderr, "rwlock_bench: lost a write\n");
+        exit(1);
+    }
+    return (double)threads * ITERATIONS * 1000.0 / ns;
+}
+
+int main(void) {
+    printf("%-8s %-8s %16s %16s %10s\n", "writes", "threads", "spinlock Mop/s", "rwlock Mop/s", "speedup");
+    for (size_t m = 0; m < sizeof(write_permilles) / sizeof(write_permilles[0]); m++) {
+        write_permille = write_permilles[m];
+        for_each_thread_count(threads) {
+            double spin = run(threads, spinlock_worker);
+            double rw = run(threads, rwlock_worker);
+            printf("%5.1f%%   %-8u %16.1f %16.1f %9.2fx\n", write_permille / 10.0, threads, spin, rw, rw / spin);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+@ wsdeque.h fork/join benchmark
+@ A binary task tree DEPTH levels deep: an inner task forks its two children, a leaf does LEAF_WORK of busy work.
+@ Every thread stands in for a CPU with its own deque, pops its own work and steals from a random victim when
+@ it runs dry. The same tree also runs on one spinlock_t protected global stack. Reported are leaves per
+@ microsecond and the speedup over one thread, for 1, 2, 4, ... threads.
+@ Tasks are encoded in the item pointer((depth + 1) * 2, never WSDEQUE_EMPTY or WSDEQUE_ABORT), so nothing is allocated.
+*/
+
+#include "bench.h"
+#include "../utils/spinlock.h"
+
+#define MALLOC_IMPL(n) malloc(n)
+#define FREE_IMPL(p) free(p)
+#include "../utils/wsdeque.h"
+
+#define DEPTH 18
+#define LEAF_WORK 200
+#define LEAVES (1ull << DEPTH)
+
+#define TASK(depth) ((void*)(uintptr_t)(((depth) + 1) * 2))
+#define TASK_DEPTH(item) ((uint32_t)((uintptr_t)(item) / 2 - 1))
+
+static wsdeque_t deques[BENCH_MAX_THREADS];
+static volatile uint64_t leaves_done __cacheline_aligned;
+
+static struct {
+    spinlock_t lock;
+    uint32_t count;
+    void* items[1 << 16];
+} global;
+
+static inline void leaf(void) {
+    for (volatile int i = 0; i < LEAF_WORK; i++) {
+    }
+    __atomic_fetch_add(&leaves_done, 1, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t next_random(uint32_t* seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static void wsdeque_worker(uint32_t thread, uint32_t threads, void* arg) {
+    wsdeque_t* own = &deques[thread];
+    uint32_t seed = thread * 2654435761u + 1;
+    (void)arg;
+
+    while (__atomic_load_n(&leaves_done, __ATOMIC_RELAXED) < LEAVES) {
+        void* item = wsdeque_pop(own);
+        if (item == WSDEQUE_EMPTY) {
+            uint32_t victim = next_random(&seed) % threads;
+            if (victim == thread || (item = wsdeque_steal(&deques[victim])) == WSDEQUE_EMPTY || item == WSDEQUE_ABORT) {
+                sched_yield();
+                continue;
+            }
+        }
+        if (TASK_DEPTH(item) == 0) {
+            leaf();
+        } else {
+            wsdeque_push(own, TASK(TASK_DEPTH(item) - 1));
+            wsdeque_push(own, TASK(TASK_DEPTH(item) - 1));
+        }
+    }
+}
+
+static void global_worker(uint32_t thread, uint32_t threads, void* arg) {
+    (void)thread;
+    (void)threads;
+    (void)arg;
+
+    while (__atomic_load_n(&leaves_done, __ATOMIC_RELAXED) < LEAVES) {
+        void* item = NULL;
+        lock(global.lock);
+        if (global.count != 0) {
+            item = global.items[--global.count];
+        }
+        unlock(global.lock);
+        if (item == NULL) {
+            sched_yield();
+            continue;
+        }
+        if (TASK_DEPTH(item) == 0) {
+            leaf();
+        } else {
+            lock(global.lock);
+            global.items[global.count++] = TASK(TASK_DEPTH(item) - 1);
+            global.items[global.count++] = TASK(TASK_DEPTH(item) - 1);
+            unlock(global.lock);
+        }
+    }
+}
+
+static double run(uint32_t threads, bench_fn_t fn) {
+    uint64_t ns;
+    for (uint32_t i = 0; i < threads; i++) {
+        if (!wsdeque_init(&deques[i], 64)) {
+            fprintf(stderr, "wsdeque_bench: out of memory\n");
+            exit(1);
+        }
+    }
+    wsdeque_push(&deques[0], TASK(DEPTH));
+    global.count = 0;
+    global.items[global.count++] = TASK(DEPTH);
+    leaves_done = 0;
+
+    ns = bench_run(threads, fn, NULL);
+    if (leaves_done != LEAVES) {
+        fprintf(stderr, "wsdeque_bench: %llu leaves ran, expected %llu\n", (unsigned long long)leaves_done, LEAVES);
+        exit(1);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        wsdeque_destroy(&deques[i]);
+    }
+    return LEAVES * 1000.0 / ns;
+}
+
+int main(void) {
+    double wsdeque_base = 0, global_base = 0;
+
+    printf("%-8s %16s %10s %16s %10s\n", "threads", "wsdeque leaf/us", "scaling", "global leaf/us", "scaling");
+    for_each_thread_count(threads) {
+        double ws = run(threads, wsdeque_worker);
+        double gl = run(threads, global_worker);
+        if (threads == 1) {
+            wsdeque_base = ws;
+            global_base = gl;
+        }
+        printf("%-8u %16.2f %9.2fx %16.2f %9.2fx\n", threads, ws, ws / wsdeque_base, gl, gl / global_base);
+    }
+    return 0;
+}
\ No newline at end of file
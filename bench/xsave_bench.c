@@ -0,0 +1,141 @@
+/*
+@ xsave.h save/restore benchmark
+@ Cycles per xsave_save and per xsave_restore of every method the CPU has in ring 3(FXSAVE, XSAVE, XSAVEOPT,
+@ XSAVEC, XSAVES needs ring 0), for the components the kernel enabled(XCR0). With AVX the upper YMM halves
+@ are measured twice: in their init state(after VZEROUPPER) and dirty, which is where XSAVEOPT/XSAVEC can
+@ or can't skip work. Each row is the best of BATCHES batches of ITERATIONS calls, timed with rdtsc.
+@ Before timing a method its round trip is checked: MXCSR saved with one value and restored over another.
+*/
+
+#include "bench.h"
+
+#define XSAVE_USERSPACE
+#define XSAVE_IMPL
+#include "../arch/x86/xsave.h"
+#include "../arch/x86/tsc.h"
+
+#define ITERATIONS 1000
+#define BATCHES 100
+
+//MXCSR with every exception masked and rounding toward zero
+#define MXCSR_DEFAULT 0x1F80u
+#define MXCSR_TEST    0x7F80u
+
+static const char* const method_names[] = {"FXSAVE", "XSAVE", "XSAVEOPT", "XSAVEC", "XSAVES"};
+
+static inline void set_mxcsr(uint32_t value) {
+    __asm__ __volatile__ ("ldmxcsr %0" : : "m" (value));
+}
+
+static inline uint32_t get_mxcsr(void) {
+    uint32_t value;
+    __asm__ __volatile__ ("stmxcsr %0" : "=m" (value));
+    return value;
+}
+
+static int method_supported(uint8_t method, int have_xsave) {
+    switch (method) {
+        case XSAVE_METHOD_FXSAVE:
+            return 1;
+        case XSAVE_METHOD_XSAVE:
+            return have_xsave;
+        case XSAVE_METHOD_XSAVEOPT:
+            return have_xsave && (xsave_info.instructions & (CPUID_XSAVE_1_EAX_XSAVEOPT));
+        case XSAVE_METHOD_XSAVEC:
+            return have_xsave && (xsave_info.instructions & (CPUID_XSAVE_1_EAX_XSAVEC));
+        default:
+            return 0;
+    }
+}
+
+static void check_round_trip(void* area) {
+    set_mxcsr(MXCSR_TEST);
+    xsave_save(area, XSAVE_ALL);
+    set_mxcsr(MXCSR_DEFAULT);
+    xsave_restore(area, XSAVE_ALL);
+    if (get_mxcsr() != MXCSR_TEST) {
+        fprintf(stderr, "xsave_bench: %s didn't restore MXCSR(0x%x)\n", method_names[xsave_info.method], get_mxcsr());
+        exit(1);
+    }
+    set_mxcsr(MXCSR_DEFAULT);
+}
+
+//Best cycles per call over the batches, save or restore
+static uint64_t measure(void* area, int restore) {
+    uint64_t best = UINT64_MAX;
+    for (int batch = 0; batch < BATCHES; batch++) {
+        uint64_t start = rdtsc_ordered();
+        for (int i = 0; i < ITERATIONS; i++) {
+            if (restore) {
+                xsave_restore(area, XSAVE_ALL);
+            } else {
+                xsave_save(area, XSAVE_ALL);
+            }
+        }
+        uint64_t cycles = rdtsc_ordered() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best / ITERATIONS;
+}
+
+static void run(uint8_t method, int ymm, int dirty) {
+    void* area;
+
+    xsave_set_method(&xsave_info, method);
+    area = aligned_alloc(XSAVE_ALIGN, (xsave_info.size + XSAVE_ALIGN - 1) & ~(uint32_t)(XSAVE_ALIGN - 1));
+    if (area == NULL) {
+        fprintf(stderr, "xsave_bench: out of memory\n");
+        exit(1);
+    }
+    xsave_area_init(area);
+    check_round_trip(area);
+
+    //the area's state is what every restore below loads again, so the registers stay as set up here
+    if (ymm) {
+        if (dirty) {
+            __asm__ __volatile__ ("vpcmpeqd %%ymm1, %%ymm1, %%ymm1" : : : "xmm1");
+        } else {
+            __asm__ __volatile__ ("vzeroupper");
+        }
+    }
+    xsave_save(area, XSAVE_ALL);
+    xsave_restore(area, XSAVE_ALL);
+
+    uint64_t save = measure(area, 0);
+    uint64_t restore = measure(area, 1);
+    printf("%-10s %-6s %8u %12llu %12llu\n", method_names[method], !ymm ? "-" : dirty ? "dirty" : "init",
+           xsave_info.size, (unsigned long long)save, (unsigned long long)restore);
+    if (ymm) {
+        __asm__ __volatile__ ("vzeroupper");
+    }
+    free(area);
+}
+
+int main(void) {
+    uint32_t regs[4];
+    uint64_t xcr0 = XFEATURE_MASK_FPSSE;
+    int have_xsave;
+
+    //XGETBV faults unless the OS turned XSAVE on
+    cpuid_native(CPUID_CPU_INFO, 0, regs);
+    if (regs[2] & (CPUID_CPU_INFO_ECX_OSXSAVE)) {
+        xcr0 = xgetbv(0);
+    }
+    have_xsave = xsave_probe(xcr0, 0);
+    int ymm = (xsave_info.xcr0 & XFEATURE_MASK(XFEATURE_YMM)) != 0;
+
+    printf("XCR0 0x%llx\n", (unsigned long long)xsave_info.xcr0);
+    printf("%-10s %-6s %8s %12s %12s\n", "method", "ymm", "bytes", "save cycles", "restore cycles");
+    for (uint8_t method = XSAVE_METHOD_FXSAVE; method <= XSAVE_METHOD_XSAVEC; method++) {
+        if (!method_supported(method, have_xsave)) {
+            continue;
+        }
+        run(method, ymm && method != XSAVE_METHOD_FXSAVE, 0);
+        if (ymm && method != XSAVE_METHOD_FXSAVE) {
+            run(method, 1, 1);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+/*
+@ cacheinfo.h decoder test
+@ Replays the recorded CPUID dumps of cpuid_fixtures.h through cacheinfo_decode, one per cache leaf:
+@ leaf 2 descriptors(Pentium 4), leaf 4(Coffee Lake) and leaf 0x8000001D plus the AMD TLB leaves(Zen).
+*/
+
+#define CACHEINFO_IMPL
+#include "../arch/x86/cacheinfo.h"
+#include "cpuid_fixtures.h"
+#include "test.h"
+
+#define DATA        CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_DATA
+#define INSTRUCTION CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_INSTRUCTION
+#define UNIFIED     CPUID_CACHE_PARAMS_EAX_CACHE_TYPE_UNIFIED
+
+static void check_cache(const cache_info_t* info, uint32_t level, uint32_t type, uint64_t size, uint32_t ways,
+                        uint32_t sets, uint32_t sharing, uint32_t inclusive) {
+    const cache_desc_t* c = cacheinfo_find(info, level, type);
+    CHECK(c != NULL);
+    CHECK(c->type == type);
+    CHECK(c->size == size);
+    CHECK(c->ways == ways);
+    CHECK(c->sets == sets);
+    CHECK(c->line_size == 64);
+    CHECK(c->sharing == sharing);
+    CHECK(c->inclusive == inclusive);
+    CHECK(!c->fully_associative);
+}
+
+static const tlb_desc_t* find_tlb(const cache_info_t* info, uint32_t level, uint32_t type, uint32_t page_sizes) {
+    for (uint32_t i = 0; i < info->tlb_count; i++) {
+        const tlb_desc_t* t = &info->tlbs[i];
+        if (t->level == level && t->type == type && t->page_sizes == page_sizes) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void test_leaf2(void) {
+    cache_info_t info;
+    const tlb_desc_t* t;
+
+    cpuid_fixture_use(cpuid_pentium4);
+    cacheinfo_decode(&info, cpuid_fixture);
+
+    //0x66, 0x7A, the trace cache(0x70) and 0x40 are skipped
+    CHECK(info.cache_count == 2);
+    check_cache(&info, 1, DATA, 8 * 1024, 4, 32, 0, 0);
+    check_cache(&info, 2, UNIFIED, 256 * 1024, 8, 512, 0, 0);
+    CHECK(cacheinfo_find(&info, 1, INSTRUCTION) == NULL);
+    CHECK(cacheinfo_last_level(&info)->level == 2);
+
+    //0x50 and 0x5B
+    CHECK(info.tlb_count == 2);
+    t = find_tlb(&info, 1, INSTRUCTION, TLB_PAGE_4K | TLB_PAGE_2M | TLB_PAGE_4M);
+    CHECK(t != NULL && t->entries == 64);
+    t = find_tlb(&info, 1, DATA, TLB_PAGE_4K | TLB_PAGE_4M);
+    CHECK(t != NULL && t->entries == 64);
+    CHECK(info.prefetch_size == 0);
+}
+
+static void test_leaf4(void) {
+    cache_info_t info;
+
+    cpuid_fixture_use(cpuid_coffeelake);
+    cacheinfo_decode(&info, cpuid_fixture);
+
+    CHECK(info.cache_count == 4);
+    check_cache(&info, 1, DATA, 32 * 1024, 8, 64, 2, 0);
+    check_cache(&info, 1, INSTRUCTION, 32 * 1024, 8, 64, 2, 0);
+    check_cache(&info, 2, UNIFIED, 256 * 1024, 4, 1024, 2, 0);
+    check_cache(&info, 3, UNIFIED, 12 * 1024 * 1024, 16, 12288, 16, 1);
+    //sorted by level, data before instruction
+    CHECK(info.caches[0].type == DATA && info.caches[1].type == INSTRUCTION);
+    CHECK(cacheinfo_last_level(&info)->level == 3);
+    CHECK(cacheinfo_line_size(&info) == 64);
+
+    //0xF0 in leaf 2, 0xFE points at leaf 0x18 which this CPU doesn't have and Intel leaves 0x80000005 empty
+    CHECK(info.prefetch_size == 64);
+    CHECK(info.tlb_count == 0);
+}
+
+static void test_leaf8000001d(void) {
+    cache_info_t info;
+    const tlb_desc_t* t;
+
+    cpuid_fixture_use(cpuid_zen);
+    cacheinfo_decode(&info, cpuid_fixture);
+
+    CHECK(info.cache_count == 4);
+    check_cache(&info, 1, DATA, 32 * 1024, 8, 64, 2, 0);
+    check_cache(&info, 1, INSTRUCTION, 64 * 1024, 4, 256, 2, 0);
+    check_cache(&info, 2, UNIFIED, 512 * 1024, 8, 1024, 2, 1);
+    check_cache(&info, 3, UNIFIED, 8 * 1024 * 1024, 16, 8192, 8, 0);
+
+    //0x80000005: fully associative L1 TLBs, 0x80000006: the L2 TLBs
+    CHECK(info.tlb_count == 8);
+    t = find_tlb(&info, 1, DATA, TLB_PAGE_4K);
+    CHECK(t != NULL && t->entries == 64 && t->fully_associative);
+    t = find_tlb(&info, 1, INSTRUCTION, TLB_PAGE_2M | TLB_PAGE_4M);
+    CHECK(t != NULL && t->entries == 64 && t->fully_associative);
+    t = find_tlb(&info, 2, DATA, TLB_PAGE_4K);
+    CHECK(t != NULL && t->entries == 1536 && t->ways == 8);
+    t = find_tlb(&info, 2, INSTRUCTION, TLB_PAGE_4K);
+    CHECK(t != NULL && t->entries == 1024 && t->ways == 8);
+}
+
+int main(void) {
+    test_leaf2();
+    test_leaf4();
+    test_leaf8000001d();
+    printf("cacheinfo: leaf 2, leaf 4 and leaf 0x8000001D dumps decoded\n");
+    return 0;
+}
\ No newline at end of file
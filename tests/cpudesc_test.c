@@ -0,0 +1,115 @@
+/*
+@ cpudesc.h layout test
+@ Builds 256 blocks from 4 threads(each CPU builds its own, like the APs do) and checks every TSS, descriptor
+@ and stack against what the CPU will read.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../arch/x86/cpudesc.h"
+#include "test.h"
+
+#define NR_CPUS 256
+#define NR_THREADS 4
+#define STACK_SIZE 4096
+
+static cpu_desc_t* descs;
+static cpudesc_config_t config;
+
+//Hands out unaligned memory on purpose, the stack tops have to come out aligned anyway
+static void* test_alloc(uint32_t cpu, uint32_t stack, size_t size, void* ctx) {
+    (void)cpu;
+    (void)stack;
+    (void)ctx;
+    char* mem = (char*)malloc(size + 8);
+    return mem == NULL ? NULL : mem + 3;
+}
+
+static void* builder(void* arg) {
+    uintptr_t thread = (uintptr_t)arg;
+    for (uint32_t cpu = (uint32_t)thread; cpu < NR_CPUS; cpu += NR_THREADS) {
+        CHECK(cpudesc_build_one(&descs[cpu], cpu, &config) == 0);
+    }
+    return NULL;
+}
+
+static uint64_t tss_base(const gdt_entry_t* gdt) {
+    const tss_entry_t* entry = (const tss_entry_t*)&gdt[CPUDESC_TSS / sizeof(gdt_entry_t)];
+    return (uint64_t)entry->base_low | ((uint64_t)entry->base_middle << 16) |
+           ((uint64_t)entry->base_mid2 << 24) | ((uint64_t)entry->base_high << 32);
+}
+
+static void check_desc(const cpu_desc_t* desc, uint32_t cpu) {
+    const tss_entry_t* entry = (const tss_entry_t*)&desc->gdt[CPUDESC_TSS / sizeof(gdt_entry_t)];
+    const uint8_t* raw = (const uint8_t*)&desc->tss;
+
+    CHECK(desc->cpu == cpu);
+
+    //I/O map base at 0x66, past the limit
+    CHECK(raw[0x66] == sizeof(tss_t) && raw[0x67] == 0);
+    CHECK(desc->tss.iomap_base == sizeof(tss_t));
+    CHECK(desc->tss.reserved3 == 0);
+
+    //descriptor: base is this block's TSS, limit 103, available 64 bit TSS, present, DPL 0
+    CHECK(tss_base(desc->gdt) == (uint64_t)&desc->tss);
+    CHECK((entry->limit_low | ((uint32_t)(entry->flags_limit & 0x0F) << 16)) == sizeof(tss_t) - 1);
+    CHECK(entry->access == 0x89);
+    CHECK((entry->flags_limit & 0xF0) == 0);
+    CHECK(entry->zero == 0);
+
+    //the shared part of the GDT is untouched
+    for (uint32_t i = 0; i < CPUDESC_GDT_ENTRIES; i++) {
+        if (i == CPUDESC_TSS / sizeof(gdt_entry_t)) {
+            i++;
+            continue;
+        }
+        CHECK(memcmp(&desc->gdt[i], &cpudesc_gdt_template[i], sizeof(gdt_entry_t)) == 0);
+    }
+
+    CHECK(desc->gdt_pointer.base == (uint64_t)desc->gdt);
+    CHECK(desc->gdt_pointer.limit == CPUDESC_GDT_ENTRIES * sizeof(gdt_entry_t) - 1);
+
+    //stacks: aligned, unused ones left 0
+    CHECK(desc->tss.rsp0 != 0 && desc->tss.rsp0 % CPUDESC_STACK_ALIGN == 0);
+    for (uint32_t i = 0; i < CPUDESC_IST_COUNT; i++) {
+        if (config.ist_size[i] == 0) {
+            CHECK(desc->tss.ist[i] == 0);
+        } else {
+            CHECK(desc->tss.ist[i] != 0 && desc->tss.ist[i] % CPUDESC_STACK_ALIGN == 0);
+        }
+    }
+}
+
+int main(void) {
+    pthread_t threads[NR_THREADS];
+
+    CHECK(sizeof(cpu_desc_t) == 192);
+    CHECK(offsetof(tss_t, iomap_base) == 0x66);
+
+    descs = (cpu_desc_t*)aligned_alloc(CACHELINE_SIZE, cpudesc_size(NR_CPUS));
+    CHECK(descs != NULL);
+    memset(descs, 0xA5, cpudesc_size(NR_CPUS));
+
+    config.rsp0_size = STACK_SIZE;
+    config.ist_size[0] = STACK_SIZE;
+    config.ist_size[2] = STACK_SIZE;
+    config.alloc = test_alloc;
+
+    for (uintptr_t t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_create(&threads[t], NULL, builder, (void*)t) == 0);
+    }
+    for (uintptr_t t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_join(threads[t], NULL) == 0);
+    }
+
+    for (uint32_t cpu = 0; cpu < NR_CPUS; cpu++) {
+        CHECK((uintptr_t)&descs[cpu] % CACHELINE_SIZE == 0);
+        CHECK((char*)&descs[cpu] - (char*)descs == (ptrdiff_t)cpu * 192);
+        check_desc(&descs[cpu], cpu);
+    }
+
+    printf("cpudesc: %d blocks ok\n", NR_CPUS);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+@ Recorded CPUID dumps for the decoders, replayed through a cpuid_fn_t
+@ Each entry is { leaf, subleaf, eax, ebx, ecx, edx }, a leaf that isn't listed reads as all zeroes.
+@ Only the leaves the decoders under test look at are kept.
+@
+@ How to use:
+@ 1, cpuid_fixture_use(cpuid_pentium4)
+@ 2, pass cpuid_fixture as the cpuid_fn_t
+*/
+
+#ifndef __CPUID_FIXTURES_H__
+#define __CPUID_FIXTURES_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+    uint32_t leaf;
+    uint32_t subleaf;
+    uint32_t regs[4];
+} cpuid_record_t;
+
+#define CPUID_RECORD_END { 0xFFFFFFFF, 0xFFFFFFFF, { 0, 0, 0, 0 } }
+
+//Intel Pentium 4 Northwood(family 0xF model 2): max leaf 2, caches and TLBs only as leaf 2 descriptors
+static const cpuid_record_t cpuid_pentium4[] = {
+    { 0x00000000, 0, { 0x00000002, 0x756E6547, 0x6C65746E, 0x49656E69 } },
+    { 0x00000001, 0, { 0x00000F29, 0x00020809, 0x00004400, 0xBFEBFBFF } },
+    { 0x00000002, 0, { 0x665B5001, 0x00000000, 0x00000000, 0x007A7040 } },
+    { 0x80000000, 0, { 0x80000004, 0x00000000, 0x00000000, 0x00000000 } },
+    CPUID_RECORD_END
+};
+
+//Intel Core i7-8700(Coffee Lake): leaf 2 only points at leaf 4(0xFF) and leaf 0x18(0xFE, past the max leaf here)
+static const cpuid_record_t cpuid_coffeelake[] = {
+    { 0x00000000, 0, { 0x00000016, 0x756E6547, 0x6C65746E, 0x49656E69 } },
+    { 0x00000001, 0, { 0x000906EA, 0x04100800, 0x7FFAFBFF, 0xBFEBFBFF } },
+    { 0x00000002, 0, { 0x00FEFF01, 0x000000F0, 0x00000000, 0x00000000 } },
+    { 0x00000004, 0, { 0x1C004121, 0x01C0003F, 0x0000003F, 0x00000000 } },
+    { 0x00000004, 1, { 0x1C004122, 0x01C0003F, 0x0000003F, 0x00000000 } },
+    { 0x00000004, 2, { 0x1C004143, 0x00C0003F, 0x000003FF, 0x00000000 } },
+    { 0x00000004, 3, { 0x1C03C163, 0x03C0003F, 0x00002FFF, 0x00000006 } },
+    { 0x00000004, 4, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x0000000B, 0, { 0x00000001, 0x00000002, 0x00000100, 0x00000000 } },
+    { 0x0000000B, 1, { 0x00000004, 0x0000000C, 0x00000201, 0x00000000 } },
+    { 0x0000000B, 2, { 0x00000000, 0x00000000, 0x00000002, 0x00000000 } },
+    { 0x80000000, 0, { 0x80000008, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x80000001, 0, { 0x00000000, 0x00000000, 0x00000121, 0x2C100800 } },
+    { 0x80000006, 0, { 0x00000000, 0x00000000, 0x01006040, 0x00000000 } },
+    CPUID_RECORD_END
+};
+
+//AMD Ryzen 7 1700(Zen): caches from leaf 0x8000001D(TOPOEXT), TLBs from 0x80000005/0x80000006
+static const cpuid_record_t cpuid_zen[] = {
+    { 0x00000000, 0, { 0x0000000D, 0x68747541, 0x444D4163, 0x69746E65 } },
+    { 0x00000001, 0, { 0x00800F11, 0x00100800, 0x7ED8320B, 0x178BFBFF } },
+    { 0x80000000, 0, { 0x8000001F, 0x68747541, 0x444D4163, 0x69746E65 } },
+    { 0x80000001, 0, { 0x00800F11, 0x20000000, 0x35C233FF, 0x2FD3FBFF } },
+    { 0x80000005, 0, { 0xFF40FF40, 0xFF40FF40, 0x20080140, 0x40040140 } },
+    { 0x80000006, 0, { 0x26006400, 0x66006400, 0x02006140, 0x00808140 } },
+    { 0x80000008, 0, { 0x00003030, 0x00000007, 0x0000400F, 0x00000000 } },
+    { 0x8000001D, 0, { 0x00004121, 0x01C0003F, 0x0000003F, 0x00000000 } },
+    { 0x8000001D, 1, { 0x00004122, 0x00C0003F, 0x000000FF, 0x00000000 } },
+    { 0x8000001D, 2, { 0x00004143, 0x01C0003F, 0x000003FF, 0x00000002 } },
+    { 0x8000001D, 3, { 0x0001C163, 0x03C0003F, 0x00001FFF, 0x00000001 } },
+    { 0x8000001D, 4, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x8000001E, 0, { 0x00000000, 0x00000100, 0x00000000, 0x00000000 } },
+    CPUID_RECORD_END
+};
+
+/*
+@ Intel Xeon Platinum 9282(Cascade Lake-AP): two dies per package, leaf 0x1F lists the die level
+@ Put together from the documented leaf layout for this part rather than dumped: 2 threads per core,
+@ 28 cores per die(6 bits), 2 dies(1 bit), L3 shared by the 64 APIC IDs of a die.
+*/
+static const cpuid_record_t cpuid_cascadelake_ap[] = {
+    { 0x00000000, 0, { 0x0000001F, 0x756E6547, 0x6C65746E, 0x49656E69 } },
+    { 0x00000001, 0, { 0x00050657, 0x00400800, 0x7FFEFBFF, 0xBFEBFBFF } },
+    { 0x00000004, 0, { 0x7C004121, 0x01C0003F, 0x0000003F, 0x00000000 } },
+    { 0x00000004, 1, { 0x7C004122, 0x01C0003F, 0x0000003F, 0x00000000 } },
+    { 0x00000004, 2, { 0x7C004143, 0x03C0003F, 0x000003FF, 0x00000000 } },
+    { 0x00000004, 3, { 0x7C0FC163, 0x0280003F, 0x0000DFFF, 0x00000004 } },
+    { 0x00000004, 4, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x0000000B, 0, { 0x00000001, 0x00000002, 0x00000100, 0x00000000 } },
+    { 0x0000000B, 1, { 0x00000007, 0x00000070, 0x00000201, 0x00000000 } },
+    { 0x0000000B, 2, { 0x00000000, 0x00000000, 0x00000002, 0x00000000 } },
+    { 0x0000001F, 0, { 0x00000001, 0x00000002, 0x00000100, 0x00000000 } },
+    { 0x0000001F, 1, { 0x00000006, 0x00000038, 0x00000201, 0x00000000 } },
+    { 0x0000001F, 2, { 0x00000007, 0x00000070, 0x00000502, 0x00000000 } },
+    { 0x0000001F, 3, { 0x00000000, 0x00000000, 0x00000003, 0x00000000 } },
+    { 0x80000000, 0, { 0x80000008, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x80000001, 0, { 0x00000000, 0x00000000, 0x00000121, 0x2C100800 } },
+    CPUID_RECORD_END
+};
+
+static const cpuid_record_t* cpuid_fixture_current;
+
+static inline void cpuid_fixture_use(const cpuid_record_t* records) {
+    cpuid_fixture_current = records;
+}
+
+//cpuid_fn_t that replays the current dump
+static inline void cpuid_fixture(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    for (const cpuid_record_t* r = cpuid_fixture_current; r->leaf != 0xFFFFFFFF; r++) {
+        if (r->leaf == leaf && r->subleaf == subleaf) {
+            for (int i = 0; i < 4; i++) {
+                regs[i] = r->regs[i];
+            }
+            return;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        regs[i] = 0;
+    }
+}
+
+#endif // __CPUID_FIXTURES_H__
\ No newline at end of file
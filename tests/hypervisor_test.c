@@ -0,0 +1,195 @@
+/*
+@ hypervisor.h test
+@ - hypervisor_detect only takes the TSC frequency from base + 0x10 on KVM and VMware
+@ - pvclock and the Hyper-V reference TSC page are read against synthetic areas that a thread keeps rewriting
+@   the way the hypervisor would, flipping between two parameter sets that give the same time. A torn read mixes
+@   the sets and lands far outside the window the reader measured with RDTSC around the call.
+*/
+
+#include <pthread.h>
+#include "../arch/x86/hypervisor.h"
+#include "cpuid_fixtures.h"
+#include "test.h"
+
+#define READS 200000
+
+//the updaters run until the reader has done READS reads
+static volatile int reader_done;
+
+//=================Detection=================
+
+#define SIG(a, b, c) a, b, c
+#define KVM_SIG    SIG(0x4B4D564B, 0x564B4D56, 0x0000004D)
+#define HYPERV_SIG SIG(0x7263694D, 0x666F736F, 0x76482074)
+
+//CPUID_CPU_INFO ECX with the hypervisor bit
+#define HV_BIT 0x80000000
+
+static const cpuid_record_t cpuid_kvm[] = {
+    { 0x00000001, 0, { 0, 0, HV_BIT, 0 } },
+    { 0x40000000, 0, { 0x40000010, KVM_SIG } },
+    { 0x40000001, 0, { 0x01007AFB, 0, 0, 0 } },
+    { 0x40000010, 0, { 2400000, 1000000, 0, 0 } },
+    CPUID_RECORD_END
+};
+
+//Hyper-V reports a max leaf past 0x40000010 but that leaf isn't a timing leaf
+static const cpuid_record_t cpuid_hyperv[] = {
+    { 0x00000001, 0, { 0, 0, HV_BIT, 0 } },
+    { 0x40000000, 0, { 0x40000082, HYPERV_SIG } },
+    { 0x40000001, 0, { 0x31237648, 0, 0, 0 } },
+    { 0x40000003, 0, { 0x00002E7F, 0x003B8030, 0, 0x0DE4BBB6 } },
+    { 0x40000004, 0, { 0x00060E24, 0, 0, 0 } },
+    { 0x40000010, 0, { 0xDEADBEEF, 0xDEADBEEF, 0, 0 } },
+    CPUID_RECORD_END
+};
+
+static void test_detect(void) {
+    hypervisor_info_t info;
+
+    cpuid_fixture_use(cpuid_kvm);
+    CHECK(hypervisor_detect(&info, cpuid_fixture) == HYPERVISOR_KVM);
+    CHECK(info.tsc_khz == 2400000 && info.apic_bus_khz == 1000000);
+    CHECK(hypervisor_tsc_hz(&info) == 2400000000ull);
+
+    cpuid_fixture_use(cpuid_hyperv);
+    CHECK(hypervisor_detect(&info, cpuid_fixture) == HYPERVISOR_HYPERV);
+    CHECK(info.hyperv_base == 0x40000000);
+    CHECK(info.tsc_khz == 0 && info.apic_bus_khz == 0);
+    CHECK(hypervisor_tsc_hz(&info) == 0);
+}
+
+//=================pvclock=================
+
+static pvclock_vcpu_time_info_t pvclock;
+static uint64_t pv_base;
+
+#define PV_SYSTEM_TIME 1000000000000ull
+#define PV_SHIFT_BACK 1000000000ull
+
+/*
+@ Both sets run at 1 ns per TSC tick: set 0 is { base, PV_SYSTEM_TIME, 2^31, 1 },
+@ set 1 moves the timestamp and system time back by the same amount and uses 2^30, 2
+*/
+static void pvclock_set(int set) {
+    __atomic_store_n(&pvclock.version, pvclock.version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    pvclock.tsc_timestamp = set ? pv_base - PV_SHIFT_BACK : pv_base;
+    pvclock.system_time = set ? PV_SYSTEM_TIME - PV_SHIFT_BACK : PV_SYSTEM_TIME;
+    pvclock.tsc_to_system_mul = set ? 1u << 30 : 1u << 31;
+    pvclock.tsc_shift = set ? 2 : 1;
+    pvclock.flags = PVCLOCK_TSC_STABLE_BIT;
+    __atomic_store_n(&pvclock.version, pvclock.version + 1, __ATOMIC_RELEASE);
+}
+
+static void* pvclock_updater(void* arg) {
+    uint64_t* updates = (uint64_t*)arg;
+    while (!__atomic_load_n(&reader_done, __ATOMIC_ACQUIRE)) {
+        pvclock_set((int)(++*updates & 1));
+    }
+    return NULL;
+}
+
+static void test_pvclock(void) {
+    pthread_t updater;
+    uint64_t updates = 0, last = 0, mono_last = 0;
+
+    //scale_delta: shifts both ways, and a delta past 32 bits
+    CHECK(pvclock_scale_delta(1000, 1u << 31, 1) == 1000);
+    CHECK(pvclock_scale_delta(1000, 1u << 31, -1) == 250);
+    CHECK(pvclock_scale_delta(3ull << 40, 1u << 31, 0) == 3ull << 39);
+    CHECK(pvclock_scale_delta(0x123456789ull, 0xFFFFFFFF, 0) == (uint64_t)(((unsigned __int128)0x123456789ull * 0xFFFFFFFF) >> 32));
+
+    pv_base = rdtsc_ordered();
+    pvclock_set(0);
+    reader_done = 0;
+    CHECK(pthread_create(&updater, NULL, pvclock_updater, &updates) == 0);
+    for (int i = 0; i < READS; i++) {
+        uint8_t flags;
+        uint64_t t0 = rdtsc_ordered();
+        uint64_t now = pvclock_read(&pvclock, &flags);
+        uint64_t t1 = rdtsc_ordered();
+
+        CHECK(flags == PVCLOCK_TSC_STABLE_BIT);
+        CHECK(now >= PV_SYSTEM_TIME + (t0 - pv_base) && now <= PV_SYSTEM_TIME + (t1 - pv_base));
+        CHECK(now >= last);
+        last = now;
+        CHECK(pvclock_read_monotonic(&pvclock, &mono_last) >= now);
+    }
+    __atomic_store_n(&reader_done, 1, __ATOMIC_RELEASE);
+    CHECK(pthread_join(updater, NULL) == 0);
+    printf("pvclock: %d reads during %llu updates, none torn\n", READS, (unsigned long long)updates);
+}
+
+//=================Hyper-V reference TSC page=================
+
+static hv_reference_tsc_page_t hv_page;
+static uint64_t hv_scale;
+static uint64_t hv_base;
+
+/*
+@ Set 0 is { hv_scale, 0 }, set 1 runs twice as fast from hv_base: { 2 * hv_scale, -time(hv_base) }.
+@ They drift apart, but never by more than the time since hv_base, a torn read is off by about time(hv_base).
+*/
+static void hv_page_set(int set, uint32_t sequence) {
+    __atomic_store_n(&hv_page.tsc_sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    hv_page.tsc_scale = set ? 2 * hv_scale : hv_scale;
+    hv_page.tsc_offset = set ? -(int64_t)__hv_mul_high(hv_base, hv_scale) : 0;
+    __atomic_store_n(&hv_page.tsc_sequence, sequence, __ATOMIC_RELEASE);
+}
+
+static void* hv_page_updater(void* arg) {
+    uint64_t* updates = (uint64_t*)arg;
+    while (!__atomic_load_n(&reader_done, __ATOMIC_ACQUIRE)) {
+        ++*updates;
+        //the sequence is never 0 outside an update
+        hv_page_set((int)(*updates & 1), (uint32_t)*updates | 1);
+    }
+    return NULL;
+}
+
+static void test_hv_page(void) {
+    pthread_t updater;
+    uint64_t updates = 0, invalid = 0;
+
+    //2.5 GHz: one second of TSC is 10^7 units of 100ns
+    hv_scale = (uint64_t)(((unsigned __int128)1 << 64) / 250);
+    CHECK(hv_ref_tsc_scale(2500000000ull, hv_scale, 0) == 10000000 - 1);
+    CHECK(hv_ref_tsc_scale(2500000000ull, hv_scale, 5) == 10000000 + 4);
+    CHECK(__hv_mul_high(~0ull, ~0ull) == ~0ull - 1);
+
+    hv_page.tsc_sequence = 0;
+    CHECK(hv_ref_tsc_read(&hv_page) == HV_REF_TIME_INVALID);
+
+    hv_base = rdtsc_ordered();
+    hv_page_set(0, 1);
+    reader_done = 0;
+    CHECK(pthread_create(&updater, NULL, hv_page_updater, &updates) == 0);
+    for (int i = 0; i < READS; i++) {
+        uint64_t t0 = rdtsc_ordered();
+        uint64_t now = hv_ref_tsc_read(&hv_page);
+        uint64_t t1 = rdtsc_ordered();
+        uint64_t low, high;
+
+        if (now == HV_REF_TIME_INVALID) {
+            invalid++;
+            continue;
+        }
+        low = __hv_mul_high(t0, hv_scale);
+        //rounding of the two products and the offset
+        high = __hv_mul_high(t1, hv_scale) + __hv_mul_high(t1 - hv_base, hv_scale) + 2;
+        CHECK(now >= low && now <= high);
+    }
+    __atomic_store_n(&reader_done, 1, __ATOMIC_RELEASE);
+    CHECK(pthread_join(updater, NULL) == 0);
+    printf("hv reference tsc page: %d reads(%llu while invalidated) during %llu updates, none torn\n",
+           READS, (unsigned long long)invalid, (unsigned long long)updates);
+}
+
+int main(void) {
+    test_detect();
+    test_pvclock();
+    test_hv_page();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+/*
+@ isr.h userspace harness
+@ isr_test_raise() builds the frame the CPU would(aligned RSP, SS, RSP, RFLAGS, CS, RIP and an error code for
+@ the vectors that have one) and jumps into the vector's stub, the stub's IRETQ comes back to it. CS is ring 3
+@ here, so the entry path takes its SWAPGS branch, which ISR_SWAPGS turns into a NOP.
+@ Every vector is raised once, with full and minimal handlers alternating, and the delivered vector,
+@ error code and registers are checked.
+*/
+
+#define ISR_IMPL
+#define ISR_SWAPGS "nop"
+#define ISR_UNHANDLED(frame, vector) isr_test_unhandled((frame), (vector))
+
+#include <stdint.h>
+
+static void isr_test_unhandled(void* frame, uint64_t vector);
+
+#include "../arch/x86/isr.h"
+#include "test.h"
+
+#define RBX_MAGIC 0x5AFEC0DE5AFEC0DEull
+#define ERROR_MAGIC 0xE000ull
+
+//Raises vector through stub, error_code is pushed if push_error is set, rbx holds rbx while in the stub
+void isr_test_raise(void* stub, uint64_t error_code, uint64_t push_error, uint64_t rbx);
+void isr_test_return(void);
+
+__asm__ (
+    ".pushsection .text\n\t"
+    ".globl isr_test_raise\n"
+    "isr_test_raise:\n\t"
+    "pushq %rbx\n\t"
+    "movq %rcx, %rbx\n\t"
+    "movq %rsp, %rax\n\t"
+    //like the CPU, align before pushing the frame
+    "andq $-16, %rsp\n\t"
+    "movl %ss, %ecx\n\t"
+    "pushq %rcx\n\t"
+    "pushq %rax\n\t"
+    "pushfq\n\t"
+    "movl %cs, %ecx\n\t"
+    "pushq %rcx\n\t"
+    "leaq isr_test_return(%rip), %rcx\n\t"
+    "pushq %rcx\n\t"
+    "testq %rdx, %rdx\n\t"
+    "jz 1f\n\t"
+    "pushq %rsi\n"
+    "1:\n\t"
+    "jmp *%rdi\n"
+    ".globl isr_test_return\n"
+    "isr_test_return:\n\t"
+    "popq %rbx\n\t"
+    "ret\n\t"
+    ".popsection"
+);
+
+static struct {
+    uint64_t calls;
+    uint64_t vector;
+    uint64_t error_code;
+    uint64_t full;
+    uint64_t unhandled;
+} seen;
+
+static void check_frame(const isr_min_frame_t* frame) {
+    //the dispatcher was called with RSP 16 byte aligned
+    CHECK((uintptr_t)frame % 16 == 0);
+    CHECK(frame->rip == (uint64_t)(uintptr_t)isr_test_return);
+    CHECK(isr_from_user(frame));
+}
+
+static void full_handler(isr_frame_t* frame) {
+    check_frame((const isr_min_frame_t*)&frame->r11);
+    CHECK(frame->rbx == RBX_MAGIC);
+    seen.calls++;
+    seen.vector = frame->vector;
+    seen.error_code = frame->error_code;
+    seen.full = 1;
+}
+
+static void min_handler(isr_min_frame_t* frame) {
+    check_frame(frame);
+    seen.calls++;
+    seen.vector = frame->vector;
+    seen.error_code = frame->error_code;
+    seen.full = 0;
+}
+
+static void isr_test_unhandled(void* frame, uint64_t vector) {
+    check_frame((const isr_min_frame_t*)frame);
+    seen.unhandled++;
+    seen.vector = vector;
+}
+
+int main(void) {
+    uint8_t* first = (uint8_t*)isr_stub_table[0];
+
+    //stubs are 16 bytes apart and 16 byte aligned
+    for (uint32_t vector = 0; vector < ISR_VECTORS; vector++) {
+        uint8_t* stub = (uint8_t*)isr_stub_table[vector];
+        CHECK((uintptr_t)stub % 16 == 0);
+        CHECK(stub - first == (ptrdiff_t)vector * 16);
+    }
+
+    for (uint32_t vector = 0; vector < ISR_VECTORS; vector++) {
+        int has_error = isr_has_error_code(vector);
+        uint64_t error_code = has_error ? ERROR_MAGIC | vector : 0;
+
+        if (vector % 2) {
+            isr_register((uint8_t)vector, full_handler);
+        } else {
+            isr_register_minimal((uint8_t)vector, min_handler);
+        }
+        seen.calls = 0;
+        isr_test_raise(isr_stub_table[vector], error_code, (uint64_t)has_error, RBX_MAGIC);
+        CHECK(seen.calls == 1);
+        CHECK(seen.vector == vector);
+        CHECK(seen.error_code == error_code);
+        CHECK(seen.full == vector % 2);
+        isr_unregister((uint8_t)vector);
+    }
+
+    //a vector without a handler ends up in ISR_UNHANDLED
+    seen.calls = 0;
+    isr_test_raise(isr_stub_table[0x80], 0, 0, RBX_MAGIC);
+    CHECK(seen.calls == 0 && seen.unhandled == 1 && seen.vector == 0x80);
+
+    printf("isr: %d vectors delivered\n", ISR_VECTORS);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,194 @@
+/*
+@ lfstack.h ABA stress test
+@ Threads pop and push a handful of nodes as fast as they can, so the same node is popped and pushed back
+@ under a pending CAS all the time. Every node records its owner: popping a node someone else still owns,
+@ or losing/duplicating a node, means the tag didn't catch an ABA.
+@ Threads alone rarely hit the window on few CPUs, so the exact A-B-A interleaving is also replayed by hand.
+@ The same runs over the spinlock fallback(CPUs without CMPXCHG16B), then freelist_t is checked for conservation
+@ after freelist_populate. Nothing here is timed, bench/lfstack_bench.c compares the speed.
+*/
+
+#include <pthread.h>
+#include "../utils/lfstack.h"
+#include "test.h"
+
+#define NR_THREADS 4
+#define NODES 8
+#define ROUNDS 200000
+
+#define FL_OBJECTS 1000
+#define FL_BATCH 16
+
+typedef struct {
+    lfstack_node_t link; //first, so a popped lfstack_node_t* is the node
+    volatile uint32_t owner; //0 while on the stack, thread + 1 while popped
+    uint32_t pops;
+} node_t;
+
+typedef struct {
+    freelist_node_t node;
+    volatile uint32_t owner;
+} object_t;
+
+static lfstack_t stack;
+static node_t nodes[NODES];
+
+static freelist_t fl;
+static freelist_cache_t caches[NR_THREADS];
+static object_t objects[FL_OBJECTS];
+
+static void* stack_worker(void* arg) {
+    uint32_t me = (uint32_t)(uintptr_t)arg + 1;
+    node_t* held[2];
+
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        uint32_t count = 0;
+        //hold two at a time, so the top changes under the other threads' pending CAS
+        while (count < 2) {
+            node_t* node = (node_t*)lfstack_pop(&stack);
+            if (node == NULL) {
+                break;
+            }
+            CHECK(__atomic_exchange_n(&node->owner, me, __ATOMIC_ACQ_REL) == 0);
+            node->pops++;
+            held[count++] = node;
+        }
+        while (count > 0) {
+            node_t* node = held[--count];
+            CHECK(__atomic_exchange_n(&node->owner, 0, __ATOMIC_ACQ_REL) == me);
+            lfstack_push(&stack, &node->link);
+        }
+    }
+    return NULL;
+}
+
+static void run_stack(int use_lock) {
+    pthread_t threads[NR_THREADS];
+    uint32_t seen = 0;
+    uint64_t pops = 0;
+
+    lfstack_init(&stack);
+    if (use_lock) {
+        stack.use_lock = 1;
+    }
+    for (int i = 0; i < NODES; i++) {
+        nodes[i].owner = 0;
+        nodes[i].pops = 0;
+        lfstack_push(&stack, &nodes[i].link);
+    }
+
+    for (uintptr_t t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_create(&threads[t], NULL, stack_worker, (void*)t) == 0);
+    }
+    for (int t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_join(threads[t], NULL) == 0);
+    }
+
+    //every node is back exactly once
+    for (lfstack_node_t* link = lfstack_pop(&stack); link != NULL; link = lfstack_pop(&stack)) {
+        node_t* node = (node_t*)link;
+        uint32_t bit = 1u << (node - nodes);
+        CHECK(node >= nodes && node < nodes + NODES);
+        CHECK(!(seen & bit));
+        CHECK(node->owner == 0);
+        seen |= bit;
+        pops += node->pops;
+    }
+    CHECK(seen == (1u << NODES) - 1);
+    printf("lfstack(%s): %llu pops, tag %llu\n", use_lock ? "spinlock" : "lock free", (unsigned long long)pops,
+           (unsigned long long)stack.top.tag);
+}
+
+//The interleaving ABA needs, replayed by hand: a pop reads {A, tag} and A->next == B, then stalls while
+//A and B get popped and A is pushed back. Its CAS must fail, or B(now owned by someone) becomes the top.
+static void run_aba_replay(void) {
+    lfstack_top_t stale, desired;
+
+    lfstack_init(&stack);
+    nodes[2].link.next = NULL;
+    lfstack_push(&stack, &nodes[2].link);
+    lfstack_push(&stack, &nodes[1].link);
+    lfstack_push(&stack, &nodes[0].link);
+
+    stale.head = stack.top.head;
+    stale.tag = stack.top.tag;
+    desired.head = stale.head->next;
+    desired.tag = stale.tag + 1;
+    CHECK(stale.head == &nodes[0].link && desired.head == &nodes[1].link);
+
+    CHECK(lfstack_pop(&stack) == &nodes[0].link);
+    CHECK(lfstack_pop(&stack) == &nodes[1].link);
+    lfstack_push(&stack, &nodes[0].link);
+    CHECK(stack.top.head == stale.head);
+
+    CHECK(!__lfstack_dcas(&stack.top, &stale, desired));
+    CHECK(lfstack_pop(&stack) == &nodes[0].link);
+    CHECK(lfstack_pop(&stack) == &nodes[2].link);
+    CHECK(lfstack_pop(&stack) == NULL);
+    printf("lfstack: stale CAS after A-B-A rejected\n");
+}
+
+static void* freelist_worker(void* arg) {
+    uint32_t cpu = (uint32_t)(uintptr_t)arg;
+    object_t* held[3 * FL_BATCH];
+
+    for (uint32_t i = 0; i < ROUNDS / 10; i++) {
+        uint32_t count = 0;
+        //sometimes more than the cache holds, so refills and spills go through the shared stack
+        uint32_t want = (i % 7 == 0) ? 3 * FL_BATCH : 3;
+        while (count < want) {
+            object_t* obj = (object_t*)freelist_alloc(&fl, cpu);
+            if (obj == NULL) {
+                break;
+            }
+            CHECK(__atomic_exchange_n(&obj->owner, cpu + 1, __ATOMIC_ACQ_REL) == 0);
+            held[count++] = obj;
+        }
+        while (count > 0) {
+            object_t* obj = held[--count];
+            CHECK(__atomic_exchange_n(&obj->owner, 0, __ATOMIC_ACQ_REL) == cpu + 1);
+            freelist_free(&fl, cpu, obj);
+        }
+    }
+    return NULL;
+}
+
+static void run_freelist(void) {
+    pthread_t threads[NR_THREADS];
+    uint32_t total = 0;
+    uint32_t per_cpu = FL_OBJECTS / NR_THREADS;
+
+    freelist_init(&fl, caches, NR_THREADS, FL_BATCH);
+    for (uint32_t cpu = 0; cpu < NR_THREADS; cpu++) {
+        freelist_populate(&fl, cpu, &objects[cpu * per_cpu], sizeof(object_t), per_cpu);
+        //the first allocation is served from the cache
+        CHECK(caches[cpu].count >= FL_BATCH);
+    }
+
+    for (uintptr_t t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_create(&threads[t], NULL, freelist_worker, (void*)t) == 0);
+    }
+    for (int t = 0; t < NR_THREADS; t++) {
+        CHECK(pthread_join(threads[t], NULL) == 0);
+    }
+
+    //nothing lost: drain everything from one CPU
+    while (freelist_alloc(&fl, 0) != NULL) {
+        total++;
+    }
+    for (uint32_t cpu = 1; cpu < NR_THREADS; cpu++) {
+        for (freelist_node_t* obj = caches[cpu].head; obj != NULL; obj = obj->next) {
+            total++;
+        }
+    }
+    CHECK(total == per_cpu * NR_THREADS);
+    printf("freelist: %u objects accounted for\n", total);
+}
+
+int main(void) {
+    run_aba_replay();
+    run_stack(0);
+    run_stack(1);
+    run_freelist();
+    return 0;
+}
\ No newline at end of file
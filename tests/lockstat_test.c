@@ -0,0 +1,133 @@
+/*
+@ lockstat.h test
+@ Threads take a set of locks through the instrumented lock()/unlock() and bump a plain counter under each,
+@ the table has to hold one entry per (lock, call site) with exact acquisition counts. Two more cases:
+@   the same site text passed through two different pointers(as unmerged __CUR_LOC literals would be) is one entry
+@   a slot left half claimed(as by an interrupted claim) is skipped instead of waited on
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __kprintf printf
+#define __kcease abort
+#include "../utils/logger.h"
+
+#define LOCKSTAT
+#define LOCKSTAT_IMPL
+#include "../utils/spinlock.h"
+#include "test.h"
+
+#define THREADS 4
+#define ROUNDS 20000
+#define LOCKS 64
+
+static spinlock_t locks[LOCKS];
+static uint64_t counters[LOCKS];
+static spinlock_t shared;
+static uint64_t shared_counter;
+
+//Same text, different addresses
+static char site_a[] = "lockstat_test.c:shared";
+static char site_b[] = "lockstat_test.c:shared";
+
+//Entries of lock l, and the acquisitions they hold in total
+static uint32_t entries_of(spinlock_t* l, uint64_t* acquired) {
+    uint32_t entries = 0;
+    *acquired = 0;
+    for (uint32_t i = 0; i < LOCKSTAT_ENTRIES; i++) {
+        if (lockstat_table[i].lock == l) {
+            entries++;
+            *acquired += lockstat_table[i].acquired;
+            CHECK(lockstat_table[i].hold_start == 0);
+            CHECK(lockstat_table[i].contended <= lockstat_table[i].acquired);
+            CHECK(lockstat_table[i].spin_max <= lockstat_table[i].spin_total);
+            CHECK(lockstat_table[i].hold_max <= lockstat_table[i].hold_total);
+        }
+    }
+    return entries;
+}
+
+static void* worker(void* arg) {
+    uint32_t thread = (uint32_t)(uintptr_t)arg;
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        uint32_t k = (round * 7 + thread) % LOCKS;
+        if (round & 1) {
+            lock(locks[k]);
+            counters[k]++;
+            unlock(locks[k]);
+        } else {
+            lock(locks[k]);
+            counters[k]++;
+            unlock(locks[k]);
+        }
+        lockstat_lock(&shared, thread & 1 ? site_a : site_b);
+        shared_counter++;
+        lockstat_unlock(&shared);
+    }
+    return NULL;
+}
+
+static void run_threads(void) {
+    pthread_t threads[THREADS];
+    uint64_t acquired, total = 0;
+
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        CHECK(pthread_create(&threads[t], NULL, worker, (void*)t) == 0);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (int k = 0; k < LOCKS; k++) {
+        //one entry for each of the two lock() lines
+        CHECK(entries_of(&locks[k], &acquired) == 2);
+        CHECK(acquired == counters[k]);
+        total += acquired;
+    }
+    CHECK(total == (uint64_t)THREADS * ROUNDS);
+    CHECK(entries_of(&shared, &acquired) == 1);
+    CHECK(acquired == (uint64_t)THREADS * ROUNDS);
+    CHECK(shared_counter == (uint64_t)THREADS * ROUNDS);
+    lockstat_dump(4);
+}
+
+static void run_half_claimed(void) {
+    static spinlock_t lonely;
+    uint32_t slot = __lockstat_hash(&lonely);
+    uint64_t acquired;
+
+    //its home slot looks like a claim that was interrupted before the lock address was published
+    CHECK(lockstat_table[slot].lock == NULL);
+    lockstat_table[slot].lock = LOCKSTAT_CLAIMING;
+    for (int i = 0; i < 3; i++) {
+        lock(lonely);
+        unlock(lonely);
+    }
+    CHECK(entries_of(&lonely, &acquired) == 1);
+    CHECK(acquired == 3);
+    CHECK(lockstat_table[slot].lock == LOCKSTAT_CLAIMING);
+    lockstat_table[slot].lock = NULL;
+}
+
+static void run_reset(void) {
+    lockstat_reset();
+    for (uint32_t i = 0; i < LOCKSTAT_ENTRIES; i++) {
+        CHECK(lockstat_table[i].acquired == 0);
+        CHECK(lockstat_table[i].spin_total == 0);
+        CHECK(lockstat_table[i].hold_total == 0);
+    }
+}
+
+int main(void) {
+    CHECK(cur_loc_equal(site_a, site_b));
+    CHECK(!cur_loc_equal(site_a, "lockstat_test.c:share"));
+    CHECK(!cur_loc_equal("lockstat_test.c:share", site_a));
+
+    run_threads();
+    run_half_claimed();
+    run_reset();
+    printf("lockstat: %d acquisitions counted\n", THREADS * ROUNDS * 2);
+    return 0;
+}
\ No newline at end of file
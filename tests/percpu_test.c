@@ -0,0 +1,105 @@
+/*
+@ percpu.h test with PERCPU_USE_TLS
+@ Every pthread stands in for a CPU: it gets its own area from percpu_setup and loads it with percpu_load.
+@ The threads bump per-CPU variables with this_cpu_add/this_cpu_add_return, afterwards per_cpu_ptr has to see
+@ exactly each thread's adds. A percpu_counter_t is bumped in phases(mixed signs), between two phases
+@ percpu_counter_sum has to be exact and percpu_counter_read within batch * CPUs of it.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define PERCPU_USE_TLS
+#define PERCPU_IMPL
+#include "../arch/x86/percpu.h"
+#include "test.h"
+
+#define CPUS 4
+#define ADDS 100000
+#define PHASES 4
+#define PHASE_ADDS 20000
+#define BATCH 32
+
+DEFINE_PER_CPU(uint64_t, hits);
+DEFINE_PER_CPU(uint32_t, running);
+DEFINE_PERCPU_COUNTER(events, BATCH);
+
+static pthread_barrier_t phase_start, phase_end;
+static int64_t expected_events;
+
+//Value a CPU adds in a phase, negative in the odd ones to fold in both directions
+static int32_t phase_value(uint32_t cpu, int phase) {
+    return (phase & 1) ? -(int32_t)(cpu + 1) : (int32_t)(cpu + 2);
+}
+
+static void* cpu_thread(void* arg) {
+    uint32_t cpu = (uint32_t)(uintptr_t)arg;
+    uint32_t total = 0;
+
+    percpu_load(cpu);
+    CHECK(this_cpu_read(percpu_cpu_id) == cpu);
+    CHECK(this_cpu_ptr(hits) == per_cpu_ptr(hits, cpu));
+
+    for (uint32_t i = 0; i < ADDS; i++) {
+        this_cpu_add(hits, 1);
+        total += i & 7;
+        CHECK(this_cpu_add_return(running, i & 7) == total);
+    }
+
+    for (int phase = 0; phase < PHASES; phase++) {
+        pthread_barrier_wait(&phase_start);
+        for (int i = 0; i < PHASE_ADDS; i++) {
+            percpu_counter_add(&events, phase_value(cpu, phase));
+        }
+        pthread_barrier_wait(&phase_end);
+    }
+    return NULL;
+}
+
+int main(void) {
+    pthread_t threads[CPUS];
+    size_t size = (percpu_area_size() + 63) & ~(size_t)63;
+
+    CHECK(size != 0);
+    for (uint32_t cpu = 0; cpu < CPUS; cpu++) {
+        void* area = aligned_alloc(64, size);
+        CHECK(area != NULL);
+        percpu_setup(cpu, area);
+    }
+    CHECK(percpu_nr_cpus == CPUS);
+
+    CHECK(pthread_barrier_init(&phase_start, NULL, CPUS + 1) == 0);
+    CHECK(pthread_barrier_init(&phase_end, NULL, CPUS + 1) == 0);
+    for (uintptr_t cpu = 0; cpu < CPUS; cpu++) {
+        CHECK(pthread_create(&threads[cpu], NULL, cpu_thread, (void*)cpu) == 0);
+    }
+    for (int phase = 0; phase < PHASES; phase++) {
+        int64_t exact, approximate;
+        pthread_barrier_wait(&phase_start);
+        pthread_barrier_wait(&phase_end);
+        for (uint32_t cpu = 0; cpu < CPUS; cpu++) {
+            expected_events += (int64_t)PHASE_ADDS * phase_value(cpu, phase);
+        }
+        exact = percpu_counter_sum(&events);
+        approximate = percpu_counter_read(&events);
+        CHECK(exact == expected_events);
+        CHECK(llabs(approximate - exact) < (int64_t)BATCH * CPUS);
+        for_each_cpu(cpu) {
+            int32_t delta = *per_cpu_ptr(*events.delta, cpu);
+            CHECK(delta < BATCH && delta > -BATCH);
+        }
+    }
+    for (int cpu = 0; cpu < CPUS; cpu++) {
+        pthread_join(threads[cpu], NULL);
+    }
+
+    for_each_cpu(cpu) {
+        CHECK(*per_cpu_ptr(hits, cpu) == ADDS);
+        CHECK(*per_cpu_ptr(percpu_cpu_id, cpu) == cpu);
+        CHECK(*per_cpu_ptr(percpu_base, cpu) == percpu_areas[cpu]);
+    }
+    //the template itself is never written
+    CHECK(hits == 0 && running == 0 && events_delta == 0);
+    printf("percpu: %d CPUs, %llu adds each, counter %lld\n", CPUS, (unsigned long long)ADDS, (long long)expected_events);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+/*
+@ rcu.h list update stress test
+@ Readers walk a linked list in read sections while writers replace its nodes and retire the old ones with call_rcu.
+@ A retired node is poisoned by its callback(and kept, so the memory is never reused), a reader that still
+@ reaches one after its grace period sees the poison and fails the test.
+*/
+
+#include <string.h>
+#include <pthread.h>
+#include "../utils/rcu.h"
+#include "../utils/spinlock.h"
+#include "test.h"
+
+#define NR_WRITERS 2
+#define NR_READERS 4
+#define NODES 64
+#define REPLACES 100000
+
+#define NODE_LIVE   0x4C4956454C495645ull
+#define NODE_POISON 0xDEADDEADDEADDEADull
+
+typedef struct node {
+    uint64_t magic;
+    uint64_t key;
+    uint64_t value;
+    uint64_t check;  //key ^ value ^ magic
+    struct node* next;
+    struct node* graveyard;
+    rcu_head_t rcu;
+} node_t;
+
+static rcu_domain_t domain;
+static rcu_cpu_t cpus[NR_WRITERS + NR_READERS];
+static node_t* head;
+static spinlock_t list_lock;
+static node_t* graveyard;
+static spinlock_t graveyard_lock;
+static uint64_t reclaimed;
+static volatile int writers_done;
+
+static node_t* node_new(uint64_t key, uint64_t value) {
+    node_t* node = (node_t*)malloc(sizeof(node_t));
+    CHECK(node != NULL);
+    node->magic = NODE_LIVE;
+    node->key = key;
+    node->value = value;
+    node->check = key ^ value ^ NODE_LIVE;
+    node->next = NULL;
+    return node;
+}
+
+//Grace period is over: poison the node and park it, freeing would let malloc hand the memory out again
+static void node_reclaim(rcu_head_t* rcu) {
+    node_t* node = (node_t*)((char*)rcu - offsetof(node_t, rcu));
+    node->magic = NODE_POISON;
+    node->key = NODE_POISON;
+    node->value = NODE_POISON;
+    node->check = NODE_POISON;
+    node->next = (node_t*)NODE_POISON;
+    lock(graveyard_lock);
+    node->graveyard = graveyard;
+    graveyard = node;
+    reclaimed++;
+    unlock(graveyard_lock);
+}
+
+static void* writer(void* arg) {
+    uintptr_t id = (uintptr_t)arg;
+    rcu_cpu_t* cpu = &cpus[id];
+    uint64_t seed = id * 0x9E3779B97F4A7C15ull + 1;
+
+    for (uint64_t i = 0; i < REPLACES; i++) {
+        node_t** prev;
+        node_t* old;
+        node_t* fresh;
+        uint64_t key;
+
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        key = seed % NODES;
+
+        lock(list_lock);
+        prev = &head;
+        while ((*prev)->key != key) {
+            prev = &(*prev)->next;
+        }
+        old = *prev;
+        fresh = node_new(key, (i << 8) | id);
+        fresh->next = old->next;
+        rcu_assign_pointer(*prev, fresh);
+        unlock(list_lock);
+
+        call_rcu(cpu, &old->rcu, node_reclaim);
+    }
+    synchronize_rcu(cpu);
+    return NULL;
+}
+
+static void* reader(void* arg) {
+    rcu_cpu_t* cpu = &cpus[NR_WRITERS + (uintptr_t)arg];
+    uint64_t walks = 0;
+
+    while (!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE)) {
+        uint64_t expect = 0;
+        rcu_read_lock(cpu);
+        for (node_t* node = rcu_dereference(head); node != NULL; node = rcu_dereference(node->next)) {
+            CHECK(node->magic == NODE_LIVE);
+            CHECK(node->key == expect);
+            CHECK(node->check == (node->key ^ node->value ^ NODE_LIVE));
+            expect++;
+        }
+        rcu_read_unlock(cpu);
+        CHECK(expect == NODES);
+        walks++;
+    }
+    printf("reader: %llu walks\n", (unsigned long long)walks);
+    return NULL;
+}
+
+int main(void) {
+    pthread_t writers[NR_WRITERS], readers[NR_READERS];
+    node_t** tail = &head;
+
+    rcu_domain_init(&domain, cpus, NR_WRITERS + NR_READERS);
+    for (uint64_t key = 0; key < NODES; key++) {
+        *tail = node_new(key, 0);
+        tail = &(*tail)->next;
+    }
+
+    for (uintptr_t i = 0; i < NR_READERS; i++) {
+        CHECK(pthread_create(&readers[i], NULL, reader, (void*)i) == 0);
+    }
+    for (uintptr_t i = 0; i < NR_WRITERS; i++) {
+        CHECK(pthread_create(&writers[i], NULL, writer, (void*)i) == 0);
+    }
+    for (int i = 0; i < NR_WRITERS; i++) {
+        CHECK(pthread_join(writers[i], NULL) == 0);
+    }
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < NR_READERS; i++) {
+        CHECK(pthread_join(readers[i], NULL) == 0);
+    }
+
+    //synchronize_rcu at the end of every writer ran all of its callbacks
+    CHECK(reclaimed == (uint64_t)NR_WRITERS * REPLACES);
+    printf("rcu: %llu nodes replaced and reclaimed, epoch %llu\n", (unsigned long long)reclaimed,
+           (unsigned long long)domain.epoch);
+
+    while (graveyard != NULL) {
+        node_t* next = graveyard->graveyard;
+        free(graveyard);
+        graveyard = next;
+    }
+    while (head != NULL) {
+        node_t* next = head->next;
+        free(head);
+        head = next;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+/*
+@ rwlock.h test
+@ Every pthread stands in for a CPU(__kcpu_id() is a thread local). Two parts:
+@   a CPU already holding a read lock takes it again while a writer is waiting for it to drain,
+@   which has to go through(like an IRQ reader nested in task context) while other CPUs stay out
+@   threads mix writes and nested reads of a table, a reader must never see a half written table
+@   and a writer must never share the lock
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+static __thread uint32_t cur_cpu;
+#define __kcpu_id() cur_cpu
+#include "../utils/rwlock.h"
+#include "test.h"
+
+#define THREADS 4
+#define ROUNDS 100000
+#define ENTRIES 8
+
+static rwlock_t rw = RWLOCK_INIT;
+static volatile uint32_t writer_done, reader_in;
+static uint64_t table[ENTRIES];
+static volatile uint32_t writers_in;
+
+static void* pending_writer(void* arg) {
+    cur_cpu = (uint32_t)(uintptr_t)arg;
+    write_lock(&rw);
+    writer_done = 1;
+    write_unlock(&rw);
+    return NULL;
+}
+
+static void* plain_reader(void* arg) {
+    cur_cpu = (uint32_t)(uintptr_t)arg;
+    read_lock(&rw);
+    reader_in = 1;
+    read_unlock(&rw);
+    return NULL;
+}
+
+static void nested_test(void) {
+    pthread_t writer, reader;
+
+    cur_cpu = 0;
+    read_lock(&rw);
+    CHECK(pthread_create(&writer, NULL, pending_writer, (void*)1) == 0);
+    while (__atomic_load_n(&rw.writer, __ATOMIC_ACQUIRE) != RWLOCK_WRITER_WAITING) {
+        usleep(100);
+    }
+    //a fresh reader on another CPU backs off for the waiting writer...
+    CHECK(pthread_create(&reader, NULL, plain_reader, (void*)2) == 0);
+    usleep(20000);
+    CHECK(!reader_in);
+    //...but this CPU is already inside, the writer is waiting for it
+    read_lock(&rw);
+    CHECK(!writer_done);
+    read_unlock(&rw);
+    CHECK(!writer_done);
+    read_unlock(&rw);
+    CHECK(pthread_join(writer, NULL) == 0);
+    CHECK(pthread_join(reader, NULL) == 0);
+    CHECK(writer_done && reader_in);
+    CHECK(rw.writer == 0);
+    for (uint32_t i = 0; i < RWLOCK_SHARDS; i++) {
+        CHECK(rw.readers[i].count == 0);
+    }
+}
+
+//Whether the table is in one piece, checked under a read lock
+static int table_consistent(void) {
+    for (int i = 1; i < ENTRIES; i++) {
+        if (((volatile uint64_t*)table)[i] != ((volatile uint64_t*)table)[0]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void* stress_thread(void* arg) {
+    cur_cpu = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        if (i % 16 == cur_cpu) {
+            write_lock(&rw);
+            CHECK(__atomic_add_fetch(&writers_in, 1, __ATOMIC_SEQ_CST) == 1);
+            for (int j = 0; j < ENTRIES; j++) {
+                table[j]++;
+            }
+            __atomic_sub_fetch(&writers_in, 1, __ATOMIC_SEQ_CST);
+            write_unlock(&rw);
+        } else {
+            read_lock(&rw);
+            CHECK(!writers_in);
+            CHECK(table_consistent());
+            if (i & 1) {
+                read_lock(&rw);
+                CHECK(table_consistent());
+                read_unlock(&rw);
+            }
+            CHECK(table_consistent());
+            read_unlock(&rw);
+        }
+    }
+    return NULL;
+}
+
+static void stress_test(void) {
+    pthread_t threads[THREADS];
+
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        CHECK(pthread_create(&threads[t], NULL, stress_thread, (void*)t) == 0);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        CHECK(pthread_join(threads[t], NULL) == 0);
+    }
+    //every thread writes on one round in 16
+    CHECK(table[0] == (uint64_t)THREADS * (ROUNDS / 16 + (ROUNDS % 16 > 0)));
+    CHECK(table_consistent());
+    CHECK(rw.writer == 0);
+}
+
+int main(void) {
+    nested_test();
+    stress_test();
+    printf("rwlock: ok\n");
+    return 0;
+}
\ No newline at end of file
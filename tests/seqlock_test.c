@@ -0,0 +1,85 @@
+/*
+@ seqlock.h torn read test
+@ Writers keep rewriting a multi word payload(every word the same value, plus a checksum) under write_seqlock,
+@ readers copy it inside a read section and, once read_seqretry says the copy is good, assert it isn't torn.
+*/
+
+#include <pthread.h>
+#include "../utils/seqlock.h"
+#include "test.h"
+
+#define NR_WRITERS 2
+#define NR_READERS 4
+#define WRITES 200000
+#define WORDS 8
+
+static seqlock_t sl = SEQLOCK_INIT;
+static uint64_t payload[WORDS + 1]; //the last word is the sum of the others
+static volatile int writers_done;
+
+static void* writer(void* arg) {
+    uint64_t id = (uintptr_t)arg;
+    for (uint64_t i = 1; i <= WRITES; i++) {
+        uint64_t value = (i << 8) | id;
+        write_seqlock(&sl);
+        for (int w = 0; w < WORDS; w++) {
+            __atomic_store_n(&payload[w], value, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&payload[WORDS], value * WORDS, __ATOMIC_RELAXED);
+        write_sequnlock(&sl);
+    }
+    return NULL;
+}
+
+static void* reader(void* arg) {
+    uint64_t copy[WORDS + 1];
+    uint64_t reads = 0, retries = 0;
+    (void)arg;
+
+    while (!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE)) {
+        uint32_t seq;
+        int first = 1;
+        do {
+            if (!first) {
+                retries++;
+            }
+            first = 0;
+            seq = read_seqbegin(&sl);
+            for (int w = 0; w <= WORDS; w++) {
+                copy[w] = __atomic_load_n(&payload[w], __ATOMIC_RELAXED);
+            }
+        } while (read_seqretry(&sl, seq));
+
+        CHECK(seq % 2 == 0);
+        for (int w = 1; w < WORDS; w++) {
+            CHECK(copy[w] == copy[0]);
+        }
+        CHECK(copy[WORDS] == copy[0] * WORDS);
+        reads++;
+    }
+    printf("reader: %llu reads, %llu retries\n", (unsigned long long)reads, (unsigned long long)retries);
+    return NULL;
+}
+
+int main(void) {
+    pthread_t writers[NR_WRITERS], readers[NR_READERS];
+
+    for (uintptr_t i = 0; i < NR_READERS; i++) {
+        CHECK(pthread_create(&readers[i], NULL, reader, (void*)i) == 0);
+    }
+    for (uintptr_t i = 0; i < NR_WRITERS; i++) {
+        CHECK(pthread_create(&writers[i], NULL, writer, (void*)i) == 0);
+    }
+    for (int i = 0; i < NR_WRITERS; i++) {
+        CHECK(pthread_join(writers[i], NULL) == 0);
+    }
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < NR_READERS; i++) {
+        CHECK(pthread_join(readers[i], NULL) == 0);
+    }
+
+    //every write section bumped the sequence twice
+    CHECK(sl.seqcount.sequence == 2u * NR_WRITERS * WRITES);
+    printf("seqlock: %d writes, no torn reads\n", NR_WRITERS * WRITES);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+/*
+@ Shared bits of the userspace tests
+@ CHECK(cond) aborts the test with the file, line and condition if cond is false
+*/
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+#endif // __TEST_H__
\ No newline at end of file
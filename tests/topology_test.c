@@ -0,0 +1,200 @@
+/*
+@ topology.h test
+@ fixtures: the CPUID dumps of cpuid_fixtures.h through topology_probe and topology_add_cpu, leaf 0xB(Coffee Lake),
+@           leaf 0x1F with two dies(Cascade Lake-AP) and the AMD leaves 0x80000008/0x8000001E(Zen), checking the
+@           shifts and the SMT/LLC/package masks of a table filled with the APIC IDs those parts use
+@ host:     every online CPU's APIC ID(read on that CPU) decoded with the native shifts, against core_id,
+@           physical_package_id and thread_siblings_list under /sys/devices/system/cpu
+*/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "../arch/x86/topology.h"
+#include "cpuid_fixtures.h"
+#include "test.h"
+
+static topology_t topo;
+
+//Builds a mask from a list of CPUs ending in -1
+static cpumask_t mask_of(const int* cpus) {
+    cpumask_t mask;
+    cpumask_clear_all(&mask);
+    for (; *cpus >= 0; cpus++) {
+        cpumask_set(&mask, (uint32_t)*cpus);
+    }
+    return mask;
+}
+
+static int mask_equal(const cpumask_t* a, const cpumask_t* b) {
+    for (uint32_t i = 0; i < (TOPOLOGY_MAX_CPUS + 63) / 64; i++) {
+        if (a->bits[i] != b->bits[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#define CHECK_MASK(mask, ...) do { \
+    static const int __cpus[] = { __VA_ARGS__, -1 }; \
+    cpumask_t __expected = mask_of(__cpus); \
+    CHECK(mask_equal((mask), &__expected)); \
+} while (0)
+
+static void check_shifts(uint8_t smt, uint8_t core, uint8_t die, uint8_t llc) {
+    CHECK(topo.shifts.smt_shift == smt);
+    CHECK(topo.shifts.core_shift == core);
+    CHECK(topo.shifts.die_shift == die);
+    CHECK(topo.shifts.llc_shift == llc);
+}
+
+//i7-8700: 6 cores, APIC ID = core << 1 | thread, Linux numbers the first threads 0-5 and their siblings 6-11
+static void test_leaf_b(void) {
+    cpuid_fixture_use(cpuid_coffeelake);
+    topology_init(&topo, cpuid_fixture);
+    check_shifts(1, 4, 4, 4);
+    for (uint32_t cpu = 0; cpu < 12; cpu++) {
+        topology_add_cpu(&topo, cpu, (cpu % 6) << 1 | cpu / 6);
+    }
+    CHECK(topo.count == 12);
+    CHECK(topo.cpus[7].ids.core == 1 && topo.cpus[7].ids.smt == 1 && topo.cpus[7].ids.package == 0);
+    CHECK_MASK(topology_smt_siblings(&topo, 0), 0, 6);
+    CHECK_MASK(topology_smt_siblings(&topo, 11), 5, 11);
+    CHECK_MASK(topology_llc_siblings(&topo, 3), 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
+    CHECK_MASK(topology_package_siblings(&topo, 3), 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
+}
+
+//9282: APIC ID = package << 7 | die << 6 | core << 1 | thread, a few CPUs of both dies of two packages
+static void test_leaf_1f(void) {
+    static const uint32_t apic_ids[] = { 0x00, 0x01, 0x02, 0x40, 0x41, 0x80, 0xC0, 0xC3 };
+
+    cpuid_fixture_use(cpuid_cascadelake_ap);
+    topology_init(&topo, cpuid_fixture);
+    check_shifts(1, 6, 7, 6);
+    for (uint32_t cpu = 0; cpu < sizeof(apic_ids) / sizeof(apic_ids[0]); cpu++) {
+        topology_add_cpu(&topo, cpu, apic_ids[cpu]);
+    }
+    CHECK(topo.cpus[3].ids.die == 1 && topo.cpus[3].ids.core == 0 && topo.cpus[3].ids.package == 0);
+    CHECK(topo.cpus[6].ids.die == 1 && topo.cpus[6].ids.package == 1);
+    CHECK(topo.cpus[7].ids.core == 1 && topo.cpus[7].ids.smt == 1);
+    //core 0 exists on both dies, only the die ID tells them apart
+    CHECK_MASK(topology_smt_siblings(&topo, 0), 0, 1);
+    CHECK_MASK(topology_smt_siblings(&topo, 3), 3, 4);
+    CHECK_MASK(topology_smt_siblings(&topo, 5), 5);
+    CHECK_MASK(topology_llc_siblings(&topo, 0), 0, 1, 2);
+    CHECK_MASK(topology_llc_siblings(&topo, 4), 3, 4);
+    CHECK_MASK(topology_llc_siblings(&topo, 6), 6, 7);
+    CHECK_MASK(topology_package_siblings(&topo, 2), 0, 1, 2, 3, 4);
+    CHECK_MASK(topology_package_siblings(&topo, 7), 5, 6, 7);
+    CHECK(!topology_shares_llc(&topo, 0, 3));
+}
+
+//Ryzen 7 1700: 8 cores in two CCX of 4, APIC ID = core << 1 | thread, first threads 0-7, siblings 8-15
+static void test_amd(void) {
+    cpuid_fixture_use(cpuid_zen);
+    topology_init(&topo, cpuid_fixture);
+    check_shifts(1, 4, 4, 3);
+    for (uint32_t cpu = 0; cpu < 16; cpu++) {
+        topology_add_cpu(&topo, cpu, (cpu % 8) << 1 | cpu / 8);
+    }
+    CHECK_MASK(topology_smt_siblings(&topo, 0), 0, 8);
+    CHECK_MASK(topology_smt_siblings(&topo, 13), 5, 13);
+    CHECK_MASK(topology_llc_siblings(&topo, 0), 0, 1, 2, 3, 8, 9, 10, 11);
+    CHECK_MASK(topology_llc_siblings(&topo, 12), 4, 5, 6, 7, 12, 13, 14, 15);
+    CHECK_MASK(topology_package_siblings(&topo, 0), 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    CHECK(topology_shares_llc(&topo, 1, 9));
+    CHECK(!topology_shares_llc(&topo, 3, 4));
+}
+
+//Reads one number from a sysfs file, -1 if it isn't there
+static long sysfs_number(uint32_t cpu, const char* name) {
+    char path[128];
+    long value = -1;
+    FILE* file;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/%s", cpu, name);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    if (fscanf(file, "%ld", &value) != 1) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
+
+//Reads a CPU list("0-3,8") from sysfs, 0 if it isn't there
+static int sysfs_list(uint32_t cpu, const char* name, cpumask_t* mask) {
+    char path[128];
+    unsigned first, last;
+    char separator;
+    FILE* file;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/%s", cpu, name);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    cpumask_clear_all(mask);
+    while (fscanf(file, "%u", &first) == 1) {
+        last = first;
+        separator = (char)fgetc(file);
+        if (separator == '-') {
+            CHECK(fscanf(file, "%u", &last) == 1);
+            separator = (char)fgetc(file);
+        }
+        for (unsigned c = first; c <= last && c < TOPOLOGY_MAX_CPUS; c++) {
+            cpumask_set(mask, c);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+static void test_host(void) {
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    cpu_set_t set, original;
+    uint32_t checked = 0;
+
+    CHECK(sched_getaffinity(0, sizeof(original), &original) == 0);
+    topology_init(&topo, cpuid_native);
+    for (uint32_t cpu = 0; cpu < (uint32_t)configured && cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        //offline or not ours to run on
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            continue;
+        }
+        topology_add_cpu(&topo, cpu, topology_apic_id(cpuid_native));
+    }
+    CHECK(sched_setaffinity(0, sizeof(original), &original) == 0);
+
+    for_each_cpu_in(cpu, &topo.present) {
+        const cpu_ids_t* ids = &topo.cpus[cpu].ids;
+        long core_id = sysfs_number(cpu, "core_id");
+        long package_id = sysfs_number(cpu, "physical_package_id");
+        cpumask_t siblings;
+
+        if (core_id < 0 || package_id < 0 || !sysfs_list(cpu, "thread_siblings_list", &siblings)) {
+            continue;
+        }
+        //Linux's core_id counts cores within the package, dies included
+        CHECK((uint32_t)core_id == ((ids->die << (topo.shifts.core_shift - topo.shifts.smt_shift)) | ids->core));
+        CHECK((uint32_t)package_id == ids->package);
+        CHECK(mask_equal(topology_smt_siblings(&topo, cpu), &siblings));
+        checked++;
+    }
+    printf("topology: shifts smt %u core %u die %u llc %u, %u host CPUs match sysfs\n",
+           topo.shifts.smt_shift, topo.shifts.core_shift, topo.shifts.die_shift, topo.shifts.llc_shift, checked);
+}
+
+int main(void) {
+    test_leaf_b();
+    test_leaf_1f();
+    test_amd();
+    test_host();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+/*
+@ tsc.h and tsc_clock.h test
+@ tsc_calc_mult_shift: no 64 bit overflow at TSC_MAX_DELTA_SECONDS worth of cycles, rounding error within what
+@                      the precision of mult allows
+@ tsc_probe:           synthetic leaf 0x15/0x16 dumps
+@ accuracy:            tsc_calibrate against CLOCK_MONOTONIC, then tsc_cycles_to_ns and tsc_clock_read have to stay
+@                      within PPM_BOUND of clock_gettime over ~1 s
+@ monotonic:           tsc_clock_read never goes backwards while another thread keeps calling tsc_clock_update
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "../arch/x86/tsc_clock.h"
+#include "cpuid_fixtures.h"
+#include "test.h"
+
+//Allowed deviation from CLOCK_MONOTONIC, the calibration window alone is good for a few ppm
+#define PPM_BOUND 100
+//Allowed offset between two reads that should have happened at the same time(preemption between them)
+#define SLACK_NS 50000
+#define CALIBRATION_NS 100000000ull
+#define UPDATES 200000
+
+//Crystal clock reported: 24 MHz * 166 / 2 = 1.992 GHz
+static const cpuid_record_t cpuid_tsc_crystal[] = {
+    { 0x00000000, 0, { 0x00000016, 0x756E6547, 0x6C65746E, 0x49656E69 } },
+    { 0x00000015, 0, { 0x00000002, 0x000000A6, 0x016E3600, 0x00000000 } },
+    { 0x00000016, 0, { 0x00000BB8, 0x00000FA0, 0x00000064, 0x00000000 } },
+    { 0x80000000, 0, { 0x80000008, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x80000007, 0, { 0x00000000, 0x00000000, 0x00000000, 0x00000100 } },
+    CPUID_RECORD_END
+};
+
+//Leaf 0x15 without the crystal frequency(as on Skylake client parts), the 0x16 base frequency of 3 GHz is used
+static const cpuid_record_t cpuid_tsc_freq_info[] = {
+    { 0x00000000, 0, { 0x00000016, 0x756E6547, 0x6C65746E, 0x49656E69 } },
+    { 0x00000015, 0, { 0x00000002, 0x000000FA, 0x00000000, 0x00000000 } },
+    { 0x00000016, 0, { 0x00000BB8, 0x00000FA0, 0x00000064, 0x00000000 } },
+    { 0x80000000, 0, { 0x80000008, 0x00000000, 0x00000000, 0x00000000 } },
+    { 0x80000007, 0, { 0x00000000, 0x00000000, 0x00000000, 0x00000100 } },
+    CPUID_RECORD_END
+};
+
+//Neither leaf and no invariant TSC, the frequency has to be calibrated
+static const cpuid_record_t cpuid_tsc_none[] = {
+    { 0x00000000, 0, { 0x0000000D, 0x68747541, 0x444D4163, 0x69746E65 } },
+    { 0x80000000, 0, { 0x80000004, 0x00000000, 0x00000000, 0x00000000 } },
+    CPUID_RECORD_END
+};
+
+static tsc_clock_t clock_under_test;
+static volatile int updater_done;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * TSC_NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t distance(uint64_t a, uint64_t b) {
+    return a > b ? a - b : b - a;
+}
+
+static void test_mult_shift(void) {
+    static const uint64_t frequencies[] = {
+        19200000ull, 24000000ull, 100000000ull, 1000000000ull, 1992000000ull, 2500000000ull, 3700000000ull, 5800000000ull
+    };
+    for (size_t f = 0; f < sizeof(frequencies) / sizeof(frequencies[0]); f++) {
+        uint64_t hz = frequencies[f];
+        uint64_t max_cycles = (uint64_t)TSC_MAX_DELTA_SECONDS * hz;
+        tsc_info_t tsc;
+
+        tsc_set_frequency(&tsc, hz, TSC_FREQ_EXTERNAL);
+        CHECK(tsc.mult != 0 && tsc.shift != 0);
+        //the whole window fits in 64 bits
+        CHECK((unsigned __int128)max_cycles * tsc.mult <= UINT64_MAX);
+
+        //mult is rounded to the nearest 1 / 2^shift, so a conversion is off by at most half of that per cycle
+        for (uint64_t seconds = 1; seconds <= TSC_MAX_DELTA_SECONDS; seconds *= 10) {
+            uint64_t cycles = seconds * hz + 12345;
+            uint64_t exact = (uint64_t)((unsigned __int128)cycles * TSC_NSEC_PER_SEC / hz);
+            uint64_t bound = (uint64_t)(((unsigned __int128)cycles >> (tsc.shift + 1)) + 1);
+            CHECK(distance(tsc_cycles_to_ns(&tsc, cycles), exact) <= bound);
+            //which is well below a ppm for every frequency above
+            CHECK(distance(tsc_cycles_to_ns(&tsc, cycles), exact) <= exact / 1000000 + 1);
+        }
+        CHECK(tsc_ns_to_cycles(&tsc, TSC_NSEC_PER_SEC) == hz);
+    }
+}
+
+static void test_probe(void) {
+    tsc_info_t tsc;
+
+    cpuid_fixture_use(cpuid_tsc_crystal);
+    CHECK(tsc_probe(&tsc, cpuid_fixture));
+    CHECK(tsc.source == TSC_FREQ_CPUID_TSC);
+    CHECK(tsc.hz == 1992000000ull);
+    CHECK(tsc.invariant);
+    CHECK(tsc.mult != 0);
+
+    cpuid_fixture_use(cpuid_tsc_freq_info);
+    CHECK(tsc_probe(&tsc, cpuid_fixture));
+    CHECK(tsc.source == TSC_FREQ_CPUID_FREQ_INFO);
+    CHECK(tsc.hz == 3000000000ull);
+    CHECK(tsc.invariant);
+
+    cpuid_fixture_use(cpuid_tsc_none);
+    CHECK(!tsc_probe(&tsc, cpuid_fixture));
+    CHECK(tsc.source == TSC_FREQ_UNKNOWN);
+    CHECK(tsc.hz == 0 && tsc.mult == 0);
+    CHECK(!tsc.invariant);
+}
+
+static void test_accuracy(void) {
+    tsc_info_t tsc;
+    uint64_t t0, t1, m0, m1, c0, c1, elapsed, bound;
+
+    tsc_set_frequency(&tsc, tsc_calibrate(monotonic_ns, CALIBRATION_NS), TSC_FREQ_CALIBRATED);
+    CHECK(tsc.hz != 0);
+
+    m0 = monotonic_ns();
+    t0 = rdtsc_ordered();
+    tsc_clock_init(&clock_under_test, &tsc, m0);
+    c0 = tsc_clock_read(&clock_under_test);
+    //~1 s, with the updates a timer tick would do
+    for (int i = 0; i < 10; i++) {
+        struct timespec step = { 0, 100000000 };
+        nanosleep(&step, NULL);
+        tsc_clock_update(&clock_under_test);
+    }
+    m1 = monotonic_ns();
+    t1 = rdtsc_ordered();
+    c1 = tsc_clock_read(&clock_under_test);
+
+    elapsed = m1 - m0;
+    bound = elapsed / 1000000 * PPM_BOUND + SLACK_NS;
+    printf("tsc: %llu Hz, %llu ns by CLOCK_MONOTONIC, %llu ns by tsc_cycles_to_ns, %llu ns by tsc_clock_read\n",
+           (unsigned long long)tsc.hz, (unsigned long long)elapsed,
+           (unsigned long long)tsc_cycles_to_ns(&tsc, t1 - t0), (unsigned long long)(c1 - m0));
+    CHECK(distance(tsc_cycles_to_ns(&tsc, t1 - t0), elapsed) <= bound);
+    CHECK(distance(c0, m0) <= SLACK_NS);
+    CHECK(distance(c1, m1) <= bound);
+}
+
+static void* updater(void* arg) {
+    (void)arg;
+    for (int i = 0; i < UPDATES; i++) {
+        tsc_clock_update(&clock_under_test);
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&updater_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void test_monotonic(void) {
+    pthread_t thread;
+    cpu_set_t set;
+    uint64_t last = 0, reads = 0;
+
+    //"never goes backwards" holds on one CPU, the reader stays on one
+    CPU_ZERO(&set);
+    CPU_SET(sched_getcpu(), &set);
+    CHECK(sched_setaffinity(0, sizeof(set), &set) == 0);
+
+    CHECK(pthread_create(&thread, NULL, updater, NULL) == 0);
+    while (!__atomic_load_n(&updater_done, __ATOMIC_ACQUIRE)) {
+        uint64_t now = tsc_clock_read(&clock_under_test);
+        CHECK(now >= last);
+        last = now;
+        if (++reads % 1024 == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    printf("tsc: %llu reads across %d updates, never backwards\n", (unsigned long long)reads, UPDATES);
+}
+
+int main(void) {
+    test_mult_shift();
+    test_probe();
+    test_accuracy();
+    test_monotonic();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+//Size of a cache line on every x86 CPU worth caring about
+#define CACHELINE_SIZE 64
+
+//Aligns a variable or struct member to(and pads it out to) its own cache line
+#define __cacheline_aligned __attribute__((aligned(CACHELINE_SIZE)))
+
+//Groups variables that are written once and read everywhere, so they never share a line with hot written data
+#define __read_mostly __attribute__((section(".data.read_mostly")))
+
+//Written while booting and read only after that(the kernel write protects the section once init is done)
+#define __ro_after_init __attribute__((section(".data..ro_after_init")))
+
+#endif // __CACHE_H__
\ No newline at end of file
@@ -8,4 +8,26 @@
 
 #define __CUR_LOC (__FILE__ ":" TOSTRING(__LINE__))
 
+/*
+@ Whether two __CUR_LOC strings name the same call site. Identical string literals are usually merged, so
+@ the pointers match, but the compiler doesn't have to(e.g. across translation units or with -fno-merge-constants).
+*/
+static inline int cur_loc_equal(const char* a, const char* b) {
+    if (a == b) {
+        return 1;
+    }
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+//Compile time assert that works in both C and C++
+#ifdef __cplusplus
+    #define STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+    #define STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
 #endif // __DEBUG_H__
\ No newline at end of file
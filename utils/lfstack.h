@@ -0,0 +1,240 @@
+/*
+@ KrnlAid lock-free stack(Treiber stack) and per-CPU cached freelist
+@ The top of the stack is a {pointer, tag} pair swapped with a double width CAS(CMPXCHG16B on x86_64,
+@ CMPXCHG8B on i386). Every change bumps the tag, so a pop can't be fooled by a node that got popped
+@ and pushed back in the meantime(ABA).
+@ CPUs without the double width CAS(the very first x86_64 CPUs) fall back to a spinlock.
+@
+@ IMPORTANT: a pop reads the next pointer of a node another CPU may have popped already,
+@ so memory that was on a stack must stay mapped(recycle it, e.g. through freelist_t, don't unmap it)
+*/
+
+#ifndef __LFSTACK_H__
+#define __LFSTACK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cache.h"
+#include "spinlock.h"
+#include "../arch/x86/cpuid.h"
+
+typedef struct lfstack_node {
+    struct lfstack_node* next;
+} lfstack_node_t;
+
+typedef struct {
+    lfstack_node_t* head;
+    uintptr_t tag;
+} __attribute__((aligned(2 * sizeof(void*)))) lfstack_top_t;
+
+typedef struct {
+    lfstack_top_t top;
+    uint8_t use_lock; //no double width CAS on this CPU
+    spinlock_t lock;
+} __cacheline_aligned lfstack_t;
+
+//Compares *mem with *expected and swaps in desired if they match, otherwise loads *mem into *expected
+static inline int __lfstack_dcas(lfstack_top_t* mem, lfstack_top_t* expected, lfstack_top_t desired) {
+    uint8_t ok;
+    #ifdef __x86_64__
+        __asm__ __volatile__ (
+            "lock cmpxchg16b %1\n\t"
+            "setz %0"
+            : "=q" (ok), "+m" (*mem), "+a" (expected->head), "+d" (expected->tag)
+            : "b" (desired.head), "c" (desired.tag)
+            : "memory", "cc"
+        );
+    #else
+        __asm__ __volatile__ (
+            "lock cmpxchg8b %1\n\t"
+            "setz %0"
+            : "=q" (ok), "+m" (*mem), "+a" (expected->head), "+d" (expected->tag)
+            : "b" (desired.head), "c" (desired.tag)
+            : "memory", "cc"
+        );
+    #endif
+    return ok;
+}
+
+//Sets up an empty stack and picks the lock free or the spinlock path for this CPU
+static inline void lfstack_init(lfstack_t* s) {
+    int a, b, c, d;
+    s->top.head = NULL;
+    s->top.tag = 0;
+    s->lock = 0;
+    cpuid(CPUID_CPU_INFO, 0, &a, &b, &c, &d);
+    #ifdef __x86_64__
+        s->use_lock = !(c & (CPUID_CPU_INFO_ECX_CMPXCHG16B));
+    #else
+        s->use_lock = !(d & (CPUID_CPU_INFO_EDX_CX8));
+    #endif
+}
+
+//Pushes a chain of nodes(first->...->last) with a single CAS
+static inline void lfstack_push_chain(lfstack_t* s, lfstack_node_t* first, lfstack_node_t* last) {
+    lfstack_top_t old, new_top;
+    if (s->use_lock) {
+        lock(s->lock);
+        last->next = s->top.head;
+        s->top.head = first;
+        unlock(s->lock);
+        return;
+    }
+    //a torn read is fine, the CAS fails and reloads both halves
+    old.tag = s->top.tag;
+    old.head = s->top.head;
+    do {
+        last->next = old.head;
+        new_top.head = first;
+        new_top.tag = old.tag + 1;
+    } while (!__lfstack_dcas(&s->top, &old, new_top));
+}
+
+static inline void lfstack_push(lfstack_t* s, lfstack_node_t* node) {
+    lfstack_push_chain(s, node, node);
+}
+
+//Pops the most recently pushed node, returns NULL if the stack is empty
+static inline lfstack_node_t* lfstack_pop(lfstack_t* s) {
+    lfstack_top_t old, new_top;
+    if (s->use_lock) {
+        lfstack_node_t* node;
+        lock(s->lock);
+        node = s->top.head;
+        if (node != NULL) {
+            s->top.head = node->next;
+        }
+        unlock(s->lock);
+        return node;
+    }
+    old.tag = s->top.tag;
+    old.head = s->top.head;
+    do {
+        if (old.head == NULL) {
+            return NULL;
+        }
+        new_top.head = old.head->next;
+        new_top.tag = old.tag + 1;
+    } while (!__lfstack_dcas(&s->top, &old, new_top));
+    return old.head;
+}
+
+//=================Per-CPU cached freelist=================
+
+/*
+@ Objects on a freelist have to start with a freelist_node_t(so they are at least 2 pointers big).
+@ Every CPU keeps a private list of free objects and only touches the shared stack to move whole
+@ batches: the stack holds chains of exactly `batch` objects, so a refill or a spill is a single CAS.
+*/
+typedef struct freelist_node {
+    lfstack_node_t link;        //links chains on the shared stack
+    struct freelist_node* next; //links objects inside a chain or a CPU's cache
+} freelist_node_t;
+
+typedef struct {
+    freelist_node_t* head;
+    uint32_t count;
+} __cacheline_aligned freelist_cache_t;
+
+typedef struct {
+    lfstack_t global;
+    freelist_cache_t* caches; //one per CPU, supplied by the embedder
+    uint32_t batch;
+} freelist_t;
+
+//Sets up a freelist with one cache per CPU that moves batch objects at a time
+static inline void freelist_init(freelist_t* fl, freelist_cache_t* caches, uint32_t cpu_count, uint32_t batch) {
+    lfstack_init(&fl->global);
+    fl->caches = caches;
+    fl->batch = batch;
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        caches[i].head = NULL;
+        caches[i].count = 0;
+    }
+}
+
+//Links n objects of size bytes starting at mem into a chain, returns the last one
+static inline freelist_node_t* __freelist_chain(char* mem, size_t size, uint32_t n) {
+    freelist_node_t* obj = (freelist_node_t*)mem;
+    for (uint32_t i = 1; i < n; i++) {
+        obj->next = (freelist_node_t*)(mem + i * size);
+        obj = obj->next;
+    }
+    obj->next = NULL;
+    return obj;
+}
+
+/*
+@ Carves count objects of size bytes out of mem(size has to keep every object pointer aligned and at least
+@ sizeof(freelist_node_t)) and adds them to the freelist: cpu's cache is topped up to a full batch, whole
+@ batches go onto the shared stack with one CAS each and what is left over goes into cpu's cache as well.
+@ Call it on cpu itself(or before the other CPUs start), it touches that cache without a lock.
+*/
+static inline void freelist_populate(freelist_t* fl, uint32_t cpu, void* mem, size_t size, uint32_t count) {
+    freelist_cache_t* cache = &fl->caches[cpu];
+    char* next = (char*)mem;
+    uint32_t n;
+
+    //the first allocations on cpu shouldn't need the shared stack
+    n = cache->count < fl->batch ? fl->batch - cache->count : 0;
+    n = n < count ? n : count;
+    if (n != 0) {
+        freelist_node_t* last = __freelist_chain(next, size, n);
+        last->next = cache->head;
+        cache->head = (freelist_node_t*)next;
+        cache->count += n;
+        next += n * size;
+        count -= n;
+    }
+
+    for (; count >= fl->batch; count -= fl->batch) {
+        __freelist_chain(next, size, fl->batch);
+        lfstack_push(&fl->global, &((freelist_node_t*)next)->link);
+        next += fl->batch * size;
+    }
+
+    //less than a batch, too few to go onto the stack(a cache that grows past 2 * batch spills on the next free)
+    if (count != 0) {
+        freelist_node_t* last = __freelist_chain(next, size, count);
+        last->next = cache->head;
+        cache->head = (freelist_node_t*)next;
+        cache->count += count;
+    }
+}
+
+//Takes an object from the freelist on the current CPU, returns NULL if there are none left
+static inline void* freelist_alloc(freelist_t* fl, uint32_t cpu) {
+    freelist_cache_t* cache = &fl->caches[cpu];
+    freelist_node_t* obj = cache->head;
+    if (obj == NULL) {
+        obj = (freelist_node_t*)lfstack_pop(&fl->global);
+        if (obj == NULL) {
+            return NULL;
+        }
+        cache->count = fl->batch;
+    }
+    cache->head = obj->next;
+    cache->count--;
+    return obj;
+}
+
+//Gives an object back on the current CPU, a full cache spills one batch to the shared stack
+static inline void freelist_free(freelist_t* fl, uint32_t cpu, void* ptr) {
+    freelist_cache_t* cache = &fl->caches[cpu];
+    freelist_node_t* obj = (freelist_node_t*)ptr;
+    obj->next = cache->head;
+    cache->head = obj;
+    if (++cache->count >= 2 * fl->batch) {
+        freelist_node_t* first = cache->head;
+        freelist_node_t* last = first;
+        for (uint32_t i = 1; i < fl->batch; i++) {
+            last = last->next;
+        }
+        cache->head = last->next;
+        cache->count -= fl->batch;
+        last->next = NULL;
+        lfstack_push(&fl->global, &first->link);
+    }
+}
+
+#endif // __LFSTACK_H__
\ No newline at end of file
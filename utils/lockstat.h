@@ -0,0 +1,198 @@
+/*
+@ KrnlAid lock statistics(lockstat)
+@ Records for every (lock address, __CUR_LOC of the lock() call) pair:
+@ acquisitions, contended acquisitions, total/max spin cycles and total/max hold cycles(measured with rdtsc)
+@
+@ How to use:
+@ 1, define LOCKSTAT for every file that includes utils/spinlock.h, lock()/unlock() become the instrumented variant
+@ 2, define LOCKSTAT_IMPL in exactly one source file to allocate the table and lockstat_dump(),
+@    that file also needs your logger wrapper(see utils/logger.h) included before spinlock.h
+@ 3, call lockstat_dump(n) to print the n most contended locks
+@
+@ Without LOCKSTAT none of this is compiled in and lock()/unlock() are the plain spinlock macros.
+@ The counters of an entry are only ever updated while holding the lock they describe, so they need no atomics.
+@ lockstat_reset() is the exception, see there.
+*/
+
+#ifndef __LOCKSTAT_H__
+#define __LOCKSTAT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "spinlock.h"
+#include "../arch/x86/tsc.h"
+
+//Number of (lock, call site) pairs that can be tracked, has to be a power of 2
+#ifndef LOCKSTAT_ENTRIES
+#define LOCKSTAT_ENTRIES 1024
+#endif
+
+STATIC_ASSERT((LOCKSTAT_ENTRIES & (LOCKSTAT_ENTRIES - 1)) == 0, "LOCKSTAT_ENTRIES must be a power of 2");
+
+//lockstat_entry_t.lock of a slot that is being filled in
+#define LOCKSTAT_CLAIMING ((spinlock_t*)1)
+
+typedef struct {
+    spinlock_t* volatile lock; //NULL if the entry is free, LOCKSTAT_CLAIMING while it is filled in
+    const char* site;
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t spin_total;
+    uint64_t spin_max;
+    uint64_t hold_total;
+    uint64_t hold_max;
+    uint64_t hold_start; //TSC value at acquisition while the lock is held through this entry, 0 otherwise
+} lockstat_entry_t;
+
+extern lockstat_entry_t lockstat_table[LOCKSTAT_ENTRIES];
+
+void lockstat_dump(uint32_t n);
+void lockstat_reset(void);
+
+static inline uint32_t __lockstat_hash(spinlock_t* l) {
+    return (uint32_t)(((uintptr_t)l * 0x9E3779B97F4A7C15ull) >> 40) & (LOCKSTAT_ENTRIES - 1);
+}
+
+/*
+@ Finds(or creates) the entry of a lock and call site, returns NULL if the table is full
+@ A free slot is claimed with a CAS to LOCKSTAT_CLAIMING, filled in and then published with the lock address,
+@ slots being claimed are skipped, so nothing here waits for another CPU(or an interrupted claim on this one).
+@ The caller holds l, so no other CPU can be claiming an entry for the same lock at the same time.
+*/
+static inline lockstat_entry_t* __lockstat_find(spinlock_t* l, const char* site) {
+    uint32_t i = __lockstat_hash(l);
+    for (uint32_t probe = 0; probe < LOCKSTAT_ENTRIES; probe++, i = (i + 1) & (LOCKSTAT_ENTRIES - 1)) {
+        lockstat_entry_t* e = &lockstat_table[i];
+        spinlock_t* owner = __atomic_load_n(&e->lock, __ATOMIC_ACQUIRE);
+        if (owner == NULL) {
+            spinlock_t* expected = NULL;
+            if (!__atomic_compare_exchange_n(&e->lock, &expected, LOCKSTAT_CLAIMING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                owner = expected;
+            } else {
+                e->site = site;
+                __atomic_store_n(&e->lock, l, __ATOMIC_RELEASE);
+                return e;
+            }
+        }
+        if (owner == l && cur_loc_equal(e->site, site)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+//Instrumented lock(), records how long it had to spin
+static inline void lockstat_lock(spinlock_t* l, const char* site) {
+    uint64_t spin = 0;
+    int contended = 0;
+    lockstat_entry_t* e;
+
+    if (__sync_lock_test_and_set(l, 1)) {
+        uint64_t start = rdtsc();
+        contended = 1;
+        while (__sync_lock_test_and_set(l, 1)) {
+            __asm__ __volatile__ ("pause");
+        }
+        spin = rdtsc() - start;
+    }
+
+    e = __lockstat_find(l, site);
+    if (e == NULL) {
+        return;
+    }
+    e->acquired++;
+    e->contended += contended;
+    e->spin_total += spin;
+    if (spin > e->spin_max) {
+        e->spin_max = spin;
+    }
+    e->hold_start = rdtsc() | 1;
+}
+
+//Instrumented unlock(), records how long the lock was held
+static inline void lockstat_unlock(spinlock_t* l) {
+    uint32_t i = __lockstat_hash(l);
+    spinlock_t* owner;
+    //the entry that is holding the lock is the one with the same address and a hold start
+    for (uint32_t probe = 0; probe < LOCKSTAT_ENTRIES; probe++, i = (i + 1) & (LOCKSTAT_ENTRIES - 1)) {
+        owner = __atomic_load_n(&lockstat_table[i].lock, __ATOMIC_ACQUIRE);
+        if (owner == NULL) {
+            break;
+        }
+        if (owner == l && lockstat_table[i].hold_start) {
+            lockstat_entry_t* e = &lockstat_table[i];
+            uint64_t hold = rdtsc() - e->hold_start;
+            e->hold_start = 0;
+            e->hold_total += hold;
+            if (hold > e->hold_max) {
+                e->hold_max = hold;
+            }
+            break;
+        }
+    }
+    __sync_lock_release(l);
+}
+
+#ifdef LOCKSTAT_IMPL
+    #include "logger.h"
+
+    lockstat_entry_t lockstat_table[LOCKSTAT_ENTRIES];
+
+    //Prints the n locks with the most spin cycles through the logger
+    void lockstat_dump(uint32_t n) {
+        uint64_t last_spin = UINT64_MAX;
+        uint32_t last = UINT32_MAX;
+
+        log_info("%-48s %-18s %10s %10s %14s %12s %14s %12s\n",
+                 "site", "lock", "acquired", "contended", "spin total", "spin max", "hold total", "hold max");
+
+        //selection sort by (spin_total descending, index ascending), the table is not reordered
+        for (uint32_t printed = 0; printed < n; printed++) {
+            uint32_t best = UINT32_MAX;
+            for (uint32_t i = 0; i < LOCKSTAT_ENTRIES; i++) {
+                lockstat_entry_t* e = &lockstat_table[i];
+                if (e->lock == NULL || e->lock == LOCKSTAT_CLAIMING || e->acquired == 0) {
+                    continue;
+                }
+                if (e->spin_total > last_spin || (e->spin_total == last_spin && i <= last)) {
+                    continue;
+                }
+                if (best == UINT32_MAX || e->spin_total > lockstat_table[best].spin_total) {
+                    best = i;
+                }
+            }
+            if (best == UINT32_MAX) {
+                break;
+            }
+
+            lockstat_entry_t* e = &lockstat_table[best];
+            log_info("%-48s %-18p %10llu %10llu %14llu %12llu %14llu %12llu\n",
+                     e->site, (void*)e->lock,
+                     (unsigned long long)e->acquired, (unsigned long long)e->contended,
+                     (unsigned long long)e->spin_total, (unsigned long long)e->spin_max,
+                     (unsigned long long)e->hold_total, (unsigned long long)e->hold_max);
+            last_spin = e->spin_total;
+            last = best;
+        }
+    }
+
+    /*
+    @ Clears all counters, locks that are currently held keep their hold start
+    @ It doesn't take the locks(the table keeps the addresses of locks that may have been freed since), so it
+    @ races with lock()/unlock() on other CPUs: an update made meanwhile can survive the reset or leave an entry
+    @ half cleared. Call it while the locks are quiet if the numbers have to add up.
+    */
+    void lockstat_reset(void) {
+        for (uint32_t i = 0; i < LOCKSTAT_ENTRIES; i++) {
+            lockstat_entry_t* e = &lockstat_table[i];
+            e->acquired = 0;
+            e->contended = 0;
+            e->spin_total = 0;
+            e->spin_max = 0;
+            e->hold_total = 0;
+            e->hold_max = 0;
+        }
+    }
+#endif
+
+#endif // __LOCKSTAT_H__
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+@ KrnlAid epoch based reclamation(RCU-lite)
+@ Lets lock-free readers walk shared data while writers unlink and free it:
+@ freed objects are only handed back once every CPU has left the read sections that could still see them.
+@
+@ How it works:
+@ - the domain has a global epoch, a CPU in a read section announces the epoch it saw
+@ - the epoch can only advance once every CPU in a read section has announced the current one
+@ - an object retired in epoch E can be freed once the global epoch reached E + 2
+@ - retired objects are batched per CPU and per epoch, so one epoch advance covers all of them
+@
+@ How to use:
+@ 1, allocate an rcu_domain_t and one rcu_cpu_t per CPU(or thread), call rcu_domain_init
+@ 2, readers: rcu_read_lock(cpu) ... rcu_dereference(ptr) ... rcu_read_unlock(cpu)
+@ 3, writers: unlink with rcu_assign_pointer, then call_rcu(cpu, &obj->rcu, free_func)
+@ 4, call rcu_poll(cpu) from time to time(idle loop, timer tick), call_rcu also polls once RCU_BATCH callbacks piled up
+@ Every rcu_cpu_t must only be used by the CPU it belongs to.
+@ The read side is a plain store and a fence, no atomic read-modify-write.
+*/
+
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cache.h"
+
+//Number of callbacks a CPU queues before call_rcu tries to advance the epoch on its own
+#ifndef RCU_BATCH
+#define RCU_BATCH 64
+#endif
+
+typedef struct rcu_head {
+    struct rcu_head* next;
+    void (*func)(struct rcu_head* head);
+} rcu_head_t;
+
+typedef struct rcu_domain rcu_domain_t;
+
+typedef struct {
+    volatile uint64_t state; //(epoch << 1) | 1 while in a read section, 0 otherwise
+    uint32_t nesting;
+    uint32_t pending_count;
+    rcu_domain_t* domain;
+    rcu_head_t* pending[3];   //callbacks retired in epoch E are in pending[E % 3]
+    uint64_t pending_epoch[3];
+} __cacheline_aligned rcu_cpu_t;
+
+struct rcu_domain {
+    volatile uint64_t epoch __cacheline_aligned;
+    rcu_cpu_t* cpus;
+    uint32_t cpu_count;
+};
+
+//Reads an RCU protected pointer inside a read section
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+//Publishes a pointer to readers, everything written to the object before is visible to them
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+//Sets up a domain and the per-CPU states supplied by the embedder
+static inline void rcu_domain_init(rcu_domain_t* domain, rcu_cpu_t* cpus, uint32_t cpu_count) {
+    domain->epoch = 0;
+    domain->cpus = cpus;
+    domain->cpu_count = cpu_count;
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        cpus[i].state = 0;
+        cpus[i].nesting = 0;
+        cpus[i].pending_count = 0;
+        cpus[i].domain = domain;
+        for (int b = 0; b < 3; b++) {
+            cpus[i].pending[b] = NULL;
+            cpus[i].pending_epoch[b] = 0;
+        }
+    }
+}
+
+//Enters a read section, can nest
+static inline void rcu_read_lock(rcu_cpu_t* cpu) {
+    if (cpu->nesting++ == 0) {
+        __atomic_store_n(&cpu->state, (__atomic_load_n(&cpu->domain->epoch, __ATOMIC_RELAXED) << 1) | 1, __ATOMIC_RELAXED);
+        //the announcement has to be visible before the first protected load(store-load ordering needs MFENCE on x86)
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+//Leaves a read section
+static inline void rcu_read_unlock(rcu_cpu_t* cpu) {
+    if (--cpu->nesting == 0) {
+        __atomic_store_n(&cpu->state, 0, __ATOMIC_RELEASE);
+    }
+}
+
+//Advances the global epoch if every CPU in a read section has seen the current one, returns 1 on success
+static inline int rcu_try_advance(rcu_domain_t* domain) {
+    uint64_t epoch = __atomic_load_n(&domain->epoch, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < domain->cpu_count; i++) {
+        uint64_t state = __atomic_load_n(&domain->cpus[i].state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return 0;
+        }
+    }
+    return __atomic_compare_exchange_n(&domain->epoch, &epoch, epoch + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+//Runs the callbacks of a bucket
+static inline void __rcu_run_bucket(rcu_cpu_t* cpu, int bucket) {
+    rcu_head_t* head = cpu->pending[bucket];
+    cpu->pending[bucket] = NULL;
+    while (head != NULL) {
+        rcu_head_t* next = head->next;
+        cpu->pending_count--;
+        head->func(head);
+        head = next;
+    }
+}
+
+//Runs every callback of this CPU whose grace period is over
+static inline void rcu_reclaim(rcu_cpu_t* cpu) {
+    uint64_t epoch = __atomic_load_n(&cpu->domain->epoch, __ATOMIC_ACQUIRE);
+    for (int b = 0; b < 3; b++) {
+        if (cpu->pending[b] != NULL && cpu->pending_epoch[b] + 2 <= epoch) {
+            __rcu_run_bucket(cpu, b);
+        }
+    }
+}
+
+//Tries to advance the epoch and then reclaims, call it periodically on every CPU
+static inline void rcu_poll(rcu_cpu_t* cpu) {
+    rcu_try_advance(cpu->domain);
+    rcu_reclaim(cpu);
+}
+
+//Queues func(head) to be called once no reader can see the object anymore, the object has to be unlinked already
+static inline void call_rcu(rcu_cpu_t* cpu, rcu_head_t* head, void (*func)(rcu_head_t* head)) {
+    uint64_t epoch;
+    int bucket;
+
+    head->func = func;
+    //the unlink has to be visible before the epoch is sampled
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    epoch = __atomic_load_n(&cpu->domain->epoch, __ATOMIC_RELAXED);
+
+    //a bucket that still holds an older epoch is at least 3 epochs old, so it is safe to run
+    bucket = (int)(epoch % 3);
+    if (cpu->pending_epoch[bucket] != epoch) {
+        __rcu_run_bucket(cpu, bucket);
+        cpu->pending_epoch[bucket] = epoch;
+    }
+    head->next = cpu->pending[bucket];
+    cpu->pending[bucket] = head;
+
+    if (++cpu->pending_count >= RCU_BATCH) {
+        rcu_poll(cpu);
+    }
+}
+
+//Waits for a full grace period, must not be called from inside a read section
+static inline void synchronize_rcu(rcu_cpu_t* cpu) {
+    uint64_t target = __atomic_load_n(&cpu->domain->epoch, __ATOMIC_SEQ_CST) + 2;
+    while (__atomic_load_n(&cpu->domain->epoch, __ATOMIC_ACQUIRE) < target) {
+        if (!rcu_try_advance(cpu->domain)) {
+            __asm__ __volatile__ ("pause");
+        }
+    }
+    rcu_reclaim(cpu);
+}
+
+#endif // __RCU_H__
\ No newline at end of file
@@ -0,0 +1,177 @@
+/*
+@ KrnlAid lock-free ring buffers
+@ - spsc_ring_t: wait-free single producer/single consumer ring(e.g. IRQ handler -> worker thread)
+@ - mpmc_ring_t: bounded multi producer/multi consumer queue with per-slot sequence numbers(Dmitry Vyukov's design)
+@ Both carry void* items, the slot storage is supplied by the caller and its size has to be a power of 2.
+@ The producer and consumer indices sit on their own cache lines, the *_burst functions move up to n items
+@ with one index update(one CAS for the MPMC queue) and return how many they actually moved.
+*/
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cache.h"
+
+//=================SPSC ring=================
+
+typedef struct {
+    void** slots;
+    uint32_t mask;
+    volatile uint32_t head __cacheline_aligned; //next slot to read, only written by the consumer
+    uint32_t tail_cache;                          //consumer's last view of tail
+    volatile uint32_t tail __cacheline_aligned; //next slot to write, only written by the producer
+    uint32_t head_cache;                          //producer's last view of head
+} spsc_ring_t;
+
+//Sets up an SPSC ring on top of size slots(size has to be a power of 2)
+static inline void spsc_ring_init(spsc_ring_t* ring, void** slots, uint32_t size) {
+    ring->slots = slots;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->tail = 0;
+    ring->head_cache = 0;
+}
+
+//Producer: enqueues up to n items, returns how many were enqueued
+static inline uint32_t spsc_enqueue_burst(spsc_ring_t* ring, void* const* items, uint32_t n) {
+    uint32_t tail = ring->tail;
+    uint32_t free = ring->mask + 1 - (tail - ring->head_cache);
+    //only touch the consumer's cache line when the cached view says the ring is full
+    if (free < n) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        free = ring->mask + 1 - (tail - ring->head_cache);
+        if (n > free) {
+            n = free;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        ring->slots[(tail + i) & ring->mask] = items[i];
+    }
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+//Consumer: dequeues up to n items, returns how many were dequeued
+static inline uint32_t spsc_dequeue_burst(spsc_ring_t* ring, void** items, uint32_t n) {
+    uint32_t head = ring->head;
+    uint32_t used = ring->tail_cache - head;
+    if (used < n) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        used = ring->tail_cache - head;
+        if (n > used) {
+            n = used;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        items[i] = ring->slots[(head + i) & ring->mask];
+    }
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+//Producer: enqueues one item, returns 0 if the ring is full
+static inline int spsc_enqueue(spsc_ring_t* ring, void* item) {
+    return spsc_enqueue_burst(ring, &item, 1);
+}
+
+//Consumer: dequeues one item, returns 0 if the ring is empty
+static inline int spsc_dequeue(spsc_ring_t* ring, void** item) {
+    return spsc_dequeue_burst(ring, item, 1);
+}
+
+//=================MPMC ring=================
+
+typedef struct {
+    volatile uint32_t seq;
+    void* data;
+} mpmc_cell_t;
+
+typedef struct {
+    mpmc_cell_t* cells;
+    uint32_t mask;
+    volatile uint32_t enqueue_pos __cacheline_aligned;
+    volatile uint32_t dequeue_pos __cacheline_aligned;
+} __cacheline_aligned mpmc_ring_t;
+
+//Sets up an MPMC queue on top of size cells(size has to be a power of 2)
+static inline void mpmc_ring_init(mpmc_ring_t* ring, mpmc_cell_t* cells, uint32_t size) {
+    ring->cells = cells;
+    ring->mask = size - 1;
+    for (uint32_t i = 0; i < size; i++) {
+        cells[i].seq = i;
+        cells[i].data = NULL;
+    }
+    ring->enqueue_pos = 0;
+    ring->dequeue_pos = 0;
+}
+
+/*
+@ Reserves up to n consecutive tickets starting at *pos on the index at *index
+@ A cell is free for ticket t when its sequence is t + offset(offset = 0 for producers, 1 for consumers).
+@ The free cells in front of *pos stay free until their ticket is taken, so one CAS claims all of them.
+*/
+static inline uint32_t __mpmc_reserve(mpmc_ring_t* ring, volatile uint32_t* index, uint32_t* pos, uint32_t n, uint32_t offset) {
+    uint32_t p = __atomic_load_n(index, __ATOMIC_RELAXED);
+    for (;;) {
+        uint32_t k = 0;
+        int32_t diff = 0;
+        while (k < n) {
+            diff = (int32_t)(__atomic_load_n(&ring->cells[(p + k) & ring->mask].seq, __ATOMIC_ACQUIRE) - (p + k + offset));
+            if (diff != 0) {
+                break;
+            }
+            k++;
+        }
+        if (k == 0) {
+            if (diff < 0) {
+                return 0; //full(producers) or empty(consumers)
+            }
+            //someone else took the ticket, start over from the current index
+            p = __atomic_load_n(index, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(index, &p, p + k, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            *pos = p;
+            return k;
+        }
+    }
+}
+
+//Enqueues up to n items, returns how many were enqueued
+static inline uint32_t mpmc_enqueue_burst(mpmc_ring_t* ring, void* const* items, uint32_t n) {
+    uint32_t pos;
+    n = __mpmc_reserve(ring, &ring->enqueue_pos, &pos, n, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        mpmc_cell_t* cell = &ring->cells[(pos + i) & ring->mask];
+        cell->data = items[i];
+        __atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+//Dequeues up to n items, returns how many were dequeued
+static inline uint32_t mpmc_dequeue_burst(mpmc_ring_t* ring, void** items, uint32_t n) {
+    uint32_t pos;
+    n = __mpmc_reserve(ring, &ring->dequeue_pos, &pos, n, 1);
+    for (uint32_t i = 0; i < n; i++) {
+        mpmc_cell_t* cell = &ring->cells[(pos + i) & ring->mask];
+        items[i] = cell->data;
+        __atomic_store_n(&cell->seq, pos + i + ring->mask + 1, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+//Enqueues one item, returns 0 if the queue is full
+static inline int mpmc_enqueue(mpmc_ring_t* ring, void* item) {
+    return mpmc_enqueue_burst(ring, &item, 1);
+}
+
+//Dequeues one item, returns 0 if the queue is empty
+static inline int mpmc_dequeue(mpmc_ring_t* ring, void** item) {
+    return mpmc_dequeue_burst(ring, item, 1);
+}
+
+#endif // __RING_H__
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+@ KrnlAid reader-writer spinlock
+@ Readers increment a counter in one of RWLOCK_SHARDS cache lines picked by the current CPU,
+@ so the read side scales with cores instead of bouncing one line between all of them.
+@ Writers are preferred: as soon as a writer shows up new readers back off until it is done.
+@ Read sections may nest on one CPU(an IRQ handler reading the table the interrupted code is reading):
+@ a CPU that is already inside read_lock only waits for a writer that holds the lock, never for one
+@ that is still waiting for the readers to drain(that writer is waiting for this very CPU).
+@ The lock is RWLOCK_SHARDS + 1 cache lines big, use it for mostly-read data(routing tables, handler tables, device lists)
+@
+@ How to use:
+@ 1, define __kcpu_id() (returns the index of the current CPU, below RWLOCK_MAX_CPUS)
+@ 2, include utils/rwlock.h
+@ 3, keep preemption disabled between read_lock and read_unlock(like for any other spinlock)
+*/
+
+#ifndef __RWLOCK_H__
+#define __RWLOCK_H__
+
+#include <stdint.h>
+#include "cache.h"
+
+#ifndef __kcpu_id
+#error "Please define __kcpu_id()"
+#endif
+
+//Number of reader counters, can be overriden(more shards = cheaper reads but slower writes)
+#ifndef RWLOCK_SHARDS
+#define RWLOCK_SHARDS 16
+#endif
+
+//Highest supported CPU count, can be overriden(every CPU has a nesting depth byte in its shard)
+#ifndef RWLOCK_MAX_CPUS
+#define RWLOCK_MAX_CPUS 256
+#endif
+
+//Values of rwlock_t::writer
+#define RWLOCK_WRITER_WAITING 1
+#define RWLOCK_WRITER_LOCKED 2
+
+typedef struct {
+    volatile uint32_t count;
+    //read_lock nesting depth of the CPUs using this shard, only touched by the CPU itself
+    volatile uint8_t depth[(RWLOCK_MAX_CPUS + RWLOCK_SHARDS - 1) / RWLOCK_SHARDS];
+} __cacheline_aligned rwlock_shard_t;
+
+typedef struct {
+    volatile uint32_t writer __cacheline_aligned;
+    rwlock_shard_t readers[RWLOCK_SHARDS];
+} rwlock_t;
+
+#define RWLOCK_INIT { 0 }
+
+//Whether a reader has to stay out while the writer flag is `writer`
+static inline int __read_blocked(uint32_t writer, uint8_t nested) {
+    return nested ? writer == RWLOCK_WRITER_LOCKED : writer != 0;
+}
+
+//Takes the lock for reading, any number of readers can hold it at the same time
+static inline void read_lock(rwlock_t* rw) {
+    uint32_t cpu = __kcpu_id();
+    rwlock_shard_t* shard = &rw->readers[cpu % RWLOCK_SHARDS];
+    volatile uint8_t* depth = &shard->depth[cpu / RWLOCK_SHARDS];
+    //raised before the counter, an IRQ hitting in between takes the nested path, which only costs fairness
+    uint8_t nested = *depth;
+    *depth = nested + 1;
+    for (;;) {
+        //the increment has to be visible before the writer flag is checked, LOCK XADD is a full barrier
+        __atomic_fetch_add(&shard->count, 1, __ATOMIC_SEQ_CST);
+        if (!__read_blocked(__atomic_load_n(&rw->writer, __ATOMIC_SEQ_CST), nested)) {
+            return;
+        }
+        //a writer is waiting or holds the lock, get out of its way
+        __atomic_fetch_sub(&shard->count, 1, __ATOMIC_RELEASE);
+        while (__read_blocked(__atomic_load_n(&rw->writer, __ATOMIC_RELAXED), nested)) {
+            __asm__ __volatile__ ("pause");
+        }
+    }
+}
+
+//Releases a read lock, must run on the same CPU that called read_lock
+static inline void read_unlock(rwlock_t* rw) {
+    uint32_t cpu = __kcpu_id();
+    rwlock_shard_t* shard = &rw->readers[cpu % RWLOCK_SHARDS];
+    __atomic_fetch_sub(&shard->count, 1, __ATOMIC_RELEASE);
+    shard->depth[cpu / RWLOCK_SHARDS]--;
+}
+
+//Whether every reader counter is zero
+static inline int __rwlock_drained(rwlock_t* rw) {
+    for (uint32_t i = 0; i < RWLOCK_SHARDS; i++) {
+        if (__atomic_load_n(&rw->readers[i].count, __ATOMIC_SEQ_CST)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//Takes the lock for writing: blocks out new readers first, then waits for the current ones to drain
+static inline void write_lock(rwlock_t* rw) {
+    uint32_t expected = 0;
+    while (!__atomic_compare_exchange_n(&rw->writer, &expected, RWLOCK_WRITER_WAITING, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        while (__atomic_load_n(&rw->writer, __ATOMIC_RELAXED)) {
+            __asm__ __volatile__ ("pause");
+        }
+        expected = 0;
+    }
+    for (;;) {
+        while (!__rwlock_drained(rw)) {
+            __asm__ __volatile__ ("pause");
+        }
+        //nested readers still get in while the flag says WAITING, so check again after LOCKED is visible,
+        //the store and the reader's increment are both full barriers, one of them sees the other
+        __atomic_store_n(&rw->writer, RWLOCK_WRITER_LOCKED, __ATOMIC_SEQ_CST);
+        if (__rwlock_drained(rw)) {
+            return;
+        }
+        __atomic_store_n(&rw->writer, RWLOCK_WRITER_WAITING, __ATOMIC_SEQ_CST);
+    }
+}
+
+//Releases a write lock
+static inline void write_unlock(rwlock_t* rw) {
+    __atomic_store_n(&rw->writer, 0, __ATOMIC_RELEASE);
+}
+
+#endif // __RWLOCK_H__
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+@ KrnlAid sequence locks
+@ For small, hot, mostly read data(timekeeping, statistics, config snapshots):
+@ readers never write shared memory, they just retry if a writer got in the way.
+@
+@ Read side:
+@   uint32_t seq;
+@   do {
+@       seq = read_seqbegin(&sl);
+@       copy = data;
+@   } while (read_seqretry(&sl, seq));
+@
+@ seqlock_t carries its own spinlock_t to serialize writers(write_seqlock/write_sequnlock).
+@ If the data is already protected by a spinlock_t use a bare seqcount_t and call
+@ write_seqcount_begin/write_seqcount_end while holding that lock.
+@ Readers must not dereference pointers read inside the section before the retry check passed.
+*/
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+#include "spinlock.h"
+
+typedef struct {
+    volatile uint32_t sequence; //odd while a write is in progress
+} seqcount_t;
+
+typedef struct {
+    seqcount_t seqcount;
+    spinlock_t lock;
+} seqlock_t;
+
+#define SEQCOUNT_INIT { 0 }
+#define SEQLOCK_INIT { SEQCOUNT_INIT, 0 }
+
+//Starts a read section, waits out a write in progress
+static inline uint32_t read_seqcount_begin(const seqcount_t* s) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1) {
+        __asm__ __volatile__ ("pause");
+    }
+    return seq;
+}
+
+//Ends a read section, returns non zero if the data read since read_seqcount_begin may be torn
+static inline int read_seqcount_retry(const seqcount_t* s, uint32_t start) {
+    //x86 never reorders loads with loads, this only stops the compiler from doing so
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != start;
+}
+
+//Starts a write section, the caller has to serialize writers
+static inline void write_seqcount_begin(seqcount_t* s) {
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELAXED);
+    //the odd sequence has to be visible before any of the data stores
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+//Ends a write section
+static inline void write_seqcount_end(seqcount_t* s) {
+    __atomic_store_n(&s->sequence, s->sequence + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t read_seqbegin(const seqlock_t* sl) {
+    return read_seqcount_begin(&sl->seqcount);
+}
+
+static inline int read_seqretry(const seqlock_t* sl, uint32_t start) {
+    return read_seqcount_retry(&sl->seqcount, start);
+}
+
+//Takes the writer lock and starts a write section
+static inline void write_seqlock(seqlock_t* sl) {
+    lock(sl->lock);
+    write_seqcount_begin(&sl->seqcount);
+}
+
+//Ends a write section and releases the writer lock
+static inline void write_sequnlock(seqlock_t* sl) {
+    write_seqcount_end(&sl->seqcount);
+    unlock(sl->lock);
+}
+
+#endif // __SEQLOCK_H__
\ No newline at end of file
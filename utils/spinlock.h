@@ -1,11 +1,183 @@
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cache.h"
+#include "debug.h"
+
 typedef char spinlock_t;
 
-#define lock(lock) do { \
+#define __spin_lock(lock) do { \
     while (__sync_lock_test_and_set(&lock, 1)) { \
         asm volatile ("pause"); \
     } \
 } while (0)
 
-#define unlock(lock) do { \
+#define __spin_unlock(lock) do { \
     __sync_lock_release(&lock); \
-} while (0)
\ No newline at end of file
+} while (0)
+
+//With LOCKSTAT defined lock()/unlock() record contention statistics, see utils/lockstat.h
+#ifdef LOCKSTAT
+    #define lock(lock) lockstat_lock(&(lock), __CUR_LOC)
+    #define unlock(lock) lockstat_unlock(&(lock))
+#else
+    #define lock(lock) __spin_lock(lock)
+    #define unlock(lock) __spin_unlock(lock)
+#endif
+
+/*
+@ Queued spinlock(qspinlock): a 4 byte MCS lock for heavily contended locks
+@ Uncontended it costs a single CMPXCHG, contended every waiter spins on its own per-CPU node
+@ instead of everyone hammering the cache line of the lock
+@ To use it:
+@ 1, define __kcpu_id() (returns the index of the current CPU) before including this header
+@ 2, define SPINLOCK_IMPL in exactly one source file to allocate the queue nodes
+@ 3, keep preemption disabled while waiting for or holding the lock
+*/
+#ifdef __kcpu_id
+
+//Maximum number of CPUs that can queue on a qspinlock, can be overriden
+#ifndef QSPINLOCK_MAX_CPUS
+#define QSPINLOCK_MAX_CPUS 256
+#endif
+
+//How deep qspinlocks can nest on one CPU(task, softirq, irq, nmi)
+#define QSPINLOCK_MAX_NESTING 4
+
+/*
+@ Layout of the lock word:
+@ bits 0-7:   locked byte
+@ bits 8-15:  unused
+@ bits 16-17: nesting index of the node at the tail of the queue
+@ bits 18-31: CPU index + 1 of the node at the tail of the queue(0 means the queue is empty)
+*/
+#define QSPINLOCK_LOCKED_MASK   0x000000FF
+#define QSPINLOCK_TAIL_IDX_MASK 0x00030000
+#define QSPINLOCK_TAIL_CPU_MASK 0xFFFC0000
+#define QSPINLOCK_TAIL_MASK     0xFFFF0000
+#define QSPINLOCK_TAIL_SHIFT    16
+
+STATIC_ASSERT(QSPINLOCK_MAX_CPUS < (1 << 14), "QSPINLOCK_MAX_CPUS does not fit in the tail of the lock word");
+
+typedef union {
+    volatile uint32_t val;
+    struct {
+        volatile uint8_t locked;
+        uint8_t unused;
+        volatile uint16_t tail;
+    };
+} qspinlock_t;
+
+STATIC_ASSERT(sizeof(qspinlock_t) == 4, "qspinlock_t must fit in 4 bytes");
+
+//Per-CPU queue node, each one has its own cache line so waiters never share one
+typedef struct qspin_node {
+    struct qspin_node* volatile next;
+    volatile uint32_t locked;
+    uint32_t count; //nesting depth, only used in the first node of every CPU
+} __cacheline_aligned qspin_node_t;
+
+#define QSPINLOCK_INIT { 0 }
+
+extern qspin_node_t qspin_nodes[QSPINLOCK_MAX_CPUS][QSPINLOCK_MAX_NESTING];
+
+void qspin_lock_slowpath(qspinlock_t* lock);
+
+//Tries to take a qspinlock once, returns 1 on success
+static inline int qspin_trylock(qspinlock_t* lock) {
+    uint32_t expected = 0;
+    return __atomic_compare_exchange_n(&lock->val, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+//Takes a qspinlock
+static inline void qspin_lock(qspinlock_t* lock) {
+    if (qspin_trylock(lock)) {
+        return;
+    }
+    qspin_lock_slowpath(lock);
+}
+
+//Releases a qspinlock, only the locked byte is touched so queued CPUs are left alone
+static inline void qspin_unlock(qspinlock_t* lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline int qspin_is_locked(qspinlock_t* lock) {
+    return __atomic_load_n(&lock->val, __ATOMIC_RELAXED) != 0;
+}
+
+#ifdef SPINLOCK_IMPL
+    qspin_node_t qspin_nodes[QSPINLOCK_MAX_CPUS][QSPINLOCK_MAX_NESTING];
+
+    void qspin_lock_slowpath(qspinlock_t* lock) {
+        uint32_t cpu = __kcpu_id();
+        uint32_t idx = qspin_nodes[cpu][0].count++;
+        uint32_t tail, val;
+        qspin_node_t* node;
+        qspin_node_t* next;
+
+        //out of nodes(NMI inside of NMI?), just spin on the lock word
+        if (idx >= QSPINLOCK_MAX_NESTING) {
+            while (!qspin_trylock(lock)) {
+                __asm__ __volatile__ ("pause");
+            }
+            goto release;
+        }
+
+        node = &qspin_nodes[cpu][idx];
+        node->locked = 0;
+        node->next = NULL;
+        tail = ((cpu + 1) << 2 | idx) << QSPINLOCK_TAIL_SHIFT;
+
+        //the owner might have left while the node was set up
+        if (qspin_trylock(lock)) {
+            goto release;
+        }
+
+        //publish the node as the new tail of the queue
+        val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&lock->val, &val, (val & ~QSPINLOCK_TAIL_MASK) | tail, 1,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        }
+
+        //link behind the previous tail and wait until it hands the head of the queue over
+        if (val & QSPINLOCK_TAIL_MASK) {
+            uint32_t prev = val >> QSPINLOCK_TAIL_SHIFT;
+            __atomic_store_n(&qspin_nodes[(prev >> 2) - 1][prev & 3].next, node, __ATOMIC_RELEASE);
+            while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+                __asm__ __volatile__ ("pause");
+            }
+        }
+
+        //head of the queue: only this CPU spins on the lock word itself
+        while ((val = __atomic_load_n(&lock->val, __ATOMIC_ACQUIRE)) & QSPINLOCK_LOCKED_MASK) {
+            __asm__ __volatile__ ("pause");
+        }
+
+        //last in the queue: take the lock and empty the queue in one go
+        if ((val & QSPINLOCK_TAIL_MASK) == tail &&
+            __atomic_compare_exchange_n(&lock->val, &val, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            goto release;
+        }
+
+        //someone queued behind us, nobody else can set the locked byte while the queue is not empty
+        __atomic_store_n(&lock->locked, 1, __ATOMIC_RELAXED);
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            __asm__ __volatile__ ("pause");
+        }
+        __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+
+    release:
+        qspin_nodes[cpu][0].count--;
+    }
+#endif
+
+#endif // __kcpu_id
+
+#ifdef LOCKSTAT
+#include "lockstat.h"
+#endif
+
+#endif // __SPINLOCK_H__
\ No newline at end of file
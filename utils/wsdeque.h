@@ -0,0 +1,148 @@
+/*
+@ KrnlAid work-stealing deque(Chase-Lev, with the fences from Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models")
+@ One per CPU run queue: the owning CPU pushes and pops work at the bottom, idle CPUs steal from the top.
+@ - wsdeque_push: owner only, plain stores(x86 keeps stores in order, the release only stops the compiler)
+@ - wsdeque_pop:  owner only, one MFENCE and a CAS only when racing a thief for the last item
+@ - wsdeque_steal: any CPU, one CAS
+@ Items are pointers other than WSDEQUE_EMPTY(NULL) and WSDEQUE_ABORT(1). The deque grows on demand, replaced arrays stay alive(thieves may still
+@ be reading them) until wsdeque_destroy.
+@
+@ IMPORTANT: you must define MALLOC_IMPL(n) and FREE_IMPL(p) before including this header
+*/
+
+#ifndef __WSDEQUE_H__
+#define __WSDEQUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cache.h"
+
+#ifndef MALLOC_IMPL
+#error "Please define MALLOC_IMPL(n)"
+#endif
+#ifndef FREE_IMPL
+#error "Please define FREE_IMPL(p)"
+#endif
+
+//Returned by wsdeque_pop and wsdeque_steal if there was nothing to take
+#define WSDEQUE_EMPTY ((void*)0)
+//Returned by wsdeque_steal if it lost a race, try again(or another victim)
+#define WSDEQUE_ABORT ((void*)1)
+
+typedef struct wsdeque_array {
+    struct wsdeque_array* prev; //the array this one replaced
+    int64_t size;
+    void* volatile items[];
+} wsdeque_array_t;
+
+typedef struct {
+    volatile int64_t top __cacheline_aligned;    //taken from by thieves
+    volatile int64_t bottom __cacheline_aligned; //only written by the owner
+    wsdeque_array_t* volatile array;
+} wsdeque_t;
+
+static inline wsdeque_array_t* __wsdeque_alloc_array(int64_t size, wsdeque_array_t* prev) {
+    wsdeque_array_t* a = (wsdeque_array_t*)MALLOC_IMPL(sizeof(wsdeque_array_t) + size * sizeof(void*));
+    if (a != NULL) {
+        a->prev = prev;
+        a->size = size;
+    }
+    return a;
+}
+
+//Sets up an empty deque with room for size(power of 2) items, returns 0 if the allocation failed
+static inline int wsdeque_init(wsdeque_t* dq, int64_t size) {
+    dq->top = 0;
+    dq->bottom = 0;
+    dq->array = __wsdeque_alloc_array(size, NULL);
+    return dq->array != NULL;
+}
+
+//Frees the deque's arrays, nobody may use it anymore
+static inline void wsdeque_destroy(wsdeque_t* dq) {
+    wsdeque_array_t* a = dq->array;
+    while (a != NULL) {
+        wsdeque_array_t* prev = a->prev;
+        FREE_IMPL(a);
+        a = prev;
+    }
+    dq->array = NULL;
+}
+
+//Owner: pushes an item to the bottom, returns 0 if the deque was full and could not grow
+static inline int wsdeque_push(wsdeque_t* dq, void* item) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    wsdeque_array_t* a = __atomic_load_n(&dq->array, __ATOMIC_RELAXED);
+
+    if (b - t > a->size - 1) {
+        wsdeque_array_t* grown = __wsdeque_alloc_array(a->size * 2, a);
+        if (grown == NULL) {
+            return 0;
+        }
+        for (int64_t i = t; i < b; i++) {
+            grown->items[i & (grown->size - 1)] = a->items[i & (a->size - 1)];
+        }
+        __atomic_store_n(&dq->array, grown, __ATOMIC_RELEASE);
+        a = grown;
+    }
+    a->items[b & (a->size - 1)] = item;
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+//Owner: pops the most recently pushed item, returns WSDEQUE_EMPTY if there is none
+static inline void* wsdeque_pop(wsdeque_t* dq) {
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    wsdeque_array_t* a = __atomic_load_n(&dq->array, __ATOMIC_RELAXED);
+    int64_t t;
+    void* item;
+
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    //the new bottom has to be visible to thieves before top is read(store-load, MFENCE on x86)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        //already empty
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return WSDEQUE_EMPTY;
+    }
+    item = a->items[b & (a->size - 1)];
+    if (t == b) {
+        //last item, race the thieves for it
+        if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            item = WSDEQUE_EMPTY;
+        }
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return item;
+}
+
+//Any CPU: steals the oldest item, returns WSDEQUE_EMPTY or WSDEQUE_ABORT if it got nothing
+static inline void* wsdeque_steal(wsdeque_t* dq) {
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    int64_t b;
+    wsdeque_array_t* a;
+    void* item;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return WSDEQUE_EMPTY;
+    }
+    a = __atomic_load_n(&dq->array, __ATOMIC_CONSUME);
+    item = a->items[t & (a->size - 1)];
+    if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return WSDEQUE_ABORT;
+    }
+    return item;
+}
+
+//Rough number of items in the deque, for load balancing decisions
+static inline int64_t wsdeque_size(wsdeque_t* dq) {
+    int64_t n = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+    return n < 0 ? 0 : n;
+}
+
+#endif // __WSDEQUE_H__
\ No newline at end of file